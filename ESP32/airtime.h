@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================
+// LoRa Airtime and Uplink Budget Governor
+// ============================================
+//
+// Time-on-air follows the Semtech SX127x formula (AN1200.13) for the frame
+// the module actually transmits: application payload plus the LoRaWAN MAC
+// overhead. The budget is a token bucket refilled continuously from the
+// local clock; low-priority uplinks (periodic reports) wait for enough
+// tokens, high-priority ones (cleanups) always go out and may run the
+// bucket into debt, which later reports then pay back.
+
+#define LORAWAN_FRAME_OVERHEAD    13     // MHDR (1) + DevAddr (4) + FCtrl (1) + FCnt (2) + FPort (1) + MIC (4)
+#define LORA_PREAMBLE_SYMBOLS     8
+#define LORA_CODING_RATE          1      // 4/5
+
+// Rolling budget: TTN fair-use policy allows 30 s of uplink airtime per 24 h
+#define AIRTIME_BUDGET_MS         30000UL
+#define AIRTIME_WINDOW_MS         (24UL * 3600UL * 1000UL)
+#define AIRTIME_MAX_DEBT_MS       AIRTIME_BUDGET_MS  // Debt from high-priority uplinks is capped at one budget
+
+#define AIRTIME_MAGIC             0x41495254UL // "AIRT"
+#define LORA_DEFAULT_DATA_RATE    0      // Assume the slowest rate until the module says otherwise
+
+#define UPLINK_PRIORITY_LOW       0      // May be deferred and coalesced (periodic reports)
+#define UPLINK_PRIORITY_HIGH      1      // Always sent (worker cleanups)
+
+// Class A receive windows (AU915): RX1 opens the RX1 delay after the end of
+// the uplink, RX2 1 s later at DR8 (SF12, 500 kHz); nothing can arrive after
+// RX2. The network sets the RX1 delay in the join accept (1-15 s, 5 s on The
+// Things Stack); the firmware asks the module for it after each join
+#define LORAWAN_RX1_DELAY_DEFAULT_MS 5000  // Until the module has reported one
+#define LORAWAN_RX1_DELAY_MAX_MS  15000
+#define LORAWAN_RX2_AFTER_RX1_MS  1000
+#define LORAWAN_RX2_SF            12
+#define LORAWAN_RX2_BW_KHZ        500
+#define LORAWAN_MAX_DOWNLINK      53     // Largest application payload at DR8
+#define LORAWAN_RX_MARGIN_MS      500    // Module processing and UART output of the RX: line
+
+// Budget state - kept in RTC memory so it survives deep sleep
+struct AirtimeBudgetState {
+  uint32_t magic;
+  uint8_t  data_rate;          // Last data rate reported by the module
+  uint16_t rx1_delay_ms;       // RX1 delay reported by the module (0 = not asked since the join)
+  int32_t  tokens_ms;          // Available airtime (negative = debt)
+  int64_t  last_refill_ms;     // Local clock of the last refill
+  uint32_t deferred_uplinks;   // Low-priority uplinks deferred since power-on
+  uint32_t total_airtime_ms;   // Airtime spent since power-on
+};
+
+// AU915 data rates (Brazil): DR0-DR5 = SF12-SF7 at 125 kHz, DR6 = SF8 at 500 kHz
+// Returns false for data rates that are not valid uplink rates
+inline bool lora_data_rate_params(uint8_t data_rate, uint8_t& sf, uint16_t& bw_khz) {
+  if (data_rate <= 5) {
+    sf = 12 - data_rate;
+    bw_khz = 125;
+    return true;
+  }
+  if (data_rate == 6) {
+    sf = 8;
+    bw_khz = 500;
+    return true;
+  }
+  return false;
+}
+
+// AU915 downlink data rates (RX2 and class C): DR8-DR13 = SF12-SF7 at 500 kHz
+inline bool lora_downlink_data_rate_params(uint8_t data_rate, uint8_t& sf, uint16_t& bw_khz) {
+  if (data_rate < 8 || data_rate > 13) return false;
+  sf = 12 - (data_rate - 8);
+  bw_khz = 500;
+  return true;
+}
+
+// Time-on-air in microseconds for an application payload at the given SF/BW
+inline uint32_t lora_airtime_us(size_t payload_length, uint8_t sf, uint16_t bw_khz) {
+  uint32_t phy_length = (uint32_t)payload_length + LORAWAN_FRAME_OVERHEAD;
+  uint32_t symbol_us = ((uint32_t)1 << sf) * 1000UL / bw_khz;
+
+  // Low data rate optimization is mandatory for SF11/SF12 at 125 kHz
+  int de = (sf >= 11 && bw_khz == 125) ? 1 : 0;
+
+  // Explicit header, CRC on
+  int numerator = 8 * (int)phy_length - 4 * sf + 28 + 16;
+  int denominator = 4 * (sf - 2 * de);
+  int blocks = numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+  uint32_t payload_symbols = 8 + (uint32_t)blocks * (LORA_CODING_RATE + 4);
+
+  // Preamble is (n + 4.25) symbols
+  uint32_t preamble_us = LORA_PREAMBLE_SYMBOLS * symbol_us + (symbol_us * 17) / 4;
+  return preamble_us + payload_symbols * symbol_us;
+}
+
+// Time-on-air in milliseconds (rounded up) at a LoRaWAN data rate
+inline uint32_t lora_airtime_ms_for_data_rate(size_t payload_length, uint8_t data_rate) {
+  uint8_t sf;
+  uint16_t bw_khz;
+  if (!lora_data_rate_params(data_rate, sf, bw_khz)) {
+    lora_data_rate_params(LORA_DEFAULT_DATA_RATE, sf, bw_khz);
+  }
+  return (lora_airtime_us(payload_length, sf, bw_khz) + 999) / 1000;
+}
+
+// RX1 delay to plan the receive windows with
+inline uint32_t lorawan_rx1_delay_ms(const AirtimeBudgetState& state) {
+  return state.rx1_delay_ms != 0 ? state.rx1_delay_ms : LORAWAN_RX1_DELAY_DEFAULT_MS;
+}
+
+// Time from the start of an uplink until both of its receive windows have
+// closed and a downlink received in RX2 has been printed by the module
+inline uint32_t lorawan_rx_windows_ms(uint32_t uplink_airtime_ms, uint32_t rx1_delay_ms) {
+  uint32_t rx2_airtime_ms = (lora_airtime_us(LORAWAN_MAX_DOWNLINK, LORAWAN_RX2_SF, LORAWAN_RX2_BW_KHZ) + 999) / 1000;
+  return uplink_airtime_ms + rx1_delay_ms + LORAWAN_RX2_AFTER_RX1_MS + rx2_airtime_ms + LORAWAN_RX_MARGIN_MS;
+}
+
+// Reset the budget (power-on or corrupted RTC memory) - starts full
+inline void airtime_budget_init(AirtimeBudgetState& state, int64_t local_ms) {
+  state.magic = AIRTIME_MAGIC;
+  state.data_rate = LORA_DEFAULT_DATA_RATE;
+  state.rx1_delay_ms = 0;
+  state.tokens_ms = (int32_t)AIRTIME_BUDGET_MS;
+  state.last_refill_ms = local_ms;
+  state.deferred_uplinks = 0;
+  state.total_airtime_ms = 0;
+}
+
+// Add the tokens earned since the last refill
+inline void airtime_budget_refill(AirtimeBudgetState& state, int64_t local_ms) {
+  int64_t elapsed_ms = local_ms - state.last_refill_ms;
+  if (elapsed_ms <= 0) return;
+
+  int64_t earned = (elapsed_ms * (int64_t)AIRTIME_BUDGET_MS) / (int64_t)AIRTIME_WINDOW_MS;
+  if (earned <= 0) return;  // Keep last_refill_ms so fractions accumulate
+
+  int64_t tokens = state.tokens_ms + earned;
+  if (tokens > (int64_t)AIRTIME_BUDGET_MS) tokens = AIRTIME_BUDGET_MS;
+  state.tokens_ms = (int32_t)tokens;
+  state.last_refill_ms = local_ms;
+}
+
+// Decide whether an uplink of the given airtime may be sent now
+inline bool airtime_budget_allow(AirtimeBudgetState& state, int64_t local_ms,
+                                 uint32_t airtime_ms, uint8_t priority) {
+  airtime_budget_refill(state, local_ms);
+
+  if (priority == UPLINK_PRIORITY_HIGH) return true;
+  return state.tokens_ms >= (int32_t)airtime_ms;
+}
+
+// Charge a transmitted uplink against the budget
+// Debt is capped so a burst of cleanups can't silence reports for days
+inline void airtime_budget_charge(AirtimeBudgetState& state, uint32_t airtime_ms) {
+  state.tokens_ms -= (int32_t)airtime_ms;
+  if (state.tokens_ms < -(int32_t)AIRTIME_MAX_DEBT_MS) {
+    state.tokens_ms = -(int32_t)AIRTIME_MAX_DEBT_MS;
+  }
+  state.total_airtime_ms += airtime_ms;
+}
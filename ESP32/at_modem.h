@@ -0,0 +1,246 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "text.h"
+
+// ============================================
+// Radioenge AT Modem Driver
+// ============================================
+//
+// AT transactions with the LoRaWAN module, independent of the Arduino core.
+// The functions are templates over:
+//   Port  - serial link: int available(), int read(), println(const char*)
+//   Clock - time source: unsigned long millis(), void delay(unsigned long), void idle()
+// The firmware passes Serial1 and the Arduino clock; the host-side modem
+// emulator (tools/modem_emu) passes a scripted fake and a virtual clock, so
+// the same timing logic can be measured deterministically.
+//
+// Downlinks are reported by the module as "RX:HEXDATA:PORT:RSSI:SNR" lines,
+// usually some time after the OK of the AT+SENDB that opened the RX windows.
+
+#define LORA_DR_QUERY_CMD        "AT+DR=?"  // Query the current (ADR-managed) data rate
+#define LORA_RX1_DELAY_QUERY_CMD "AT+RX1DL=?"  // Query the RX1 delay (ms) set by the join accept
+#define LORA_CLASS_A_CMD         "AT+CLASS=A"
+#define LORA_CLASS_C_CMD         "AT+CLASS=C"  // Receive continuously (multicast windows)
+
+// Timing used by the firmware
+#define AT_MODULE_BOOT_MS        3000   // Module boot time after power-up of the UART
+#define AT_COMMAND_TIMEOUT_MS    2000   // Wait for OK (plain commands)
+#define AT_SENDB_TIMEOUT_MS      5000   // Wait for OK (AT+SENDB)
+#define AT_JOIN_MAX_RETRIES      3
+#define AT_JOIN_TIMEOUT_MS       60000  // Per attempt
+#define AT_JOIN_SETTLE_MS        500    // Pause after draining the buffer, before AT+JOIN
+#define AT_JOIN_RETRY_DELAY_MS   5000   // Pause between join attempts
+#define AT_UPLINK_GAP_MS         2000   // Pause between back-to-back uplinks (module answers ERROR while busy)
+
+#define AT_RESPONSE_MAX_LENGTH   512    // Longer responses are truncated
+#define AT_DOWNLINK_MAX_LENGTH   64     // Largest downlink payload kept (bytes)
+#define AT_SENDB_MAX_LENGTH      128    // "AT+SENDB=<port>:" + hex of the largest uplink + NUL
+#define AT_MCAST_MAX_LENGTH      112    // AT+MCAST command with both session keys + NUL
+
+enum AtJoinResult {
+  AT_JOIN_OK,
+  AT_JOIN_FAILED,    // Module answered ERROR / Join Failed
+  AT_JOIN_TIMEOUT    // No answer within the timeout
+};
+
+// Raw module response, NUL-terminated
+struct AtResponse {
+  char   text[AT_RESPONSE_MAX_LENGTH + 1];
+  size_t length;
+};
+
+// One parsed RX: line
+struct AtDownlink {
+  uint8_t data[AT_DOWNLINK_MAX_LENGTH];
+  size_t  length;
+  int     port;
+  int     rssi;
+  float   snr;
+};
+
+inline void at_response_clear(AtResponse& response) {
+  response.length = 0;
+  response.text[0] = '\0';
+}
+
+inline void at_response_append(AtResponse& response, char c) {
+  if (response.length >= AT_RESPONSE_MAX_LENGTH) return;
+  response.text[response.length++] = c;
+  response.text[response.length] = '\0';
+}
+
+// Build "AT+SENDB=<port>:<HEX>" into out, returns its length (0 if out is too small)
+inline size_t at_format_sendb(char* out, size_t size, int port, const uint8_t* data, size_t length) {
+  int prefix = snprintf(out, size, "AT+SENDB=%d:", port);
+  if (prefix < 0 || (size_t)prefix >= size) return 0;
+
+  size_t hex_length = hex_encode(out + prefix, size - (size_t)prefix, data, length);
+  if (hex_length == 0 && length > 0) return 0;
+  return (size_t)prefix + hex_length;
+}
+
+// Build "AT+MCAST=<ADDR>:<NWKSKEY>:<APPSKEY>:<FREQ_HZ>:<DR>" (hex address and
+// keys, decimal frequency and data rate), which gives the module the multicast
+// session it then receives on in class C; returns its length (0 if out is too small)
+inline size_t at_format_mcast(char* out, size_t size, uint32_t group_addr, const uint8_t* nwk_skey,
+                              const uint8_t* app_skey, uint32_t frequency_hz, uint8_t data_rate) {
+  int prefix = snprintf(out, size, "AT+MCAST=%08lX:", (unsigned long)group_addr);
+  if (prefix < 0 || (size_t)prefix >= size) return 0;
+  size_t length = (size_t)prefix;
+
+  size_t hex_length = hex_encode(out + length, size - length, nwk_skey, 16);
+  if (hex_length == 0 || length + hex_length + 1 >= size) return 0;
+  length += hex_length;
+  out[length++] = ':';
+
+  hex_length = hex_encode(out + length, size - length, app_skey, 16);
+  if (hex_length == 0) return 0;
+  length += hex_length;
+
+  int suffix = snprintf(out + length, size - length, ":%lu:%u", (unsigned long)frequency_hz, data_rate);
+  if (suffix < 0 || length + (size_t)suffix >= size) return 0;
+  return length + (size_t)suffix;
+}
+
+// Parse "RX:HEXDATA:PORT:RSSI:SNR" (PORT, RSSI and SNR are optional)
+// line must start at "RX:"; parsing stops at the end of the line
+inline bool at_parse_rx_line(const char* line, AtDownlink& downlink) {
+  if (strncmp(line, "RX:", 3) != 0) return false;
+
+  downlink.length = 0;
+  downlink.port = 0;
+  downlink.rssi = 0;
+  downlink.snr = 0;
+
+  size_t consumed = 0;
+  TextView hex = text_view(line + 3, strcspn(line + 3, ":\r\n"));
+  downlink.length = hex_decode(hex, downlink.data, AT_DOWNLINK_MAX_LENGTH, &consumed);
+  const char* p = line + 3 + consumed;
+  if (*p != ':') return false;  // Odd digit count or garbage in the payload
+
+  char* end;
+  downlink.port = (int)strtol(p + 1, &end, 10);
+  if (*end != ':') return true;
+  downlink.rssi = (int)strtol(end + 1, &end, 10);
+  if (*end != ':') return true;
+  downlink.snr = strtof(end + 1, NULL);
+  return true;
+}
+
+// First RX: line in a response, or NULL
+inline const char* at_find_rx(const char* response) {
+  return strstr(response, "RX:");
+}
+
+// First number in the answer to a query command (a possible command echo is
+// skipped), or -1 if the answer holds no number
+inline long at_parse_query_number(const char* response, const char* command) {
+  const char* echo = strstr(response, command);
+  const char* start = echo ? echo + strlen(command) : response;
+  return text_first_number(text_view(start));
+}
+
+// Data rate from the answer to AT+DR=?, or -1
+inline int at_parse_data_rate(const char* response) {
+  return (int)at_parse_query_number(response, LORA_DR_QUERY_CMD);
+}
+
+// RX1 delay in milliseconds from the answer to AT+RX1DL=?, or -1
+inline long at_parse_rx1_delay(const char* response) {
+  return at_parse_query_number(response, LORA_RX1_DELAY_QUERY_CMD);
+}
+
+// Send one command and wait for OK
+// After OK the response keeps being captured for post_ok_wait ms (RX lines
+// arrive after the OK of AT+SENDB); 0 returns right after OK.
+template <typename Port, typename Clock>
+bool at_command(Port& port, Clock& clock, const char* command, unsigned long timeout,
+                unsigned long post_ok_wait, AtResponse& response) {
+  while (port.available()) {
+    port.read();
+  }
+
+  port.println(command);
+  at_response_clear(response);
+
+  unsigned long start = clock.millis();
+  bool found_ok = false;
+  unsigned long ok_time = 0;
+  char previous = '\0';
+
+  while (true) {
+    if (!found_ok && clock.millis() - start >= timeout) break;
+    if (found_ok && clock.millis() - ok_time >= post_ok_wait) break;
+
+    if (port.available()) {
+      char c = (char)port.read();
+      at_response_append(response, c);
+
+      if (!found_ok && previous == 'O' && c == 'K') {
+        found_ok = true;
+        ok_time = clock.millis();
+      }
+      previous = c;
+    } else {
+      clock.idle();
+    }
+  }
+
+  return found_ok;
+}
+
+// One OTAA join attempt (OTAA can take 30-60 seconds)
+template <typename Port, typename Clock>
+AtJoinResult at_join(Port& port, Clock& clock, unsigned long timeout, AtResponse& response) {
+  while (port.available()) {
+    port.read();
+  }
+
+  // Give module time to settle after clearing buffer
+  clock.delay(AT_JOIN_SETTLE_MS);
+
+  port.println("AT+JOIN");
+  at_response_clear(response);
+
+  unsigned long start = clock.millis();
+  while (clock.millis() - start < timeout) {
+    if (!port.available()) {
+      clock.idle();
+      continue;
+    }
+
+    at_response_append(response, (char)port.read());
+
+    if (strstr(response.text, "OK") || strstr(response.text, "JOINED") ||
+        strstr(response.text, "Join Success")) {
+      return AT_JOIN_OK;
+    }
+    if (strstr(response.text, "ERROR") || strstr(response.text, "Join Failed")) {
+      return AT_JOIN_FAILED;
+    }
+  }
+  return AT_JOIN_TIMEOUT;
+}
+
+// Join with retries; on_attempt (optional) is told the outcome of every attempt
+// Returns true once joined
+template <typename Port, typename Clock>
+bool at_join_network(Port& port, Clock& clock, int max_retries, unsigned long timeout,
+                     AtResponse& response,
+                     void (*on_attempt)(int attempt, int max_retries, AtJoinResult result) = NULL) {
+  for (int attempt = 1; attempt <= max_retries; attempt++) {
+    AtJoinResult result = at_join(port, clock, timeout, response);
+    if (on_attempt) on_attempt(attempt, max_retries, result);
+    if (result == AT_JOIN_OK) return true;
+
+    if (attempt < max_retries) {
+      clock.delay(AT_JOIN_RETRY_DELAY_MS);
+    }
+  }
+  return false;
+}
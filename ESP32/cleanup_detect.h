@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================
+// Inferred Cleanup Detection
+// ============================================
+//
+// Fallback for a worker who empties the bin without tapping a card: a sharp
+// drop of the filtered fill level that holds for CLEANUP_CONFIRM_READINGS
+// readings in a row is reported as an inferred cleanup, which the backend
+// matches with a later (or earlier) RFID cleanup. The detector takes one
+// reading per wake (the first: the report, or the expired active window), so
+// the candidate drop waits in RTC memory and the bin never stays awake to
+// confirm it; a motion wake reads the level twice, but the second reading is
+// taken with someone still at the bin. A single short
+// reading (an echo off the lid or a hand) does not survive the
+// confirmation, and a reading that is no lower than the filtered level by
+// the drop threshold cancels a pending drop. An authorized tap resets the
+// filter, so the drop after a real cleanup is not reported twice.
+
+#define CLEANUP_DROP_PCT           30.0f  // Drop below the filtered level, in fill points
+#define CLEANUP_MIN_LEVEL_PCT      35.0f  // Filtered level the bin must have reached
+#define CLEANUP_CONFIRM_READINGS   3      // Consecutive low readings (one per wake) for a detection
+#define CLEANUP_LEVEL_ALPHA        0.5f   // Weight of a new reading in the filtered level
+
+#define CLEANUP_DETECT_NONE        0
+#define CLEANUP_DETECT_PENDING     1  // Drop seen, more readings needed
+#define CLEANUP_DETECT_DETECTED    2
+
+// Kept in RTC memory
+struct CleanupDetectState {
+  uint8_t known;        // 0 until the first reading after a reset
+  uint8_t low_readings; // Consecutive readings below the drop threshold
+  float   level_pct;    // Filtered fill level
+  float   low_pct;      // Highest of the low readings (level after the drop)
+  int64_t low_since_ms; // Local clock of the first low reading (when the drop happened)
+  uint32_t read_wake;   // Wake (RtcState.wake_count) of the last reading taken, 0 = none
+};
+
+// Inferred cleanup not yet reported upstream (kept in RTC memory)
+struct InferredCleanupReport {
+  uint8_t pending;
+  uint8_t channel;      // Ultrasound channel (compartment) that was emptied
+  uint8_t before_pct;   // Filtered level before the drop
+  uint8_t after_pct;    // Level after the drop
+  int64_t detected_ms;  // Local clock of the detection
+};
+
+// Forget the level (power-on, corrupted RTC memory or authorized cleanup)
+inline void cleanup_detect_reset(CleanupDetectState& state) {
+  state.known = 0;
+  state.low_readings = 0;
+  state.level_pct = 0;
+  state.low_pct = 0;
+  state.low_since_ms = 0;
+  state.read_wake = 0;
+}
+
+// Feed a fill reading (0-100 %, negative = invalid) taken at local_ms;
+// returns CLEANUP_DETECT_*. On DETECTED, before_pct/after_pct hold the levels,
+// low_since_ms still holds the time of the drop and the filter restarts from
+// the level after it
+inline uint8_t cleanup_detect_update(CleanupDetectState& state, float fill_pct, int64_t local_ms,
+                                     uint8_t& before_pct, uint8_t& after_pct) {
+  if (fill_pct < 0) {
+    return state.low_readings > 0 ? CLEANUP_DETECT_PENDING : CLEANUP_DETECT_NONE;
+  }
+  if (!state.known) {
+    state.level_pct = fill_pct;
+    state.known = 1;
+    return CLEANUP_DETECT_NONE;
+  }
+
+  bool low = state.level_pct >= CLEANUP_MIN_LEVEL_PCT && fill_pct <= state.level_pct - CLEANUP_DROP_PCT;
+  if (!low) {
+    state.low_readings = 0;
+    state.level_pct += CLEANUP_LEVEL_ALPHA * (fill_pct - state.level_pct);
+    return CLEANUP_DETECT_NONE;
+  }
+
+  if (state.low_readings == 0) state.low_since_ms = local_ms;
+  if (state.low_readings == 0 || fill_pct > state.low_pct) state.low_pct = fill_pct;
+  state.low_readings++;
+  if (state.low_readings < CLEANUP_CONFIRM_READINGS) return CLEANUP_DETECT_PENDING;
+
+  before_pct = (uint8_t)(state.level_pct + 0.5f);
+  after_pct = (uint8_t)(state.low_pct + 0.5f);
+  state.level_pct = state.low_pct;
+  state.low_readings = 0;
+  return CLEANUP_DETECT_DETECTED;
+}
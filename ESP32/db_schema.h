@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+// ============================================
+// Whitelist Database Schema
+// ============================================
+//
+// Statements that create the whitelist database, run in order by init_db.cpp
+// when a device is provisioned and by main.cpp when it rebuilds a damaged
+// database from the golden snapshot (golden_whitelist.h). All of them are
+// idempotent.
+
+#define DB_PATH  "/littlefs/database.db"
+
+static const char* const db_schema_statements[] = {
+  // Role table (reference table for integrity)
+  "CREATE TABLE IF NOT EXISTS role ("
+  "role_code TEXT PRIMARY KEY"
+  ")",
+  "INSERT OR IGNORE INTO role (role_code) VALUES ('WORKER')",
+  "INSERT OR IGNORE INTO role (role_code) VALUES ('ADMIN')",
+  // User table with FK to role
+  "CREATE TABLE IF NOT EXISTS user ("
+  "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+  "name TEXT NOT NULL, "
+  "rfid_tag_id TEXT NOT NULL UNIQUE, "
+  "role TEXT NOT NULL, "
+  "FOREIGN KEY (role) REFERENCES role(role_code)"
+  ")",
+  // Index on rfid_tag_id for faster lookups
+  "CREATE INDEX IF NOT EXISTS idx_user_rfid ON user(rfid_tag_id)",
+};
+
+#define DB_SCHEMA_STATEMENT_COUNT  (sizeof(db_schema_statements) / sizeof(db_schema_statements[0]))
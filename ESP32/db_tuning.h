@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <sqlite3.h>
+
+// ============================================
+// SQLite Tuning
+// ============================================
+//
+// Settings for the whitelist database on LittleFS, shared by the firmware
+// and the host benchmarks (tools/bench) so both measure the same thing.
+//
+// Page cache: a fixed pool of DB_CACHE_PAGES slots handed to SQLite with
+// SQLITE_CONFIG_PAGECACHE before the database is opened. main.cpp places it
+// in PSRAM, which keeps the internal heap free for the modem, FreeRTOS and
+// JSON results; pages that do not fit fall back to the heap and show up as
+// page cache in the memory telemetry.
+//
+// Journal: TRUNCATE keeps one journal file and truncates it on commit
+// instead of creating and deleting it for every transaction, which on
+// LittleFS costs a directory update each time. EXCLUSIVE locking holds the
+// file lock for the whole connection (the firmware is the only user) and
+// skips the lock calls per transaction.
+//
+// Durability: synchronous NORMAL skips the syncs FULL adds around the
+// journal header. SQLite documents a very small chance of corruption on a
+// power loss at the wrong moment when the file system reorders writes;
+// LittleFS is copy-on-write and commits a file's new contents atomically
+// on sync, so the remaining risk is losing the last transaction. The only
+// writes are whitelist changes from downlinks, which the backend can send
+// again. WAL would save more syncs but needs shared memory that the ESP32
+// VFS does not provide.
+//
+// Memory-mapped reads: requested with mmap_size; SQLite ignores it where
+// the VFS has no xFetch (LittleFS on the ESP32) and the value read back is 0.
+
+#define DB_PAGE_SIZE     4096        // Set by init_db.cpp when the database is created
+#define DB_CACHE_PAGES   64          // Page cache slots (about 260 KB with headers)
+#define DB_MMAP_SIZE     262144      // 256 KB
+
+#define DB_TUNING_STR(x)  #x
+#define DB_TUNING_XSTR(x) DB_TUNING_STR(x)
+
+// Applied in order right after opening the database
+static const char* const db_tuning_pragmas[] = {
+  "PRAGMA locking_mode = EXCLUSIVE;",
+  "PRAGMA journal_mode = TRUNCATE;",
+  "PRAGMA synchronous = NORMAL;",
+  "PRAGMA cache_size = " DB_TUNING_XSTR(DB_CACHE_PAGES) ";",
+  "PRAGMA temp_store = MEMORY;",
+  "PRAGMA mmap_size = " DB_TUNING_XSTR(DB_MMAP_SIZE) ";",
+};
+
+#define DB_TUNING_PRAGMA_COUNT  (sizeof(db_tuning_pragmas) / sizeof(db_tuning_pragmas[0]))
+
+// Bytes per page cache slot: a page plus SQLite's per-page header
+inline int db_page_cache_slot_size() {
+  int header = 0;
+  sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &header);
+  return DB_PAGE_SIZE + header;
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+// ============================================
+// Delta Firmware Patches
+// ============================================
+//
+// A patch rebuilds the new firmware image from the running one, so an update
+// over LoRaWAN costs the changed bytes instead of the whole image. It is a
+// header followed by four operations: ADD (literal bytes), COPY_OLD (a range
+// of the running image), COPY_NEXT (the running image at the cursor, which
+// follows the last COPY_OLD and advances with every byte written, so code
+// between two small edits costs two bytes) and COPY_NEW (a range of the image
+// written so far, for repeats inside the new code). Numbers are unsigned LEB128 varints and
+// the header is little-endian, as in the LoRaWAN fragmentation package that
+// carries the patch (frag_session.h).
+//
+//   [magic "DLTP"] [old size] [old CRC-32] [new size] [new CRC-32]
+//   { [op] [varints] [literal bytes] } ... [END]
+//
+// The patch is only applied to the image it was made from (old CRC) and the
+// output is checked against the new CRC before main.cpp switches slots;
+// esp_ota_end() then validates the ESP-IDF image itself. tools/ota_patch
+// builds patches with the matching encoder and replays them over lossy
+// fragment delivery through this code.
+//
+// Streams are small interfaces, as in golden_whitelist.h:
+//   patch:  bool read(offset, data, length)   reassembled fragments
+//   old:    bool read(offset, data, length)   running image
+//   out:    bool write(data, length)          appended in order
+//           bool read(offset, data, length)   bytes already written
+
+#define PATCH_MAGIC        0x50544C44UL // "DLTP"
+#define PATCH_HEADER_SIZE  20
+#define PATCH_CHUNK        256          // Bytes moved per read/write
+
+#define PATCH_OP_ADD       0x00  // [length] [bytes]
+#define PATCH_OP_COPY_OLD  0x01  // [offset] [length]
+#define PATCH_OP_COPY_NEW  0x02  // [offset] [length]; may overlap the output end
+#define PATCH_OP_COPY_NEXT 0x03  // [length] from the old image cursor
+#define PATCH_OP_END       0xFF
+
+// Result codes (also the status of the OTA report uplink)
+#define PATCH_OK              0x00
+#define PATCH_BAD_HEADER      0x01
+#define PATCH_OLD_MISMATCH    0x02  // Running image is not the one the patch was made from
+#define PATCH_CORRUPT         0x03  // Unknown op, range out of bounds or truncated patch
+#define PATCH_IO_ERROR        0x04
+#define PATCH_NEW_MISMATCH    0x05  // Output size or CRC differs from the header
+#define PATCH_INSTALL_FAILED  0x06  // Image rejected or boot slot not switched (device only)
+
+inline const char* patch_status_name(uint8_t status) {
+  switch (status) {
+    case PATCH_OK:             return "ok";
+    case PATCH_BAD_HEADER:     return "bad header";
+    case PATCH_OLD_MISMATCH:   return "old image mismatch";
+    case PATCH_CORRUPT:        return "corrupt patch";
+    case PATCH_IO_ERROR:       return "I/O error";
+    case PATCH_NEW_MISMATCH:   return "new image mismatch";
+    case PATCH_INSTALL_FAILED: return "install failed";
+    default:                   return "unknown";
+  }
+}
+
+struct PatchHeader {
+  uint32_t magic;
+  uint32_t old_size;
+  uint32_t old_crc;
+  uint32_t new_size;
+  uint32_t new_crc;
+};
+
+// Pending OTA report, kept in RTC memory (and NVS across the restart into the
+// new image) until the uplink goes out
+struct OtaReport {
+  uint8_t  pending;
+  uint8_t  status;    // PATCH_*
+  uint32_t new_crc;   // Image the patch targeted
+};
+
+inline void patch_put_u32le(uint8_t* p, uint32_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+inline uint32_t patch_get_u32le(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void patch_header_encode(const PatchHeader& header, uint8_t* out) {
+  patch_put_u32le(out, header.magic);
+  patch_put_u32le(out + 4, header.old_size);
+  patch_put_u32le(out + 8, header.old_crc);
+  patch_put_u32le(out + 12, header.new_size);
+  patch_put_u32le(out + 16, header.new_crc);
+}
+
+inline PatchHeader patch_header_decode(const uint8_t* in) {
+  PatchHeader header;
+  header.magic = patch_get_u32le(in);
+  header.old_size = patch_get_u32le(in + 4);
+  header.old_crc = patch_get_u32le(in + 8);
+  header.new_size = patch_get_u32le(in + 12);
+  header.new_crc = patch_get_u32le(in + 16);
+  return header;
+}
+
+// Appends a varint; returns the bytes written (at most 5)
+inline size_t patch_put_varint(uint8_t* out, uint32_t value) {
+  size_t n = 0;
+  while (value >= 0x80) {
+    out[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+// ============================================
+// Applying
+// ============================================
+
+// Buffered sequential reader over the patch
+template <typename In>
+struct PatchReader {
+  In&      in;
+  uint32_t size;
+  uint32_t offset;
+  uint8_t  buffer[64];
+  uint32_t start;
+  uint32_t length;
+  bool     io_error;
+
+  PatchReader(In& in_, uint32_t size_) : in(in_), size(size_), offset(0), start(0), length(0), io_error(false) {}
+
+  bool byte(uint8_t& value) {
+    if (offset >= start + length) {
+      if (offset >= size) return false;
+      start = offset;
+      length = size - offset < sizeof(buffer) ? size - offset : sizeof(buffer);
+      if (!in.read(start, buffer, length)) {
+        length = 0;
+        io_error = true;
+        return false;
+      }
+    }
+    value = buffer[offset++ - start];
+    return true;
+  }
+
+  bool varint(uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t b;
+      if (!byte(b)) return false;
+      value |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+};
+
+// CRC-32 of the first size bytes of a stream
+template <typename Stream>
+bool patch_stream_crc(Stream& stream, uint32_t size, uint32_t& crc) {
+  uint8_t chunk[PATCH_CHUNK];
+  crc = 0;
+  for (uint32_t offset = 0; offset < size;) {
+    uint32_t n = size - offset < sizeof(chunk) ? size - offset : sizeof(chunk);
+    if (!stream.read(offset, chunk, n)) return false;
+    crc = crc32_update(crc, chunk, n);
+    offset += n;
+  }
+  return true;
+}
+
+template <typename In>
+uint8_t delta_patch_read_header(In& in, uint32_t patch_size, PatchHeader& header) {
+  uint8_t raw[PATCH_HEADER_SIZE];
+  if (patch_size < PATCH_HEADER_SIZE + 1) return PATCH_BAD_HEADER;
+  if (!in.read(0, raw, sizeof(raw))) return PATCH_IO_ERROR;
+  header = patch_header_decode(raw);
+  return header.magic == PATCH_MAGIC ? PATCH_OK : PATCH_BAD_HEADER;
+}
+
+// Rebuild the new image into out; PATCH_OK once its size and CRC match
+template <typename In, typename Old, typename Out>
+uint8_t delta_patch_apply(In& in, uint32_t patch_size, Old& old, Out& out) {
+  PatchHeader header;
+  uint8_t status = delta_patch_read_header(in, patch_size, header);
+  if (status != PATCH_OK) return status;
+
+  uint32_t old_crc;
+  if (!patch_stream_crc(old, header.old_size, old_crc)) return PATCH_IO_ERROR;
+  if (old_crc != header.old_crc) return PATCH_OLD_MISMATCH;
+
+  PatchReader<In> reader(in, patch_size);
+  reader.offset = PATCH_HEADER_SIZE;
+  uint8_t chunk[PATCH_CHUNK];
+  uint32_t written = 0;
+  uint32_t cursor = 0;  // Old image offset for COPY_NEXT
+  uint32_t crc = 0;
+
+  for (;;) {
+    uint8_t op;
+    if (!reader.byte(op)) return reader.io_error ? PATCH_IO_ERROR : PATCH_CORRUPT;
+    if (op == PATCH_OP_END) break;
+
+    uint32_t source = 0;
+    uint32_t length;
+    if (op == PATCH_OP_COPY_OLD || op == PATCH_OP_COPY_NEW) {
+      if (!reader.varint(source)) return PATCH_CORRUPT;
+    } else if (op == PATCH_OP_COPY_NEXT) {
+      source = cursor;
+      op = PATCH_OP_COPY_OLD;
+    } else if (op != PATCH_OP_ADD) {
+      return PATCH_CORRUPT;
+    }
+    if (!reader.varint(length)) return PATCH_CORRUPT;
+    if (length > header.new_size - written) return PATCH_CORRUPT;
+    if (op == PATCH_OP_COPY_OLD && (source > header.old_size || length > header.old_size - source)) {
+      return PATCH_CORRUPT;
+    }
+    if (op == PATCH_OP_COPY_NEW && source >= written) return PATCH_CORRUPT;
+    cursor = (op == PATCH_OP_COPY_OLD ? source : cursor) + length;
+
+    while (length > 0) {
+      uint32_t n = length < sizeof(chunk) ? length : sizeof(chunk);
+      if (op == PATCH_OP_ADD) {
+        for (uint32_t i = 0; i < n; i++) {
+          if (!reader.byte(chunk[i])) return PATCH_CORRUPT;
+        }
+      } else if (op == PATCH_OP_COPY_OLD) {
+        if (!old.read(source, chunk, n)) return PATCH_IO_ERROR;
+      } else {
+        // Overlapping copies repeat the bytes just written
+        if (n > written - source) n = written - source;
+        if (!out.read(source, chunk, n)) return PATCH_IO_ERROR;
+      }
+      if (!out.write(chunk, n)) return PATCH_IO_ERROR;
+      crc = crc32_update(crc, chunk, n);
+      written += n;
+      source += n;
+      length -= n;
+    }
+  }
+
+  if (written != header.new_size || crc != header.new_crc) return PATCH_NEW_MISMATCH;
+  return PATCH_OK;
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+// ============================================
+// Runtime Device Configuration
+// ============================================
+//
+// Typed configuration block persisted in NVS (Preferences) as a single blob
+// and cached in RTC memory so warm wakes skip the NVS read. Each field can
+// be changed over the air with a SET_CONFIG downlink:
+//   [OP (1)] [PARAM_ID (1)] [VALUE (big-endian, size depends on param)]
+// Every change is range-checked and answered with a CONFIG_ACK uplink.
+//
+// A controller may drive several ultrasound sensors, one per compartment of
+// a station (e.g. common waste and recycling side by side). Channel 0 is the
+// primary sensor and uses depth_mm; the others have their own depth. The
+// number of channels is fixed by the firmware build, not by a downlink.
+
+#define DEVICE_NAME_LENGTH        6
+#define CONFIG_MAGIC              0x43464721UL // "CFG!"
+#define CONFIG_VERSION            3
+#define SENSOR_CHANNELS_MAX       4     // Ultrasound channels per controller
+
+// Parameter IDs and their value sizes in the SET_CONFIG downlink
+#define CFG_PARAM_SLEEP_INTERVAL  0x01  // uint32 seconds (report period)
+#define CFG_PARAM_ACTIVE_WINDOW   0x02  // uint32 milliseconds
+#define CFG_PARAM_DEPTH           0x03  // uint16 millimeters
+#define CFG_PARAM_DOWNLINK_WAIT   0x04  // uint32 milliseconds
+#define CFG_PARAM_NAME            0x05  // 6 ASCII characters
+#define CFG_PARAM_DIAGNOSTICS     0x06  // uint8 0 = off, 1 = memory diagnostics uplink after each report
+#define CFG_PARAM_CHANNEL_DEPTH   0x07  // uint8 channel, uint16 millimeters
+
+// Valid ranges
+#define CFG_SLEEP_INTERVAL_MIN_S  60
+#define CFG_SLEEP_INTERVAL_MAX_S  86400
+#define CFG_ACTIVE_WINDOW_MIN_MS  5000
+#define CFG_ACTIVE_WINDOW_MAX_MS  300000
+#define CFG_DEPTH_MIN_MM          100
+#define CFG_DEPTH_MAX_MM          3000
+#define CFG_DOWNLINK_WAIT_MAX_MS  60000
+
+// Result codes carried in CONFIG_ACK
+#define CFG_STATUS_APPLIED        0x00
+#define CFG_STATUS_OUT_OF_RANGE   0x01
+#define CFG_STATUS_BAD_LENGTH     0x02
+#define CFG_STATUS_UNKNOWN_PARAM  0x03
+#define CFG_STATUS_STORAGE_ERROR  0x04
+
+struct DeviceConfig {
+  uint32_t magic;
+  uint16_t version;
+  uint32_t sleep_interval_s;       // Report period (timer wake-up)
+  uint32_t active_window_ms;       // Stay awake after wake-up waiting for RFID
+  uint16_t depth_mm;               // Sensor to bottom distance when empty
+  uint32_t downlink_wait_ms;       // Upper bound on the listen window after each uplink
+  char     name[DEVICE_NAME_LENGTH + 1];
+  uint8_t  diagnostics;            // Opt-in memory diagnostics uplink (version 2; was padding)
+  uint8_t  channel_count;          // Ultrasound channels wired (version 3; set by the firmware)
+  uint8_t  reserved;
+  uint16_t channel_depth_mm[SENSOR_CHANNELS_MAX - 1];  // Depth of channels 1 and up (version 3)
+  uint32_t crc;                    // CRC-32 of everything above
+};
+
+// Layout of versions 1 and 2, for the upgrade from an older NVS blob
+struct DeviceConfigV2 {
+  uint32_t magic;
+  uint16_t version;
+  uint32_t sleep_interval_s;
+  uint32_t active_window_ms;
+  uint16_t depth_mm;
+  uint32_t downlink_wait_ms;
+  char     name[DEVICE_NAME_LENGTH + 1];
+  uint8_t  diagnostics;
+  uint32_t crc;
+};
+
+inline uint32_t device_config_crc(const DeviceConfig& config) {
+  return crc32_buffer(&config, offsetof(DeviceConfig, crc));
+}
+
+inline void device_config_seal(DeviceConfig& config) {
+  config.magic = CONFIG_MAGIC;
+  config.version = CONFIG_VERSION;
+  config.crc = device_config_crc(config);
+}
+
+inline bool device_config_valid(const DeviceConfig& config) {
+  return config.magic == CONFIG_MAGIC &&
+         config.version == CONFIG_VERSION &&
+         config.crc == device_config_crc(config);
+}
+
+// Upgrade a version 1 or 2 blob: version 2 gave a padding byte that version 1
+// kept zero to the diagnostics flag (same layout and CRC range), version 3
+// appended the channels. Every channel starts with the primary depth.
+// Returns true if config is now a valid current-version configuration
+inline bool device_config_upgrade(const DeviceConfigV2& old, DeviceConfig& config) {
+  if (old.magic != CONFIG_MAGIC || (old.version != 1 && old.version != 2)) return false;
+  if (old.crc != crc32_buffer(&old, offsetof(DeviceConfigV2, crc))) return false;
+  if (old.version == 1 && old.diagnostics != 0) return false;
+
+  memset(&config, 0, sizeof(config));  // Padding must be zero for a stable CRC
+  config.sleep_interval_s = old.sleep_interval_s;
+  config.active_window_ms = old.active_window_ms;
+  config.depth_mm = old.depth_mm;
+  config.downlink_wait_ms = old.downlink_wait_ms;
+  memcpy(config.name, old.name, sizeof(config.name));
+  config.diagnostics = old.diagnostics;
+  config.channel_count = 1;
+  for (int i = 0; i < SENSOR_CHANNELS_MAX - 1; i++) config.channel_depth_mm[i] = old.depth_mm;
+  device_config_seal(config);
+  return true;
+}
+
+// Fill a configuration with the compile-time defaults (one channel)
+inline void device_config_defaults(DeviceConfig& config, uint32_t sleep_interval_s,
+                                   uint32_t active_window_ms, uint16_t depth_mm,
+                                   uint32_t downlink_wait_ms, const char* name) {
+  memset(&config, 0, sizeof(config));  // Padding must be zero for a stable CRC
+  config.sleep_interval_s = sleep_interval_s;
+  config.active_window_ms = active_window_ms;
+  config.depth_mm = depth_mm;
+  config.downlink_wait_ms = downlink_wait_ms;
+  memcpy(config.name, name, strnlen(name, DEVICE_NAME_LENGTH));  // Rest stays zero
+  config.channel_count = 1;
+  for (int i = 0; i < SENSOR_CHANNELS_MAX - 1; i++) config.channel_depth_mm[i] = depth_mm;
+  device_config_seal(config);
+}
+
+// Depth of one ultrasound channel, in millimeters
+inline uint16_t device_config_depth_mm(const DeviceConfig& config, uint8_t channel) {
+  if (channel == 0 || channel >= SENSOR_CHANNELS_MAX) return config.depth_mm;
+  return config.channel_depth_mm[channel - 1];
+}
+
+// Set the depth of one channel (no range check; see CFG_PARAM_CHANNEL_DEPTH)
+inline void device_config_set_depth_mm(DeviceConfig& config, uint8_t channel, uint16_t depth_mm) {
+  if (channel == 0) {
+    config.depth_mm = depth_mm;
+  } else if (channel < SENSOR_CHANNELS_MAX) {
+    config.channel_depth_mm[channel - 1] = depth_mm;
+  }
+}
+
+inline uint32_t config_read_u32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline uint16_t config_read_u16(const uint8_t* p) {
+  return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+// Validate and apply one parameter to the configuration
+// Returns a CFG_STATUS_* code; the configuration is only touched on CFG_STATUS_APPLIED
+inline uint8_t device_config_apply(DeviceConfig& config, uint8_t param,
+                                   const uint8_t* value, size_t length) {
+  switch (param) {
+    case CFG_PARAM_SLEEP_INTERVAL: {
+      if (length != 4) return CFG_STATUS_BAD_LENGTH;
+      uint32_t v = config_read_u32(value);
+      if (v < CFG_SLEEP_INTERVAL_MIN_S || v > CFG_SLEEP_INTERVAL_MAX_S) return CFG_STATUS_OUT_OF_RANGE;
+      config.sleep_interval_s = v;
+      break;
+    }
+    case CFG_PARAM_ACTIVE_WINDOW: {
+      if (length != 4) return CFG_STATUS_BAD_LENGTH;
+      uint32_t v = config_read_u32(value);
+      if (v < CFG_ACTIVE_WINDOW_MIN_MS || v > CFG_ACTIVE_WINDOW_MAX_MS) return CFG_STATUS_OUT_OF_RANGE;
+      config.active_window_ms = v;
+      break;
+    }
+    case CFG_PARAM_DEPTH: {
+      if (length != 2) return CFG_STATUS_BAD_LENGTH;
+      uint16_t v = config_read_u16(value);
+      if (v < CFG_DEPTH_MIN_MM || v > CFG_DEPTH_MAX_MM) return CFG_STATUS_OUT_OF_RANGE;
+      config.depth_mm = v;
+      break;
+    }
+    case CFG_PARAM_DOWNLINK_WAIT: {
+      if (length != 4) return CFG_STATUS_BAD_LENGTH;
+      uint32_t v = config_read_u32(value);
+      if (v > CFG_DOWNLINK_WAIT_MAX_MS) return CFG_STATUS_OUT_OF_RANGE;
+      config.downlink_wait_ms = v;
+      break;
+    }
+    case CFG_PARAM_NAME: {
+      if (length != DEVICE_NAME_LENGTH) return CFG_STATUS_BAD_LENGTH;
+      for (size_t i = 0; i < length; i++) {
+        if (value[i] < 0x20 || value[i] > 0x7E) return CFG_STATUS_OUT_OF_RANGE;  // Printable ASCII only
+      }
+      memcpy(config.name, value, DEVICE_NAME_LENGTH);
+      config.name[DEVICE_NAME_LENGTH] = '\0';
+      break;
+    }
+    case CFG_PARAM_DIAGNOSTICS: {
+      if (length != 1) return CFG_STATUS_BAD_LENGTH;
+      if (value[0] > 1) return CFG_STATUS_OUT_OF_RANGE;
+      config.diagnostics = value[0];
+      break;
+    }
+    case CFG_PARAM_CHANNEL_DEPTH: {
+      if (length != 3) return CFG_STATUS_BAD_LENGTH;
+      uint16_t v = config_read_u16(value + 1);
+      if (value[0] >= config.channel_count) return CFG_STATUS_OUT_OF_RANGE;
+      if (v < CFG_DEPTH_MIN_MM || v > CFG_DEPTH_MAX_MM) return CFG_STATUS_OUT_OF_RANGE;
+      device_config_set_depth_mm(config, value[0], v);
+      break;
+    }
+    default:
+      return CFG_STATUS_UNKNOWN_PARAM;
+  }
+
+  device_config_seal(config);
+  return CFG_STATUS_APPLIED;
+}
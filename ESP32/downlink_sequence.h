@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================
+// Downlink Sequencing
+// ============================================
+//
+// Unicast operation downlinks (INSERT, DELETE, SET_CONFIG, JOURNAL_UPLOAD,
+// MULTICAST_SETUP) carry a sequence number so each one is applied once and
+// in the order the server queued it. The same frame can reach
+// process_downlink_message() more than once: found in an AT response and
+// read again as an RX: line, or repeated by the network server after the
+// ack of a confirmed downlink was lost. Without numbers every copy is
+// another SQLite or NVS write.
+//
+// A numbered downlink sets DL_FLAG_SEQUENCED on the operation byte and
+// carries a header after it:
+//   [OP | 0x40] [SESSION (1)] [SEQ (2, big-endian)] [rest of the operation]
+// The server numbers each device's downlinks from 0 within a session byte
+// it picks when it starts, so a restarted server does not look like a
+// replay of the old numbers.
+//
+// The bin keeps the last sequence applied in order and up to
+// DL_SEQ_BUFFER_FRAMES frames that arrived ahead of a gap (RTC memory):
+//   applied - DL_SEQ_WINDOW < seq <= applied      duplicate, not applied again (its ack is re-sent)
+//   seq == applied + 1                            applied, then the buffered frames that follow
+//   applied + 1 < seq <= applied + DL_SEQ_WINDOW  buffered until the gap is filled
+//   anything else, or another session             the numbering restarts at seq
+// A gap still open after DL_SEQ_GAP_WAKES wakes, or one that would overflow
+// the buffer, is given up: the frame was lost over the air, and the frames
+// after it are applied in order. Downlinks without the flag are applied as
+// they come.
+
+#define DL_FLAG_SEQUENCED       0x40   // On the operation byte
+#define DL_SEQ_HEADER_LENGTH    3      // Session and sequence, after the operation byte
+#define DL_SEQ_WINDOW           32
+#define DL_SEQ_BUFFER_FRAMES    4
+#define DL_SEQ_FRAME_MAX        46     // Operation byte and body; MULTICAST_SETUP is the longest
+#define DL_SEQ_GAP_WAKES        3
+
+// Result of one numbered downlink
+#define DL_SEQ_APPLIED          0      // In order: applied, with any buffered frames it unblocked
+#define DL_SEQ_RESTARTED        1      // New session or far out of the window: applied, numbering restarts
+#define DL_SEQ_BUFFERED         2      // Ahead of a gap: kept for later (or already kept)
+#define DL_SEQ_DUPLICATE        3      // Applied before (or given up on): not applied again
+#define DL_SEQ_INVALID          4      // Too short or too long
+
+// A frame as it is applied: the operation byte without DL_FLAG_SEQUENCED,
+// then the body
+struct DownlinkFrame {
+  uint16_t sequence;
+  uint8_t  length;
+  uint8_t  data[DL_SEQ_FRAME_MAX];
+};
+
+struct DownlinkSequenceState {
+  uint8_t  session;
+  uint8_t  started;             // A numbered downlink was applied in this session
+  uint16_t applied;             // Last sequence applied in order
+  uint8_t  buffered;            // Frames waiting in frames[], in sequence order
+  uint8_t  gap_wakes;           // Wakes the gap before frames[0] has been open
+  DownlinkFrame frames[DL_SEQ_BUFFER_FRAMES];
+};
+
+// Apply the frame at frames[0] and drop it from the buffer
+template <typename Fn>
+void downlink_sequence_pop(DownlinkSequenceState& state, Fn& apply) {
+  DownlinkFrame frame = state.frames[0];
+  state.buffered--;
+  memmove(&state.frames[0], &state.frames[1], state.buffered * sizeof(DownlinkFrame));
+  state.applied = frame.sequence;
+  state.gap_wakes = 0;
+  apply(frame.data, (size_t)frame.length);
+}
+
+// Apply the buffered frames that follow the last one applied; with
+// skip_gap, give up the gap before the first one
+template <typename Fn>
+void downlink_sequence_drain(DownlinkSequenceState& state, Fn& apply, bool skip_gap) {
+  if (skip_gap && state.buffered > 0) downlink_sequence_pop(state, apply);
+  while (state.buffered > 0 && state.frames[0].sequence == (uint16_t)(state.applied + 1)) {
+    downlink_sequence_pop(state, apply);
+  }
+}
+
+// Split a numbered downlink (data starts at the operation byte, with
+// DL_FLAG_SEQUENCED set) into its session byte and the frame as it is
+// applied. Returns false if it is too short or too long
+inline bool downlink_sequence_parse(const uint8_t* data, size_t length, uint8_t& session, DownlinkFrame& frame) {
+  if (length < 1 + DL_SEQ_HEADER_LENGTH || length - DL_SEQ_HEADER_LENGTH > DL_SEQ_FRAME_MAX) return false;
+  session = data[1];
+  frame.sequence = (uint16_t)(((uint16_t)data[2] << 8) | data[3]);
+  frame.length = (uint8_t)(length - DL_SEQ_HEADER_LENGTH);
+  frame.data[0] = data[0] & (uint8_t)~DL_FLAG_SEQUENCED;
+  memcpy(frame.data + 1, data + 1 + DL_SEQ_HEADER_LENGTH, frame.length - 1);
+  return true;
+}
+
+// Handle one numbered downlink (data starts at the operation byte, with
+// DL_FLAG_SEQUENCED set): apply(frame, length) is called for every frame that
+// is due, in sequence order. Returns DL_SEQ_*
+template <typename Fn>
+uint8_t downlink_sequence_receive(DownlinkSequenceState& state, const uint8_t* data, size_t length, Fn apply) {
+  uint8_t session;
+  DownlinkFrame frame;
+  if (!downlink_sequence_parse(data, length, session, frame)) return DL_SEQ_INVALID;
+
+  uint16_t ahead = (uint16_t)(frame.sequence - state.applied);
+  uint16_t behind = (uint16_t)(state.applied - frame.sequence);
+
+  if (!state.started || session != state.session || (ahead > DL_SEQ_WINDOW && behind >= DL_SEQ_WINDOW)) {
+    // Frames buffered under the old numbering go first, in their order
+    while (state.buffered > 0) downlink_sequence_drain(state, apply, true);
+    state.session = session;
+    state.started = 1;
+    state.applied = frame.sequence;
+    apply(frame.data, (size_t)frame.length);
+    return DL_SEQ_RESTARTED;
+  }
+  if (ahead == 0 || ahead > DL_SEQ_WINDOW) return DL_SEQ_DUPLICATE;
+
+  for (uint8_t i = 0; i < state.buffered; i++) {
+    if (state.frames[i].sequence == frame.sequence) return DL_SEQ_BUFFERED;
+  }
+
+  if (ahead == 1) {
+    state.applied = frame.sequence;
+    state.gap_wakes = 0;
+    apply(frame.data, (size_t)frame.length);
+    downlink_sequence_drain(state, apply, false);
+    return DL_SEQ_APPLIED;
+  }
+
+  // Ahead of a gap; a full buffer gives up its oldest gap to make room,
+  // which may make this frame due, or late
+  while (state.buffered == DL_SEQ_BUFFER_FRAMES) {
+    downlink_sequence_drain(state, apply, true);
+    ahead = (uint16_t)(frame.sequence - state.applied);
+    if (ahead == 0 || ahead > DL_SEQ_WINDOW) return DL_SEQ_DUPLICATE;
+    if (ahead == 1) {
+      state.applied = frame.sequence;
+      apply(frame.data, (size_t)frame.length);
+      downlink_sequence_drain(state, apply, false);
+      return DL_SEQ_APPLIED;
+    }
+  }
+
+  uint8_t at = state.buffered;
+  while (at > 0 && (uint16_t)(state.frames[at - 1].sequence - state.applied) > ahead) at--;
+  memmove(&state.frames[at + 1], &state.frames[at], (state.buffered - at) * sizeof(DownlinkFrame));
+  state.frames[at] = frame;
+  if (state.buffered == 0) state.gap_wakes = 0;
+  state.buffered++;
+  return DL_SEQ_BUFFERED;
+}
+
+// Once per wake: count how long the gap has been open and give it up after
+// DL_SEQ_GAP_WAKES wakes. Returns true when frames were applied
+template <typename Fn>
+bool downlink_sequence_wake(DownlinkSequenceState& state, Fn apply) {
+  if (state.buffered == 0) return false;
+  if (++state.gap_wakes < DL_SEQ_GAP_WAKES) return false;
+  downlink_sequence_drain(state, apply, true);
+  return true;
+}
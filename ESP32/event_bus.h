@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "at_modem.h"
+
+// ============================================
+// Active Window Event Bus
+// ============================================
+//
+// During the active window the firmware is driven by events instead of a
+// polling loop. Producers (PIR interrupt, RFID reader task, modem reader
+// task, sensor, window and uplink timers) post an Event to a FreeRTOS queue in
+// main.cpp; loop() blocks on the queue and runs one small handler per event.
+// This header holds the queue-independent part: the event record, the
+// per-type handling deadlines and the latency statistics.
+
+enum EventType {
+  EVT_PIR_MOTION = 0,   // PIR rising edge (someone at the bin)
+  EVT_RFID_TAP,         // New card read by the RFID task
+  EVT_MODEM_LINE,       // RX: line read from the module outside an AT transaction
+  EVT_SENSOR_TICK,      // Time for a sensor sample and countdown print
+  EVT_WINDOW_TIMEOUT,   // Active window ended
+  EVT_CLEANUP_UPLINK,   // Module ready for the cleanup uplink of an authenticated tap
+  EVT_TYPE_COUNT
+};
+
+#define EVENT_RFID_UID_MAX  10  // MFRC522 UIDs are 4, 7 or 10 bytes
+
+struct Event {
+  uint8_t  type;
+  uint32_t posted_ms;   // millis() when the producer posted it
+  union {
+    struct {
+      uint8_t uid[EVENT_RFID_UID_MAX];
+      uint8_t size;
+    } rfid;
+    AtDownlink downlink;
+  };
+};
+
+// Time from posting to the end of handling before an event counts as late
+// A card tap must be answered quickly; sensor ticks may wait behind an uplink
+inline uint32_t event_deadline_ms(uint8_t type) {
+  switch (type) {
+    case EVT_PIR_MOTION:     return 100;
+    case EVT_RFID_TAP:       return 250;
+    case EVT_MODEM_LINE:     return 500;
+    case EVT_SENSOR_TICK:    return 1000;
+    case EVT_WINDOW_TIMEOUT: return 1000;
+    case EVT_CLEANUP_UPLINK: return 1000;
+    default:                 return 1000;
+  }
+}
+
+inline const char* event_type_name(uint8_t type) {
+  switch (type) {
+    case EVT_PIR_MOTION:     return "PIR motion";
+    case EVT_RFID_TAP:       return "RFID tap";
+    case EVT_MODEM_LINE:     return "Modem line";
+    case EVT_SENSOR_TICK:    return "Sensor tick";
+    case EVT_WINDOW_TIMEOUT: return "Window timeout";
+    case EVT_CLEANUP_UPLINK: return "Cleanup uplink";
+    default:                 return "Unknown";
+  }
+}
+
+struct EventTypeStats {
+  uint32_t count;
+  uint32_t queue_max_ms;     // Longest wait in the queue
+  uint32_t queue_total_ms;
+  uint32_t handler_max_ms;   // Longest handler run
+  uint32_t deadline_misses;  // Posted-to-handled time above event_deadline_ms()
+};
+
+struct EventBusStats {
+  EventTypeStats types[EVT_TYPE_COUNT];
+  uint32_t dropped;          // Posts refused because the queue was full
+};
+
+// Record one handled event (times from millis(), wrap-safe)
+inline void event_bus_record(EventBusStats& stats, const Event& event,
+                             uint32_t started_ms, uint32_t finished_ms) {
+  if (event.type >= EVT_TYPE_COUNT) return;
+  EventTypeStats& s = stats.types[event.type];
+
+  uint32_t queued_ms = started_ms - event.posted_ms;
+  uint32_t handler_ms = finished_ms - started_ms;
+  s.count++;
+  s.queue_total_ms += queued_ms;
+  if (queued_ms > s.queue_max_ms) s.queue_max_ms = queued_ms;
+  if (handler_ms > s.handler_max_ms) s.handler_max_ms = handler_ms;
+  if (queued_ms + handler_ms > event_deadline_ms(event.type)) s.deadline_misses++;
+}
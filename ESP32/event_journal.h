@@ -0,0 +1,241 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+// ============================================
+// Event Journal
+// ============================================
+//
+// Append-only log of what happened at the bin, kept on the device whether or
+// not the matching uplink went out: cleanups, denied taps, reports (sent,
+// deferred or failed) and reboots. Records are 16 bytes with a fixed layout,
+// appended to one of JOURNAL_SEGMENTS segment files; when the current
+// segment is full the oldest one is cleared and reused. An append is one
+// small file write, with no SQLite transaction or journal file.
+//
+// Every segment has a sparse time index (the time of every
+// JOURNAL_INDEX_STRIDE-th record) kept in RTC memory and rebuilt from the
+// files on a cold boot. Times within a segment never go backwards (a
+// backwards clock step starts a new segment), so a range query jumps to the
+// right stride instead of scanning. Times are Unix seconds once network time
+// is synced, local clock seconds (JOURNAL_FLAG_LOCAL_TIME) before that.
+//
+// Segment access goes through a small interface, as in golden_whitelist.h:
+//   uint32_t size(segment)                           bytes in the segment
+//   bool read(segment, offset, data, length)
+//   bool append(segment, data, length)
+//   bool clear(segment)
+
+#define JOURNAL_SEGMENTS          8
+#define JOURNAL_SEGMENT_RECORDS   256   // 4 KB per segment
+#define JOURNAL_INDEX_STRIDE      32
+#define JOURNAL_INDEX_ENTRIES     (JOURNAL_SEGMENT_RECORDS / JOURNAL_INDEX_STRIDE)
+#define JOURNAL_READ_RECORDS      16    // Records per read in queries and rebuilds
+
+// Record types
+#define JOURNAL_CLEANUP     0x01  // data: card UID (4)
+#define JOURNAL_DENIED_TAP  0x02  // data: card UID (4)
+#define JOURNAL_REPORT      0x03  // data: fill %, usage, minutes to full (2, big-endian)
+#define JOURNAL_REBOOT      0x04  // data: reset reason, wake-up cause
+
+// Record flags
+#define JOURNAL_FLAG_SENT        0x01  // Uplink accepted by the module
+#define JOURNAL_FLAG_DEFERRED    0x02  // Uplink held back by the airtime governor
+#define JOURNAL_FLAG_INFERRED    0x04  // Cleanup inferred from the fill level; data: fill % before, after
+#define JOURNAL_FLAG_LOCAL_TIME  0x80  // time is local clock seconds, not Unix time
+
+struct JournalRecord {
+  uint32_t time;
+  uint32_t sequence;  // Increases by one per record, across segments
+  uint8_t  type;
+  uint8_t  flags;
+  uint8_t  data[4];
+  uint16_t check;     // Low 16 bits of the CRC-32 of the fields above
+};
+
+struct JournalSegmentIndex {
+  uint32_t first_sequence;
+  uint32_t first_time;
+  uint32_t last_time;
+  uint16_t count;     // Records in the segment
+  uint8_t  sealed;    // No more appends (torn record or write error)
+  uint8_t  reserved;
+  uint32_t stride_time[JOURNAL_INDEX_ENTRIES];  // Time of record k * JOURNAL_INDEX_STRIDE
+};
+
+// Kept in RTC memory
+struct JournalState {
+  uint32_t next_sequence;
+  uint8_t  head;      // Segment being appended to
+  uint8_t  reserved[3];
+  JournalSegmentIndex segments[JOURNAL_SEGMENTS];
+};
+
+// Upload of a time range requested by downlink, sent a few frames per wake;
+// kept in RTC memory
+struct JournalUpload {
+  uint8_t  active;
+  uint8_t  reserved[3];
+  uint32_t from;
+  uint32_t to;
+  uint32_t next_sequence;  // First record not yet sent
+};
+
+inline void journal_init(JournalState& state) {
+  memset(&state, 0, sizeof(state));
+  state.next_sequence = 1;
+}
+
+inline uint16_t journal_record_check(const JournalRecord& record) {
+  return (uint16_t)crc32_buffer(&record, offsetof(JournalRecord, check));
+}
+
+inline bool journal_record_valid(const JournalRecord& record) {
+  return record.sequence != 0 && record.check == journal_record_check(record);
+}
+
+inline const char* journal_type_name(uint8_t type) {
+  switch (type) {
+    case JOURNAL_CLEANUP:    return "cleanup";
+    case JOURNAL_DENIED_TAP: return "denied tap";
+    case JOURNAL_REPORT:     return "report";
+    case JOURNAL_REBOOT:     return "reboot";
+    default:                 return "unknown";
+  }
+}
+
+inline void journal_index_add(JournalSegmentIndex& index, const JournalRecord& record) {
+  if (index.count == 0) {
+    index.first_sequence = record.sequence;
+    index.first_time = record.time;
+  }
+  if (index.count % JOURNAL_INDEX_STRIDE == 0) {
+    index.stride_time[index.count / JOURNAL_INDEX_STRIDE] = record.time;
+  }
+  index.last_time = record.time;
+  index.count++;
+}
+
+// Rebuild the index from the segment files (cold boot). A segment is read
+// up to its first invalid record, which seals it.
+template <typename Storage>
+void journal_rebuild(JournalState& state, Storage& storage) {
+  journal_init(state);
+  uint32_t newest = 0;
+  JournalRecord chunk[JOURNAL_READ_RECORDS];
+
+  for (uint8_t s = 0; s < JOURNAL_SEGMENTS; s++) {
+    JournalSegmentIndex& index = state.segments[s];
+    uint32_t stored = storage.size(s) / sizeof(JournalRecord);
+    if (stored > JOURNAL_SEGMENT_RECORDS) stored = JOURNAL_SEGMENT_RECORDS;
+
+    for (uint32_t done = 0; done < stored && !index.sealed;) {
+      uint32_t n = stored - done < JOURNAL_READ_RECORDS ? stored - done : JOURNAL_READ_RECORDS;
+      if (!storage.read(s, done * sizeof(JournalRecord), chunk, n * sizeof(JournalRecord))) {
+        index.sealed = 1;
+        break;
+      }
+      for (uint32_t i = 0; i < n; i++) {
+        const JournalRecord& record = chunk[i];
+        bool in_order = index.count == 0 ||
+                        (record.sequence == index.first_sequence + index.count && record.time >= index.last_time);
+        if (!journal_record_valid(record) || !in_order) {
+          index.sealed = 1;
+          break;
+        }
+        journal_index_add(index, record);
+      }
+      done += n;
+    }
+    if (storage.size(s) != (uint32_t)index.count * sizeof(JournalRecord)) index.sealed = 1;
+
+    if (index.count > 0 && index.first_sequence + index.count - 1 >= newest) {
+      newest = index.first_sequence + index.count - 1;
+      state.head = s;
+    }
+  }
+  state.next_sequence = newest + 1;
+}
+
+// Append one record; false on a write error (the record is lost)
+template <typename Storage>
+bool journal_append(JournalState& state, Storage& storage, uint32_t time, uint8_t type, uint8_t flags,
+                    const uint8_t* data) {
+  JournalSegmentIndex* index = &state.segments[state.head];
+  if (index->count >= JOURNAL_SEGMENT_RECORDS || index->sealed || (index->count > 0 && time < index->last_time)) {
+    // Reuse the oldest segment
+    state.head = (state.head + 1) % JOURNAL_SEGMENTS;
+    index = &state.segments[state.head];
+    memset(index, 0, sizeof(*index));
+    if (!storage.clear(state.head)) {
+      index->sealed = 1;
+      return false;
+    }
+  }
+
+  JournalRecord record;
+  memset(&record, 0, sizeof(record));
+  record.time = time;
+  record.sequence = state.next_sequence;
+  record.type = type;
+  record.flags = flags;
+  if (data != NULL) memcpy(record.data, data, sizeof(record.data));
+  record.check = journal_record_check(record);
+
+  if (!storage.append(state.head, &record, sizeof(record))) {
+    index->sealed = 1;  // A partial record may be in the file
+    return false;
+  }
+  journal_index_add(*index, record);
+  state.next_sequence++;
+  return true;
+}
+
+// Call fn(const JournalRecord&) for the records with from <= time <= to and
+// sequence >= min_sequence, oldest first, until fn returns false. Returns
+// the number of records passed to fn.
+template <typename Storage, typename Fn>
+uint32_t journal_query(const JournalState& state, Storage& storage, uint32_t from, uint32_t to,
+                       uint32_t min_sequence, Fn fn) {
+  uint32_t visited = 0;
+  JournalRecord chunk[JOURNAL_READ_RECORDS];
+
+  for (uint8_t k = 1; k <= JOURNAL_SEGMENTS; k++) {
+    uint8_t s = (state.head + k) % JOURNAL_SEGMENTS;
+    const JournalSegmentIndex& index = state.segments[s];
+    if (index.count == 0 || index.last_time < from || index.first_time > to) continue;
+    if (index.first_sequence + index.count <= min_sequence) continue;
+
+    // Records before the last stride that starts below from are all below from
+    uint32_t start = 0;
+    for (uint32_t e = 1; e * JOURNAL_INDEX_STRIDE < index.count; e++) {
+      if (index.stride_time[e] >= from) break;
+      start = e * JOURNAL_INDEX_STRIDE;
+    }
+    if (min_sequence > index.first_sequence + start) {
+      start = min_sequence - index.first_sequence;
+    }
+
+    // A later segment may start below to again after a clock step
+    bool past_range = false;
+    for (uint32_t done = start; done < index.count && !past_range;) {
+      uint32_t n = index.count - done < JOURNAL_READ_RECORDS ? index.count - done : JOURNAL_READ_RECORDS;
+      if (!storage.read(s, done * sizeof(JournalRecord), chunk, n * sizeof(JournalRecord))) break;
+      for (uint32_t i = 0; i < n; i++) {
+        const JournalRecord& record = chunk[i];
+        if (record.time > to) {
+          past_range = true;
+          break;
+        }
+        if (record.time < from) continue;
+        visited++;
+        if (!fn(record)) return visited;
+      }
+      done += n;
+    }
+  }
+  return visited;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// ============================================
+// Fill-Rate Forecasting
+// ============================================
+//
+// Online exponentially weighted linear trend (Holt's method) over the fill
+// readings. Readings arrive at irregular intervals (timer slots, PIR wakes),
+// so the smoothing factors are derived from time constants instead of being
+// fixed per sample. The level absorbs every reading; the trend compares the
+// level against an anchor at least FORECAST_MIN_TREND_DT_H old, so bins that
+// report every few minutes still learn their rate. The model is reset when a
+// worker empties the bin.
+
+#define FORECAST_MAGIC              0x46434153UL // "FCAS"
+#define FORECAST_LEVEL_TAU_H        0.5f   // Level time constant (hours)
+#define FORECAST_TREND_TAU_H        3.0f   // Trend time constant (hours)
+#define FORECAST_MIN_TREND_DT_H     (5.0f / 60.0f) // Shortest span the rate is measured over
+#define FORECAST_MIN_RATE_PCT_H     0.01f  // Slower than this is treated as "not filling"
+#define FORECAST_THRESHOLD_PCT      66.0f  // Dispatch threshold (red marker on the dashboard map)
+#define FORECAST_SAMPLES_TO_THRESHOLD 4    // Aim for this many reports before crossing the threshold
+#define FORECAST_MAX_STRETCH        8      // Longest interval, in report periods
+#define FORECAST_MINUTES_UNKNOWN    0xFFFF // Uplink value when time-to-full is unknown
+
+// Forecast state - kept in RTC memory so it survives deep sleep
+struct FillForecastState {
+  uint32_t magic;
+  uint8_t  initialized;      // 0 until the first reading after a reset
+  float    level_pct;        // Smoothed fill level
+  float    rate_pct_per_h;   // Smoothed fill rate
+  int64_t  last_local_ms;    // Local clock of the last reading
+  float    anchor_pct;       // Smoothed level when the rate was last updated
+  int64_t  anchor_local_ms;  // Local clock of that update
+};
+
+// Reset the model (power-on, corrupted RTC memory or bin emptied)
+inline void fill_forecast_reset(FillForecastState& state) {
+  state.magic = FORECAST_MAGIC;
+  state.initialized = 0;
+  state.level_pct = 0;
+  state.rate_pct_per_h = 0;
+  state.last_local_ms = 0;
+  state.anchor_pct = 0;
+  state.anchor_local_ms = 0;
+}
+
+// Feed a fill reading (0-100 %) taken at the given local clock time
+inline void fill_forecast_update(FillForecastState& state, int64_t local_ms, float fill_pct) {
+  if (fill_pct < 0) return;  // Invalid reading
+
+  if (!state.initialized) {
+    state.level_pct = fill_pct;
+    state.rate_pct_per_h = 0;
+    state.last_local_ms = local_ms;
+    state.anchor_pct = fill_pct;
+    state.anchor_local_ms = local_ms;
+    state.initialized = 1;
+    return;
+  }
+
+  float dt_h = (float)(local_ms - state.last_local_ms) / 3600000.0f;
+  if (dt_h <= 0) return;
+
+  float alpha = 1.0f - expf(-dt_h / FORECAST_LEVEL_TAU_H);
+  float predicted = state.level_pct + state.rate_pct_per_h * dt_h;
+  float level = alpha * fill_pct + (1.0f - alpha) * predicted;
+
+  state.level_pct = level;
+  state.last_local_ms = local_ms;
+
+  // Readings only minutes apart say more about sensor noise than about the
+  // rate: measure it against the anchor once that is old enough
+  float anchor_dt_h = (float)(local_ms - state.anchor_local_ms) / 3600000.0f;
+  if (anchor_dt_h >= FORECAST_MIN_TREND_DT_H) {
+    float beta = 1.0f - expf(-anchor_dt_h / FORECAST_TREND_TAU_H);
+    float observed_rate = (level - state.anchor_pct) / anchor_dt_h;
+    state.rate_pct_per_h = beta * observed_rate + (1.0f - beta) * state.rate_pct_per_h;
+    state.anchor_pct = level;
+    state.anchor_local_ms = local_ms;
+  }
+}
+
+// Hours until the smoothed level reaches target_pct, or -1 if not filling
+inline float fill_forecast_hours_to(const FillForecastState& state, float target_pct) {
+  if (!state.initialized) return -1;
+  if (state.level_pct >= target_pct) return 0;
+  if (state.rate_pct_per_h < FORECAST_MIN_RATE_PCT_H) return -1;
+  return (target_pct - state.level_pct) / state.rate_pct_per_h;
+}
+
+// Predicted time-to-full in minutes for the uplink (FORECAST_MINUTES_UNKNOWN if unknown)
+inline uint16_t fill_forecast_minutes_to_full(const FillForecastState& state) {
+  float hours = fill_forecast_hours_to(state, 100.0f);
+  if (hours < 0) return FORECAST_MINUTES_UNKNOWN;
+
+  float minutes = hours * 60.0f;
+  if (minutes >= (float)(FORECAST_MINUTES_UNKNOWN - 1)) return FORECAST_MINUTES_UNKNOWN - 1;
+  return (uint16_t)minutes;
+}
+
+// Number of report periods to sleep before the next report
+// Bins near (or past) the dispatch threshold report every period; slow or
+// idle bins stretch up to FORECAST_MAX_STRETCH periods.
+inline uint32_t fill_forecast_report_periods(const FillForecastState& state, uint32_t period_s) {
+  if (!state.initialized || period_s == 0) return 1;
+
+  float hours = fill_forecast_hours_to(state, FORECAST_THRESHOLD_PCT);
+  if (hours < 0) return FORECAST_MAX_STRETCH;  // Not filling
+  if (hours == 0) return 1;                     // Already past the threshold
+
+  float interval_s = hours * 3600.0f / FORECAST_SAMPLES_TO_THRESHOLD;
+  uint32_t periods = (uint32_t)(interval_s / (float)period_s);
+  if (periods < 1) periods = 1;
+  if (periods > FORECAST_MAX_STRETCH) periods = FORECAST_MAX_STRETCH;
+  return periods;
+}
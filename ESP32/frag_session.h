@@ -0,0 +1,401 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+// ============================================
+// LoRaWAN Fragmented Data Block Transport
+// ============================================
+//
+// Receiver side of LoRaWAN TS004 v1.0 (port 201), used to deliver firmware
+// patches (delta_patch.h). The server splits a data block into NbFrag
+// fragments and follows them with coded fragments, each the XOR of about
+// half of the uncoded ones chosen by the TS004 parity matrix. Any NbFrag
+// fragments that together have full rank rebuild the block, so lost
+// downlinks cost extra coded fragments instead of retransmission requests.
+//
+// The session state is small enough for RTC memory; the fragments
+// themselves go to a storage with read(offset, data, length) and
+// write(offset, data, length) (a LittleFS file on the device, memory on
+// the host), laid out as the NbFrag uncoded fragments followed by the
+// coded ones as [N (2)] [payload]. Decoding runs once enough fragments are
+// stored, with a caller-provided scratch area of FRAG_SCRATCH_SIZE bytes.
+
+#define FRAG_PORT                 201
+#define FRAG_PACKAGE_ID           3
+#define FRAG_PACKAGE_VERSION      1
+
+// Commands (same identifiers for requests and answers)
+#define FRAG_PACKAGE_VERSION_REQ  0x00
+#define FRAG_SESSION_STATUS_REQ   0x01
+#define FRAG_SESSION_SETUP_REQ    0x02
+#define FRAG_SESSION_DELETE_REQ   0x03
+#define FRAG_DATA_FRAGMENT        0x08
+
+#define FRAG_MAX_FRAGMENTS   1024  // Largest block: 1024 x FRAG_MAX_SIZE
+#define FRAG_MAX_SIZE        50    // LORAWAN_MAX_DOWNLINK minus the fragment header (3)
+#define FRAG_MAX_CODED       256   // Coded fragments kept, and most missing ones recoverable
+#define FRAG_ANSWER_MAX      16    // Answers to one downlink, sent as one uplink on FRAG_PORT
+#define FRAG_CODED_ROWS      1024  // Parity rows tracked in coded_rows (higher ones are looked up in storage)
+
+#define FRAG_SCRATCH_SIZE  (FRAG_MAX_CODED * (FRAG_MAX_FRAGMENTS / 8) + \
+                            FRAG_MAX_CODED * (FRAG_MAX_CODED / 8) +     \
+                            FRAG_MAX_CODED * FRAG_MAX_SIZE +            \
+                            FRAG_MAX_CODED * 2)
+
+// Session status
+#define FRAG_STATUS_IDLE       0
+#define FRAG_STATUS_RECEIVING  1
+#define FRAG_STATUS_COMPLETE   2  // Block rebuilt and its CRC matches the descriptor
+#define FRAG_STATUS_FAILED     3  // Block rebuilt but the CRC does not match
+
+// FragSessionSetupAns status bits
+#define FRAG_SETUP_ENCODING_UNSUPPORTED  0x01
+#define FRAG_SETUP_NOT_ENOUGH_MEMORY     0x02
+#define FRAG_SETUP_INDEX_UNSUPPORTED     0x04
+
+// FragSessionDeleteAns status bit
+#define FRAG_DELETE_NO_SESSION           0x04
+
+struct FragSessionState {
+  uint8_t  status;
+  uint8_t  index;        // FragIndex (only 0 is supported)
+  uint16_t nb_frag;
+  uint8_t  frag_size;
+  uint8_t  padding;      // Bytes of padding in the last fragment
+  uint32_t descriptor;   // CRC-32 of the block (set by the sender)
+  uint16_t received;     // Uncoded fragments stored
+  uint16_t coded;        // Coded fragments stored
+  uint16_t last_counter; // Highest fragment counter seen
+  uint8_t  bitmap[FRAG_MAX_FRAGMENTS / 8];  // Uncoded fragments stored
+  uint8_t  coded_rows[FRAG_CODED_ROWS / 8]; // Coded fragments stored, by parity row (N - NbFrag - 1)
+};
+
+// Result of one downlink on FRAG_PORT
+struct FragResult {
+  uint8_t answer[FRAG_ANSWER_MAX];
+  size_t  answer_length;     // Uplink to send on FRAG_PORT, 0 for none
+  bool    fragment_stored;   // A data fragment was new
+  bool    decode_due;        // Enough fragments to try frag_session_decode()
+};
+
+inline void frag_session_reset(FragSessionState& state) {
+  memset(&state, 0, sizeof(state));
+}
+
+inline uint32_t frag_block_size(const FragSessionState& state) {
+  return (uint32_t)state.nb_frag * state.frag_size - state.padding;
+}
+
+inline bool frag_bit(const uint8_t* bits, uint32_t i) {
+  return (bits[i >> 3] >> (i & 7)) & 1;
+}
+
+inline void frag_set_bit(uint8_t* bits, uint32_t i) {
+  bits[i >> 3] |= (uint8_t)(1 << (i & 7));
+}
+
+inline uint16_t frag_read_u16le(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t frag_read_u32le(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ============================================
+// Parity Matrix (TS004 v1.0, section 6)
+// ============================================
+
+inline uint32_t frag_prbs23(uint32_t x) {
+  uint32_t b0 = x & 1;
+  uint32_t b1 = (x & 32) >> 5;
+  return (x >> 1) + ((b0 ^ b1) << 22);
+}
+
+// Row n (1-based coded fragment number) of the parity matrix for a block of
+// m fragments, as a bit set over the m uncoded fragments
+inline void frag_parity_row(uint32_t n, uint32_t m, uint8_t* bits) {
+  memset(bits, 0, (m + 7) / 8);
+  uint32_t m_temp = (m & (m - 1)) == 0 ? 1 : 0;  // Power of two
+  uint32_t x = 1 + 1001 * n;
+  for (uint32_t coefficients = 0; coefficients < m / 2; coefficients++) {
+    uint32_t r = 1 << 16;
+    while (r >= m) {
+      x = frag_prbs23(x);
+      r = x % (m + m_temp);
+    }
+    frag_set_bit(bits, r);
+  }
+}
+
+// ============================================
+// Decoding
+// ============================================
+
+inline uint32_t frag_coded_offset(const FragSessionState& state, uint32_t i) {
+  return (uint32_t)state.nb_frag * state.frag_size + i * (2 + state.frag_size);
+}
+
+inline bool frag_decode_due(const FragSessionState& state) {
+  return state.status == FRAG_STATUS_RECEIVING &&
+         (state.received == state.nb_frag ||
+          (uint32_t)state.received + state.coded >= state.nb_frag);
+}
+
+// CRC-32 of the rebuilt block against the descriptor
+template <typename Storage>
+bool frag_block_crc_matches(const FragSessionState& state, Storage& storage) {
+  uint8_t chunk[FRAG_MAX_SIZE];
+  uint32_t crc = 0;
+  uint32_t size = frag_block_size(state);
+  for (uint32_t offset = 0; offset < size;) {
+    uint32_t n = size - offset < sizeof(chunk) ? size - offset : sizeof(chunk);
+    if (!storage.read(offset, chunk, n)) return false;
+    crc = crc32_update(crc, chunk, n);
+    offset += n;
+  }
+  return crc == state.descriptor;
+}
+
+// Rebuild missing fragments from the coded ones (Gaussian elimination over
+// GF(2)) and check the block CRC. Returns true once the session is complete
+// or failed; false if more coded fragments are needed.
+template <typename Storage>
+bool frag_session_decode(FragSessionState& state, Storage& storage, uint8_t* scratch) {
+  if (state.status != FRAG_STATUS_RECEIVING) return state.status != FRAG_STATUS_IDLE;
+
+  if (state.received < state.nb_frag) {
+    const uint32_t full_bytes = (state.nb_frag + 7) / 8;
+    const uint32_t size = state.frag_size;
+    uint8_t* full_rows = scratch;                                            // coded x nb_frag bits
+    uint8_t* rows = full_rows + FRAG_MAX_CODED * (FRAG_MAX_FRAGMENTS / 8);   // coded x missing bits
+    uint8_t* payloads = rows + FRAG_MAX_CODED * (FRAG_MAX_CODED / 8);       // coded x frag_size
+    uint16_t* missing = (uint16_t*)(payloads + FRAG_MAX_CODED * FRAG_MAX_SIZE);
+
+    uint32_t missing_count = 0;
+    for (uint32_t j = 0; j < state.nb_frag; j++) {
+      if (frag_bit(state.bitmap, j)) continue;
+      if (missing_count == FRAG_MAX_CODED) return false;
+      missing[missing_count++] = (uint16_t)j;
+    }
+    uint32_t coded = state.coded;
+    if (coded < missing_count) return false;
+
+    // Coded payloads and their parity rows
+    for (uint32_t c = 0; c < coded; c++) {
+      uint8_t counter[2];
+      uint32_t offset = frag_coded_offset(state, c);
+      if (!storage.read(offset, counter, 2) || !storage.read(offset + 2, payloads + c * size, size)) return false;
+      frag_parity_row(frag_read_u16le(counter) - state.nb_frag, state.nb_frag, full_rows + c * full_bytes);
+    }
+
+    // Remove the known fragments from every equation (one read per fragment)
+    uint8_t known[FRAG_MAX_SIZE];
+    for (uint32_t j = 0; j < state.nb_frag; j++) {
+      if (!frag_bit(state.bitmap, j)) continue;
+      bool loaded = false;
+      for (uint32_t c = 0; c < coded; c++) {
+        if (!frag_bit(full_rows + c * full_bytes, j)) continue;
+        if (!loaded) {
+          if (!storage.read(j * size, known, size)) return false;
+          loaded = true;
+        }
+        uint8_t* p = payloads + c * size;
+        for (uint32_t b = 0; b < size; b++) p[b] ^= known[b];
+      }
+    }
+
+    // Equations over the missing fragments only
+    const uint32_t row_bytes = (missing_count + 7) / 8;
+    memset(rows, 0, coded * row_bytes);
+    for (uint32_t c = 0; c < coded; c++) {
+      for (uint32_t k = 0; k < missing_count; k++) {
+        if (frag_bit(full_rows + c * full_bytes, missing[k])) frag_set_bit(rows + c * row_bytes, k);
+      }
+    }
+
+    for (uint32_t col = 0; col < missing_count; col++) {
+      uint32_t pivot = col;
+      while (pivot < coded && !frag_bit(rows + pivot * row_bytes, col)) pivot++;
+      if (pivot == coded) return false;  // Not full rank yet
+      if (pivot != col) {
+        for (uint32_t b = 0; b < row_bytes; b++) {
+          uint8_t t = rows[pivot * row_bytes + b];
+          rows[pivot * row_bytes + b] = rows[col * row_bytes + b];
+          rows[col * row_bytes + b] = t;
+        }
+        for (uint32_t b = 0; b < size; b++) {
+          uint8_t t = payloads[pivot * size + b];
+          payloads[pivot * size + b] = payloads[col * size + b];
+          payloads[col * size + b] = t;
+        }
+      }
+      for (uint32_t r = 0; r < coded; r++) {
+        if (r == col || !frag_bit(rows + r * row_bytes, col)) continue;
+        for (uint32_t b = 0; b < row_bytes; b++) rows[r * row_bytes + b] ^= rows[col * row_bytes + b];
+        for (uint32_t b = 0; b < size; b++) payloads[r * size + b] ^= payloads[col * size + b];
+      }
+    }
+
+    for (uint32_t k = 0; k < missing_count; k++) {
+      if (!storage.write(missing[k] * size, payloads + k * size, size)) return false;
+      frag_set_bit(state.bitmap, missing[k]);
+    }
+    state.received = state.nb_frag;
+  }
+
+  state.status = frag_block_crc_matches(state, storage) ? FRAG_STATUS_COMPLETE : FRAG_STATUS_FAILED;
+  return true;
+}
+
+// ============================================
+// Commands
+// ============================================
+
+// Whether coded fragment n is stored already (a repeated downlink would take
+// a slot and add a dependent equation)
+template <typename Storage>
+bool frag_coded_stored(const FragSessionState& state, Storage& storage, uint16_t n) {
+  uint32_t row = n - state.nb_frag - 1;
+  if (row < FRAG_CODED_ROWS) return frag_bit(state.coded_rows, row);
+  for (uint32_t c = 0; c < state.coded; c++) {
+    uint8_t counter[2];
+    if (storage.read(frag_coded_offset(state, c), counter, 2) && frag_read_u16le(counter) == n) return true;
+  }
+  return false;
+}
+
+inline bool frag_answer_append(FragResult& result, const uint8_t* data, size_t length) {
+  if (result.answer_length + length > FRAG_ANSWER_MAX) return false;
+  memcpy(result.answer + result.answer_length, data, length);
+  result.answer_length += length;
+  return true;
+}
+
+// Handle one downlink on FRAG_PORT (commands may be concatenated)
+// storage.reset() is called when a new session starts
+template <typename Storage>
+FragResult frag_session_handle(FragSessionState& state, Storage& storage, const uint8_t* data, size_t length) {
+  FragResult result;
+  memset(&result, 0, sizeof(result));
+
+  size_t i = 0;
+  while (i < length) {
+    uint8_t command = data[i++];
+    switch (command) {
+      case FRAG_PACKAGE_VERSION_REQ: {
+        uint8_t answer[3] = {FRAG_PACKAGE_VERSION_REQ, FRAG_PACKAGE_ID, FRAG_PACKAGE_VERSION};
+        frag_answer_append(result, answer, sizeof(answer));
+        break;
+      }
+
+      case FRAG_SESSION_STATUS_REQ: {
+        if (i + 1 > length) return result;
+        uint8_t param = data[i++];
+        uint8_t index = (param >> 1) & 0x03;
+        bool participants = param & 0x01;
+        if (state.status == FRAG_STATUS_IDLE || index != state.index) break;
+        uint32_t missing = state.nb_frag - state.received;
+        if (!participants && missing == 0) break;
+        uint16_t received = (uint16_t)((state.received + state.coded) & 0x3FFF) | (uint16_t)(index << 14);
+        uint8_t answer[5] = {
+          FRAG_SESSION_STATUS_REQ,
+          (uint8_t)(received & 0xFF), (uint8_t)(received >> 8),
+          (uint8_t)(missing > 0xFF ? 0xFF : missing),
+          (uint8_t)(missing > FRAG_MAX_CODED ? 0x01 : 0x00)  // Not enough matrix memory
+        };
+        frag_answer_append(result, answer, sizeof(answer));
+        break;
+      }
+
+      case FRAG_SESSION_SETUP_REQ: {
+        if (i + 10 > length) return result;
+        const uint8_t* p = data + i;
+        i += 10;
+        uint8_t index = (p[0] >> 4) & 0x03;
+        uint16_t nb_frag = frag_read_u16le(p + 1);
+        uint8_t frag_size = p[3];
+        uint8_t matrix = (p[4] >> 3) & 0x07;
+        uint8_t padding = p[5];
+
+        uint8_t status = 0;
+        if (matrix != 0) status |= FRAG_SETUP_ENCODING_UNSUPPORTED;
+        if (nb_frag == 0 || nb_frag > FRAG_MAX_FRAGMENTS || frag_size == 0 ||
+            frag_size > FRAG_MAX_SIZE || padding >= frag_size) {
+          status |= FRAG_SETUP_NOT_ENOUGH_MEMORY;
+        }
+        if (index != 0) status |= FRAG_SETUP_INDEX_UNSUPPORTED;
+        if (status == 0 && !storage.reset()) status |= FRAG_SETUP_NOT_ENOUGH_MEMORY;
+
+        if (status == 0) {
+          frag_session_reset(state);
+          state.status = FRAG_STATUS_RECEIVING;
+          state.index = index;
+          state.nb_frag = nb_frag;
+          state.frag_size = frag_size;
+          state.padding = padding;
+          state.descriptor = frag_read_u32le(p + 6);
+        }
+        uint8_t answer[2] = {FRAG_SESSION_SETUP_REQ, (uint8_t)(status | (index << 6))};
+        frag_answer_append(result, answer, sizeof(answer));
+        break;
+      }
+
+      case FRAG_SESSION_DELETE_REQ: {
+        if (i + 1 > length) return result;
+        uint8_t index = data[i++] & 0x03;
+        uint8_t status = index;
+        if (state.status == FRAG_STATUS_IDLE || index != state.index) {
+          status |= FRAG_DELETE_NO_SESSION;
+        } else {
+          frag_session_reset(state);
+        }
+        uint8_t answer[2] = {FRAG_SESSION_DELETE_REQ, status};
+        frag_answer_append(result, answer, sizeof(answer));
+        break;
+      }
+
+      case FRAG_DATA_FRAGMENT: {
+        // Takes the rest of the downlink
+        if (i + 2 > length) return result;
+        uint16_t index_and_n = frag_read_u16le(data + i);
+        const uint8_t* payload = data + i + 2;
+        size_t payload_length = length - i - 2;
+        i = length;
+
+        uint8_t index = index_and_n >> 14;
+        uint16_t n = index_and_n & 0x3FFF;
+        if (state.status != FRAG_STATUS_RECEIVING || index != state.index) break;
+        if (n == 0 || payload_length != state.frag_size) break;
+        if (n > state.last_counter) state.last_counter = n;
+
+        if (n <= state.nb_frag) {
+          if (frag_bit(state.bitmap, n - 1)) break;
+          if (!storage.write((uint32_t)(n - 1) * state.frag_size, payload, payload_length)) break;
+          frag_set_bit(state.bitmap, n - 1);
+          state.received++;
+        } else {
+          if (state.received == state.nb_frag || state.coded >= FRAG_MAX_CODED) break;
+          if (frag_coded_stored(state, storage, n)) break;
+          uint8_t counter[2] = {(uint8_t)(n & 0xFF), (uint8_t)(n >> 8)};
+          uint32_t offset = frag_coded_offset(state, state.coded);
+          if (!storage.write(offset, counter, 2) || !storage.write(offset + 2, payload, payload_length)) break;
+          uint32_t row = n - state.nb_frag - 1;
+          if (row < FRAG_CODED_ROWS) frag_set_bit(state.coded_rows, row);
+          state.coded++;
+        }
+        result.fragment_stored = true;
+        break;
+      }
+
+      default:
+        return result;  // Unknown command: the rest cannot be parsed
+    }
+  }
+
+  result.decode_due = frag_decode_due(state);
+  return result;
+}
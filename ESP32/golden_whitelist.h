@@ -0,0 +1,253 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+#include "text.h"
+
+// ============================================
+// Golden Whitelist Snapshot
+// ============================================
+//
+// A compact copy of the whitelist in its own flash partition ("golden" in
+// partitions.csv), outside LittleFS. When the filesystem does not mount or
+// the database is damaged, the boot path rebuilds the database from it in
+// one transaction instead of halting or starting with an empty whitelist.
+//
+// The partition holds two slots. A snapshot is written to the slot that
+// does not hold the newest valid one: records first, header last, so a
+// power loss mid-write leaves the previous snapshot in place. The firmware
+// only writes a snapshot from a database that answered queries, after the
+// whitelist changed; the restore path never writes.
+//
+// Flash access goes through a small interface (as Stream/Clock do in
+// at_modem.h): uint32_t size(), bool read(offset, data, length),
+// bool write(offset, data, length) and bool erase(offset, length), with
+// erase on 4 KB sector boundaries.
+
+#define GOLDEN_MAGIC          0x474C4457UL // "GLDW"
+#define GOLDEN_VERSION        1
+#define GOLDEN_SLOT_COUNT     2
+#define GOLDEN_SECTOR_SIZE    4096
+#define GOLDEN_UID_LENGTH     4            // Downlinks carry 4-byte UIDs
+#define GOLDEN_CHUNK_RECORDS  64           // Records per flash read/write
+
+// Roles as carried in user downlinks (DL_ROLE_* in main.cpp)
+#define GOLDEN_ROLE_WORKER    0x01
+#define GOLDEN_ROLE_ADMIN     0x02
+
+struct GoldenRecord {
+  uint8_t uid[GOLDEN_UID_LENGTH];
+  uint8_t role;
+};
+
+struct GoldenHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint32_t sequence;     // Higher is newer
+  uint32_t count;
+  uint32_t records_crc;  // CRC-32 of the records
+  uint32_t crc;          // CRC-32 of everything above
+};
+
+// Snapshot location found by golden_find_newest()
+struct GoldenSnapshot {
+  int          slot;     // -1 if there is none
+  GoldenHeader header;
+};
+
+// ============================================
+// Layout
+// ============================================
+
+inline uint32_t golden_slot_size(uint32_t partition_size) {
+  return (partition_size / GOLDEN_SLOT_COUNT) & ~(uint32_t)(GOLDEN_SECTOR_SIZE - 1);
+}
+
+inline uint32_t golden_slot_capacity(uint32_t partition_size) {
+  uint32_t slot_size = golden_slot_size(partition_size);
+  if (slot_size < sizeof(GoldenHeader)) return 0;
+  return (slot_size - sizeof(GoldenHeader)) / sizeof(GoldenRecord);
+}
+
+inline uint32_t golden_header_crc(const GoldenHeader& header) {
+  return crc32_buffer(&header, offsetof(GoldenHeader, crc));
+}
+
+inline bool golden_header_valid(const GoldenHeader& header, uint32_t partition_size) {
+  return header.magic == GOLDEN_MAGIC &&
+         header.version == GOLDEN_VERSION &&
+         header.record_size == sizeof(GoldenRecord) &&
+         header.crc == golden_header_crc(header) &&
+         header.count <= golden_slot_capacity(partition_size);
+}
+
+// ============================================
+// Tags and Roles
+// ============================================
+
+// "21 47 C2 4C" -> 4 bytes; false for anything else (longer UIDs included)
+inline bool golden_tag_to_uid(const char* tag, uint8_t* uid) {
+  TextView view = text_view(tag);
+  if (view.length != GOLDEN_UID_LENGTH * 3 - 1) return false;
+  for (size_t i = 0; i < GOLDEN_UID_LENGTH; i++) {
+    if (hex_decode(text_view(view.data + i * 3, 2), uid + i, 1) != 1) return false;
+    if (i + 1 < GOLDEN_UID_LENGTH && view.data[i * 3 + 2] != ' ') return false;
+  }
+  return true;
+}
+
+inline uint8_t golden_role_code(const char* role) {
+  if (role == NULL) return 0;
+  if (strcmp(role, "WORKER") == 0) return GOLDEN_ROLE_WORKER;
+  if (strcmp(role, "ADMIN") == 0) return GOLDEN_ROLE_ADMIN;
+  return 0;
+}
+
+inline const char* golden_role_name(uint8_t code) {
+  if (code == GOLDEN_ROLE_WORKER) return "WORKER";
+  if (code == GOLDEN_ROLE_ADMIN) return "ADMIN";
+  return NULL;
+}
+
+// ============================================
+// Reading
+// ============================================
+
+// Call fn(const GoldenRecord&) for each record of a snapshot, checking the
+// records CRC on the way; returns false on a read error or CRC mismatch
+// (fn has then seen records of a damaged snapshot: run it in a transaction)
+template <typename Flash, typename Fn>
+bool golden_for_each(Flash& flash, const GoldenSnapshot& snapshot, Fn fn) {
+  if (snapshot.slot < 0) return false;
+  uint32_t offset = snapshot.slot * golden_slot_size(flash.size()) + sizeof(GoldenHeader);
+  GoldenRecord chunk[GOLDEN_CHUNK_RECORDS];
+  uint32_t crc = 0;
+
+  for (uint32_t done = 0; done < snapshot.header.count;) {
+    uint32_t n = snapshot.header.count - done;
+    if (n > GOLDEN_CHUNK_RECORDS) n = GOLDEN_CHUNK_RECORDS;
+    if (!flash.read(offset, chunk, n * sizeof(GoldenRecord))) return false;
+    crc = crc32_update(crc, chunk, n * sizeof(GoldenRecord));
+    for (uint32_t i = 0; i < n; i++) fn(chunk[i]);
+    offset += n * sizeof(GoldenRecord);
+    done += n;
+  }
+  return crc == snapshot.header.records_crc;
+}
+
+// Newest snapshot with a valid header (records are checked by golden_for_each)
+template <typename Flash>
+GoldenSnapshot golden_find_newest(Flash& flash) {
+  GoldenSnapshot newest;
+  newest.slot = -1;
+  memset(&newest.header, 0, sizeof(newest.header));
+
+  uint32_t slot_size = golden_slot_size(flash.size());
+  for (int slot = 0; slot < GOLDEN_SLOT_COUNT && slot_size > 0; slot++) {
+    GoldenHeader header;
+    if (!flash.read(slot * slot_size, &header, sizeof(header))) continue;
+    if (!golden_header_valid(header, flash.size())) continue;
+    if (newest.slot < 0 || (int32_t)(header.sequence - newest.header.sequence) > 0) {
+      newest.slot = slot;
+      newest.header = header;
+    }
+  }
+  return newest;
+}
+
+// ============================================
+// Writing
+// ============================================
+
+struct GoldenWriter {
+  int          slot;
+  uint32_t     sequence;
+  uint32_t     count;
+  uint32_t     crc;
+  uint32_t     buffered;
+  bool         failed;
+  GoldenRecord buffer[GOLDEN_CHUNK_RECORDS];
+};
+
+// Erase the slot not holding the newest snapshot and start a new one there
+template <typename Flash>
+bool golden_writer_begin(Flash& flash, GoldenWriter& writer) {
+  memset(&writer, 0, sizeof(writer));
+  uint32_t slot_size = golden_slot_size(flash.size());
+  if (slot_size == 0) {
+    writer.failed = true;
+    return false;
+  }
+
+  GoldenSnapshot newest = golden_find_newest(flash);
+  writer.slot = newest.slot == 0 ? 1 : 0;
+  writer.sequence = newest.slot < 0 ? 1 : newest.header.sequence + 1;
+  writer.failed = !flash.erase(writer.slot * slot_size, slot_size);
+  return !writer.failed;
+}
+
+template <typename Flash>
+bool golden_writer_flush(Flash& flash, GoldenWriter& writer) {
+  if (writer.buffered == 0 || writer.failed) return !writer.failed;
+  uint32_t offset = writer.slot * golden_slot_size(flash.size()) + sizeof(GoldenHeader) +
+                    (writer.count - writer.buffered) * sizeof(GoldenRecord);
+  uint32_t length = writer.buffered * sizeof(GoldenRecord);
+  writer.failed = !flash.write(offset, writer.buffer, length);
+  writer.crc = crc32_update(writer.crc, writer.buffer, length);
+  writer.buffered = 0;
+  return !writer.failed;
+}
+
+// Append one record; false once the slot is full or a write failed
+template <typename Flash>
+bool golden_writer_add(Flash& flash, GoldenWriter& writer, const GoldenRecord& record) {
+  if (writer.failed) return false;
+  if (writer.count >= golden_slot_capacity(flash.size())) {
+    writer.failed = true;
+    return false;
+  }
+  writer.buffer[writer.buffered++] = record;
+  writer.count++;
+  if (writer.buffered == GOLDEN_CHUNK_RECORDS) return golden_writer_flush(flash, writer);
+  return true;
+}
+
+// Write the header, which makes the snapshot the newest one
+template <typename Flash>
+bool golden_writer_finish(Flash& flash, GoldenWriter& writer) {
+  if (!golden_writer_flush(flash, writer)) return false;
+
+  GoldenHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = GOLDEN_MAGIC;
+  header.version = GOLDEN_VERSION;
+  header.record_size = sizeof(GoldenRecord);
+  header.sequence = writer.sequence;
+  header.count = writer.count;
+  header.records_crc = writer.crc;
+  header.crc = golden_header_crc(header);
+  writer.failed = !flash.write(writer.slot * golden_slot_size(flash.size()), &header, sizeof(header));
+  return !writer.failed;
+}
+
+// ============================================
+// Recovery Report
+// ============================================
+
+// Reason codes of the recovery uplink (wake_cycle_build_recovery)
+#define RECOVERY_NONE           0x00
+#define RECOVERY_FS_FORMATTED   0x01  // LittleFS did not mount and was formatted
+#define RECOVERY_DB_OPEN        0x02  // Database did not open
+#define RECOVERY_DB_CORRUPT     0x03  // Integrity check or schema probe failed
+#define RECOVERY_DB_UNAVAILABLE 0x04  // Could not rebuild; running without a whitelist
+#define RECOVERY_NO_SNAPSHOT    0x80  // Flag: no valid golden snapshot, whitelist rebuilt empty
+
+// Pending recovery report, kept in RTC memory until the uplink goes out
+struct RecoveryReport {
+  uint8_t  reason;        // RECOVERY_NONE when nothing is pending
+  uint16_t users;         // Users restored from the snapshot
+  uint32_t duration_ms;   // Mount to usable database
+};
@@ -2,6 +2,8 @@
 #include <SQLiteManager.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include "db_tuning.h"
+#include "db_schema.h"
 
 SQLiteManager database;
 
@@ -14,56 +16,28 @@ void setup() {
 	}
 
 	try {
-		database.open("/littlefs/database.db");
+		database.open(DB_PATH);
 	} catch (const std::exception &e) {
 		Serial.println(e.what());
 		while (true);
 	}
 
-	// Create role table (reference table for integrity)
+	// Page size matching the firmware's page cache slots (only takes effect on a new database)
 	try {
-		database.execute(
-			"CREATE TABLE IF NOT EXISTS role ("
-			"role_code TEXT PRIMARY KEY"
-			")"
-		);
-		Serial.println("Table 'role' created.");
+		database.execute("PRAGMA page_size = " DB_TUNING_XSTR(DB_PAGE_SIZE) ";");
 	} catch (const std::exception &e) {
 		Serial.println(e.what());
 	}
 
-	// Insert default roles
-	try {
-		database.execute("INSERT OR IGNORE INTO role (role_code) VALUES (?)", "WORKER");
-		database.execute("INSERT OR IGNORE INTO role (role_code) VALUES (?)", "ADMIN");
-		Serial.println("Default roles inserted.");
-	} catch (const std::exception &e) {
-		Serial.println(e.what());
-	}
-
-	// Create user table with FK to role
-	try {
-		database.execute(
-			"CREATE TABLE IF NOT EXISTS user ("
-			"id INTEGER PRIMARY KEY AUTOINCREMENT, "
-			"name TEXT NOT NULL, "
-			"rfid_tag_id TEXT NOT NULL UNIQUE, "
-			"role TEXT NOT NULL, "
-			"FOREIGN KEY (role) REFERENCES role(role_code)"
-			")"
-		);
-		Serial.println("Table 'user' created.");
-	} catch (const std::exception &e) {
-		Serial.println(e.what());
-	}
-
-	// Create index on rfid_tag_id for faster lookups
-	try {
-		database.execute("CREATE INDEX IF NOT EXISTS idx_user_rfid ON user(rfid_tag_id)");
-		Serial.println("Indexes created.");
-	} catch (const std::exception &e) {
-		Serial.println(e.what());
+	// Create tables, default roles and indexes (shared with the firmware's rebuild path)
+	for (size_t i = 0; i < DB_SCHEMA_STATEMENT_COUNT; i++) {
+		try {
+			database.execute(db_schema_statements[i]);
+		} catch (const std::exception &e) {
+			Serial.println(e.what());
+		}
 	}
+	Serial.println("Tables 'role' and 'user', default roles and indexes created.");
 
 	Serial.println("Database initialization complete!");
 }
@@ -2,10 +2,37 @@
 #include <SPI.h>
 #include <MFRC522.h>
 #include <SQLiteManager.h>
+#include <sqlite3.h>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <esp_sleep.h>
+#include <esp_system.h>
 #include <Preferences.h>
+#include <sys/time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+#include "time_sync.h"
+#include "fill_forecast.h"
+#include "airtime.h"
+#include "device_config.h"
+#include "rtc_state.h"
+#include "wake_cycle.h"
+#include "at_modem.h"
+#include "text.h"
+#include "event_bus.h"
+#include "db_tuning.h"
+#include "db_schema.h"
+#include "power_profile.h"
+
+// The wake-cycle paths run on fixed buffers (text.h) instead of the heap:
+// any String in this file is a build error
+#pragma GCC poison String
 
 // Define pin connections - RFID
 #define SS_PIN   5   // SDA on RC522
@@ -23,186 +50,377 @@
 #define TRIG_PIN     6   // Ultrasound trigger
 #define ECHO_PIN     7   // Ultrasound echo
 
-// Trashcan configuration
+// Trashcan configuration defaults
+// These are factory defaults only: the values in use live in device_config
+// (NVS) and can be changed over the air with a SET_CONFIG downlink
 #define TRASHCAN_DEPTH_CM  30.0  // Distance from sensor to bottom when empty (adjust to your trashcan)
 #define TRASHCAN_NAME "LX-001" // Name identifier for this trashcan
 
-// Deep sleep configuration
+// Ultrasound channels, one per compartment of the station; channel 0 is the
+// primary sensor above. Add a row for each extra compartment driven by this
+// controller (at most SENSOR_CHANNELS_MAX); the backend tells them apart by
+// channel number. Depths are factory defaults like TRASHCAN_DEPTH_CM.
+struct UltrasoundChannel {
+  byte  trig_pin;
+  byte  echo_pin;
+  float depth_cm;
+};
+const UltrasoundChannel ULTRASOUND_CHANNELS[] = {
+  {TRIG_PIN, ECHO_PIN, TRASHCAN_DEPTH_CM},
+  // {15, 16, 30.0},  // e.g. recycling compartment next to it
+};
+#define SENSOR_CHANNELS  (sizeof(ULTRASOUND_CHANNELS) / sizeof(ULTRASOUND_CHANNELS[0]))
+static_assert(SENSOR_CHANNELS <= SENSOR_CHANNELS_MAX, "too many ultrasound channels");
+
+// Channels are pinged one after the other: an echo of one sensor still
+// bouncing around the station must not be picked up by the next
+#define ULTRASOUND_CHANNEL_GAP_MS  60
+
+// Deep sleep configuration defaults
 #define DEEP_SLEEP_TIMER_US  180000000ULL   // 3 minutes in microseconds (180 * 1000 * 1000)
 #define ACTIVE_WINDOW_MS     30000          // Stay awake for 30 seconds after wake-up
 
+// Downlink wait configuration default
+#define DOWNLINK_WAIT_MS   15000   // Upper bound on listening after an uplink (RX windows close sooner)
+
 MFRC522 rfid(SS_PIN, RST_PIN); // Create MFRC522 instance
 SQLiteManager database;
+int page_cache_slot_size = 0;  // Bytes per slot of the PSRAM page cache, 0 without one
+bool database_ready = false;   // Whitelist database open and answering (see open_whitelist_database)
+bool whitelist_changed = false; // Users changed this wake: refresh the golden snapshot before sleep
+bool filesystem_ready = false;  // LittleFS mounted (whitelist, journal and firmware downloads)
 HardwareSerial LoRaSerial(1); // Serial1 for LoRaWAN
 
 // LoRaWAN state management
 bool lorawan_joined = false;
 
-// Persistent storage for usage counter (survives deep sleep)
+// State that survives deep sleep, protected by a CRC (see rtc_state.h)
+RTC_DATA_ATTR RtcState rtc_state;
+
+// Persistent storage (NVS) - opened lazily, only when it must be read or written
 Preferences preferences;
-int usage_counter = 0;
+bool preferences_open = false;
+
+// Usage counter lives in RTC memory and is flushed to NVS in batches
+int32_t& usage_counter = rtc_state.usage_counter;
 
 // Flag to track if worker was authenticated this wake cycle
 bool worker_authenticated = false;
 
-// Function to format RFID UID as string (e.g., "21 47 C2 4C")
-String format_rfid(byte *uid, byte size) {
-  String rfidString = "";
-  for (byte i = 0; i < size; i++) {
-    if (i > 0) rfidString += " ";
-    if (uid[i] < 0x10) rfidString += "0";
-    rfidString += String(uid[i], HEX);
-  }
-  rfidString.toUpperCase();
-  return rfidString;
+// Where this wake cycle spent its power, printed before deep sleep (see power_profile.h)
+WakeProfile wake_profile;
+unsigned long rfid_on_at = 0;  // millis() when the RC522 field came on, 0 while it is off
+
+// Runtime configuration (persisted in NVS, cached in RTC memory for warm wakes)
+DeviceConfig device_config;
+DeviceConfig& config_cache = rtc_state.config;
+
+// Pending SET_CONFIG acknowledgements, sent after the downlink wait
+#define MAX_CONFIG_ACKS  4
+byte config_ack_params[MAX_CONFIG_ACKS];
+byte config_ack_status[MAX_CONFIG_ACKS];
+int config_ack_count = 0;
+char config_ack_name[DEVICE_NAME_LENGTH + 1];  // Name in effect before the changes
+
+// Follow-up uplinks (config acks, polls for pending downlinks) per downlink exchange
+#define DOWNLINK_MAX_FOLLOWUPS  3
+bool downlink_more_pending = false;  // Last downlink flagged another one queued on the server
+
+// Firmware patch download (see frag_session.h); the session survives deep sleep
+FragSessionState& frag_session = rtc_state.frag;
+byte frag_answer[FRAG_ANSWER_MAX];  // Answer to the last FRAG_PORT downlink, sent after the downlink wait
+size_t frag_answer_length = 0;
+
+// Event journal index and pending upload (see event_journal.h); records are in LittleFS
+JournalState& event_journal = rtc_state.journal;
+JournalUpload& journal_upload = rtc_state.journal_upload;
+
+// Network time sync state (survives deep sleep)
+TimeSyncState& time_sync = rtc_state.time_sync;
+
+// Multicast group session and whitelist batch reception (see multicast_session.h)
+MulticastGroup& multicast_group = rtc_state.multicast_group;
+MulticastBatchState& multicast_batch = rtc_state.multicast;
+bool multicast_frame_received = false;  // A batch frame was heard in this wake
+
+// Numbered unicast downlinks applied once and in order (see downlink_sequence.h)
+DownlinkSequenceState& downlink_sequence = rtc_state.downlink_sequence;
+
+// Fill-rate forecast state per channel (survives deep sleep, reset on cleanup)
+FillForecastState* fill_forecast = rtc_state.forecast;
+
+// Motion wakes per bin since the last report (survives deep sleep)
+UsageHistogramState& usage_histogram = rtc_state.usage_histogram;
+
+// Uplink airtime budget (survives deep sleep)
+AirtimeBudgetState& airtime_budget = rtc_state.airtime;
+bool data_rate_queried = false;     // Data rate is refreshed once per wake cycle
+bool last_uplink_deferred = false;  // Set when the governor held back the last uplink
+unsigned long last_uplink_done_ms = 0;  // millis() when the last AT+SENDB transaction ended (0 = none)
+
+// Free-running local clock in milliseconds
+// Backed by the RTC timer, so it keeps counting through deep sleep
+int64_t local_clock_ms() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+// Function to format RFID UID as text (e.g., "21 47 C2 4C")
+// out must hold RFID_TAG_TEXT_SIZE characters
+void format_rfid(byte *uid, byte size, char* out) {
+  text_format_rfid(uid, size, out, RFID_TAG_TEXT_SIZE);
 }
 
 // ============================================
 // Persistent Counter Functions
 // ============================================
 
-// Increment usage counter and save to persistent storage
-void increment_counter() {
-  usage_counter++;
-  preferences.putInt("usage_count", usage_counter);
-  Serial.print("📊 Usage counter incremented to: ");
-  Serial.println(usage_counter);
+// Open the NVS namespace on first use
+void open_preferences() {
+  if (!preferences_open) {
+    preferences.begin("trashcan", false);  // namespace "trashcan", read-write mode
+    preferences_open = true;
+  }
 }
 
 // Clear usage counter (after sending periodic report)
+// Counters live in RTC memory only and are flushed to NVS in batches
 void clear_counter() {
-  usage_counter = 0;
-  preferences.putInt("usage_count", 0);
+  wake_cycle_report_sent(rtc_state, local_clock_ms());
   Serial.println("📊 Usage counter cleared to 0");
 }
 
-// Forward declaration for process_downlink_message
-void process_downlink_message(String hexData, int port);
+// Write RTC counters to NVS if they changed since the last flush
+void flush_counters_to_nvs(const char* reason) {
+  if (!wake_cycle_flush(rtc_state, local_clock_ms())) return;
+  
+  open_preferences();
+  preferences.putInt("usage_count", usage_counter);
+  
+  Serial.print("💾 Counters flushed to NVS (");
+  Serial.print(reason);
+  Serial.println(")");
+}
 
-// Function to check response for RX: messages and process them
-void check_response_for_downlink(String& response) {
-  // Look for RX: pattern in response
-  int rxIndex = response.indexOf("RX:");
-  if (rxIndex >= 0) {
-    Serial.println("\n📩 ===== Downlink Found in Response =====");
-    
-    // Extract the RX line - find the end (newline or end of string)
-    int lineEnd = response.indexOf('\n', rxIndex);
-    if (lineEnd < 0) lineEnd = response.indexOf('\r', rxIndex);
-    if (lineEnd < 0) lineEnd = response.length();
+// Restore RTC state at boot
+// Valid CRC: keep the RTC copy (no NVS access). Otherwise (power-on, reset
+// in the middle of a wake, corrupted memory): rebuild and reload from NVS.
+void restore_rtc_state() {
+  if (rtc_state_valid(rtc_state)) {
+    Serial.println("🧠 RTC state valid - skipping NVS");
+  } else {
+    Serial.println("🧠 RTC state invalid - recovering from NVS");
+    rtc_state_init(rtc_state, local_clock_ms());
     
-    String rxLine = response.substring(rxIndex, lineEnd);
-    rxLine.trim();
-    Serial.print("RX Line: ");
-    Serial.println(rxLine);
+    open_preferences();
+    usage_counter = preferences.getInt("usage_count", 0);  // default 0
+    rtc_state.flushed_usage_counter = usage_counter;
     
-    // Parse format: RX:HEXDATA:PORT:RSSI:SNR
-    int firstColon = rxLine.indexOf(':');
-    int secondColon = rxLine.indexOf(':', firstColon + 1);
-    int thirdColon = rxLine.indexOf(':', secondColon + 1);
-    int fourthColon = rxLine.indexOf(':', thirdColon + 1);
+    // Firmware update result written before the restart into a new image
+    if (preferences.getBytes("ota_report", &rtc_state.ota, sizeof(rtc_state.ota)) != sizeof(rtc_state.ota)) {
+      memset(&rtc_state.ota, 0, sizeof(rtc_state.ota));
+    }
     
-    if (secondColon > 0) {
-      // Extract hex data (between first and second colon)
-      String hexData = rxLine.substring(firstColon + 1, secondColon);
-      
-      // Extract port
-      int port = 0;
-      if (thirdColon > 0) {
-        String portStr = rxLine.substring(secondColon + 1, thirdColon);
-        port = portStr.toInt();
-      }
-      
-      // Extract rssi, snr for logging
-      String rssi = "";
-      String snr = "";
-      if (fourthColon > 0) {
-        rssi = rxLine.substring(thirdColon + 1, fourthColon);
-        snr = rxLine.substring(fourthColon + 1);
-      }
-      
-      // Display info
-      Serial.print("Hex Data: ");
-      for (unsigned int i = 0; i < hexData.length(); i += 2) {
-        Serial.print(hexData.substring(i, i + 2));
-        if (i + 2 < hexData.length()) Serial.print(" ");
-      }
-      Serial.println();
-      Serial.print("Port: ");
-      Serial.println(port);
-      if (rssi.length() > 0) {
-        Serial.print("RSSI: ");
-        Serial.print(rssi);
-        Serial.println(" dBm");
-      }
-      if (snr.length() > 0) {
-        Serial.print("SNR: ");
-        Serial.println(snr);
-      }
-      Serial.println("========================================\n");
-      
-      // Process the downlink message
-      process_downlink_message(hexData, port);
+    // Multicast group session from the last MULTICAST_SETUP
+    if (preferences.getBytes("mcast", &multicast_group, sizeof(multicast_group)) != sizeof(multicast_group)) {
+      memset(&multicast_group, 0, sizeof(multicast_group));
     }
   }
+  
+  wake_cycle_start(rtc_state);
+  
+  Serial.print("📊 Usage counter: ");
+  Serial.print(usage_counter);
+  Serial.print(" (wake #");
+  Serial.print(rtc_state.wake_count);
+  Serial.println(")");
 }
 
-// Function to send AT command to LoRaWAN and check for OK response
-// Also captures and processes any RX: (downlink) messages in the response
-bool send_at_command(const char* command, unsigned long timeout = 2000) {
-  // Clear any pending data
-  while (LoRaSerial.available()) {
-    LoRaSerial.read();
+// ============================================
+// Device Configuration Functions
+// ============================================
+
+// Give the channels from first_channel on their factory depth and record
+// how many channels this build drives
+void apply_channel_defaults(byte first_channel) {
+  for (byte i = first_channel; i < SENSOR_CHANNELS; i++) {
+    device_config_set_depth_mm(device_config, i, (uint16_t)(ULTRASOUND_CHANNELS[i].depth_cm * 10));
+  }
+  device_config.channel_count = SENSOR_CHANNELS;
+  device_config_seal(device_config);
+}
+
+// Load the runtime configuration
+// A valid RTC cache is used as is; otherwise (power-on or a corrupted cache)
+// NVS is read, and a missing or invalid NVS blob falls back to the
+// compile-time defaults
+void load_device_config() {
+  if (device_config_valid(config_cache)) {
+    device_config = config_cache;
+    Serial.println("⚙️  Configuration loaded from RTC cache");
+    return;
   }
   
-  // Send AT command
-  LoRaSerial.println(command);
-  Serial.print("Sent to LoRaWAN: ");
-  Serial.println(command);
+  open_preferences();
+  size_t length = preferences.getBytes("config", &device_config, sizeof(device_config));
+  DeviceConfigV2 old_config;
+  if (length == sizeof(old_config)) memcpy(&old_config, &device_config, sizeof(old_config));
+  
+  if (length == sizeof(device_config) && device_config_valid(device_config)) {
+    Serial.println("⚙️  Configuration loaded from NVS");
+  } else if (length == sizeof(old_config) && device_config_upgrade(old_config, device_config)) {
+    apply_channel_defaults(1);
+    preferences.putBytes("config", &device_config, sizeof(device_config));
+    Serial.print("⚙️  Configuration upgraded from version ");
+    Serial.println(old_config.version);
+  } else {
+    device_config_defaults(device_config,
+                           (uint32_t)(DEEP_SLEEP_TIMER_US / 1000000ULL),
+                           ACTIVE_WINDOW_MS,
+                           (uint16_t)(TRASHCAN_DEPTH_CM * 10),
+                           DOWNLINK_WAIT_MS,
+                           TRASHCAN_NAME);
+    apply_channel_defaults(1);
+    preferences.putBytes("config", &device_config, sizeof(device_config));
+    Serial.println("⚙️  No valid configuration in NVS - defaults stored");
+  }
+  
+  // Channels added by this firmware build start with their factory depth
+  if (device_config.channel_count != SENSOR_CHANNELS) {
+    apply_channel_defaults(device_config.channel_count);
+    preferences.putBytes("config", &device_config, sizeof(device_config));
+    Serial.print("⚙️  Ultrasound channels: ");
+    Serial.println(device_config.channel_count);
+  }
   
-  // Wait for response
-  unsigned long start = millis();
-  String response = "";
-  bool foundOK = false;
-  unsigned long okFoundTime = 0;
+  config_cache = device_config;
+}
+
+// Persist the runtime configuration to NVS and refresh the RTC cache
+bool save_device_config() {
+  config_cache = device_config;
+  open_preferences();
+  return preferences.putBytes("config", &device_config, sizeof(device_config)) == sizeof(device_config);
+}
+
+// Print the runtime configuration
+void print_device_config() {
+  Serial.print("  Name: ");
+  Serial.println(device_config.name);
+  Serial.print("  Report interval: ");
+  Serial.print(device_config.sleep_interval_s);
+  Serial.println(" s");
+  Serial.print("  Active window: ");
+  Serial.print(device_config.active_window_ms);
+  Serial.println(" ms");
+  Serial.print("  Depth: ");
+  Serial.print(device_config.depth_mm / 10.0, 1);
+  Serial.println(" cm");
+  for (byte i = 1; i < device_config.channel_count; i++) {
+    Serial.print("  Depth (channel ");
+    Serial.print(i);
+    Serial.print("): ");
+    Serial.print(device_config_depth_mm(device_config, i) / 10.0, 1);
+    Serial.println(" cm");
+  }
+  Serial.print("  Downlink wait: ");
+  Serial.print(device_config.downlink_wait_ms);
+  Serial.println(" ms");
+  Serial.print("  Diagnostics uplink: ");
+  Serial.println(device_config.diagnostics ? "on" : "off");
+}
+
+// Forward declaration for process_downlink_message
+void process_downlink_message(const byte* data, size_t length, int port);
+
+// Print the fields of a parsed RX: line
+void print_downlink(const AtDownlink& downlink) {
+  Serial.print("Hex Data: ");
+  for (size_t i = 0; i < downlink.length; i++) {
+    if (downlink.data[i] < 0x10) Serial.print("0");
+    Serial.print(downlink.data[i], HEX);
+    if (i + 1 < downlink.length) Serial.print(" ");
+  }
+  Serial.println();
+  Serial.print("Port: ");
+  Serial.println(downlink.port);
+  if (downlink.rssi != 0) {
+    Serial.print("RSSI: ");
+    Serial.print(downlink.rssi);
+    Serial.println(" dBm");
+    Serial.print("SNR: ");
+    Serial.println(downlink.snr, 1);
+  }
+}
+
+// Function to check response for RX: messages and process them
+void check_response_for_downlink(const char* response) {
+  // Look for RX: pattern in response
+  const char* rx_line = at_find_rx(response);
+  if (rx_line == NULL) return;
   
-  // Additional wait time after OK to capture any RX: message (10 seconds)
-  const unsigned long POST_OK_WAIT_MS = 10000;
+  Serial.println("\n📩 ===== Downlink Found in Response =====");
+  Serial.print("RX Line: ");
+  Serial.write(rx_line, strcspn(rx_line, "\r\n"));
+  Serial.println();
   
-  while (true) {
-    // Check timeout conditions
-    if (!foundOK && (millis() - start >= timeout)) {
-      // Timed out waiting for OK
-      break;
-    }
-    if (foundOK && (millis() - okFoundTime >= POST_OK_WAIT_MS)) {
-      // Found OK and waited additional time for RX
-      break;
-    }
-    
-    if (LoRaSerial.available()) {
-      char c = LoRaSerial.read();
-      response += c;
-      Serial.print(c); // Echo in real-time for debugging
-      
-      // Check if we received "OK" (and haven't found it yet)
-      if (!foundOK && response.indexOf("OK") != -1) {
-        foundOK = true;
-        okFoundTime = millis();
-        Serial.println("\n[OK received, waiting for potential RX...]");
-      }
-    }
+  // Parse format: RX:HEXDATA:PORT:RSSI:SNR
+  AtDownlink downlink;
+  if (!at_parse_rx_line(rx_line, downlink)) {
+    Serial.println("✗ Malformed RX line (ignored)");
+    Serial.println("========================================\n");
+    return;
   }
   
-  Serial.println(); // New line after response
+  print_downlink(downlink);
+  Serial.println("========================================\n");
+  
+  // Process the downlink message
+  process_downlink_message(downlink.data, downlink.length, downlink.port);
+}
+
+// Time source for the AT modem driver (see at_modem.h)
+struct ArduinoClock {
+  unsigned long millis() { return ::millis(); }
+  void delay(unsigned long ms) { ::delay(ms); }
+  // Nothing to read yet: yield a tick (1 ms) to the event loop and the other
+  // tasks instead of spinning. The UART driver buffers what arrives meanwhile
+  void idle() { vTaskDelay(1); }
+};
+
+ArduinoClock arduino_clock;
+AtResponse at_response;  // Last module response (static: too big for the stack)
+
+// The main task and the modem reader task share the UART; whoever holds the
+// lock owns it for a whole AT transaction (recursive: downlink handling may
+// send further commands)
+SemaphoreHandle_t modem_mutex = NULL;
+
+struct ModemLock {
+  ModemLock() { xSemaphoreTakeRecursive(modem_mutex, portMAX_DELAY); }
+  ~ModemLock() { xSemaphoreGiveRecursive(modem_mutex); }
+};
+
+// Function to send AT command to LoRaWAN and check for OK response
+// Also captures and processes any RX: (downlink) messages in the response
+// post_ok_wait: how long to keep listening after OK (uplinks: their RX windows)
+// The raw response stays in at_response for the caller to parse
+bool send_at_command(const char* command, unsigned long timeout = AT_COMMAND_TIMEOUT_MS,
+                     unsigned long post_ok_wait = 0) {
+  ModemLock lock;
+  Serial.print("Sent to LoRaWAN: ");
+  Serial.println(command);
+  
+  bool foundOK = at_command(LoRaSerial, arduino_clock, command, timeout, post_ok_wait, at_response);
   
   // Print full response for debugging
   Serial.print("Full Response: [");
-  Serial.print(response);
+  Serial.print(at_response.text);
   Serial.println("]");
   
   // Check for and process any RX: messages in the response
-  check_response_for_downlink(response);
+  check_response_for_downlink(at_response.text);
   
   if (!foundOK) {
     Serial.println("✗ No OK received (timeout)");
@@ -212,36 +430,118 @@ bool send_at_command(const char* command, unsigned long timeout = 2000) {
   return true;
 }
 
+// Function to query the module's current data rate (ADR may change it)
+// Updates airtime_budget.data_rate; keeps the previous value if the query fails
+bool query_lorawan_data_rate() {
+  if (!send_at_command(LORA_DR_QUERY_CMD, AT_COMMAND_TIMEOUT_MS, 0)) {
+    Serial.print("✗ Data rate query failed, keeping DR");
+    Serial.println(airtime_budget.data_rate);
+    return false;
+  }
+  
+  // Skip a possible command echo, then take the first number in the answer
+  int value = at_parse_data_rate(at_response.text);
+  
+  uint8_t sf;
+  uint16_t bw_khz;
+  if (value < 0 || value > 255 || !lora_data_rate_params((uint8_t)value, sf, bw_khz)) {
+    Serial.print("✗ Could not parse data rate, keeping DR");
+    Serial.println(airtime_budget.data_rate);
+    return false;
+  }
+  
+  airtime_budget.data_rate = (uint8_t)value;
+  Serial.print("📶 Data rate: DR");
+  Serial.print(value);
+  Serial.print(" (SF");
+  Serial.print(sf);
+  Serial.print(", ");
+  Serial.print(bw_khz);
+  Serial.println(" kHz)");
+  return true;
+}
+
+// Function to query the RX1 delay the join accept gave the module
+// Updates airtime_budget.rx1_delay_ms; the default stays in use if the query fails
+bool query_lorawan_rx1_delay() {
+  if (!send_at_command(LORA_RX1_DELAY_QUERY_CMD, AT_COMMAND_TIMEOUT_MS, 0)) {
+    Serial.println("✗ RX1 delay query failed, planning with the default");
+    return false;
+  }
+  
+  long value = at_parse_rx1_delay(at_response.text);
+  if (value <= 0 || value > LORAWAN_RX1_DELAY_MAX_MS) {
+    Serial.println("✗ Could not parse RX1 delay, planning with the default");
+    return false;
+  }
+  
+  airtime_budget.rx1_delay_ms = (uint16_t)value;
+  Serial.print("📶 RX1 delay: ");
+  Serial.print(value);
+  Serial.println(" ms");
+  return true;
+}
+
 // Function to send data via LoRaWAN using AT+SENDB command
-bool send_lorawan_data(byte* data, int length, int port = 1) {
+// The airtime governor may defer low-priority uplinks (returns false and sets
+// last_uplink_deferred); high-priority uplinks are always sent
+bool send_lorawan_data(byte* data, int length, int port = 1, byte priority = UPLINK_PRIORITY_LOW) {
   Serial.println("\n=== Sending Data via LoRaWAN ===");
   Serial.print("Data length: ");
   Serial.print(length);
   Serial.print(" bytes on port ");
   Serial.println(port);
   
-  // Convert bytes to hex string
-  String hexData = "";
-  for (int i = 0; i < length; i++) {
-    if (data[i] < 0x10) hexData += "0";
-    hexData += String(data[i], HEX);
+  // Estimate time-on-air at the module's current data rate
+  if (!data_rate_queried) {
+    query_lorawan_data_rate();
+    if (airtime_budget.rx1_delay_ms == 0) query_lorawan_rx1_delay();
+    data_rate_queried = true;
+  }
+  uint32_t airtime_ms = 0;
+  bool allowed = wake_cycle_uplink_allowed(rtc_state, local_clock_ms(), length, priority, airtime_ms);
+  
+  Serial.print("Estimated airtime: ");
+  Serial.print(airtime_ms);
+  Serial.print(" ms at DR");
+  Serial.println(airtime_budget.data_rate);
+  
+  last_uplink_deferred = false;
+  if (!allowed) {
+    last_uplink_deferred = true;
+    Serial.print("⏸ Airtime budget exhausted (");
+    Serial.print(airtime_budget.tokens_ms);
+    Serial.println(" ms left) - uplink deferred");
+    Serial.println("====================================\n");
+    return false;
   }
-  hexData.toUpperCase();
-  
-  Serial.print("Hex data: ");
-  Serial.println(hexData);
   
-  // Construct AT+SENDB command
-  String command = "AT+SENDB=" + String(port) + ":" + hexData;
+  // Construct AT+SENDB command (uppercase hex payload)
+  char command[AT_SENDB_MAX_LENGTH];
+  if (at_format_sendb(command, sizeof(command), port, data, length) == 0) {
+    Serial.println("✗ Payload too long for AT+SENDB");
+    Serial.println("====================================\n");
+    return false;
+  }
   
-  // Send the command
+  // Send the command and listen until both receive windows have closed
+  uint32_t listen_ms = wake_cycle_listen_ms(device_config, airtime_ms, lorawan_rx1_delay_ms(airtime_budget));
   Serial.print("Sending command: ");
   Serial.println(command);
+  Serial.print("Listening for a downlink for ");
+  Serial.print(listen_ms);
+  Serial.println(" ms after OK");
   
-  bool success = send_at_command(command.c_str(), 5000); // 5 second timeout
+  bool success = send_at_command(command, AT_SENDB_TIMEOUT_MS, listen_ms);
+  last_uplink_done_ms = millis();
   
   if (success) {
+    airtime_budget_charge(airtime_budget, airtime_ms);
+    wake_profile_uplink(wake_profile, airtime_ms, listen_ms);
     Serial.println("✓ Data queued for transmission");
+    Serial.print("Airtime budget left: ");
+    Serial.print(airtime_budget.tokens_ms);
+    Serial.println(" ms");
   } else {
     Serial.println("✗ Failed to queue data for transmission");
   }
@@ -268,173 +568,68 @@ bool test_lorawan_module() {
   return at_ok;
 }
 
+// Log one join attempt (callback for at_join_network)
+void log_join_attempt(int attempt, int max_retries, AtJoinResult result) {
+  Serial.print("Join attempt ");
+  Serial.print(attempt);
+  Serial.print("/");
+  Serial.print(max_retries);
+  Serial.print(": [");
+  Serial.print(at_response.text);
+  Serial.println("]");
+  
+  if (result == AT_JOIN_OK) return;
+  
+  Serial.print("✗ Join attempt ");
+  Serial.print(attempt);
+  Serial.println(result == AT_JOIN_TIMEOUT ? " timed out" : " failed");
+  if (attempt < max_retries) {
+    Serial.println("Retrying in 5 seconds...");
+  }
+}
+
 // Function to join LoRaWAN network in OTAA mode
-bool join_lorawan_network(int max_retries = 3, unsigned long timeout = 60000) {
+bool join_lorawan_network(int max_retries = AT_JOIN_MAX_RETRIES, unsigned long timeout = AT_JOIN_TIMEOUT_MS) {
   Serial.println("\n=== Joining LoRaWAN Network (OTAA) ===");
+  Serial.println("Sent: AT+JOIN - waiting for join confirmation...");
   
-  for (int attempt = 1; attempt <= max_retries; attempt++) {
-    Serial.print("Join attempt ");
-    Serial.print(attempt);
-    Serial.print("/");
-    Serial.println(max_retries);
-    
-    // Clear any pending data thoroughly
-    while (LoRaSerial.available()) {
-      LoRaSerial.read();
-    }
-    
-    // Give module time to settle after clearing buffer
-    delay(500);
-    
-    // Send JOIN command
-    LoRaSerial.println("AT+JOIN");
-    Serial.println("Sent: AT+JOIN");
-    
-    // Wait for join response (OTAA can take 30-60 seconds)
-    unsigned long start = millis();
-    String response = "";
-    bool joined = false;
-    
-    Serial.println("Waiting for join confirmation...");
-    
-    while (millis() - start < timeout) {
-      if (LoRaSerial.available()) {
-        char c = LoRaSerial.read();
-        response += c;
-        Serial.print(c); // Echo response in real-time
-        
-        // Check for success indicators
-        if (response.indexOf("OK") != -1 || 
-            response.indexOf("JOINED") != -1 || 
-            response.indexOf("Join Success") != -1) {
-          joined = true;
-          break;
-        }
-        
-        // Check for failure indicators
-        if (response.indexOf("ERROR") != -1 || 
-            response.indexOf("Join Failed") != -1) {
-          break;
-        }
-      }
-      
-      // Give some feedback every 10 seconds
-      if ((millis() - start) % 10000 == 0) {
-        Serial.print(".");
-      }
-    }
-    
-    Serial.println(); // New line after response
-    
-    if (joined) {
-      Serial.println("✓ Successfully joined LoRaWAN network!");
-      Serial.println("=========================================\n");
-      return true;
-    } else {
-      Serial.print("✗ Join attempt ");
-      Serial.print(attempt);
-      Serial.println(" failed");
-      
-      if (attempt < max_retries) {
-        Serial.println("Retrying in 5 seconds...");
-        delay(5000);
-      }
-    }
-  }
+  // Drain, settle, AT+JOIN and retries live in at_modem.h
+  unsigned long started = millis();
+  bool joined = at_join_network(LoRaSerial, arduino_clock, max_retries, timeout, at_response, log_join_attempt);
+  wake_profile.rx_ms += millis() - started; // Module listening for the join accept
   
-  Serial.println("✗ Failed to join LoRaWAN network after all attempts");
+  if (joined) {
+    airtime_budget.rx1_delay_ms = 0;  // The join accept may have set another one
+    Serial.println("✓ Successfully joined LoRaWAN network!");
+  } else {
+    Serial.println("✗ Failed to join LoRaWAN network after all attempts");
+  }
   Serial.println("=========================================\n");
-  return false;
+  return joined;
 }
 
-// Function to check for incoming LoRaWAN messages
-void check_incoming_lorawan() {
-  static String rxBuffer = "";
+// Print and process one downlink received outside an AT command response
+void handle_downlink(const AtDownlink& downlink) {
+  Serial.println("\n📩 ===== LoRaWAN Message Received =====");
+  print_downlink(downlink);
+  Serial.println("========================================\n");
   
-  // Read all available characters from LoRa serial
+  process_downlink_message(downlink.data, downlink.length, downlink.port);
+}
+
+// Partial module output line, shared by both readers (guarded by modem_mutex)
+TextLine modem_line = {};
+
+// Read module output line by line; RX: lines go to handler
+void read_lorawan_lines(void (*handler)(const AtDownlink&)) {
+  ModemLock lock;
   while (LoRaSerial.available()) {
-    char c = LoRaSerial.read();
-    
-    // Accumulate characters
-    rxBuffer += c;
-    
     // Check if we have a complete line (ends with newline)
-    if (c == '\n' || c == '\r') {
-      // Trim whitespace
-      rxBuffer.trim();
-      
-      // Check if this is an RX message (incoming downlink)
-      if (rxBuffer.startsWith("RX:")) {
-        Serial.println("\n📩 ===== LoRaWAN Message Received =====");
-        
-        // Parse format: RX:HEXDATA:PORT:RSSI:SNR
-        int firstColon = rxBuffer.indexOf(':');
-        int secondColon = rxBuffer.indexOf(':', firstColon + 1);
-        int thirdColon = rxBuffer.indexOf(':', secondColon + 1);
-        int fourthColon = rxBuffer.indexOf(':', thirdColon + 1);
-        
-        if (secondColon > 0) {
-          // Extract hex data (between first and second colon)
-          String hexData = rxBuffer.substring(firstColon + 1, secondColon);
-          
-          // Extract port, rssi, snr if available
-          String port = "";
-          String rssi = "";
-          String snr = "";
-          
-          if (thirdColon > 0) {
-            port = rxBuffer.substring(secondColon + 1, thirdColon);
-          }
-          if (fourthColon > 0) {
-            rssi = rxBuffer.substring(thirdColon + 1, fourthColon);
-            snr = rxBuffer.substring(fourthColon + 1);
-          }
-          
-          // Display hex data with spaces
-          Serial.print("Hex Data: ");
-          for (int i = 0; i < hexData.length(); i += 2) {
-            Serial.print(hexData.substring(i, i + 2));
-            if (i + 2 < hexData.length()) Serial.print(" ");
-          }
-          Serial.println();
-          
-          // Convert hex string to bytes and display
-          Serial.print("Raw Bytes: [");
-          for (int i = 0; i < hexData.length(); i += 2) {
-            String byteStr = hexData.substring(i, i + 2);
-            int byteValue = strtol(byteStr.c_str(), NULL, 16);
-            Serial.print(byteValue);
-            if (i + 2 < hexData.length()) Serial.print(", ");
-          }
-          Serial.println("]");
-          
-          // Display metadata
-          if (port.length() > 0) {
-            Serial.print("Port: ");
-            Serial.println(port);
-          }
-          if (rssi.length() > 0) {
-            Serial.print("RSSI: ");
-            Serial.print(rssi);
-            Serial.println(" dBm");
-          }
-          if (snr.length() > 0) {
-            Serial.print("SNR: ");
-            Serial.println(snr);
-          }
-          
-          Serial.println("========================================\n");
-        }
-      }
-      
-      // Clear buffer for next message
-      rxBuffer = "";
-    }
+    if (!text_line_push(modem_line, (char)LoRaSerial.read())) continue;
     
-    // Prevent buffer overflow
-    if (rxBuffer.length() > 200) {
-      rxBuffer = "";
-    }
+    // Check if this is an RX message (incoming downlink)
+    AtDownlink downlink;
+    if (at_parse_rx_line(modem_line.text, downlink)) handler(downlink);
   }
 }
 
@@ -448,21 +643,24 @@ bool read_pir() {
   return digitalRead(PIR_PIN) == HIGH;
 }
 
-// Function to read ultrasound distance sensor
+// Function to read ultrasound distance sensor (channel 0 is the primary sensor)
 // Returns distance in centimeters, or -1 if measurement failed
-float read_ultrasound() {
+float read_ultrasound(byte channel = 0) {
+  const UltrasoundChannel& sensor = ULTRASOUND_CHANNELS[channel];
+  wake_profile.ultrasound_readings++;
+  
   // Clear the trigger pin
-  digitalWrite(TRIG_PIN, LOW);
+  digitalWrite(sensor.trig_pin, LOW);
   delayMicroseconds(2);
   
   // Send 10 microsecond pulse to trigger
-  digitalWrite(TRIG_PIN, HIGH);
+  digitalWrite(sensor.trig_pin, HIGH);
   delayMicroseconds(10);
-  digitalWrite(TRIG_PIN, LOW);
+  digitalWrite(sensor.trig_pin, LOW);
   
   // Read the echo pin - returns pulse duration in microseconds
   // Timeout after 30ms (max range ~5m)
-  long duration = pulseIn(ECHO_PIN, HIGH, 30000);
+  long duration = pulseIn(sensor.echo_pin, HIGH, 30000);
   
   // Check for timeout (no echo received)
   if (duration == 0) {
@@ -480,15 +678,16 @@ float read_ultrasound() {
 // Function to calculate trash fill level percentage from a given distance
 // Pass the distance reading to avoid multiple ultrasound polls (HC-SR04 needs ~60ms between readings)
 // Returns percentage (0-100%), or -1 if distance is invalid
-float get_fill_percentage(float distance) {
+float get_fill_percentage(float distance, byte channel = 0) {
   if (distance < 0) {
     return -1.0; // Invalid distance
   }
   
   // Calculate fill percentage
-  // When empty: distance = TRASHCAN_DEPTH_CM, fill = 0%
+  // When empty: distance = depth, fill = 0%
   // When full: distance = 0, fill = 100%
-  float fill = ((TRASHCAN_DEPTH_CM - distance) / TRASHCAN_DEPTH_CM) * 100.0;
+  float depth_cm = device_config_depth_mm(device_config, channel) / 10.0;
+  float fill = ((depth_cm - distance) / depth_cm) * 100.0;
   
   // Clamp to 0-100% range
   if (fill < 0) fill = 0;
@@ -497,6 +696,14 @@ float get_fill_percentage(float distance) {
   return fill;
 }
 
+// Read the fill level of every channel, one sensor at a time
+void read_fill_levels(float* fill_percentages) {
+  for (byte i = 0; i < SENSOR_CHANNELS; i++) {
+    if (i > 0) delay(ULTRASOUND_CHANNEL_GAP_MS);
+    fill_percentages[i] = get_fill_percentage(read_ultrasound(i), i);
+  }
+}
+
 // Function to print all sensor readings
 void print_sensor_readings() {
   Serial.println("\n========= Sensor Readings =========");
@@ -506,38 +713,162 @@ void print_sensor_readings() {
   Serial.print("🚶 PIR Motion:    ");
   Serial.println(motion ? "DETECTED!" : "No motion");
   
-  // Read ultrasound (only once - HC-SR04 needs ~60ms between readings)
-  float distance = read_ultrasound();
-  Serial.print("📏 Distance:      ");
-  if (distance < 0) {
-    Serial.println("Error (no echo)");
-  } else {
-    Serial.print(distance, 1);
-    Serial.println(" cm");
-  }
-  
-  // Calculate fill level from the already-read distance
-  float fill = get_fill_percentage(distance);
-  Serial.print("🗑️  Fill Level:    ");
-  if (fill < 0) {
-    Serial.println("Error");
-  } else {
-    Serial.print(fill, 1);
-    Serial.println("%");
+  for (byte channel = 0; channel < SENSOR_CHANNELS; channel++) {
+    if (channel > 0) {
+      delay(ULTRASOUND_CHANNEL_GAP_MS);
+      Serial.print("🔢 Channel ");
+      Serial.println(channel);
+    }
+    
+    // Read ultrasound (only once - HC-SR04 needs ~60ms between readings)
+    float distance = read_ultrasound(channel);
+    Serial.print("📏 Distance:      ");
+    if (distance < 0) {
+      Serial.println("Error (no echo)");
+    } else {
+      Serial.print(distance, 1);
+      Serial.println(" cm");
+    }
     
-    // Visual fill bar
-    Serial.print("   [");
-    int bars = (int)(fill / 5); // 20 character bar
-    for (int i = 0; i < 20; i++) {
-      if (i < bars) Serial.print("█");
-      else Serial.print("░");
+    // Calculate fill level from the already-read distance
+    float fill = get_fill_percentage(distance, channel);
+    Serial.print("🗑️  Fill Level:    ");
+    if (fill < 0) {
+      Serial.println("Error");
+    } else {
+      Serial.print(fill, 1);
+      Serial.println("%");
+      
+      // Visual fill bar
+      Serial.print("   [");
+      int bars = (int)(fill / 5); // 20 character bar
+      for (int i = 0; i < 20; i++) {
+        if (i < bars) Serial.print("█");
+        else Serial.print("░");
+      }
+      Serial.println("]");
     }
-    Serial.println("]");
   }
   
   Serial.println("===================================\n");
 }
 
+// ============================================
+// Event Bus (see event_bus.h)
+// ============================================
+
+#define EVENT_QUEUE_LENGTH   16     // Events waiting for loop()
+#define EVENT_TASK_STACK     4096   // Stack of the RFID and modem reader tasks (bytes)
+#define EVENT_TASK_PRIORITY  2      // Above loop() so producers are never starved by a handler
+#define RFID_POLL_MS         50     // Card presence polling period of the RFID task
+#define RFID_REPEAT_MS       1000   // The same card is reported again only after this long
+#define MODEM_POLL_MS        20     // UART polling period of the modem reader task
+#define SENSOR_TICK_MS       2000   // Sensor readings and countdown print
+
+QueueHandle_t event_queue = NULL;
+EventBusStats event_stats = {};
+TaskHandle_t rfid_task_handle = NULL;
+TaskHandle_t modem_task_handle = NULL;
+
+// Post an event from a task or timer callback (never blocks; counted if the queue is full)
+bool post_event(Event& event) {
+  event.posted_ms = millis();
+  if (xQueueSend(event_queue, &event, 0) != pdTRUE) {
+    event_stats.dropped++;
+    return false;
+  }
+  return true;
+}
+
+// Print per-type event counts, queue latency and deadline misses
+void print_event_stats() {
+  Serial.println("Event bus (count / queue avg, max / handler max / late):");
+  for (int type = 0; type < EVT_TYPE_COUNT; type++) {
+    const EventTypeStats& s = event_stats.types[type];
+    if (s.count == 0) continue;
+    Serial.print("  ");
+    Serial.print(event_type_name(type));
+    Serial.print(": ");
+    Serial.print(s.count);
+    Serial.print(" / ");
+    Serial.print(s.queue_total_ms / s.count);
+    Serial.print(", ");
+    Serial.print(s.queue_max_ms);
+    Serial.print(" ms / ");
+    Serial.print(s.handler_max_ms);
+    Serial.print(" ms / ");
+    Serial.println(s.deadline_misses);
+  }
+  if (event_stats.dropped > 0) {
+    Serial.print("  Dropped (queue full): ");
+    Serial.println(event_stats.dropped);
+  }
+}
+
+// ============================================
+// Memory Telemetry (see mem_telemetry.h)
+// ============================================
+
+MemTelemetryState& memory_telemetry = rtc_state.memory;
+
+// Unused stack of a task in bytes, 0 if it is not running
+uint16_t stack_free_bytes(TaskHandle_t task) {
+  UBaseType_t words = uxTaskGetStackHighWaterMark(task);  // Bytes on ESP-IDF
+  return words > 0xFFFF ? 0xFFFF : (uint16_t)words;
+}
+
+// Sample heap, PSRAM, stacks and SQLite memory at one point of the wake cycle
+void sample_memory(uint8_t point) {
+  MemSample sample = {};
+  sample.heap_free = ESP.getFreeHeap();
+  sample.heap_min_free = ESP.getMinFreeHeap();
+  sample.heap_largest_block = ESP.getMaxAllocHeap();
+  sample.psram_free = ESP.getFreePsram();
+  sample.psram_min_free = ESP.getMinFreePsram();
+  
+  int current = 0;
+  int highwater = 0;
+  sqlite3_status(SQLITE_STATUS_MEMORY_USED, &current, &highwater, 0);
+  sample.sqlite_memory = (uint32_t)current;
+  sqlite3_status(SQLITE_STATUS_PAGECACHE_OVERFLOW, &current, &highwater, 0);  // Page cache on the heap
+  sample.sqlite_cache = (uint32_t)current;
+  sqlite3_status(SQLITE_STATUS_PAGECACHE_USED, &current, &highwater, 0);      // Slots of the PSRAM pool
+  sample.sqlite_cache += (uint32_t)current * page_cache_slot_size;
+  
+  sample.stack_free[MEM_TASK_MAIN] = stack_free_bytes(NULL);
+  if (rfid_task_handle != NULL) sample.stack_free[MEM_TASK_RFID] = stack_free_bytes(rfid_task_handle);
+  if (modem_task_handle != NULL) sample.stack_free[MEM_TASK_MODEM] = stack_free_bytes(modem_task_handle);
+  
+  mem_telemetry_record(memory_telemetry, point, sample);
+}
+
+void print_memory_sample(const MemSample& sample) {
+  Serial.print("Heap: ");
+  Serial.print(sample.heap_free);
+  Serial.print(" bytes free, minimum ");
+  Serial.print(sample.heap_min_free);
+  Serial.print(", largest block ");
+  Serial.print(sample.heap_largest_block);
+  Serial.print(" of ");
+  Serial.println(ESP.getHeapSize());
+  if (ESP.getPsramSize() > 0) {
+    Serial.print("PSRAM: ");
+    Serial.print(sample.psram_free);
+    Serial.print(" bytes free, minimum ");
+    Serial.println(sample.psram_min_free);
+  }
+  Serial.print("SQLite: ");
+  Serial.print(sample.sqlite_memory);
+  Serial.print(" bytes, page cache ");
+  Serial.println(sample.sqlite_cache);
+  Serial.print("Stack free (main/rfid/modem): ");
+  Serial.print(sample.stack_free[MEM_TASK_MAIN]);
+  Serial.print(" / ");
+  Serial.print(sample.stack_free[MEM_TASK_RFID]);
+  Serial.print(" / ");
+  Serial.println(sample.stack_free[MEM_TASK_MODEM]);
+}
+
 // ============================================
 // Deep Sleep Functions
 // ============================================
@@ -546,11 +877,11 @@ void print_sensor_readings() {
 unsigned long wake_up_time = 0;
 
 // Function to get wake-up reason as string
-String get_wakeup_reason_string(esp_sleep_wakeup_cause_t wakeup_reason) {
+const char* get_wakeup_reason_string(esp_sleep_wakeup_cause_t wakeup_reason) {
   switch(wakeup_reason) {
     case ESP_SLEEP_WAKEUP_EXT0:     return "EXT0 (PIR Motion)";
     case ESP_SLEEP_WAKEUP_EXT1:     return "EXT1";
-    case ESP_SLEEP_WAKEUP_TIMER:    return "Timer (1 hour)";
+    case ESP_SLEEP_WAKEUP_TIMER:    return "Timer (report slot or multicast window)";
     case ESP_SLEEP_WAKEUP_TOUCHPAD: return "Touchpad";
     case ESP_SLEEP_WAKEUP_ULP:      return "ULP";
     case ESP_SLEEP_WAKEUP_GPIO:     return "GPIO";
@@ -576,8 +907,8 @@ esp_sleep_wakeup_cause_t handle_wakeup_reason() {
       break;
       
     case ESP_SLEEP_WAKEUP_TIMER:
-      // Timer wake-up (1 hour elapsed)
-      Serial.println("⏰ Timer wake-up (1 hour periodic check)");
+      // Timer wake-up (report slot reached)
+      Serial.println("⏰ Timer wake-up (periodic report slot)");
       Serial.println("Will send sensor data via LoRaWAN...");
       break;
       
@@ -593,36 +924,131 @@ esp_sleep_wakeup_cause_t handle_wakeup_reason() {
   return wakeup_reason;
 }
 
-// Operation ID constants for LoRaWAN uplink messages
-#define OP_WORKER_CLEANUP  0x01
-#define OP_HOURLY_REPORT   0x02
+// ============================================
+// Event Journal (see event_journal.h)
+// ============================================
+
+// Segment files of the journal on LittleFS, opened per call
+struct JournalFiles {
+  void path(uint8_t segment, char* out, size_t size) {
+    snprintf(out, size, "/journal-%u.bin", (unsigned)segment);
+  }
+  uint32_t size(uint8_t segment) {
+    char name[24];
+    path(segment, name, sizeof(name));
+    if (!LittleFS.exists(name)) return 0;
+    File file = LittleFS.open(name, "r");
+    if (!file) return 0;
+    uint32_t bytes = file.size();
+    file.close();
+    return bytes;
+  }
+  bool read(uint8_t segment, uint32_t offset, void* data, size_t length) {
+    char name[24];
+    path(segment, name, sizeof(name));
+    File file = LittleFS.open(name, "r");
+    if (!file) return false;
+    bool ok = file.seek(offset) && file.read((uint8_t*)data, length) == length;
+    file.close();
+    return ok;
+  }
+  bool append(uint8_t segment, const void* data, size_t length) {
+    char name[24];
+    path(segment, name, sizeof(name));
+    File file = LittleFS.open(name, "a");
+    if (!file) return false;
+    bool ok = file.write((const uint8_t*)data, length) == length;
+    file.close();
+    return ok;
+  }
+  bool clear(uint8_t segment) {
+    char name[24];
+    path(segment, name, sizeof(name));
+    File file = LittleFS.open(name, "w");
+    if (!file) return false;
+    file.close();
+    return true;
+  }
+};
+
+// Append one record, stamped with network time when synced (local clock seconds otherwise)
+void journal_log(byte type, byte flags, const byte* data) {
+  if (!filesystem_ready) return;
+  
+  uint32_t time;
+  if (time_sync.valid) {
+    time = (uint32_t)(time_sync_now_unix_ms(time_sync, local_clock_ms()) / 1000);
+  } else {
+    time = (uint32_t)(local_clock_ms() / 1000);
+    flags |= JOURNAL_FLAG_LOCAL_TIME;
+  }
+  
+  JournalFiles files;
+  if (!journal_append(event_journal, files, time, type, flags, data)) {
+    Serial.print("✗ Journal append failed (");
+    Serial.print(journal_type_name(type));
+    Serial.println(")");
+  }
+}
+
+// Rebuild the journal index when RTC memory was lost (or the filesystem
+// formatted) and record why the chip booted
+void open_journal() {
+  if (!filesystem_ready) return;
+  
+  JournalFiles files;
+  bool cold_boot = rtc_state.wake_count == 1;
+  if (cold_boot || rtc_state.recovery.reason == RECOVERY_FS_FORMATTED) {
+    unsigned long started = millis();
+    journal_rebuild(event_journal, files);
+    Serial.print("📒 Journal index rebuilt in ");
+    Serial.print(millis() - started);
+    Serial.print(" ms, next record #");
+    Serial.println(event_journal.next_sequence);
+  }
+  
+  if (cold_boot) {
+    byte data[4] = {(byte)esp_reset_reason(), (byte)esp_sleep_get_wakeup_cause(), 0, 0};
+    journal_log(JOURNAL_REBOOT, 0, data);
+  }
+}
+
+// Operation ID constants for LoRaWAN uplink messages: see wake_cycle.h
 
 // Operation ID constants for LoRaWAN downlink messages
 #define DL_OP_INSERT_USER  0x01
 #define DL_OP_DELETE_USER  0x02
+#define DL_OP_SET_CONFIG   0x03
+#define DL_OP_JOURNAL_UPLOAD  0x04
+#define DL_OP_MULTICAST_SETUP 0x05
+#define DL_FLAG_MORE_PENDING  0x80  // Set on the operation byte: another downlink is queued
+                                    // (0x40 numbers the downlink, see downlink_sequence.h)
 #define DL_ROLE_WORKER     0x01
 #define DL_ROLE_ADMIN      0x02
 
-// Downlink wait configuration
-#define DOWNLINK_WAIT_MS   15000   // Wait 15 seconds after uplink for potential downlink
-
 // ============================================
 // Downlink Processing Functions
 // ============================================
 
 // Insert user into local database from downlink command
-bool insert_user_from_downlink(String rfid_tag_id, String role) {
+bool insert_user_from_downlink(const char* rfid_tag_id, const char* role) {
   Serial.println("\n👤 ===== INSERTING USER FROM DOWNLINK =====");
   Serial.print("RFID Tag: ");
   Serial.println(rfid_tag_id);
   Serial.print("Role: ");
   Serial.println(role);
   
+  if (!database_ready) {
+    Serial.println("✗ No database - user not inserted");
+    return false;
+  }
+  
   try {
     database.execute(
       "INSERT OR REPLACE INTO user (rfid_tag_id, role) VALUES(?, ?);",
       rfid_tag_id, role
     );
+    whitelist_changed = true;
     Serial.println("✓ User inserted/updated successfully!");
     Serial.println("===========================================\n");
     return true;
@@ -635,16 +1061,22 @@ bool insert_user_from_downlink(String rfid_tag_id, String role) {
 }
 
 // Delete user from local database from downlink command
-bool delete_user_from_downlink(String rfid_tag_id) {
+bool delete_user_from_downlink(const char* rfid_tag_id) {
   Serial.println("\n🗑️  ===== DELETING USER FROM DOWNLINK =====");
   Serial.print("RFID Tag: ");
   Serial.println(rfid_tag_id);
   
+  if (!database_ready) {
+    Serial.println("✗ No database - user not deleted");
+    return false;
+  }
+  
   try {
     database.execute(
       "DELETE FROM user WHERE rfid_tag_id = ?;",
       rfid_tag_id
     );
+    whitelist_changed = true;
     Serial.println("✓ User deleted successfully (if existed)!");
     Serial.println("==========================================\n");
     return true;
@@ -656,31 +1088,76 @@ bool delete_user_from_downlink(String rfid_tag_id) {
   }
 }
 
-// Process a downlink message for user management
-// Format: [OP (1)] [RFID (4)] [ROLE (1, INSERT only)]
-// INSERT (0x01): 6 bytes total, DELETE (0x02): 5 bytes total
-void process_downlink_message(String hexData, int port) {
-  Serial.println("\n🔽 ===== PROCESSING DOWNLINK MESSAGE =====");
-  Serial.print("Port: ");
-  Serial.println(port);
-  Serial.print("Hex Data: ");
-  Serial.println(hexData);
-  
-  // Calculate byte length (2 hex chars = 1 byte)
-  int byteLength = hexData.length() / 2;
-  Serial.print("Message length: ");
-  Serial.print(byteLength);
-  Serial.println(" bytes");
-  
-  // Convert hex string to byte array
-  byte data[10];  // Max expected size
-  for (int i = 0; i < byteLength && i < 10; i++) {
-    String byteStr = hexData.substring(i * 2, i * 2 + 2);
-    data[i] = (byte)strtol(byteStr.c_str(), NULL, 16);
+// Apply a clock sync answer (AppTimeAns) received on CLOCK_SYNC_PORT
+bool handle_time_sync_answer(const byte* data, int length) {
+  Serial.println("--- CLOCK SYNC Answer ---");
+
+  if (!time_sync_handle_answer(time_sync, local_clock_ms(), data, length)) {
+    Serial.println("✗ Invalid or stale clock sync answer (ignored)");
+    return false;
   }
-  
-  // Extract operation code
-  byte operation = data[0];
+
+  Serial.print("✓ Network time applied: ");
+  Serial.print((long long)(time_sync_now_unix_ms(time_sync, local_clock_ms()) / 1000));
+  Serial.print(" (Unix s), drift estimate: ");
+  Serial.print(time_sync.drift_ppm);
+  Serial.println(" ppm");
+  return true;
+}
+
+// Apply a SET_CONFIG downlink and queue its acknowledgement
+// The change is validated by device_config_apply() and persisted to NVS
+// Queue one entry of the next CONFIG_ACK uplink
+void queue_config_ack(byte param, byte status) {
+  // The ack identifies the device by the name in effect before this batch of changes
+  if (config_ack_count == 0) {
+    memcpy(config_ack_name, device_config.name, sizeof(config_ack_name));
+  }
+  if (config_ack_count < MAX_CONFIG_ACKS) {
+    config_ack_params[config_ack_count] = param;
+    config_ack_status[config_ack_count] = status;
+    config_ack_count++;
+  }
+}
+
+void apply_config_from_downlink(byte param, const byte* value, int length) {
+  // Keep the previous config so a failed NVS write can be rolled back
+  DeviceConfig previous = device_config;
+  byte status = device_config_apply(device_config, param, value, length);
+  
+  if (status == CFG_STATUS_APPLIED && !save_device_config()) {
+    device_config = previous;
+    config_cache = previous;
+    status = CFG_STATUS_STORAGE_ERROR;
+  }
+  
+  Serial.print("  Param: 0x");
+  if (param < 0x10) Serial.print("0");
+  Serial.print(param, HEX);
+  Serial.print(" -> status 0x");
+  if (status < 0x10) Serial.print("0");
+  Serial.println(status, HEX);
+  if (status == CFG_STATUS_APPLIED) {
+    Serial.println("✓ Configuration updated:");
+    print_device_config();
+  } else {
+    Serial.println("✗ Configuration change rejected");
+  }
+  
+  queue_config_ack(param, status);
+}
+
+// Forward declarations for process_downlink_message
+void handle_fragmentation_downlink(const byte* data, size_t length);
+void handle_multicast_batch(const byte* data, size_t length);
+void apply_multicast_setup(const byte* data, size_t length);
+
+// Apply one operation downlink (data starts at the operation byte)
+// Format: [OP (1)] [RFID (4)] [ROLE (1, INSERT only)]
+// INSERT (0x01): 6 bytes total, DELETE (0x02): 5 bytes total
+void apply_downlink_operation(const byte* data, size_t length) {
+  int byteLength = (int)length;
+  byte operation = data[0] & ~(DL_FLAG_MORE_PENDING | DL_FLAG_SEQUENCED);
   Serial.print("Operation: 0x");
   if (operation < 0x10) Serial.print("0");
   Serial.println(operation, HEX);
@@ -691,22 +1168,16 @@ void process_downlink_message(String hexData, int port) {
     if (byteLength != 6) {
       Serial.print("✗ Invalid message length for INSERT: expected 6, got ");
       Serial.println(byteLength);
-      Serial.println("==========================================\n");
       return;
     }
     
     // Extract RFID (bytes 1-4) and format as spaced hex string
-    String rfid_tag = "";
-    for (int i = 1; i <= 4; i++) {
-      if (i > 1) rfid_tag += " ";
-      if (data[i] < 0x10) rfid_tag += "0";
-      rfid_tag += String(data[i], HEX);
-    }
-    rfid_tag.toUpperCase();
+    char rfid_tag[RFID_TAG_TEXT_SIZE];
+    text_format_rfid(&data[1], RFID_UID_LENGTH, rfid_tag, sizeof(rfid_tag));
     
     // Extract role byte and convert to string
     byte roleByte = data[5];
-    String role = "";
+    const char* role = NULL;
     if (roleByte == DL_ROLE_WORKER) {
       role = "WORKER";
     } else if (roleByte == DL_ROLE_ADMIN) {
@@ -716,7 +1187,6 @@ void process_downlink_message(String hexData, int port) {
       if (roleByte < 0x10) Serial.print("0");
       Serial.println(roleByte, HEX);
       Serial.println("  Expected: 0x01 (WORKER) or 0x02 (ADMIN)");
-      Serial.println("==========================================\n");
       return;
     }
     
@@ -729,23 +1199,28 @@ void process_downlink_message(String hexData, int port) {
     // Execute database insert
     insert_user_from_downlink(rfid_tag, role);
     
+  } else if (operation == DL_OP_SET_CONFIG) {
+    // SET_CONFIG: [OP(1) + PARAM(1) + VALUE(N)]
+    if (byteLength < 3) {
+      Serial.print("✗ Invalid message length for SET_CONFIG: expected at least 3, got ");
+      Serial.println(byteLength);
+      return;
+    }
+    
+    Serial.println("--- SET_CONFIG Operation ---");
+    apply_config_from_downlink(data[1], &data[2], byteLength - 2);
+    
   } else if (operation == DL_OP_DELETE_USER) {
     // DELETE: Expect 5 bytes [OP(1) + RFID(4)]
     if (byteLength != 5) {
       Serial.print("✗ Invalid message length for DELETE: expected 5, got ");
       Serial.println(byteLength);
-      Serial.println("==========================================\n");
       return;
     }
     
     // Extract RFID (bytes 1-4) and format as spaced hex string
-    String rfid_tag = "";
-    for (int i = 1; i <= 4; i++) {
-      if (i > 1) rfid_tag += " ";
-      if (data[i] < 0x10) rfid_tag += "0";
-      rfid_tag += String(data[i], HEX);
-    }
-    rfid_tag.toUpperCase();
+    char rfid_tag[RFID_TAG_TEXT_SIZE];
+    text_format_rfid(&data[1], RFID_UID_LENGTH, rfid_tag, sizeof(rfid_tag));
     
     Serial.println("--- DELETE Operation ---");
     Serial.print("  RFID: ");
@@ -754,167 +1229,346 @@ void process_downlink_message(String hexData, int port) {
     // Execute database delete
     delete_user_from_downlink(rfid_tag);
     
+  } else if (operation == DL_OP_JOURNAL_UPLOAD) {
+    // JOURNAL_UPLOAD: Expect 9 bytes [OP(1) + FROM(4) + TO(4)], times as in the journal
+    if (byteLength != 9) {
+      Serial.print("✗ Invalid message length for JOURNAL_UPLOAD: expected 9, got ");
+      Serial.println(byteLength);
+      return;
+    }
+    
+    journal_upload.from = ((uint32_t)data[1] << 24) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 8) | data[4];
+    journal_upload.to = ((uint32_t)data[5] << 24) | ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 8) | data[8];
+    journal_upload.next_sequence = 0;
+    journal_upload.active = 1;
+    
+    Serial.println("--- JOURNAL_UPLOAD Operation ---");
+    Serial.print("  From: ");
+    Serial.print(journal_upload.from);
+    Serial.print(" to ");
+    Serial.println(journal_upload.to);
+    
+  } else if (operation == DL_OP_MULTICAST_SETUP) {
+    // MULTICAST_SETUP: Expect MC_SETUP_LENGTH bytes (see multicast_session.h)
+    if (length != MC_SETUP_LENGTH) {
+      Serial.print("✗ Invalid message length for MULTICAST_SETUP: expected 46, got ");
+      Serial.println(byteLength);
+      return;
+    }
+    
+    Serial.println("--- MULTICAST_SETUP Operation ---");
+    apply_multicast_setup(data, length);
+    
   } else {
     Serial.print("✗ Unknown operation code: 0x");
     if (operation < 0x10) Serial.print("0");
     Serial.println(operation, HEX);
-    Serial.println("  Expected: 0x01 (INSERT) or 0x02 (DELETE)");
+    Serial.println("  Expected: 0x01 (INSERT), 0x02 (DELETE), 0x03 (SET_CONFIG), 0x04 (JOURNAL_UPLOAD) or 0x05 (MULTICAST_SETUP)");
+    return;
+  }
+}
+
+// Answer a copy of a numbered operation that was already applied, without
+// applying it again: the ack of the first copy may be what got lost. Only
+// SET_CONFIG is acknowledged; its status is worked out on a scratch copy of
+// the configuration, so nothing is written to NVS
+void requeue_downlink_ack(const byte* data, size_t length) {
+  byte operation = data[0] & ~DL_FLAG_MORE_PENDING;
+  if (operation != DL_OP_SET_CONFIG || length < 3) return;
+  
+  DeviceConfig scratch = device_config;
+  byte status = device_config_apply(scratch, data[1], &data[2], length - 2);
+  Serial.print("  CONFIG_ACK queued again for param 0x");
+  if (data[1] < 0x10) Serial.print("0");
+  Serial.println(data[1], HEX);
+  queue_config_ack(data[1], status);
+}
+
+// Process a downlink message for user management
+// Port CLOCK_SYNC_PORT carries clock sync answers instead (see time_sync.h),
+// FRAG_PORT firmware patch fragments (see frag_session.h) and
+// MC_WHITELIST_PORT multicast whitelist batches (see multicast_session.h)
+// Operation downlinks may be numbered (see downlink_sequence.h)
+void process_downlink_message(const byte* data, size_t length, int port) {
+  Serial.println("\n🔽 ===== PROCESSING DOWNLINK MESSAGE =====");
+  Serial.print("Port: ");
+  Serial.println(port);
+  
+  int byteLength = (int)length;
+  Serial.print("Message length: ");
+  Serial.print(byteLength);
+  Serial.println(" bytes");
+  
+  if (byteLength == 0) {
+    Serial.println("✗ Empty downlink (ignored)");
+    Serial.println("==========================================\n");
+    return;
+  }
+
+  // Clock sync answers (AppTimeAns) arrive on their own port
+  if (port == CLOCK_SYNC_PORT) {
+    handle_time_sync_answer(data, byteLength);
+    Serial.println("==========================================\n");
+    return;
+  }
+  
+  // Fragmentation session commands and fragments of a firmware patch
+  if (port == FRAG_PORT) {
+    handle_fragmentation_downlink(data, length);
+    Serial.println("==========================================\n");
+    return;
+  }
+  
+  // Whitelist batch sent to the multicast group
+  if (port == MC_WHITELIST_PORT) {
+    handle_multicast_batch(data, length);
+    Serial.println("==========================================\n");
+    return;
+  }
+
+  // The server flags a further queued downlink so the device polls for it
+  // instead of waiting for the next report
+  if (data[0] & DL_FLAG_MORE_PENDING) {
+    downlink_more_pending = true;
+    Serial.println("More downlinks pending on the server");
+  }
+  
+  if (!(data[0] & DL_FLAG_SEQUENCED)) {
+    apply_downlink_operation(data, length);
     Serial.println("==========================================\n");
     return;
   }
   
+  // Numbered downlink: a copy already applied is dropped before it reaches storage
+  uint16_t sequence = (byteLength > DL_SEQ_HEADER_LENGTH) ? (uint16_t)((data[2] << 8) | data[3]) : 0;
+  Serial.print("Sequence: ");
+  Serial.println(sequence);
+  switch (downlink_sequence_receive(downlink_sequence, data, length, apply_downlink_operation)) {
+    case DL_SEQ_APPLIED:   break;
+    case DL_SEQ_RESTARTED: Serial.println("Downlink numbering restarted"); break;
+    case DL_SEQ_BUFFERED:
+      Serial.print("⏸ Ahead of a missing downlink (last applied ");
+      Serial.print(downlink_sequence.applied);
+      Serial.println(") - kept until it arrives");
+      break;
+    case DL_SEQ_DUPLICATE: {
+      Serial.println("Already applied - not applied again");
+      uint8_t session;
+      DownlinkFrame frame;
+      if (downlink_sequence_parse(data, length, session, frame)) requeue_downlink_ack(frame.data, frame.length);
+      break;
+    }
+    default:               Serial.println("✗ Invalid numbered downlink (ignored)"); break;
+  }
   Serial.println("==========================================\n");
 }
 
 // Forward declaration for check_incoming_lorawan_blocking
 void check_incoming_lorawan_blocking();
 
-// Wait for potential downlink messages after sending an uplink
-// This gives the network server time to queue and send pending downlinks
-void wait_for_downlink() {
-  Serial.println("\n⏳ Waiting for potential downlink messages...");
-  Serial.print("Wait time: ");
-  Serial.print(DOWNLINK_WAIT_MS / 1000.0, 1);
-  Serial.println(" seconds");
+// Send queued SET_CONFIG acknowledgements in one uplink (Operation 03)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [COUNT (1)] [PARAM (1) STATUS (1)] x COUNT
+void send_config_acks() {
+  if (config_ack_count == 0) return;
+  
+  Serial.println("\n📡 ========== CONFIG ACK ==========");
+  
+  byte message[8 + 2 * MAX_CONFIG_ACKS];
+  int length = 0;
+  message[length++] = OP_CONFIG_ACK;  // Operation ID: 0x03
+  for (int i = 0; i < DEVICE_NAME_LENGTH; i++) {
+    message[length++] = (byte)config_ack_name[i];
+  }
+  message[length++] = (byte)config_ack_count;
+  for (int i = 0; i < config_ack_count; i++) {
+    message[length++] = config_ack_params[i];
+    message[length++] = config_ack_status[i];
+  }
   
-  unsigned long start = millis();
-  while (millis() - start < DOWNLINK_WAIT_MS) {
-    // Check for incoming messages while waiting
-    check_incoming_lorawan_blocking();
-    delay(10);  // Small delay to prevent busy-waiting
+  Serial.print("Acknowledging ");
+  Serial.print(config_ack_count);
+  Serial.println(" configuration change(s)");
+  
+  // Clear first: downlinks captured while sending queue new acks
+  config_ack_count = 0;
+  
+  // Operator-initiated and rare - not subject to the airtime governor
+  if (!send_lorawan_data(message, length, 1, UPLINK_PRIORITY_HIGH)) {
+    Serial.println("✗ Failed to send configuration ack");
   }
   
-  Serial.println("✓ Downlink wait complete\n");
+  Serial.println("==================================\n");
 }
 
-// Blocking version of check_incoming_lorawan that processes messages immediately
-// Used during the downlink wait window
-void check_incoming_lorawan_blocking() {
-  static String rxBuffer = "";
+// Send the answers to the last fragmentation downlink on FRAG_PORT
+// (FragSessionSetupAns, FragSessionStatusAns, ...)
+void send_frag_answer() {
+  if (frag_answer_length == 0) return;
   
-  // Read all available characters from LoRa serial
-  while (LoRaSerial.available()) {
-    char c = LoRaSerial.read();
-    
-    // Accumulate characters
-    rxBuffer += c;
+  Serial.println("\n📡 ========== FRAGMENTATION ANSWER ==========");
+  
+  byte message[FRAG_ANSWER_MAX];
+  size_t length = frag_answer_length;
+  memcpy(message, frag_answer, length);
+  
+  // Clear first: downlinks captured while sending queue a new answer
+  frag_answer_length = 0;
+  
+  // Answers to the server's session commands - not subject to the airtime governor
+  if (!send_lorawan_data(message, length, FRAG_PORT, UPLINK_PRIORITY_HIGH)) {
+    Serial.println("✗ Failed to send fragmentation answer");
+  }
+  
+  Serial.println("============================================\n");
+}
+
+// Send a downlink poll uplink (Operation 04) to open new receive windows
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] = 7 bytes
+// Polls are server-requested and rare, except while fetching the fragments of
+// a firmware patch, which go through the airtime governor (low priority)
+bool send_downlink_poll(byte priority = UPLINK_PRIORITY_HIGH) {
+  Serial.println("\n📡 ========== DOWNLINK POLL ==========");
+  
+  byte message[POLL_FRAME_LENGTH];
+  size_t length = wake_cycle_build_poll(device_config, message);
+  
+  bool success = send_lorawan_data(message, length, 1, priority);
+  if (!success) {
+    Serial.println("✗ Failed to send downlink poll");
+  }
+  
+  Serial.println("===================================\n");
+  return success;
+}
+
+// Finish the downlink exchange of an uplink
+// Class A devices only receive in the RX1/RX2 windows right after an uplink,
+// and send_lorawan_data() already listened until both closed, so there is
+// nothing left to wait for. Fragmentation answers, config acks and polls for
+// downlinks the server flagged as pending (or the next patch fragment) are
+// further uplinks, each with its own windows.
+void wait_for_downlink() {
+  // Lines the module printed after the listen window
+  check_incoming_lorawan_blocking();
+  
+  for (int followups = 0; followups < DOWNLINK_MAX_FOLLOWUPS; followups++) {
+    bool more_pending = downlink_more_pending;
+    downlink_more_pending = false;
     
-    // Check if we have a complete line (ends with newline)
-    if (c == '\n' || c == '\r') {
-      // Trim whitespace
-      rxBuffer.trim();
-      
-      // Check if this is an RX message (incoming downlink)
-      if (rxBuffer.startsWith("RX:")) {
-        Serial.println("\n📩 ===== LoRaWAN Message Received =====");
-        
-        // Parse format: RX:HEXDATA:PORT:RSSI:SNR
-        int firstColon = rxBuffer.indexOf(':');
-        int secondColon = rxBuffer.indexOf(':', firstColon + 1);
-        int thirdColon = rxBuffer.indexOf(':', secondColon + 1);
-        int fourthColon = rxBuffer.indexOf(':', thirdColon + 1);
-        
-        if (secondColon > 0) {
-          // Extract hex data (between first and second colon)
-          String hexData = rxBuffer.substring(firstColon + 1, secondColon);
-          
-          // Extract port, rssi, snr if available
-          String portStr = "";
-          String rssi = "";
-          String snr = "";
-          int port = 0;
-          
-          if (thirdColon > 0) {
-            portStr = rxBuffer.substring(secondColon + 1, thirdColon);
-            port = portStr.toInt();
-          }
-          if (fourthColon > 0) {
-            rssi = rxBuffer.substring(thirdColon + 1, fourthColon);
-            snr = rxBuffer.substring(fourthColon + 1);
-          }
-          
-          // Display hex data with spaces
-          Serial.print("Hex Data: ");
-          for (unsigned int i = 0; i < hexData.length(); i += 2) {
-            Serial.print(hexData.substring(i, i + 2));
-            if (i + 2 < hexData.length()) Serial.print(" ");
-          }
-          Serial.println();
-          
-          // Display metadata
-          if (portStr.length() > 0) {
-            Serial.print("Port: ");
-            Serial.println(portStr);
-          }
-          if (rssi.length() > 0) {
-            Serial.print("RSSI: ");
-            Serial.print(rssi);
-            Serial.println(" dBm");
-          }
-          if (snr.length() > 0) {
-            Serial.print("SNR: ");
-            Serial.println(snr);
-          }
-          
-          Serial.println("========================================\n");
-          
-          // Process the downlink message if on correct port
-          process_downlink_message(hexData, port);
-        }
-      }
-      
-      // Clear buffer for next message
-      rxBuffer = "";
+    if (frag_answer_length > 0) {
+      // Answer the server's fragmentation command (also collects the next fragment)
+      send_frag_answer();
+    } else if (config_ack_count > 0) {
+      // Acknowledge configuration changes (the ack also collects a pending downlink)
+      send_config_acks();
+    } else if (more_pending) {
+      bool fetching = frag_session.status == FRAG_STATUS_RECEIVING;
+      if (!send_downlink_poll(fetching ? UPLINK_PRIORITY_LOW : UPLINK_PRIORITY_HIGH)) break;
+    } else {
+      break;
     }
-    
-    // Prevent buffer overflow
-    if (rxBuffer.length() > 200) {
-      rxBuffer = "";
+  }
+  
+  downlink_more_pending = false;
+  Serial.println("✓ Downlink exchange complete\n");
+}
+
+// Process module output that arrived after the listen window of an uplink
+// (in the calling task, without going through the event queue)
+void check_incoming_lorawan_blocking() {
+  read_lorawan_lines(handle_downlink);
+}
+
+// Feed the fill readings to the cleanup detectors (see cleanup_detect.h); a
+// sharp drop stays a candidate in RTC memory until the readings of later
+// wakes confirm or cancel it
+// Returns true when an inferred cleanup was queued
+bool check_for_emptying(const float* fill_percentages) {
+  bool queued = false;
+  for (byte channel = 0; channel < SENSOR_CHANNELS; channel++) {
+    byte result = wake_cycle_check_emptied(rtc_state, channel, local_clock_ms(), fill_percentages[channel]);
+    if (result == CLEANUP_DETECT_PENDING) {
+      Serial.print("🧹 Fill drop on channel ");
+      Serial.print(channel);
+      Serial.print(": ");
+      Serial.print(rtc_state.cleanup_detect[channel].low_readings);
+      Serial.print("/");
+      Serial.print(CLEANUP_CONFIRM_READINGS);
+      Serial.println(" low readings");
     }
+    if (result != CLEANUP_DETECT_DETECTED) continue;
+    
+    const InferredCleanupReport& report = rtc_state.inferred_cleanup[channel];
+    Serial.print("🧹 Bin emptied without a card tap: fill ");
+    Serial.print(report.before_pct);
+    Serial.print("% -> ");
+    Serial.print(report.after_pct);
+    Serial.print("% (channel ");
+    Serial.print(channel);
+    Serial.println(")");
+    
+    byte data[4] = {report.before_pct, report.after_pct, channel, 0};
+    journal_log(JOURNAL_CLEANUP, JOURNAL_FLAG_INFERRED, data);
+    queued = true;
   }
+  return queued;
 }
 
 // Send hourly report via LoRaWAN (Operation 02)
-// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [FILL_PCT (1)] [USAGE_COUNT (1)] = 9 bytes
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [FILL_PCT (1)] [USAGE_COUNT (1)] [MINUTES_TO_FULL (2, big-endian)]
+//         [USAGE_HISTOGRAM (2-34)]
+// MINUTES_TO_FULL is 0xFFFF when the bin is not filling (see fill_forecast.h),
+// the histogram counts motion wakes per bin since the last report (see usage_histogram.h)
+// A station with several ultrasound channels sends one multi-channel report
+// instead (Operation 0A, see send_multi_channel_report)
+bool send_multi_channel_report(const float* fill_percentages);
+
 bool send_periodic_lorawan_data() {
   Serial.println("\n📡 ========== PERIODIC DATA SEND ==========");
   Serial.println("Timer wake-up: Sending periodic report via LoRaWAN");
   
   // Read current sensor values
-  float distance = read_ultrasound();
-  float fill_percentage = get_fill_percentage(distance);
+  float fill_percentages[SENSOR_CHANNELS];
+  read_fill_levels(fill_percentages);
+  
+  // A bin emptied without a card tap restarts the forecast before this reading
+  check_for_emptying(fill_percentages);
+  
+  if (SENSOR_CHANNELS > 1) {
+    return send_multi_channel_report(fill_percentages);
+  }
+  float fill_percentage = fill_percentages[0];
   
-  // Convert to bytes (clamp to valid ranges)
-  byte fill_pct_byte = (fill_percentage >= 0) ? (byte)fill_percentage : 0;
-  if (fill_pct_byte > 100) fill_pct_byte = 100;
+  // Update the fill-rate forecast with this reading and build the frame
+  byte message[REPORT_FRAME_MAX_LENGTH];
+  size_t length = wake_cycle_build_report(rtc_state, device_config, local_clock_ms(), fill_percentage, message);
   
-  // Cap usage counter at 255 (1 byte max)
-  byte usage_count_byte = (usage_counter > 255) ? 255 : (byte)usage_counter;
+  byte fill_pct_byte = message[7];
+  byte usage_count_byte = message[8];
+  uint16_t minutes_to_full = ((uint16_t)message[9] << 8) | message[10];
   
   Serial.println("\n--- Periodic Report Data ---");
   Serial.print("Trashcan Name: ");
-  Serial.println(TRASHCAN_NAME);
+  Serial.println(device_config.name);
   Serial.print("Fill Level: ");
   Serial.print(fill_pct_byte);
   Serial.println("%");
   Serial.print("Usage count since last report: ");
   Serial.println(usage_count_byte);
-  
-  // Build the message: Operation ID + Trashcan Name (6 bytes) + Fill % + Usage Count
-  byte message[9];
-  message[0] = OP_HOURLY_REPORT;   // Operation ID: 0x02
-  
-  // Copy 6-character trashcan name as bytes
-  for (int i = 0; i < 6; i++) {
-    message[1 + i] = (byte)TRASHCAN_NAME[i];
+  Serial.print("Fill rate: ");
+  Serial.print(fill_forecast[0].rate_pct_per_h, 2);
+  Serial.println(" %/h");
+  Serial.print("Predicted time to full: ");
+  if (minutes_to_full == FORECAST_MINUTES_UNKNOWN) {
+    Serial.println("unknown (not filling)");
+  } else {
+    Serial.print(minutes_to_full);
+    Serial.println(" min");
   }
   
-  message[7] = fill_pct_byte;      // Fill percentage (0-100)
-  message[8] = usage_count_byte;   // Usage counter (0-255)
-  
   // Print what we're sending
   Serial.print("Message bytes: ");
-  for (int i = 0; i < 9; i++) {
+  for (size_t i = 0; i < length; i++) {
     if (message[i] < 0x10) Serial.print("0");
     Serial.print(message[i], HEX);
     Serial.print(" ");
@@ -923,7 +1577,7 @@ bool send_periodic_lorawan_data() {
   
   Serial.print("  - Operation: Hourly Report (0x02)\n");
   Serial.print("  - Trashcan Name: ");
-  Serial.print(TRASHCAN_NAME);
+  Serial.print(device_config.name);
   Serial.print(" (");
   for (int i = 0; i < 6; i++) {
     if (message[1 + i] < 0x10) Serial.print("0");
@@ -943,9 +1597,23 @@ bool send_periodic_lorawan_data() {
   if (usage_count_byte < 0x10) Serial.print("0");
   Serial.print(usage_count_byte, HEX);
   Serial.println(")");
+  Serial.print("  - Minutes to full: ");
+  Serial.println(minutes_to_full);
+  Serial.print("  - Usage per ");
+  Serial.print(USAGE_BIN_MINUTES << usage_histogram.scale);
+  Serial.print(" min: ");
+  for (int i = 0; i < (message[UPLINK_FRAME_LENGTH] & 0x1F); i++) {
+    Serial.print(usage_histogram.counts[i]);
+    Serial.print(" ");
+  }
+  Serial.print("(");
+  Serial.print(length - UPLINK_FRAME_LENGTH);
+  Serial.println(" bytes)");
   
   // Send via LoRaWAN
-  bool success = send_lorawan_data(message, 9, 1);
+  bool success = send_lorawan_data(message, length, 1, UPLINK_PRIORITY_LOW);
+  journal_log(JOURNAL_REPORT, success ? JOURNAL_FLAG_SENT : (last_uplink_deferred ? JOURNAL_FLAG_DEFERRED : 0),
+              &message[7]);
   
   if (success) {
     Serial.println("✓ Periodic report sent successfully");
@@ -954,6 +1622,10 @@ bool send_periodic_lorawan_data() {
     
     // Wait for potential downlink messages (user management commands)
     wait_for_downlink();
+  } else if (last_uplink_deferred) {
+    // Coalesced: the counter keeps accumulating into the next report
+    Serial.println("⏸ Periodic report deferred by airtime governor");
+    Serial.println("⚠ Counter NOT cleared - usage will be included in the next report");
   } else {
     Serial.println("✗ Failed to send periodic report");
     Serial.println("⚠ Counter NOT cleared - will retry next hour");
@@ -963,24 +1635,67 @@ bool send_periodic_lorawan_data() {
   return success;
 }
 
+// Send the report of a station with several ultrasound channels (Operation 0A)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [USAGE_COUNT (1)] [COUNT (1)]
+//         { [FILL_PCT (1)] [MINUTES_TO_FULL (2, big-endian)] } x COUNT [USAGE_HISTOGRAM (2-34)]
+// One frame for the whole station: usage comes from its single PIR sensor
+bool send_multi_channel_report(const float* fill_percentages) {
+  byte message[MULTI_REPORT_FRAME_MAX_LENGTH];
+  size_t length = wake_cycle_build_multi_report(rtc_state, device_config, local_clock_ms(), fill_percentages, message);
+  
+  Serial.println("\n--- Multi-Channel Report Data ---");
+  Serial.print("Station Name: ");
+  Serial.println(device_config.name);
+  Serial.print("Usage count since last report: ");
+  Serial.println(message[7]);
+  for (byte channel = 0; channel < message[8]; channel++) {
+    const byte* entry = &message[9 + 3 * channel];
+    uint16_t minutes_to_full = ((uint16_t)entry[1] << 8) | entry[2];
+    Serial.print("  - Channel ");
+    Serial.print(channel);
+    Serial.print(": fill ");
+    Serial.print(entry[0]);
+    Serial.print("%, rate ");
+    Serial.print(fill_forecast[channel].rate_pct_per_h, 2);
+    Serial.print(" %/h, time to full ");
+    if (minutes_to_full == FORECAST_MINUTES_UNKNOWN) {
+      Serial.println("unknown");
+    } else {
+      Serial.print(minutes_to_full);
+      Serial.println(" min");
+    }
+  }
+  Serial.print("Frame: ");
+  Serial.print(length);
+  Serial.println(" bytes");
+  
+  bool success = send_lorawan_data(message, length, 1, UPLINK_PRIORITY_LOW);
+  byte data[4] = {message[9], message[7], message[10], message[11]};  // Journal keeps channel 0
+  journal_log(JOURNAL_REPORT, success ? JOURNAL_FLAG_SENT : (last_uplink_deferred ? JOURNAL_FLAG_DEFERRED : 0),
+              data);
+  
+  if (success) {
+    Serial.println("✓ Multi-channel report sent successfully");
+    clear_counter();
+    wait_for_downlink();
+  } else if (last_uplink_deferred) {
+    Serial.println("⏸ Multi-channel report deferred by airtime governor");
+  } else {
+    Serial.println("✗ Failed to send multi-channel report");
+  }
+  
+  Serial.println("============================================\n");
+  return success;
+}
+
 // Send worker cleanup notification via LoRaWAN (Operation 01)
 // Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [RFID_UID (4)] = 11 bytes
 bool send_emptied_notification(byte* uid, byte uid_size) {
   Serial.println("\n📡 ========== WORKER EMPTIED NOTIFICATION ==========");
   
   // Build the message: Operation ID + Trashcan Name (6 bytes) + RFID UID (4 bytes)
-  byte message[11];
-  message[0] = OP_WORKER_CLEANUP;  // Operation ID: 0x01
-  
-  // Copy 6-character trashcan name as bytes
-  for (int i = 0; i < 6; i++) {
-    message[1 + i] = (byte)TRASHCAN_NAME[i];
-  }
-  
-  // Copy RFID UID bytes (assuming 4 bytes)
-  for (int i = 0; i < 4 && i < uid_size; i++) {
-    message[7 + i] = uid[i];
-  }
+  byte message[UPLINK_FRAME_LENGTH];
+  wake_cycle_build_cleanup(device_config, uid, uid_size, message);
   
   // Print what we're sending
   Serial.print("Message bytes: ");
@@ -993,7 +1708,7 @@ bool send_emptied_notification(byte* uid, byte uid_size) {
   
   Serial.print("  - Operation: Worker Cleanup (0x01)\n");
   Serial.print("  - Trashcan Name: ");
-  Serial.print(TRASHCAN_NAME);
+  Serial.print(device_config.name);
   Serial.print(" (");
   for (int i = 0; i < 6; i++) {
     if (message[1 + i] < 0x10) Serial.print("0");
@@ -1009,8 +1724,8 @@ bool send_emptied_notification(byte* uid, byte uid_size) {
   }
   Serial.println();
   
-  // Send via LoRaWAN
-  bool success = send_lorawan_data(message, 11, 1);
+  // Send via LoRaWAN (cleanups bypass the airtime governor)
+  bool success = send_lorawan_data(message, UPLINK_FRAME_LENGTH, 1, UPLINK_PRIORITY_HIGH);
   
   if (success) {
     Serial.println("✓ Worker cleanup notification sent successfully");
@@ -1025,6 +1740,217 @@ bool send_emptied_notification(byte* uid, byte uid_size) {
   return success;
 }
 
+// Report the cleanups inferred from the fill level (Operation 09), one frame
+// per emptied channel
+// Each pending report stays in RTC memory until its uplink is accepted
+bool send_inferred_cleanup() {
+  Serial.println("\n🧹 ========== INFERRED CLEANUP ==========");
+  
+  bool all_sent = true;
+  for (byte channel = 0; channel < SENSOR_CHANNELS; channel++) {
+    InferredCleanupReport& report = rtc_state.inferred_cleanup[channel];
+    if (!report.pending) continue;
+    
+    byte message[INFERRED_CLEANUP_FRAME_MAX_LENGTH];
+    size_t length = wake_cycle_build_inferred_cleanup(report, device_config, local_clock_ms(), message);
+    Serial.print("Channel ");
+    Serial.print(channel);
+    Serial.print(": fill ");
+    Serial.print(report.before_pct);
+    Serial.print("% -> ");
+    Serial.print(report.after_pct);
+    Serial.print("%, ");
+    Serial.print(((uint16_t)message[9] << 8) | message[10]);
+    Serial.println(" min ago");
+    
+    // Like a tapped cleanup, it keeps a truck from driving to an empty bin: bypass the airtime governor
+    if (send_lorawan_data(message, length, 1, UPLINK_PRIORITY_HIGH)) {
+      report.pending = 0;
+      Serial.println("✓ Inferred cleanup reported");
+      wait_for_downlink();
+    } else {
+      Serial.println("✗ Inferred cleanup not sent - will retry next wake");
+      all_sent = false;
+    }
+  }
+  
+  Serial.println("========================================\n");
+  return all_sent;
+}
+
+// Send the memory diagnostics uplink (Operation 05, opt-in via CFG_PARAM_DIAGNOSTICS)
+// Carries the worst values since the last one; see wake_cycle_build_diagnostics()
+bool send_diagnostics() {
+  Serial.println("\n🩺 ========== MEMORY DIAGNOSTICS ==========");
+  
+  byte message[DIAG_FRAME_LENGTH];
+  wake_cycle_build_diagnostics(rtc_state, device_config, message);
+  Serial.print("Samples since last diagnostics: ");
+  Serial.println(memory_telemetry.samples);
+  print_memory_sample(memory_telemetry.worst);
+  
+  // Low priority: the airtime governor may defer it; the worst values keep accumulating
+  bool success = send_lorawan_data(message, DIAG_FRAME_LENGTH, 1, UPLINK_PRIORITY_LOW);
+  if (success) {
+    mem_telemetry_reset_worst(memory_telemetry);
+    Serial.println("✓ Diagnostics sent");
+    wait_for_downlink();
+  } else {
+    Serial.println("✗ Diagnostics not sent - kept for the next report");
+  }
+  
+  Serial.println("==========================================\n");
+  return success;
+}
+
+// Report a database recovery upstream (Operation 06)
+// The pending report stays in RTC memory until the uplink is accepted
+bool send_recovery_report() {
+  Serial.println("\n🩹 ========== RECOVERY REPORT ==========");
+  
+  byte message[UPLINK_FRAME_LENGTH];
+  wake_cycle_build_recovery(rtc_state.recovery, device_config, message);
+  Serial.print("Reason: 0x");
+  Serial.print(rtc_state.recovery.reason, HEX);
+  Serial.print(", users restored: ");
+  Serial.print(rtc_state.recovery.users);
+  Serial.print(", took ");
+  Serial.print(rtc_state.recovery.duration_ms);
+  Serial.println(" ms");
+  
+  // A bin that lost its whitelist needs attention: bypass the airtime governor
+  bool success = send_lorawan_data(message, UPLINK_FRAME_LENGTH, 1, UPLINK_PRIORITY_HIGH);
+  if (success) {
+    rtc_state.recovery.reason = RECOVERY_NONE;
+    Serial.println("✓ Recovery reported");
+    wait_for_downlink();
+  } else {
+    Serial.println("✗ Recovery report not sent - will retry next wake");
+  }
+  
+  Serial.println("======================================\n");
+  return success;
+}
+
+// Report the result of a firmware update upstream (Operation 07)
+// The pending report stays in RTC memory (and NVS) until the uplink is accepted
+bool send_ota_report() {
+  Serial.println("\n📦 ========== FIRMWARE UPDATE REPORT ==========");
+  
+  byte message[OTA_FRAME_LENGTH];
+  wake_cycle_build_ota_status(rtc_state.ota, device_config, message);
+  Serial.print("Status: ");
+  Serial.print(patch_status_name(rtc_state.ota.status));
+  Serial.print(", image CRC ");
+  Serial.println(rtc_state.ota.new_crc, HEX);
+  
+  // Rare and needed to track the rollout - not subject to the airtime governor
+  bool success = send_lorawan_data(message, OTA_FRAME_LENGTH, 1, UPLINK_PRIORITY_HIGH);
+  if (success) {
+    memset(&rtc_state.ota, 0, sizeof(rtc_state.ota));
+    open_preferences();
+    preferences.remove("ota_report");
+    Serial.println("✓ Firmware update reported");
+    wait_for_downlink();
+  } else {
+    Serial.println("✗ Firmware update report not sent - will retry next wake");
+  }
+  
+  Serial.println("==============================================\n");
+  return success;
+}
+
+// Send the next frames of a journal upload requested by downlink (Operation 08)
+// Low priority: the airtime governor spreads a long range over several wakes
+#define JOURNAL_UPLOAD_FRAMES_PER_WAKE  4
+
+void send_journal_upload() {
+  Serial.println("\n📒 ========== JOURNAL UPLOAD ==========");
+  Serial.print("Range: ");
+  Serial.print(journal_upload.from);
+  Serial.print(" to ");
+  Serial.print(journal_upload.to);
+  Serial.print(", from record #");
+  Serial.println(journal_upload.next_sequence);
+  
+  JournalFiles files;
+  for (int frame = 0; frame < JOURNAL_UPLOAD_FRAMES_PER_WAKE && journal_upload.active; frame++) {
+    JournalRecord records[JOURNAL_FRAME_RECORDS];
+    uint8_t count = 0;
+    journal_query(event_journal, files, journal_upload.from, journal_upload.to, journal_upload.next_sequence,
+                  [&](const JournalRecord& record) {
+                    records[count++] = record;
+                    return count < JOURNAL_FRAME_RECORDS;
+                  });
+    
+    for (uint8_t i = 0; i < count; i++) {
+      Serial.print("  #");
+      Serial.print(records[i].sequence);
+      Serial.print(" ");
+      Serial.print(records[i].time);
+      Serial.print(" ");
+      Serial.println(journal_type_name(records[i].type));
+    }
+    
+    byte message[JOURNAL_FRAME_MAX_LENGTH];
+    size_t length = wake_cycle_build_journal(records, count, device_config, message);
+    if (!send_lorawan_data(message, length, 1, UPLINK_PRIORITY_LOW)) {
+      Serial.println("✗ Journal frame not sent - upload continues next wake");
+      break;
+    }
+    if (count > 0) journal_upload.next_sequence = records[count - 1].sequence + 1;
+    if (count < JOURNAL_FRAME_RECORDS) {
+      journal_upload.active = 0;
+      Serial.println("✓ Journal upload complete");
+    }
+    wait_for_downlink();
+  }
+  
+  Serial.println("======================================\n");
+}
+
+// Request network time via LoRaWAN clock sync (AppTimeReq on CLOCK_SYNC_PORT)
+// The answer is handled by process_downlink_message() during the downlink wait
+bool request_network_time() {
+  Serial.println("\n🕒 ========== NETWORK TIME SYNC ==========");
+
+  byte request[CLOCK_SYNC_REQ_LENGTH];
+  size_t length = time_sync_build_request(time_sync, local_clock_ms(), request);
+
+  Serial.print("Clock synced: ");
+  Serial.println(time_sync.valid ? "yes (refreshing)" : "no");
+  Serial.print("Request token: ");
+  Serial.println(time_sync.token);
+
+  bool success = send_lorawan_data(request, length, CLOCK_SYNC_PORT);
+
+  if (success) {
+    // Answer comes in the RX windows of this uplink
+    wait_for_downlink();
+  } else {
+    Serial.println("✗ Failed to send clock sync request");
+  }
+
+  Serial.println("==========================================\n");
+  return success && time_sync.valid;
+}
+
+// Compute the timer wake-up interval in microseconds (see wake_cycle.h)
+// The wake is for the next report, or for a multicast window if one comes first
+uint64_t get_next_sleep_us() {
+  uint32_t periods = 1;
+  uint64_t sleep_ms = wake_cycle_schedule_sleep_ms(rtc_state, device_config, local_clock_ms(), &periods);
+
+  Serial.print("📈 Report cadence: every ");
+  Serial.print(periods);
+  Serial.println(" period(s)");
+  if (multicast_batch.window_wake) {
+    Serial.println("📻 Next timer wake: multicast window");
+  }
+
+  return sleep_ms * 1000ULL;
+}
+
 // Function to configure deep sleep wake-up sources
 void configure_deep_sleep() {
   Serial.println("\n💤 Configuring deep sleep wake-up sources...");
@@ -1039,10 +1965,13 @@ void configure_deep_sleep() {
     Serial.println(ext0_result);
   }
   
-  // Configure timer wake-up (1 hour)
-  esp_err_t timer_result = esp_sleep_enable_timer_wakeup(DEEP_SLEEP_TIMER_US);
+  // Configure timer wake-up (next report slot)
+  uint64_t sleep_us = get_next_sleep_us();
+  esp_err_t timer_result = esp_sleep_enable_timer_wakeup(sleep_us);
   if (timer_result == ESP_OK) {
-    Serial.println("✓ Timer wake-up configured (1 hour interval)");
+    Serial.print("✓ Timer wake-up configured (");
+    Serial.print((unsigned long)(sleep_us / 1000000ULL));
+    Serial.println(time_sync.valid ? " s, aligned to report slot)" : " s, clock not synced)");
   } else {
     Serial.print("✗ Timer wake-up configuration failed: ");
     Serial.println(timer_result);
@@ -1051,15 +1980,58 @@ void configure_deep_sleep() {
   Serial.println("Deep sleep configuration complete.\n");
 }
 
+// Forward declarations for enter_deep_sleep
+bool write_golden_snapshot();
+bool apply_firmware_update();
+void restart_into_new_firmware();
+
 // Function to enter deep sleep
 void enter_deep_sleep() {
   Serial.println("\n💤 ========== ENTERING DEEP SLEEP ==========");
   Serial.println("Wake-up sources:");
   Serial.println("  - PIR motion detection (GPIO 4)");
-  Serial.println("  - Timer (1 hour)");
+  Serial.println("  - Timer (next report slot)");
   Serial.println("Good night! 😴");
+  
+  // Memory high-water marks of this wake cycle (kept in RTC memory)
+  sample_memory(MEM_POINT_SLEEP);
+  print_memory_sample(memory_telemetry.last[MEM_POINT_SLEEP]);
+  if (event_queue != NULL) {
+    print_event_stats();
+  }
+  
+  // Power profile of this wake, for tools/power_model
+  wake_profile.awake_ms = millis();
+  if (rfid_on_at != 0) {
+    wake_profile.rfid_ms = wake_profile.awake_ms - rfid_on_at;
+  }
+  char power_line[POWER_LINE_MAX_LENGTH];
+  wake_profile_format(wake_profile, power_line, sizeof(power_line));
+  Serial.println(power_line);
   Serial.println("=============================================\n");
   
+  // Keep the golden snapshot in step with the whitelist
+  if (whitelist_changed) {
+    write_golden_snapshot();
+  }
+  
+  // Install a downloaded firmware patch; on success the chip restarts into it
+  if (frag_session.status == FRAG_STATUS_COMPLETE && apply_firmware_update()) {
+    restart_into_new_firmware();
+  }
+  
+  // Configure wake-up sources now so the timer is computed from the actual sleep time
+  configure_deep_sleep();
+  
+  // Batch counters to NVS when due, then seal the RTC state for the next wake
+  if (rtc_state_flush_due(rtc_state, local_clock_ms())) {
+    flush_counters_to_nvs("periodic");
+  }
+  rtc_state_seal(rtc_state);
+  if (preferences_open) {
+    preferences.end();
+  }
+  
   // Flush serial buffer before sleep
   Serial.flush();
   
@@ -1070,25 +2042,683 @@ void enter_deep_sleep() {
   esp_deep_sleep_start();
 }
 
-// Function to check if RFID is authorized
-bool check_access(String rfid_tag_id) {
-  try {
-    JsonDocument result = database.execute(
-      "SELECT id, role FROM user WHERE rfid_tag_id = ?;",
-      rfid_tag_id
-    );
+// ============================================
+// Database Setup (see db_tuning.h)
+// ============================================
 
-    // Check if any rows were returned
-    if (result.size() > 0 && result[0].size() > 0) {
-      // User found - access role by column name (SQLiteManager returns JSON objects)
-      String role = result[0]["role"].as<String>();
-      Serial.print("✓ ACCESS GRANTED - Role: ");
-      Serial.println(role);
-      return true;
-    } else {
-      // User not found
-      Serial.println("✗ ACCESS DENIED - Unknown RFID tag");
-      return false;
+// Give SQLite a page cache pool in PSRAM; must run before the database is opened
+// Without PSRAM (or if SQLite is already initialized) the cache stays on the heap
+void configure_page_cache() {
+  int slot_size = db_page_cache_slot_size();
+  void* pool = heap_caps_malloc((size_t)slot_size * DB_CACHE_PAGES, MALLOC_CAP_SPIRAM);
+  if (pool == NULL) {
+    Serial.println("⚠ No PSRAM for the SQLite page cache - using the heap");
+    return;
+  }
+  if (sqlite3_config(SQLITE_CONFIG_PAGECACHE, pool, slot_size, DB_CACHE_PAGES) != SQLITE_OK) {
+    heap_caps_free(pool);
+    Serial.println("⚠ SQLite page cache not configured - using the heap");
+    return;
+  }
+  page_cache_slot_size = slot_size;
+  Serial.print("SQLite page cache: ");
+  Serial.print(DB_CACHE_PAGES);
+  Serial.print(" x ");
+  Serial.print(slot_size);
+  Serial.println(" bytes in PSRAM");
+}
+
+// Apply the journal, sync, cache and mmap settings to the open database
+// A failed pragma leaves that SQLite default in place
+void tune_database() {
+  for (size_t i = 0; i < DB_TUNING_PRAGMA_COUNT; i++) {
+    try {
+      database.execute(db_tuning_pragmas[i]);
+    } catch (const std::exception &e) {
+      Serial.print("⚠ ");
+      Serial.print(db_tuning_pragmas[i]);
+      Serial.print(" failed: ");
+      Serial.println(e.what());
+    }
+  }
+  
+  // mmap_size reads back 0 where the VFS cannot map the file
+  try {
+    JsonDocument mmap = database.execute("PRAGMA mmap_size;");
+    Serial.print("SQLite mmap_size: ");
+    Serial.println(mmap[0]["mmap_size"].as<long>());
+  } catch (const std::exception &e) {
+    Serial.print("Database error: ");
+    Serial.println(e.what());
+  }
+}
+
+// ============================================
+// Database Recovery (see golden_whitelist.h)
+// ============================================
+
+// Flash interface of golden_whitelist.h over the "golden" partition
+struct PartitionFlash {
+  const esp_partition_t* partition;
+  
+  uint32_t size() { return partition ? partition->size : 0; }
+  bool read(uint32_t offset, void* data, size_t length) {
+    return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+  }
+  bool write(uint32_t offset, const void* data, size_t length) {
+    return partition && esp_partition_write(partition, offset, data, length) == ESP_OK;
+  }
+  bool erase(uint32_t offset, size_t length) {
+    return partition && esp_partition_erase_range(partition, offset, length) == ESP_OK;
+  }
+};
+
+PartitionFlash golden_flash() {
+  PartitionFlash flash = {
+    esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "golden")
+  };
+  return flash;
+}
+
+bool open_database() {
+  try {
+    database.open(DB_PATH);
+    tune_database();
+    return true;
+  } catch (const std::exception &e) {
+    Serial.print("Error opening database: ");
+    Serial.println(e.what());
+    return false;
+  }
+}
+
+// Schema probe on every wake; full integrity check when thorough is set
+bool database_healthy(bool thorough) {
+  try {
+    database.execute("SELECT COUNT(*) AS users FROM user;");
+    if (!thorough) return true;
+    JsonDocument check = database.execute("PRAGMA quick_check;");
+    const char* result = check[0]["quick_check"].as<const char*>();
+    if (result != NULL && strcmp(result, "ok") == 0) return true;
+    Serial.print("Integrity check: ");
+    Serial.println(result ? result : "(no result)");
+    return false;
+  } catch (const std::exception &e) {
+    Serial.print("Database error: ");
+    Serial.println(e.what());
+    return false;
+  }
+}
+
+// Load the newest golden snapshot into an empty database in one transaction
+// Returns the number of users restored, -1 without a valid snapshot
+int restore_from_golden() {
+  PartitionFlash flash = golden_flash();
+  GoldenSnapshot snapshot = golden_find_newest(flash);
+  if (snapshot.slot < 0) {
+    Serial.println("⚠ No golden snapshot - whitelist starts empty");
+    return -1;
+  }
+  
+  int restored = 0;
+  try {
+    database.execute("BEGIN;");
+    bool intact = golden_for_each(flash, snapshot, [&restored](const GoldenRecord& record) {
+      const char* role = golden_role_name(record.role);
+      if (role == NULL) return;
+      char rfid_tag[RFID_TAG_TEXT_SIZE];
+      text_format_rfid(record.uid, GOLDEN_UID_LENGTH, rfid_tag, sizeof(rfid_tag));
+      database.execute(
+        "INSERT OR REPLACE INTO user (name, rfid_tag_id, role) VALUES(?, ?, ?);",
+        rfid_tag, rfid_tag, role
+      );
+      restored++;
+    });
+    if (!intact) {
+      database.execute("ROLLBACK;");
+      Serial.println("⚠ Golden snapshot damaged - whitelist starts empty");
+      return -1;
+    }
+    database.execute("COMMIT;");
+  } catch (const std::exception &e) {
+    Serial.print("Database error restoring snapshot: ");
+    Serial.println(e.what());
+    try { database.execute("ROLLBACK;"); } catch (const std::exception &) {}
+    return -1;
+  }
+  
+  Serial.print("✓ Restored ");
+  Serial.print(restored);
+  Serial.print(" users from golden snapshot #");
+  Serial.println(snapshot.header.sequence);
+  return restored;
+}
+
+// Delete the database file and create an empty one with the schema
+bool rebuild_database() {
+  try {
+    database.close();
+  } catch (const std::exception &) {
+    // Was not open
+  }
+  LittleFS.remove("/database.db");
+  LittleFS.remove("/database.db-journal");
+  
+  if (!open_database()) return false;
+  for (size_t i = 0; i < DB_SCHEMA_STATEMENT_COUNT; i++) {
+    try {
+      database.execute(db_schema_statements[i]);
+    } catch (const std::exception &e) {
+      Serial.print("Error creating schema: ");
+      Serial.println(e.what());
+      return false;
+    }
+  }
+  return true;
+}
+
+// Remember a recovery for the recovery uplink (kept in RTC until it goes out)
+void record_recovery(byte reason, int restored, unsigned long started) {
+  if (restored < 0) {
+    reason |= RECOVERY_NO_SNAPSHOT;
+    restored = 0;
+  }
+  rtc_state.recovery.reason = reason;
+  rtc_state.recovery.users = (uint16_t)restored;
+  rtc_state.recovery.duration_ms = millis() - started;
+  
+  Serial.print("🩹 Recovery 0x");
+  Serial.print(reason, HEX);
+  Serial.print(" finished in ");
+  Serial.print(rtc_state.recovery.duration_ms);
+  Serial.println(" ms");
+}
+
+// Mount LittleFS and open the whitelist database without ever halting
+// A filesystem that does not mount is formatted; a database that does not
+// open or fails its check is recreated and filled from the golden snapshot.
+// The work is bounded by the snapshot size (one transaction). A cold boot
+// (power-on or reset, the usual moment for a damaged file) runs the full
+// integrity check; other wakes only probe the schema.
+void open_whitelist_database() {
+  unsigned long started = millis();
+  byte reason = RECOVERY_NONE;
+  
+  Serial.println("Mounting LittleFS...");
+  if (!LittleFS.begin(false)) {
+    Serial.println("⚠ LittleFS did not mount - formatting");
+    reason = RECOVERY_FS_FORMATTED;
+    if (!LittleFS.format() || !LittleFS.begin(false)) {
+      Serial.println("✗ LittleFS unusable - running without a whitelist");
+      record_recovery(RECOVERY_DB_UNAVAILABLE, 0, started);
+      return;
+    }
+  }
+  Serial.println("LittleFS mounted successfully");
+  filesystem_ready = true;
+  
+  Serial.println("Opening database...");
+  if (reason == RECOVERY_NONE) {
+    bool cold_boot = rtc_state.wake_count == 1;
+    if (!open_database()) {
+      reason = RECOVERY_DB_OPEN;
+    } else if (!database_healthy(cold_boot)) {
+      reason = RECOVERY_DB_CORRUPT;
+    } else {
+      database_ready = true;
+      Serial.println("Database opened successfully");
+      
+      // Devices without a snapshot yet (first boot, new partition table) write one before sleep
+      PartitionFlash flash = golden_flash();
+      if (cold_boot && golden_find_newest(flash).slot < 0) {
+        whitelist_changed = true;
+      }
+      return;
+    }
+  }
+  
+  Serial.println("⚠ Rebuilding database from the golden snapshot...");
+  if (!rebuild_database()) {
+    Serial.println("✗ Database unusable - running without a whitelist");
+    record_recovery(RECOVERY_DB_UNAVAILABLE, 0, started);
+    return;
+  }
+  database_ready = true;
+  record_recovery(reason, restore_from_golden(), started);
+}
+
+// Write the current whitelist as a new golden snapshot (paged reads keep the
+// JSON results small); the previous snapshot stays valid if this fails
+bool write_golden_snapshot() {
+  PartitionFlash flash = golden_flash();
+  if (!database_ready || flash.size() == 0) return false;
+  
+  static GoldenWriter writer;  // Record buffer: too big for the stack
+  if (!golden_writer_begin(flash, writer)) {
+    Serial.println("✗ Golden snapshot: erase failed");
+    return false;
+  }
+  
+  long last_id = 0;
+  uint32_t skipped = 0;
+  try {
+    for (;;) {
+      JsonDocument page = database.execute(
+        "SELECT id, rfid_tag_id, role FROM user WHERE id > ? ORDER BY id LIMIT 32;",
+        last_id
+      );
+      if (page.size() == 0) break;
+      for (size_t i = 0; i < page.size(); i++) {
+        last_id = page[i]["id"].as<long>();
+        GoldenRecord record;
+        record.role = golden_role_code(page[i]["role"].as<const char*>());
+        const char* rfid_tag = page[i]["rfid_tag_id"].as<const char*>();
+        if (record.role == 0 || rfid_tag == NULL || !golden_tag_to_uid(rfid_tag, record.uid)) {
+          skipped++;
+          continue;
+        }
+        if (!golden_writer_add(flash, writer, record)) break;
+      }
+      if (writer.failed) break;
+    }
+  } catch (const std::exception &e) {
+    Serial.print("✗ Golden snapshot: database error ");
+    Serial.println(e.what());
+    return false;
+  }
+  
+  if (!golden_writer_finish(flash, writer)) {
+    Serial.println("✗ Golden snapshot: write failed (full or flash error)");
+    return false;
+  }
+  whitelist_changed = false;
+  Serial.print("💾 Golden snapshot #");
+  Serial.print(writer.sequence);
+  Serial.print(": ");
+  Serial.print(writer.count);
+  Serial.print(" users");
+  if (skipped > 0) {
+    Serial.print(", ");
+    Serial.print(skipped);
+    Serial.print(" skipped (not a 4-byte UID)");
+  }
+  Serial.println();
+  return true;
+}
+
+// ============================================
+// Multicast Whitelist (see multicast_session.h)
+// ============================================
+
+#define MC_POLL_INTERVAL_MS  50  // Module line polling during a window
+
+// Apply a MULTICAST_SETUP downlink: the session and schedule go to NVS and
+// the RTC cache; the first window is planned when the bin goes to sleep
+void apply_multicast_setup(const byte* data, size_t length) {
+  MulticastGroup group;
+  if (!multicast_group_parse_setup(data, length, group)) {
+    Serial.println("✗ Invalid multicast setup (ignored)");
+    return;
+  }
+  
+  open_preferences();
+  if (preferences.putBytes("mcast", &group, sizeof(group)) != sizeof(group)) {
+    Serial.println("✗ Failed to store multicast setup");
+    return;
+  }
+  multicast_group = group;
+  memset(&multicast_batch, 0, sizeof(multicast_batch));
+  
+  if (!multicast_group_active(multicast_group)) {
+    Serial.println("✓ Left the multicast group");
+    return;
+  }
+  Serial.print("✓ Multicast group ");
+  Serial.print(multicast_group.group_addr, HEX);
+  Serial.print(": window every ");
+  Serial.print(multicast_group.period_min);
+  Serial.print(" min at +");
+  Serial.print(multicast_group.offset_min);
+  Serial.print(" min for ");
+  Serial.print(multicast_group.window_s);
+  Serial.println(" s");
+}
+
+// Apply one frame of a whitelist batch heard in a multicast window
+void handle_multicast_batch(const byte* data, size_t length) {
+  Serial.println("--- MULTICAST Whitelist Batch ---");
+  
+  byte result = multicast_batch_receive(multicast_batch, data, length,
+                                        [](uint8_t operation, const uint8_t* uid, uint8_t role) {
+    char rfid_tag[RFID_TAG_TEXT_SIZE];
+    text_format_rfid(uid, RFID_UID_LENGTH, rfid_tag, sizeof(rfid_tag));
+    if (operation == MC_ENTRY_DELETE) {
+      delete_user_from_downlink(rfid_tag);
+    } else if (role == DL_ROLE_WORKER) {
+      insert_user_from_downlink(rfid_tag, "WORKER");
+    } else if (role == DL_ROLE_ADMIN) {
+      insert_user_from_downlink(rfid_tag, "ADMIN");
+    } else {
+      Serial.print("✗ Invalid role byte for ");
+      Serial.print(rfid_tag);
+      Serial.print(": 0x");
+      Serial.println(role, HEX);
+    }
+  });
+  
+  if (result == MC_FRAME_INVALID) {
+    Serial.println("✗ Invalid batch frame (ignored)");
+    return;
+  }
+  multicast_frame_received = true;
+  Serial.print("Batch #");
+  Serial.print(multicast_batch.batch_id);
+  Serial.print(" frame ");
+  Serial.print(data[2] + 1);
+  Serial.print("/");
+  Serial.print(multicast_batch.frame_count);
+  Serial.println(result == MC_FRAME_NEW ? " applied" : " already applied");
+}
+
+// Listen in class C through the multicast window this timer wake was planned
+// for. The window closes early once the whole batch was heard.
+void run_multicast_window() {
+  Serial.println("\n📻 ========== MULTICAST WINDOW ==========");
+  
+  if (!lorawan_joined || !database_ready || wake_cycle_multicast_window_left_ms(rtc_state, local_clock_ms()) == 0) {
+    Serial.println("✗ Window skipped (not joined, no database, no group or clock, or window over)");
+    Serial.println("========================================\n");
+    return;
+  }
+  
+  char command[AT_MCAST_MAX_LENGTH];
+  if (at_format_mcast(command, sizeof(command), multicast_group.group_addr, multicast_group.nwk_skey,
+                      multicast_group.app_skey, multicast_group.frequency_hz, multicast_group.data_rate) == 0 ||
+      !send_at_command(command)) {
+    Serial.println("✗ Module did not accept the multicast session");
+    Serial.println("========================================\n");
+    return;
+  }
+  
+  // Time to the window after the module setup
+  int64_t to_window_ms = multicast_ms_to_window(multicast_group, time_sync, local_clock_ms());
+  if (to_window_ms > 0) {
+    Serial.print("Window opens in ");
+    Serial.print((long)(to_window_ms / 1000));
+    Serial.println(" s");
+    delay((unsigned long)to_window_ms);
+  }
+  int64_t close_ms = local_clock_ms() + (to_window_ms < 0 ? to_window_ms : 0) + multicast_group.window_s * 1000LL;
+  
+  if (!send_at_command(LORA_CLASS_C_CMD)) {
+    Serial.println("✗ Module did not switch to class C");
+    Serial.println("========================================\n");
+    return;
+  }
+  
+  multicast_frame_received = false;
+  bool complete = false;
+  unsigned long class_c_at = millis();
+  while (local_clock_ms() < close_ms && !complete) {
+    check_incoming_lorawan_blocking();
+    complete = multicast_frame_received && multicast_batch_complete(multicast_batch);
+    delay(MC_POLL_INTERVAL_MS);
+  }
+  wake_profile.rx_ms += millis() - class_c_at; // Receiver on for the whole class C window
+  if (!send_at_command(LORA_CLASS_A_CMD)) {
+    Serial.println("⚠ Module did not switch back to class A");
+  }
+  
+  if (multicast_frame_received) {
+    multicast_batch.ack_pending = 1;
+    Serial.print("Batch #");
+    Serial.print(multicast_batch.batch_id);
+    Serial.print(": ");
+    Serial.print(multicast_batch.frames_heard);
+    Serial.print("/");
+    Serial.print(multicast_batch.frame_count);
+    Serial.println(" frame(s) heard");
+  } else {
+    Serial.println("No batch in this window");
+  }
+  Serial.println("========================================\n");
+}
+
+// Acknowledge a batch with the bitmap of the frames heard (Operation 0B)
+// Sent at the next report wake, not right after the window, so the fleet's
+// acks spread over the report slots instead of colliding
+bool send_multicast_ack() {
+  Serial.println("\n📻 ========== MULTICAST ACK ==========");
+  
+  byte message[MULTICAST_ACK_MAX_LENGTH];
+  size_t length = wake_cycle_build_multicast_ack(multicast_batch, device_config, message);
+  Serial.print("Batch #");
+  Serial.print(multicast_batch.batch_id);
+  Serial.print(": ");
+  Serial.print(multicast_batch.frames_heard);
+  Serial.print("/");
+  Serial.print(multicast_batch.frame_count);
+  Serial.println(" frame(s) heard");
+  
+  // Needed for the server to reach stragglers - not subject to the airtime governor
+  bool success = send_lorawan_data(message, length, 1, UPLINK_PRIORITY_HIGH);
+  if (success) {
+    multicast_batch.ack_pending = 0;
+    Serial.println("✓ Multicast batch acknowledged");
+    wait_for_downlink();
+  } else {
+    Serial.println("✗ Multicast ack not sent - will retry next wake");
+  }
+  
+  Serial.println("====================================\n");
+  return success;
+}
+
+// ============================================
+// Firmware Update (see frag_session.h, delta_patch.h)
+// ============================================
+
+#define FRAG_STORAGE_PATH  "/ota.frag"  // Received fragments, on LittleFS
+
+// Fragment storage of frag_session.h, and the patch read by delta_patch.h
+struct FragFile {
+  File file;
+  
+  FragFile() { file = LittleFS.open(FRAG_STORAGE_PATH, "r+"); }
+  ~FragFile() { close(); }
+  
+  void close() {
+    if (file) file.close();
+  }
+  bool reset() {
+    close();
+    file = LittleFS.open(FRAG_STORAGE_PATH, "w+");
+    return (bool)file;
+  }
+  bool read(uint32_t offset, void* data, size_t length) {
+    return file && file.seek(offset) && file.read((uint8_t*)data, length) == length;
+  }
+  bool write(uint32_t offset, const void* data, size_t length) {
+    return file && file.seek(offset) && file.write((const uint8_t*)data, length) == length;
+  }
+};
+
+// Output of delta_patch.h: the next OTA slot, read back for COPY_NEW
+struct OtaWriter {
+  esp_ota_handle_t handle;
+  const esp_partition_t* partition;
+  
+  bool write(const uint8_t* data, size_t length) {
+    return esp_ota_write(handle, data, length) == ESP_OK;
+  }
+  bool read(uint32_t offset, uint8_t* data, size_t length) {
+    return esp_partition_read(partition, offset, data, length) == ESP_OK;
+  }
+};
+
+// Drop the download (fragments and session state)
+void end_fragmentation_session() {
+  frag_session_reset(frag_session);
+  LittleFS.remove(FRAG_STORAGE_PATH);
+}
+
+// Handle a downlink on FRAG_PORT; answers go out after the downlink wait,
+// and each new fragment makes wait_for_downlink() poll for the next one
+void handle_fragmentation_downlink(const byte* data, size_t length) {
+  FragFile storage;
+  FragResult result = frag_session_handle(frag_session, storage, data, length);
+  if (result.answer_length > 0) {
+    memcpy(frag_answer, result.answer, result.answer_length);
+    frag_answer_length = result.answer_length;
+  }
+  
+  if (result.decode_due) {
+    // Decoder matrices (about 54 KB): PSRAM when present, for this call only
+    uint8_t* scratch = (uint8_t*)heap_caps_malloc(FRAG_SCRATCH_SIZE, MALLOC_CAP_SPIRAM);
+    if (scratch == NULL) scratch = (uint8_t*)malloc(FRAG_SCRATCH_SIZE);
+    if (scratch == NULL) {
+      Serial.println("✗ No memory for the fragment decoder - retrying with the next fragment");
+    } else {
+      unsigned long started = millis();
+      if (frag_session_decode(frag_session, storage, scratch)) {
+        Serial.print("Fragments decoded in ");
+        Serial.print(millis() - started);
+        Serial.println(" ms");
+      }
+      free(scratch);
+    }
+  }
+  
+  if (frag_session.status == FRAG_STATUS_IDLE) {
+    Serial.println("No firmware download in progress");
+    return;
+  }
+  Serial.print("Firmware download: ");
+  Serial.print(frag_session.received);
+  Serial.print("/");
+  Serial.print(frag_session.nb_frag);
+  Serial.print(" fragments, ");
+  Serial.print(frag_session.coded);
+  Serial.println(" coded");
+  
+  if (frag_session.status == FRAG_STATUS_COMPLETE) {
+    Serial.println("✓ Firmware patch complete - installing before sleep");
+  } else if (frag_session.status == FRAG_STATUS_FAILED) {
+    Serial.println("✗ Firmware patch does not match its CRC - dropped");
+    storage.close();
+    end_fragmentation_session();
+    rtc_state.ota.pending = 1;
+    rtc_state.ota.status = PATCH_CORRUPT;
+    rtc_state.ota.new_crc = 0;
+  } else if (result.fragment_stored) {
+    downlink_more_pending = true;
+  }
+}
+
+// Rebuild the new image from the downloaded patch into the next OTA slot and
+// make it the boot image. The patch must match the running image (CRC) and
+// produce the image its header names (CRC); esp_ota_end() then checks the
+// image itself. The patch is dropped either way: a failed one is not retried.
+bool apply_firmware_update() {
+  Serial.println("\n📦 ========== FIRMWARE UPDATE ==========");
+  unsigned long started = millis();
+  
+  const esp_partition_t* running = esp_ota_get_running_partition();
+  const esp_partition_t* target = esp_ota_get_next_update_partition(NULL);
+  uint32_t patch_size = frag_block_size(frag_session);
+  OtaReport& report = rtc_state.ota;
+  report.pending = 1;
+  report.new_crc = 0;
+  
+  FragFile patch;
+  PatchHeader header;
+  esp_ota_handle_t handle = 0;
+  uint8_t status = delta_patch_read_header(patch, patch_size, header);
+  if (status == PATCH_OK) {
+    report.new_crc = header.new_crc;
+    if (target == NULL || header.new_size > target->size ||
+        esp_ota_begin(target, header.new_size, &handle) != ESP_OK) {
+      status = PATCH_INSTALL_FAILED;
+    }
+  }
+  if (status == PATCH_OK) {
+    PartitionFlash old = {running};
+    OtaWriter out = {handle, target};
+    status = delta_patch_apply(patch, patch_size, old, out);
+    if (status != PATCH_OK) {
+      esp_ota_abort(handle);
+    } else if (esp_ota_end(handle) != ESP_OK || esp_ota_set_boot_partition(target) != ESP_OK) {
+      status = PATCH_INSTALL_FAILED;
+    }
+  }
+  report.status = status;
+  patch.close();
+  end_fragmentation_session();
+  
+  Serial.print(status == PATCH_OK ? "✓ New image installed in " : "✗ Update failed: ");
+  if (status == PATCH_OK) {
+    Serial.print(target->label);
+  } else {
+    Serial.print(patch_status_name(status));
+  }
+  Serial.print(" (");
+  Serial.print(millis() - started);
+  Serial.println(" ms)");
+  Serial.println("=======================================\n");
+  return status == PATCH_OK;
+}
+
+// Restart into the installed image. The report also goes to NVS: the new
+// image may lay out its RTC state differently and rebuild it from NVS.
+void restart_into_new_firmware() {
+  flush_counters_to_nvs("firmware update");
+  open_preferences();
+  preferences.putBytes("ota_report", &rtc_state.ota, sizeof(rtc_state.ota));
+  preferences.end();
+  rtc_state_seal(rtc_state);
+  
+  Serial.println("🔄 Restarting into the new firmware...");
+  Serial.flush();
+  ESP.restart();
+}
+
+// First boot of a new image: mark it valid once setup got this far, which
+// cancels the bootloader's rollback to the previous image (when enabled)
+void confirm_running_firmware() {
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &state) != ESP_OK ||
+      state != ESP_OTA_IMG_PENDING_VERIFY) {
+    return;
+  }
+  if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+    Serial.println("✓ New firmware confirmed");
+  }
+}
+
+// Function to check if RFID is authorized
+bool check_access(const char* rfid_tag_id) {
+  if (!database_ready) {
+    Serial.println("✗ ACCESS DENIED - No whitelist database");
+    return false;
+  }
+  
+  try {
+    JsonDocument result = database.execute(
+      "SELECT id, role FROM user WHERE rfid_tag_id = ?;",
+      rfid_tag_id
+    );
+
+    // Check if any rows were returned
+    if (result.size() > 0 && result[0].size() > 0) {
+      // User found - access role by column name (SQLiteManager returns JSON objects)
+      const char* role = result[0]["role"].as<const char*>();
+      Serial.print("✓ ACCESS GRANTED - Role: ");
+      Serial.println(role);
+      return true;
+    } else {
+      // User not found
+      Serial.println("✗ ACCESS DENIED - Unknown RFID tag");
+      return false;
     }
   } catch (const std::exception &e) {
     Serial.print("Database error: ");
@@ -1097,32 +2727,288 @@ bool check_access(String rfid_tag_id) {
   }
 }
 
+// ============================================
+// Active Window: Event Producers
+// ============================================
+
+TimerHandle_t sensor_timer = NULL;
+TimerHandle_t window_timer = NULL;
+TimerHandle_t uplink_timer = NULL;
+unsigned long window_end_ms = 0;  // millis() at which the active window closes
+
+// Card of the authenticated tap whose cleanup uplink waits for the module
+bool cleanup_pending = false;
+byte cleanup_uid[EVENT_RFID_UID_MAX];
+byte cleanup_uid_size = 0;
+
+// PIR rising edge (GPIO interrupt)
+void IRAM_ATTR on_pir_edge() {
+  Event event;
+  event.type = EVT_PIR_MOTION;
+  event.posted_ms = millis();
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(event_queue, &event, &woken) != pdTRUE) {
+    event_stats.dropped++;
+  }
+  portYIELD_FROM_ISR(woken);
+}
+
+void on_sensor_timer(TimerHandle_t timer) {
+  Event event;
+  event.type = EVT_SENSOR_TICK;
+  post_event(event);
+}
+
+void on_window_timer(TimerHandle_t timer) {
+  Event event;
+  event.type = EVT_WINDOW_TIMEOUT;
+  post_event(event);
+}
+
+void on_uplink_timer(TimerHandle_t timer) {
+  Event event;
+  event.type = EVT_CLEANUP_UPLINK;
+  post_event(event);
+}
+
+// Poll the reader and post each new card; a card held on the reader is
+// reported once, a re-tap of the same card after RFID_REPEAT_MS
+void rfid_task(void* arg) {
+  byte last_uid[EVENT_RFID_UID_MAX];
+  byte last_size = 0;
+  unsigned long last_read = 0;
+  
+  for (;;) {
+    if (rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial()) {
+      byte size = rfid.uid.size < EVENT_RFID_UID_MAX ? rfid.uid.size : EVENT_RFID_UID_MAX;
+      bool repeat = size == last_size &&
+                    memcmp(rfid.uid.uidByte, last_uid, size) == 0 &&
+                    millis() - last_read < RFID_REPEAT_MS;
+      if (!repeat) {
+        Event event;
+        event.type = EVT_RFID_TAP;
+        memcpy(event.rfid.uid, rfid.uid.uidByte, size);
+        event.rfid.size = size;
+        post_event(event);
+      }
+      memcpy(last_uid, rfid.uid.uidByte, size);
+      last_size = size;
+      last_read = millis();
+      
+      // Halt the card
+      rfid.PICC_HaltA();
+    }
+    vTaskDelay(pdMS_TO_TICKS(RFID_POLL_MS));
+  }
+}
+
+void post_downlink_event(const AtDownlink& downlink) {
+  Event event;
+  event.type = EVT_MODEM_LINE;
+  event.downlink = downlink;
+  post_event(event);
+}
+
+// Watch the module for RX: lines between AT transactions (which hold the
+// modem lock, so this task never steals their response)
+void modem_reader_task(void* arg) {
+  for (;;) {
+    read_lorawan_lines(post_downlink_event);
+    vTaskDelay(pdMS_TO_TICKS(MODEM_POLL_MS));
+  }
+}
+
+// Create the queue, timers and producer tasks for the active window
+// Returns false if FreeRTOS is out of memory
+bool start_event_bus() {
+  event_queue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(Event));
+  if (event_queue == NULL) return false;
+  
+  window_end_ms = wake_up_time + device_config.active_window_ms;
+  sensor_timer = xTimerCreate("sensor", pdMS_TO_TICKS(SENSOR_TICK_MS), pdTRUE, NULL, on_sensor_timer);
+  window_timer = xTimerCreate("window", pdMS_TO_TICKS(device_config.active_window_ms), pdFALSE, NULL, on_window_timer);
+  uplink_timer = xTimerCreate("uplink", pdMS_TO_TICKS(AT_UPLINK_GAP_MS), pdFALSE, NULL, on_uplink_timer);
+  if (sensor_timer == NULL || window_timer == NULL || uplink_timer == NULL) return false;
+  
+  if (xTaskCreate(rfid_task, "rfid", EVENT_TASK_STACK, NULL, EVENT_TASK_PRIORITY, &rfid_task_handle) != pdPASS) return false;
+  if (xTaskCreate(modem_reader_task, "modem", EVENT_TASK_STACK, NULL, EVENT_TASK_PRIORITY, &modem_task_handle) != pdPASS) return false;
+  
+  attachInterrupt(digitalPinToInterrupt(PIR_PIN), on_pir_edge, RISING);
+  xTimerStart(sensor_timer, 0);
+  xTimerStart(window_timer, 0);
+  return true;
+}
+
+// ============================================
+// Active Window: Event Handlers
+// ============================================
+
+// Motion keeps the window open for a worker who is still at the bin, up to
+// twice its configured length
+void handle_pir_motion() {
+  unsigned long now = millis();
+  unsigned long window_ms = device_config.active_window_ms;
+  unsigned long limit = wake_up_time + 2 * window_ms;
+  unsigned long end = now + window_ms;
+  if ((long)(end - limit) > 0) end = limit;
+  if ((long)(end - window_end_ms) <= 0) return;
+  
+  window_end_ms = end;
+  xTimerChangePeriod(window_timer, pdMS_TO_TICKS(end - now), 0);
+  Serial.println("🚶 Motion - active window extended");
+}
+
+void handle_rfid_tap(const Event& event) {
+  // A worker already tapped; the cleanup uplink is on its way
+  if (cleanup_pending) return;
+  
+  // Format the RFID UID as text
+  char rfidTag[RFID_TAG_TEXT_SIZE];
+  format_rfid((byte*)event.rfid.uid, event.rfid.size, rfidTag);
+  
+  Serial.println("\n--- Card Detected ---");
+  Serial.print("RFID Tag: ");
+  Serial.println(rfidTag);
+  
+  // Check access in database
+  if (!check_access(rfidTag)) {
+    // Unknown RFID - just print message and continue waiting
+    journal_log(JOURNAL_DENIED_TAP, 0, (const byte*)event.rfid.uid);
+    Serial.println("Unknown RFID detected. Continuing to wait for valid worker...");
+    Serial.println("---------------------\n");
+    return;
+  }
+  
+  // Worker authenticated - send notification and go to sleep immediately
+  worker_authenticated = true;
+  wake_profile.taps++;
+  
+  // Bin was emptied - restart the fill-rate model from the next reading
+  wake_cycle_bin_emptied(rtc_state);
+  
+  // The module answers ERROR while busy: keep AT_UPLINK_GAP_MS after the
+  // last uplink, with the event loop running meanwhile
+  cleanup_pending = true;
+  memcpy(cleanup_uid, event.rfid.uid, event.rfid.size);
+  cleanup_uid_size = event.rfid.size;
+  unsigned long since_uplink = millis() - last_uplink_done_ms;
+  if (last_uplink_done_ms == 0 || since_uplink >= AT_UPLINK_GAP_MS) {
+    Event uplink;
+    uplink.type = EVT_CLEANUP_UPLINK;
+    post_event(uplink);
+    return;
+  }
+  Serial.print("⏳ Cleanup uplink in ");
+  Serial.print(AT_UPLINK_GAP_MS - since_uplink);
+  Serial.println(" ms (module may still be busy)");
+  xTimerChangePeriod(uplink_timer, pdMS_TO_TICKS(AT_UPLINK_GAP_MS - since_uplink), 0);
+}
+
+void handle_cleanup_uplink() {
+  // Send emptied notification with raw RFID bytes
+  bool sent = send_emptied_notification(cleanup_uid, cleanup_uid_size);
+  journal_log(JOURNAL_CLEANUP, sent ? JOURNAL_FLAG_SENT : 0, cleanup_uid);
+  
+  Serial.println("✓ Worker authenticated. Going to sleep (no counter increment)...");
+  
+  // Go to sleep immediately - worker emptied the trash
+  enter_deep_sleep();
+  // Note: This function never returns - CPU resets on wake-up
+}
+
+void handle_sensor_tick() {
+  unsigned long now = millis();
+  unsigned long remaining = (long)(window_end_ms - now) > 0 ? window_end_ms - now : 0;
+  
+  print_sensor_readings();
+  
+  // Show time remaining before deep sleep and current counter
+  Serial.print("📊 Usage counter: ");
+  Serial.println(usage_counter);
+  Serial.print("⏱️  Time to deep sleep: ");
+  Serial.print(remaining / 1000);
+  Serial.println(" seconds\n");
+}
+
+void handle_window_timeout() {
+  // A tap is waiting for its uplink (its event may have been dropped): send it now
+  if (cleanup_pending) handle_cleanup_uplink();
+  
+  // No worker was authenticated during this wake cycle: count one use
+  bool reading_due = wake_cycle_window_expired(rtc_state, local_clock_ms(), worker_authenticated);
+  if (!worker_authenticated) {
+    Serial.println("\n⏰ Active window expired - no worker authenticated");
+    Serial.print("📊 Usage counter incremented to: ");
+    Serial.println(usage_counter);
+  }
+  
+  // Someone may have emptied the bin without tapping a card (unless the
+  // report of this wake already fed the cleanup detectors)
+  if (reading_due) {
+    float fill_percentages[SENSOR_CHANNELS];
+    read_fill_levels(fill_percentages);
+    if (check_for_emptying(fill_percentages)) {
+      send_inferred_cleanup();
+    }
+  }
+  
+  enter_deep_sleep();
+  // Note: This function never returns - CPU resets on wake-up
+}
+
+void dispatch_event(const Event& event) {
+  switch (event.type) {
+    case EVT_PIR_MOTION:     handle_pir_motion(); break;
+    case EVT_RFID_TAP:       handle_rfid_tap(event); break;
+    case EVT_MODEM_LINE:     handle_downlink(event.downlink); break;
+    case EVT_SENSOR_TICK:    handle_sensor_tick(); break;
+    case EVT_WINDOW_TIMEOUT: handle_window_timeout(); break;
+    case EVT_CLEANUP_UPLINK: handle_cleanup_uplink(); break;
+  }
+}
+
 // Global variable to store wake-up reason
 esp_sleep_wakeup_cause_t wakeup_reason;
 
+// Send the uplinks queued in RTC memory (WAKE_UPLINK_* bits, see wake_cycle.h)
+void send_queued_uplinks(byte uplinks) {
+  if (uplinks == 0 || !lorawan_joined) return;
+  if (uplinks & WAKE_UPLINK_RECOVERY) send_recovery_report();
+  if (uplinks & WAKE_UPLINK_INFERRED_CLEANUP) send_inferred_cleanup();
+  if (uplinks & WAKE_UPLINK_OTA_STATUS) send_ota_report();
+  if (uplinks & WAKE_UPLINK_DIAGNOSTICS) send_diagnostics();
+  if (uplinks & WAKE_UPLINK_JOURNAL) send_journal_upload();
+  if (uplinks & WAKE_UPLINK_MULTICAST_ACK) send_multicast_ack();
+}
+
 void setup() {
   Serial.begin(115200);
-  delay(500);
+  delay(SETUP_SERIAL_SETTLE_MS);
+  modem_mutex = xSemaphoreCreateRecursiveMutex();
   
   // Handle wake-up reason first (before any initialization)
   wakeup_reason = handle_wakeup_reason();
+  wake_profile_reset(wake_profile, wakeup_reason == ESP_SLEEP_WAKEUP_EXT0  ? POWER_WAKE_MOTION :
+                                   wakeup_reason == ESP_SLEEP_WAKEUP_TIMER ? POWER_WAKE_TIMER : POWER_WAKE_BOOT);
   
   // Record wake-up time for active window tracking
   wake_up_time = millis();
   
-  // Initialize persistent storage and load usage counter
-  Serial.println("Loading persistent storage...");
-  preferences.begin("trashcan", false);  // namespace "trashcan", read-write mode
-  usage_counter = preferences.getInt("usage_count", 0);  // default 0
-  Serial.print("📊 Usage counter loaded: ");
-  Serial.println(usage_counter);
+  // Restore counters and module state (RTC memory, NVS fallback)
+  Serial.println("Loading persistent state...");
+  restore_rtc_state();
+  sample_memory(MEM_POINT_BOOT);
+  
+  // Load runtime configuration (RTC cache on warm wakes, NVS otherwise)
+  load_device_config();
+  print_device_config();
   
   Serial.println("\n\n=== System Initialization ===");
 
   // Initialize LoRaWAN Serial (Serial1)
   Serial.println("Initializing LoRaWAN module...");
   LoRaSerial.begin(LORA_BAUD, SERIAL_8N1, LORA_RX_PIN, LORA_TX_PIN);
-  delay(3000); // Give LoRaWAN time to fully boot and initialize
+  delay(AT_MODULE_BOOT_MS); // Give LoRaWAN time to fully boot and initialize
   
   // Test LoRaWAN connectivity
   if (test_lorawan_module()) {
@@ -1132,36 +3018,39 @@ void setup() {
   }
 
   // Join LoRaWAN network in OTAA mode
-  lorawan_joined = join_lorawan_network(3, 60000); // 3 attempts, 60 seconds timeout each
+  lorawan_joined = join_lorawan_network(); // 3 attempts, 60 seconds timeout each
   
   if (!lorawan_joined) {
     Serial.println("⚠ WARNING: Failed to join LoRaWAN network!");
     Serial.println("⚠ Data transmission will be disabled until network join succeeds");
   }
 
-  // Initialize LittleFS (format on first mount if needed)
-  Serial.println("Mounting LittleFS...");
-  if (!LittleFS.begin(true)) {
-    Serial.println("Error mounting LittleFS!");
-    while (true); // halt
+  // Sync wall-clock time when missing or stale (keeps reports on aligned slots)
+  if (lorawan_joined && time_sync_needed(time_sync, local_clock_ms())) {
+    request_network_time();
   }
-  Serial.println("LittleFS mounted successfully");
 
-  // Open database
-  Serial.println("Opening database...");
-  try {
-    database.open("/littlefs/database.db");
-    Serial.println("Database opened successfully");
-  } catch (const std::exception &e) {
-    Serial.print("Error opening database: ");
-    Serial.println(e.what());
-    while (true); // halt
+  // Flush counters before mounting the filesystem when due (see wake_cycle.h)
+  if (wake_cycle_boot_flush_due(rtc_state, local_clock_ms())) {
+    flush_counters_to_nvs("before filesystem mount");
+  }
+  
+  // Mount LittleFS and open the whitelist, rebuilding it from the golden snapshot if damaged
+  configure_page_cache();
+  open_whitelist_database();
+  open_journal();
+  
+  // Numbered downlinks still waiting for a lost one are applied after a few wakes
+  if (downlink_sequence_wake(downlink_sequence, apply_downlink_operation)) {
+    Serial.println("⏭ Missing downlink given up - the ones after it were applied");
   }
+  send_queued_uplinks(wake_cycle_boot_uplinks(rtc_state));
 
   // Initialize SPI and RFID reader
   Serial.println("Initializing RFID reader...");
   SPI.begin(36, 37, 35); // SCK, MISO, MOSI
   rfid.PCD_Init();       // Initialize RFID reader
+  rfid_on_at = millis();
   Serial.println("RFID reader initialized successfully");
 
   // Initialize PIR motion sensor
@@ -1169,16 +3058,24 @@ void setup() {
   pinMode(PIR_PIN, INPUT);
   Serial.println("PIR sensor initialized (GPIO 4)");
 
-  // Initialize Ultrasound distance sensor
-  Serial.println("Initializing ultrasound sensor...");
-  pinMode(TRIG_PIN, OUTPUT);
-  pinMode(ECHO_PIN, INPUT);
-  digitalWrite(TRIG_PIN, LOW); // Ensure trigger starts LOW
-  Serial.println("Ultrasound sensor initialized (TRIG: GPIO 6, ECHO: GPIO 7)");
+  // Initialize Ultrasound distance sensors
+  Serial.println("Initializing ultrasound sensors...");
+  for (byte i = 0; i < SENSOR_CHANNELS; i++) {
+    pinMode(ULTRASOUND_CHANNELS[i].trig_pin, OUTPUT);
+    pinMode(ULTRASOUND_CHANNELS[i].echo_pin, INPUT);
+    digitalWrite(ULTRASOUND_CHANNELS[i].trig_pin, LOW); // Ensure trigger starts LOW
+    Serial.print("Ultrasound channel ");
+    Serial.print(i);
+    Serial.print(" initialized (TRIG: GPIO ");
+    Serial.print(ULTRASOUND_CHANNELS[i].trig_pin);
+    Serial.print(", ECHO: GPIO ");
+    Serial.print(ULTRASOUND_CHANNELS[i].echo_pin);
+    Serial.println(")");
+  }
 
   // Wait for PIR to stabilize (HC-SR501 needs ~60 seconds to calibrate)
   Serial.println("Waiting for PIR sensor to stabilize (5 seconds)...");
-  delay(5000);
+  delay(SETUP_PIR_SETTLE_MS);
   Serial.println("PIR sensor ready!");
 
   Serial.println("\n=== System Ready ===");
@@ -1188,24 +3085,36 @@ void setup() {
   Serial.println("- Ultrasound Distance Sensor Active");
   Serial.println("- Deep Sleep Mode Active");
   Serial.print("- Trashcan depth configured: ");
-  Serial.print(TRASHCAN_DEPTH_CM);
+  Serial.print(device_config.depth_mm / 10.0, 1);
   Serial.println(" cm");
+  confirm_running_firmware();
+  sample_memory(MEM_POINT_READY);
   
-  // Configure deep sleep wake-up sources
-  configure_deep_sleep();
+  byte action = wake_cycle_action(rtc_state, wake_profile.wake);
   
-  // If this was a timer wake-up, send periodic LoRaWAN data and go back to sleep
-  if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER) {
-    send_periodic_lorawan_data();
-    Serial.println("Timer wake-up complete. Going back to sleep...");
+  // Woken ahead of a multicast window, not for a report
+  if (action == WAKE_ACTION_MULTICAST) {
+    run_multicast_window();
+    Serial.println("Multicast window complete. Going back to sleep...");
     enter_deep_sleep();
-    // Note: This function never returns - CPU resets on wake-up
   }
   
-  // If this was a PIR wake-up, also send periodic data (but stay awake for RFID)
-  if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) {
+  // Timer wake-up: send periodic LoRaWAN data and go back to sleep
+  // PIR wake-up: also send periodic data, but stay awake for RFID
+  if (action == WAKE_ACTION_REPORT_WINDOW) {
     Serial.println("\n🚶 PIR wake-up: Sending status update before entering active window...");
+  }
+  if (action == WAKE_ACTION_REPORT || action == WAKE_ACTION_REPORT_WINDOW) {
     send_periodic_lorawan_data();
+    sample_memory(MEM_POINT_UPLINK);
+    send_queued_uplinks(wake_cycle_report_uplinks(rtc_state, device_config, action));
+  }
+  if (action == WAKE_ACTION_REPORT) {
+    Serial.println("Timer wake-up complete. Going back to sleep...");
+    enter_deep_sleep();
+    // Note: This function never returns - CPU resets on wake-up
+  }
+  if (action == WAKE_ACTION_REPORT_WINDOW) {
     Serial.println("Status update sent. Now entering active window for RFID scan...");
   }
   
@@ -1215,88 +3124,24 @@ void setup() {
   
   // Print active window info
   Serial.print("\n⏱️  Active window: ");
-  Serial.print(ACTIVE_WINDOW_MS / 1000);
+  Serial.print(device_config.active_window_ms / 1000);
   Serial.println(" seconds");
+  
+  // From here on the RFID reader, PIR, module and timers drive loop() through the event queue
+  if (!start_event_bus()) {
+    Serial.println("Error starting event bus - going back to sleep");
+    enter_deep_sleep();
+  }
   Serial.println("Waiting for RFID scan...\n");
 }
 
+// Handle one event at a time; while the queue is empty the main task blocks
+// and the CPU idles
 void loop() {
-  static unsigned long last_sensor_read = 0;
+  Event event;
+  if (xQueueReceive(event_queue, &event, portMAX_DELAY) != pdTRUE) return;
   
-  // Check for incoming LoRaWAN messages (non-blocking)
-  check_incoming_lorawan();
-  
-  // Calculate time remaining in active window
-  unsigned long elapsed = millis() - wake_up_time;
-  unsigned long remaining = (elapsed < ACTIVE_WINDOW_MS) ? (ACTIVE_WINDOW_MS - elapsed) : 0;
-  
-  // Print countdown every 2 seconds (along with sensor readings)
-  if (millis() - last_sensor_read > 2000) {
-    print_sensor_readings();
-    
-    // Show time remaining before deep sleep and current counter
-    Serial.print("📊 Usage counter: ");
-    Serial.println(usage_counter);
-    Serial.print("⏱️  Time to deep sleep: ");
-    Serial.print(remaining / 1000);
-    Serial.println(" seconds\n");
-    
-    last_sensor_read = millis();
-  }
-  
-  // Check if a new RFID card is present
-  if (rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial()) {
-    // Format the RFID UID as a string
-    String rfidTag = format_rfid(rfid.uid.uidByte, rfid.uid.size);
-    
-    Serial.println("\n--- Card Detected ---");
-    Serial.print("RFID Tag: ");
-    Serial.println(rfidTag);
-    
-    // Check access in database
-    bool access_granted = check_access(rfidTag);
-    
-    if (access_granted) {
-      // Worker authenticated - send notification and go to sleep immediately
-      worker_authenticated = true;
-      
-      // Small delay to avoid LoRaWAN busy error (in case status update was just sent)
-      Serial.println("⏳ Waiting 2 seconds before sending notification (avoid busy error)...");
-      delay(2000);
-      
-      // Send emptied notification with raw RFID bytes
-      send_emptied_notification(rfid.uid.uidByte, rfid.uid.size);
-      
-      Serial.println("✓ Worker authenticated. Going to sleep (no counter increment)...");
-      
-      // Halt the card
-      rfid.PICC_HaltA();
-      
-      // Go to sleep immediately - worker emptied the trash
-      enter_deep_sleep();
-      // Note: This function never returns - CPU resets on wake-up
-    } else {
-      // Unknown RFID - just print message and continue waiting
-      Serial.println("Unknown RFID detected. Continuing to wait for valid worker...");
-      Serial.println("---------------------\n");
-      
-      // Halt the card
-      rfid.PICC_HaltA();
-      
-      // Small delay to avoid multiple reads
-      delay(1000);
-    }
-  }
-  
-  // Check if active window has expired - enter deep sleep
-  if (elapsed >= ACTIVE_WINDOW_MS) {
-    // No worker was authenticated during this wake cycle
-    if (!worker_authenticated) {
-      Serial.println("\n⏰ Active window expired - no worker authenticated");
-      increment_counter();
-    }
-    
-    enter_deep_sleep();
-    // Note: This function never returns - CPU resets on wake-up
-  }
+  unsigned long started = millis();
+  dispatch_event(event);
+  event_bus_record(event_stats, event, started, millis());
 }
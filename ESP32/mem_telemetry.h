@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================
+// Memory Telemetry
+// ============================================
+//
+// Heap, PSRAM, task stack and SQLite memory figures sampled at fixed points
+// of each wake cycle. The latest sample of every point and the worst value
+// of every field since the last diagnostics uplink live in RTC memory, so a
+// device that runs short of memory in the field reports the figures needed
+// to size the database cache and the buffers. main.cpp reads the hardware
+// counters; the diagnostics frame is built in wake_cycle.h.
+
+// Sample points of a wake cycle
+enum MemPoint {
+  MEM_POINT_BOOT = 0,   // Start of setup(), before the modem and the filesystem
+  MEM_POINT_READY,      // Database open, peripherals initialized
+  MEM_POINT_UPLINK,     // After the report uplink and its downlink exchange
+  MEM_POINT_SLEEP,      // Right before deep sleep
+  MEM_POINT_COUNT
+};
+
+// Tasks whose stack high-water mark is tracked
+enum MemTask {
+  MEM_TASK_MAIN = 0,    // Arduino loop task (setup, loop, event handlers)
+  MEM_TASK_RFID,        // RFID reader task (active window only)
+  MEM_TASK_MODEM,       // Modem reader task (active window only)
+  MEM_TASK_COUNT
+};
+
+struct MemSample {
+  uint32_t heap_free;           // Internal heap free now
+  uint32_t heap_min_free;       // Lowest internal heap free since boot
+  uint32_t heap_largest_block;  // Largest allocatable internal block
+  uint32_t psram_free;          // 0 without PSRAM
+  uint32_t psram_min_free;
+  uint32_t sqlite_memory;       // Bytes allocated by SQLite
+  uint32_t sqlite_cache;        // Bytes of page cache allocated by SQLite
+  uint16_t stack_free[MEM_TASK_COUNT];  // Unused stack (bytes), 0 = task not running
+};
+
+struct MemTelemetryState {
+  MemSample last[MEM_POINT_COUNT];  // Latest sample of each point (last wake that reached it)
+  MemSample worst;                  // Lowest free / highest used since the last diagnostics uplink
+  uint16_t  samples;                // Samples folded into worst
+};
+
+inline void mem_telemetry_reset_worst(MemTelemetryState& state) {
+  memset(&state.worst, 0, sizeof(state.worst));
+  state.samples = 0;
+}
+
+inline void mem_telemetry_init(MemTelemetryState& state) {
+  memset(&state, 0, sizeof(state));
+}
+
+inline uint32_t mem_lower(uint32_t worst, uint32_t value, bool first) {
+  return first || value < worst ? value : worst;
+}
+
+// Record a sample taken at point
+inline void mem_telemetry_record(MemTelemetryState& state, uint8_t point, const MemSample& sample) {
+  if (point >= MEM_POINT_COUNT) return;
+  state.last[point] = sample;
+
+  MemSample& w = state.worst;
+  bool first = state.samples == 0;
+  w.heap_free = mem_lower(w.heap_free, sample.heap_free, first);
+  w.heap_min_free = mem_lower(w.heap_min_free, sample.heap_min_free, first);
+  w.heap_largest_block = mem_lower(w.heap_largest_block, sample.heap_largest_block, first);
+  w.psram_free = mem_lower(w.psram_free, sample.psram_free, first);
+  w.psram_min_free = mem_lower(w.psram_min_free, sample.psram_min_free, first);
+  if (sample.sqlite_memory > w.sqlite_memory) w.sqlite_memory = sample.sqlite_memory;
+  if (sample.sqlite_cache > w.sqlite_cache) w.sqlite_cache = sample.sqlite_cache;
+  for (int i = 0; i < MEM_TASK_COUNT; i++) {
+    uint16_t free_bytes = sample.stack_free[i];
+    if (free_bytes == 0) continue;  // Task not running at this point
+    if (w.stack_free[i] == 0 || free_bytes < w.stack_free[i]) w.stack_free[i] = free_bytes;
+  }
+  if (state.samples < 0xFFFF) state.samples++;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+#include "time_sync.h"
+
+// ============================================
+// Multicast Whitelist Distribution
+// ============================================
+//
+// The whole fleet shares one LoRaWAN multicast group: a session (address and
+// keys) the network server transmits to as if it were one class C device.
+// A unicast MULTICAST_SETUP downlink gives a bin the session and a schedule,
+// once. From then on the bin opens a class C window every period_min minutes
+// of wall-clock time, offset_min minutes into the period, for window_s
+// seconds; every bin of the fleet listens at the same moment, and the server
+// sends the whitelist changes collected since the last window once for all
+// of them.
+//
+// A batch is split into frames on MC_WHITELIST_PORT:
+//   [BATCH_ID (2)] [FRAME_INDEX (1)] [FRAME_COUNT (1)] { entry } ...
+// with the entries encoded like the unicast downlinks:
+//   INSERT [0x01] [RFID_UID (4)] [ROLE (1)]    DELETE [0x02] [RFID_UID (4)]
+// Entries are idempotent, so a frame heard twice, or an entry that also came
+// by unicast, changes nothing. After the window a bin that heard a
+// batch answers with the bitmap of the frames it got (at its next report
+// slot, so the fleet's answers do not collide); the server sends the entries
+// of the missing frames, and the whole batch to bins that did not answer, as
+// ordinary class A unicast downlinks.
+//
+// Windows need a synced clock (time_sync.h); an unsynced bin keeps getting
+// whitelist changes through the stragglers path.
+
+#define MC_WHITELIST_PORT      10
+#define MC_GROUP_MAGIC         0x4D434753UL // "MCGS"
+#define MC_KEY_LENGTH          16
+
+// MULTICAST_SETUP downlink (port 1), big-endian:
+//   [OP (1)] [GROUP_ADDR (4)] [NWK_SKEY (16)] [APP_SKEY (16)] [FREQUENCY (3, 100 Hz units)]
+//   [DATA_RATE (1)] [PERIOD_MIN (2)] [OFFSET_MIN (2)] [WINDOW_S (1)] = 46 bytes
+// PERIOD_MIN 0 leaves the group
+#define MC_SETUP_LENGTH        46
+
+#define MC_PERIOD_MIN_MIN      15
+#define MC_PERIOD_MAX_MIN      10080   // One week
+#define MC_WINDOW_MIN_S        10
+#define MC_WAKE_LEAD_MS        60000   // Wake this long before a window (boot, join, module setup)
+
+#define MC_BATCH_HEADER_LENGTH 4
+#define MC_FRAME_MAX_LENGTH    51      // Largest batch frame the server sends (fits every data rate)
+#define MC_BATCH_MAX_FRAMES    64
+#define MC_BITMAP_BYTES        (MC_BATCH_MAX_FRAMES / 8)
+#define MC_ENTRY_INSERT        0x01
+#define MC_ENTRY_DELETE        0x02
+#define MC_INSERT_LENGTH       6
+#define MC_DELETE_LENGTH       5
+
+// Result of one batch frame
+#define MC_FRAME_NEW           0
+#define MC_FRAME_DUPLICATE     1
+#define MC_FRAME_INVALID       2
+
+// Multicast session and window schedule (persisted in NVS, cached in RTC memory)
+struct MulticastGroup {
+  uint32_t magic;
+  uint32_t group_addr;          // DevAddr of the multicast session
+  uint8_t  nwk_skey[MC_KEY_LENGTH];
+  uint8_t  app_skey[MC_KEY_LENGTH];
+  uint32_t frequency_hz;        // Class C downlink frequency
+  uint16_t period_min;          // Window every period_min minutes of Unix time...
+  uint16_t offset_min;          // ...offset_min minutes into the period
+  uint8_t  window_s;            // Class C listening time
+  uint8_t  data_rate;           // Class C downlink data rate
+  uint16_t reserved;
+  uint32_t crc;                 // CRC-32 of everything above
+};
+
+// Reception of the current batch (kept in RTC memory)
+struct MulticastBatchState {
+  uint16_t batch_id;
+  uint8_t  frame_count;         // 0 until a frame of the batch was heard
+  uint8_t  frames_heard;
+  uint8_t  ack_pending;         // Window closed with a batch heard; send the bitmap
+  uint8_t  window_wake;         // The next timer wake is for a window, not a report
+  uint8_t  bitmap[MC_BITMAP_BYTES];  // Frames heard, bit i = frame i (LSB first)
+};
+
+inline uint32_t multicast_group_crc(const MulticastGroup& group) {
+  return crc32_buffer(&group, offsetof(MulticastGroup, crc));
+}
+
+// True when the bin belongs to a group (a valid, non-empty setup)
+inline bool multicast_group_active(const MulticastGroup& group) {
+  return group.magic == MC_GROUP_MAGIC && group.crc == multicast_group_crc(group) && group.period_min != 0;
+}
+
+inline uint32_t multicast_read_u32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+inline uint16_t multicast_read_u16(const uint8_t* p) {
+  return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+// Parse and range-check a MULTICAST_SETUP downlink (data starts at the
+// operation byte); returns false and leaves group untouched if invalid
+inline bool multicast_group_parse_setup(const uint8_t* data, size_t length, MulticastGroup& group) {
+  if (length != MC_SETUP_LENGTH) return false;
+  MulticastGroup parsed;
+  memset(&parsed, 0, sizeof(parsed));  // Padding must be zero for a stable CRC
+  parsed.magic = MC_GROUP_MAGIC;
+  parsed.group_addr = multicast_read_u32(data + 1);
+  memcpy(parsed.nwk_skey, data + 5, MC_KEY_LENGTH);
+  memcpy(parsed.app_skey, data + 21, MC_KEY_LENGTH);
+  parsed.frequency_hz = (((uint32_t)data[37] << 16) | ((uint32_t)data[38] << 8) | data[39]) * 100;
+  parsed.data_rate = data[40];
+  parsed.period_min = multicast_read_u16(data + 41);
+  parsed.offset_min = multicast_read_u16(data + 43);
+  parsed.window_s = data[45];
+
+  if (parsed.period_min != 0) {
+    if (parsed.period_min < MC_PERIOD_MIN_MIN || parsed.period_min > MC_PERIOD_MAX_MIN) return false;
+    if (parsed.offset_min >= parsed.period_min || parsed.window_s < MC_WINDOW_MIN_S) return false;
+    if (parsed.frequency_hz == 0 || parsed.data_rate > 15) return false;
+  }
+  parsed.crc = multicast_group_crc(parsed);
+  group = parsed;
+  return true;
+}
+
+// Wall-clock start of the window at or after unix_ms
+inline int64_t multicast_next_window_unix_ms(const MulticastGroup& group, int64_t unix_ms) {
+  int64_t period_ms = (int64_t)group.period_min * 60000;
+  int64_t offset_ms = (int64_t)group.offset_min * 60000;
+  int64_t start_ms = ((unix_ms - offset_ms) / period_ms) * period_ms + offset_ms;
+  return start_ms < unix_ms ? start_ms + period_ms : start_ms;
+}
+
+// Local-clock milliseconds from local_ms to the start of the window that is
+// open or next to open (negative inside a window), or INT64_MIN without a
+// group or a synced clock
+inline int64_t multicast_ms_to_window(const MulticastGroup& group, const TimeSyncState& time_sync,
+                                      int64_t local_ms) {
+  int64_t now_ms = time_sync_now_unix_ms(time_sync, local_ms);
+  if (!multicast_group_active(group) || now_ms < 0) return INT64_MIN;
+
+  int64_t window_ms = (int64_t)group.window_s * 1000;
+  int64_t start_ms = multicast_next_window_unix_ms(group, now_ms - window_ms);
+  int64_t true_delta_ms = start_ms - now_ms;
+  return true_delta_ms + (true_delta_ms * time_sync.drift_ppm) / 1000000LL;
+}
+
+// Local-clock sleep until MC_WAKE_LEAD_MS before the next window, or 0
+// without a group or a synced clock. Windows closer than that are skipped.
+inline uint64_t multicast_sleep_ms_to_window(const MulticastGroup& group, const TimeSyncState& time_sync,
+                                             int64_t local_ms) {
+  int64_t now_ms = time_sync_now_unix_ms(time_sync, local_ms);
+  if (!multicast_group_active(group) || now_ms < 0) return 0;
+
+  int64_t wake_ms = multicast_next_window_unix_ms(group, now_ms) - MC_WAKE_LEAD_MS;
+  if (wake_ms - now_ms < TIME_SYNC_MIN_SLEEP_MS) {
+    wake_ms = multicast_next_window_unix_ms(group, now_ms + MC_WAKE_LEAD_MS + TIME_SYNC_MIN_SLEEP_MS) -
+              MC_WAKE_LEAD_MS;
+  }
+  int64_t true_delta_ms = wake_ms - now_ms;
+  int64_t local_delta_ms = true_delta_ms + (true_delta_ms * time_sync.drift_ppm) / 1000000LL;
+  return local_delta_ms > 0 ? (uint64_t)local_delta_ms : 0;
+}
+
+inline bool multicast_frame_heard(const MulticastBatchState& state, uint8_t index) {
+  return (state.bitmap[index / 8] >> (index % 8)) & 1;
+}
+
+inline bool multicast_batch_complete(const MulticastBatchState& state) {
+  return state.frame_count > 0 && state.frames_heard == state.frame_count;
+}
+
+// Handle one batch frame: fn(operation, uid, role) is called for every entry
+// of a frame not heard before (role is 0 for DELETE). The whole frame is
+// checked before any entry is applied. Returns MC_FRAME_*
+template <typename Fn>
+uint8_t multicast_batch_receive(MulticastBatchState& state, const uint8_t* data, size_t length, Fn fn) {
+  if (length < MC_BATCH_HEADER_LENGTH) return MC_FRAME_INVALID;
+  uint16_t batch_id = multicast_read_u16(data);
+  uint8_t index = data[2];
+  uint8_t count = data[3];
+  if (count == 0 || count > MC_BATCH_MAX_FRAMES || index >= count) return MC_FRAME_INVALID;
+
+  for (size_t p = MC_BATCH_HEADER_LENGTH; p < length;) {
+    size_t entry = data[p] == MC_ENTRY_INSERT ? MC_INSERT_LENGTH : data[p] == MC_ENTRY_DELETE ? MC_DELETE_LENGTH : 0;
+    if (entry == 0 || p + entry > length) return MC_FRAME_INVALID;
+    p += entry;
+  }
+
+  // A new batch replaces the previous one, heard or not
+  if (state.frame_count == 0 || batch_id != state.batch_id || count != state.frame_count) {
+    state.batch_id = batch_id;
+    state.frame_count = count;
+    state.frames_heard = 0;
+    memset(state.bitmap, 0, sizeof(state.bitmap));
+  }
+  if (multicast_frame_heard(state, index)) return MC_FRAME_DUPLICATE;
+
+  for (size_t p = MC_BATCH_HEADER_LENGTH; p < length;) {
+    bool insert = data[p] == MC_ENTRY_INSERT;
+    fn(data[p], data + p + 1, insert ? data[p + 5] : (uint8_t)0);
+    p += insert ? MC_INSERT_LENGTH : MC_DELETE_LENGTH;
+  }
+  state.bitmap[index / 8] |= (uint8_t)(1 << (index % 8));
+  state.frames_heard++;
+  return MC_FRAME_NEW;
+}
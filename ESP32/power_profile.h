@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// ============================================
+// Wake Power Profile
+// ============================================
+//
+// How long one wake cycle kept each power-hungry part on: the CPU (boot to
+// deep sleep), the LoRaWAN module transmitting and listening, the RC522
+// field and the ultrasound readings. main.cpp fills one per wake and prints
+// it as a single line before deep sleep:
+//   POWER wake=motion awake_ms=45210 tx_ms=72 rx_ms=9120 rfid_ms=37800 ultrasound=17 uplinks=1 taps=0
+// The host-side energy model (tools/power_model) reads these lines from
+// serial logs, and the fleet simulator fills the same profile for its
+// virtual bins, so measured and simulated wakes are priced the same way.
+
+#define POWER_LINE_PREFIX      "POWER "
+#define POWER_LINE_MAX_LENGTH  128
+
+#define POWER_WAKE_BOOT        0   // Power-on or reset
+#define POWER_WAKE_TIMER       1   // Report slot or multicast window
+#define POWER_WAKE_MOTION      2   // PIR
+#define POWER_WAKE_KINDS       3
+
+// Fixed delays of setup() (main.cpp), shared with the energy model
+#define SETUP_SERIAL_SETTLE_MS 500    // After Serial.begin()
+#define SETUP_PIR_SETTLE_MS    5000   // PIR output settling, with the RFID reader already on
+
+struct WakeProfile {
+  uint8_t  wake;                 // POWER_WAKE_*
+  uint8_t  taps;                 // Authorized card taps
+  uint16_t uplinks;              // Uplinks the module accepted
+  uint16_t ultrasound_readings;
+  uint32_t awake_ms;             // Boot to deep sleep
+  uint32_t tx_ms;                // Module transmitting (estimated airtime)
+  uint32_t rx_ms;                // Module listening: join, receive windows, class C windows
+  uint32_t rfid_ms;              // RC522 field on
+};
+
+inline const char* wake_profile_kind_name(uint8_t wake) {
+  switch (wake) {
+    case POWER_WAKE_BOOT:   return "boot";
+    case POWER_WAKE_TIMER:  return "timer";
+    case POWER_WAKE_MOTION: return "motion";
+  }
+  return "?";
+}
+
+inline void wake_profile_reset(WakeProfile& profile, uint8_t wake) {
+  memset(&profile, 0, sizeof(profile));
+  profile.wake = wake;
+}
+
+// Uplink accepted: airtime on air, then listening until the receive windows close
+inline void wake_profile_uplink(WakeProfile& profile, uint32_t airtime_ms, uint32_t listen_ms) {
+  profile.uplinks++;
+  profile.tx_ms += airtime_ms;
+  profile.rx_ms += listen_ms;
+}
+
+// Format the profile as a POWER line (no line ending); returns its length
+inline size_t wake_profile_format(const WakeProfile& profile, char* out, size_t size) {
+  int length = snprintf(out, size,
+                        POWER_LINE_PREFIX "wake=%s awake_ms=%lu tx_ms=%lu rx_ms=%lu rfid_ms=%lu "
+                        "ultrasound=%u uplinks=%u taps=%u",
+                        wake_profile_kind_name(profile.wake), (unsigned long)profile.awake_ms,
+                        (unsigned long)profile.tx_ms, (unsigned long)profile.rx_ms,
+                        (unsigned long)profile.rfid_ms, (unsigned)profile.ultrasound_readings,
+                        (unsigned)profile.uplinks, (unsigned)profile.taps);
+  if (length < 0) return 0;
+  return (size_t)length < size ? (size_t)length : size - 1;
+}
+
+// Parse a POWER line anywhere in text (a serial log line may carry a
+// timestamp before it); false if there is none or it is malformed
+inline bool wake_profile_parse(const char* text, WakeProfile& profile) {
+  const char* line = strstr(text, POWER_LINE_PREFIX "wake=");
+  if (!line) return false;
+
+  char kind[8];
+  unsigned long awake_ms, tx_ms, rx_ms, rfid_ms;
+  unsigned ultrasound, uplinks, taps;
+  if (sscanf(line, POWER_LINE_PREFIX "wake=%7s awake_ms=%lu tx_ms=%lu rx_ms=%lu rfid_ms=%lu "
+                   "ultrasound=%u uplinks=%u taps=%u",
+             kind, &awake_ms, &tx_ms, &rx_ms, &rfid_ms, &ultrasound, &uplinks, &taps) != 8) {
+    return false;
+  }
+
+  uint8_t wake = POWER_WAKE_KINDS;
+  for (uint8_t i = 0; i < POWER_WAKE_KINDS; i++) {
+    if (strcmp(kind, wake_profile_kind_name(i)) == 0) wake = i;
+  }
+  if (wake == POWER_WAKE_KINDS) return false;
+
+  wake_profile_reset(profile, wake);
+  profile.awake_ms = (uint32_t)awake_ms;
+  profile.tx_ms = (uint32_t)tx_ms;
+  profile.rx_ms = (uint32_t)rx_ms;
+  profile.rfid_ms = (uint32_t)rfid_ms;
+  profile.ultrasound_readings = (uint16_t)(ultrasound > 0xFFFF ? 0xFFFF : ultrasound);
+  profile.uplinks = (uint16_t)(uplinks > 0xFFFF ? 0xFFFF : uplinks);
+  profile.taps = (uint8_t)(taps > 0xFF ? 0xFF : taps);
+  return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+#include "time_sync.h"
+#include "fill_forecast.h"
+#include "airtime.h"
+#include "device_config.h"
+#include "mem_telemetry.h"
+#include "golden_whitelist.h"
+#include "frag_session.h"
+#include "delta_patch.h"
+#include "event_journal.h"
+#include "usage_histogram.h"
+#include "cleanup_detect.h"
+#include "multicast_session.h"
+#include "downlink_sequence.h"
+
+// ============================================
+// RTC Memory State
+// ============================================
+//
+// All state that must survive deep sleep lives in one RTC memory block
+// protected by a CRC-32. Counters are updated in RTC memory only and
+// flushed to NVS in batches (every few wakes, after a time interval, or
+// before operations that may reset the chip). The CRC is sealed right
+// before deep sleep, so a reset in the middle of a wake cycle (brownout,
+// watchdog, crash) leaves a mismatching CRC and the next boot falls back
+// to the last NVS flush.
+
+#define RTC_STATE_MAGIC           0x52544353UL // "RTCS"
+#define RTC_STATE_VERSION         15
+
+#define NVS_FLUSH_EVERY_WAKES     20                    // Flush after this many wakes...
+#define NVS_FLUSH_INTERVAL_MS     (6LL * 3600 * 1000)   // ...or this much time, whichever comes first
+
+struct RtcState {
+  uint32_t magic;
+  uint16_t version;
+
+  // Counters (mirrored to NVS in batches)
+  int32_t  usage_counter;          // Motion wakes without a cleanup since the last report
+  int32_t  flushed_usage_counter;  // Value last written to NVS
+
+  // Wake bookkeeping
+  uint32_t wake_count;             // Wakes since the RTC state was (re)built
+  uint32_t wakes_since_flush;
+  int64_t  last_flush_ms;          // Local clock of the last NVS flush
+
+  // Module state
+  TimeSyncState      time_sync;
+  FillForecastState  forecast[SENSOR_CHANNELS_MAX];  // One per ultrasound channel
+  AirtimeBudgetState airtime;
+  DeviceConfig       config;       // Cache of the NVS configuration blob
+  MemTelemetryState  memory;       // Memory samples (diagnostics uplink)
+  RecoveryReport     recovery;     // Database recovery not yet reported upstream
+  FragSessionState   frag;         // Firmware patch download (fragments are in LittleFS)
+  OtaReport          ota;          // Firmware update result not yet reported upstream
+  JournalState       journal;      // Event journal index (records are in LittleFS)
+  JournalUpload      journal_upload;
+  UsageHistogramState usage_histogram;  // Motion wakes per bin since the last report
+  CleanupDetectState cleanup_detect[SENSOR_CHANNELS_MAX];  // Filtered fill level for inferred cleanups
+  InferredCleanupReport inferred_cleanup[SENSOR_CHANNELS_MAX];  // Inferred cleanups not yet reported upstream
+  MulticastGroup     multicast_group;   // Cache of the NVS multicast setup
+  MulticastBatchState multicast;        // Whitelist batch heard in the multicast windows
+  DownlinkSequenceState downlink_sequence;  // Last numbered downlink applied, frames ahead of a gap
+
+  uint32_t crc;                    // CRC-32 of everything above
+};
+
+inline uint32_t rtc_state_crc(const RtcState& state) {
+  return crc32_buffer(&state, offsetof(RtcState, crc));
+}
+
+inline bool rtc_state_valid(const RtcState& state) {
+  return state.magic == RTC_STATE_MAGIC &&
+         state.version == RTC_STATE_VERSION &&
+         state.crc == rtc_state_crc(state);
+}
+
+// Seal the block before deep sleep
+inline void rtc_state_seal(RtcState& state) {
+  state.crc = rtc_state_crc(state);
+}
+
+// Rebuild the block from scratch (power-on or CRC failure)
+// The caller restores the NVS-backed fields (counters, config) afterwards
+inline void rtc_state_init(RtcState& state, int64_t local_ms) {
+  memset(&state, 0, sizeof(state));  // Padding must be zero for a stable CRC
+  state.magic = RTC_STATE_MAGIC;
+  state.version = RTC_STATE_VERSION;
+  state.last_flush_ms = local_ms;
+  time_sync_init(state.time_sync);
+  for (int i = 0; i < SENSOR_CHANNELS_MAX; i++) {
+    fill_forecast_reset(state.forecast[i]);
+    cleanup_detect_reset(state.cleanup_detect[i]);
+  }
+  airtime_budget_init(state.airtime, local_ms);
+  mem_telemetry_init(state.memory);
+  usage_histogram_reset(state.usage_histogram, local_ms);
+}
+
+// True when RTC counters differ from NVS
+inline bool rtc_state_dirty(const RtcState& state) {
+  return state.usage_counter != state.flushed_usage_counter;
+}
+
+// True when a periodic NVS flush is due
+inline bool rtc_state_flush_due(const RtcState& state, int64_t local_ms) {
+  if (!rtc_state_dirty(state)) return false;
+  return state.wakes_since_flush >= NVS_FLUSH_EVERY_WAKES ||
+         (local_ms - state.last_flush_ms) >= NVS_FLUSH_INTERVAL_MS;
+}
+
+// Record a completed NVS flush
+inline void rtc_state_mark_flushed(RtcState& state, int64_t local_ms) {
+  state.flushed_usage_counter = state.usage_counter;
+  state.wakes_since_flush = 0;
+  state.last_flush_ms = local_ms;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================
+// Heap-Free Text Helpers
+// ============================================
+//
+// Fixed-capacity replacements for Arduino String on the wake-cycle paths
+// (RX line parsing, hex payloads, RFID tags). Nothing here allocates: text
+// lives in caller-owned buffers and is read through TextView, a non-owning
+// pointer + length in the spirit of std::string_view. Hex conversion is
+// table-driven in both directions.
+
+#define RFID_TAG_TEXT_SIZE   30   // Up to 10-byte UIDs as "21 47 C2 4C ..." + NUL
+#define TEXT_LINE_MAX_LENGTH 200  // Longer UART lines are dropped
+
+// Non-owning view of characters (not necessarily NUL-terminated)
+struct TextView {
+  const char* data;
+  size_t      length;
+};
+
+inline TextView text_view(const char* data, size_t length) {
+  TextView view = {data, length};
+  return view;
+}
+
+inline TextView text_view(const char* cstr) {
+  return text_view(cstr, strlen(cstr));
+}
+
+inline bool text_is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline TextView text_trim(TextView view) {
+  while (view.length > 0 && text_is_space(view.data[0])) {
+    view.data++;
+    view.length--;
+  }
+  while (view.length > 0 && text_is_space(view.data[view.length - 1])) {
+    view.length--;
+  }
+  return view;
+}
+
+// First unsigned decimal number in the view, or -1 if there is none
+inline long text_first_number(TextView view) {
+  long value = -1;
+  for (size_t i = 0; i < view.length; i++) {
+    char c = view.data[i];
+    if (c >= '0' && c <= '9') {
+      value = (value < 0 ? 0 : value * 10) + (c - '0');
+    } else if (value >= 0) {
+      break;
+    }
+  }
+  return value;
+}
+
+// ============================================
+// Hex
+// ============================================
+
+// Value of a hex digit, or -1
+inline int hex_value(char c) {
+  static const int8_t table[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+  };
+  return table[(uint8_t)c];
+}
+
+// Uppercase hex digit for a nibble
+inline char hex_digit(uint8_t nibble) {
+  static const char digits[] = "0123456789ABCDEF";
+  return digits[nibble & 0x0F];
+}
+
+// Uppercase hex of data into out (NUL-terminated)
+// Returns the number of characters written, 0 if out is too small
+inline size_t hex_encode(char* out, size_t size, const uint8_t* data, size_t length) {
+  if (length * 2 + 1 > size) return 0;
+  char* p = out;
+  for (size_t i = 0; i < length; i++) {
+    *p++ = hex_digit(data[i] >> 4);
+    *p++ = hex_digit(data[i]);
+  }
+  *p = '\0';
+  return length * 2;
+}
+
+// Decode hex digit pairs from the start of a view, stopping at the first
+// non-hex pair or after max bytes; consumed (optional) receives the number
+// of characters used. Returns the number of bytes decoded.
+inline size_t hex_decode(TextView hex, uint8_t* out, size_t max, size_t* consumed = NULL) {
+  size_t count = 0;
+  size_t i = 0;
+  while (i + 1 < hex.length) {
+    int high = hex_value(hex.data[i]);
+    int low = hex_value(hex.data[i + 1]);
+    if (high < 0 || low < 0) break;
+    if (count < max) out[count++] = (uint8_t)((high << 4) | low);
+    i += 2;
+  }
+  if (consumed) *consumed = i;
+  return count;
+}
+
+// RFID UID as spaced uppercase hex, e.g. "21 47 C2 4C" (format_rfid)
+// out needs 3 * size characters; returns the text length, 0 if out is too small
+inline size_t text_format_rfid(const uint8_t* uid, size_t size, char* out, size_t out_size) {
+  if (size == 0 || size * 3 > out_size) {
+    if (out_size > 0) out[0] = '\0';
+    return 0;
+  }
+  char* p = out;
+  for (size_t i = 0; i < size; i++) {
+    if (i > 0) *p++ = ' ';
+    *p++ = hex_digit(uid[i] >> 4);
+    *p++ = hex_digit(uid[i]);
+  }
+  *p = '\0';
+  return (size_t)(p - out);
+}
+
+// ============================================
+// UART Line Accumulator
+// ============================================
+
+// One line of module output, collected character by character
+struct TextLine {
+  char   text[TEXT_LINE_MAX_LENGTH + 1];
+  size_t length;
+  bool   overflow;  // Line was too long; dropped at its end
+};
+
+inline void text_line_clear(TextLine& line) {
+  line.length = 0;
+  line.overflow = false;
+  line.text[0] = '\0';
+}
+
+// Add one character; returns true when it completes a non-empty line, which
+// is then in line.text (trimmed, NUL-terminated) until the next push
+inline bool text_line_push(TextLine& line, char c) {
+  if (c == '\n' || c == '\r') {
+    bool complete = !line.overflow && line.length > 0;
+    if (complete) {
+      TextView trimmed = text_trim(text_view(line.text, line.length));
+      memmove(line.text, trimmed.data, trimmed.length);
+      line.text[trimmed.length] = '\0';
+      line.length = 0;
+      complete = trimmed.length > 0;
+    } else {
+      text_line_clear(line);
+    }
+    line.overflow = false;
+    return complete;
+  }
+
+  if (line.length >= TEXT_LINE_MAX_LENGTH) {
+    line.overflow = true;
+    return false;
+  }
+  line.text[line.length++] = c;
+  line.text[line.length] = '\0';
+  return false;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ============================================
+// Network Time Sync and Aligned Scheduling
+// ============================================
+//
+// Time comes from the LoRaWAN Application Layer Clock Synchronization
+// package (TS003): the device sends AppTimeReq on port 202 with its current
+// GPS time and the server answers with AppTimeAns carrying a signed
+// correction in seconds. The device never calls settimeofday(); the RTC
+// based system clock is used as a free-running "local" clock (it survives
+// deep sleep) and wall-clock time is derived from the last sync point plus
+// a drift estimate measured between consecutive syncs.
+
+#define CLOCK_SYNC_PORT           202
+#define CLOCK_SYNC_CID_APP_TIME   0x01
+#define CLOCK_SYNC_REQ_LENGTH     6      // [CID (1)] [DEVICE_TIME (4)] [PARAM (1)]
+#define CLOCK_SYNC_ANS_LENGTH     6      // [CID (1)] [TIME_CORRECTION (4)] [PARAM (1)]
+
+#define GPS_UNIX_OFFSET_S         315964800LL  // 1980-01-06 00:00:00 UTC
+#define GPS_LEAP_SECONDS          18LL
+
+#define TIME_SYNC_MAGIC           0x54494D45UL // "TIME"
+#define TIME_SYNC_RESYNC_MS       (24LL * 3600 * 1000)  // Re-sync once a day
+#define TIME_SYNC_MIN_DRIFT_BASE_MS (3600LL * 1000)     // Need >= 1 hour between syncs to estimate drift
+#define TIME_SYNC_MAX_DRIFT_PPM   50000                 // RC slow clock is specified within +-5 %
+#define TIME_SYNC_MIN_SLEEP_MS    10000                 // Skip slots closer than this
+
+// Sync state - kept in RTC memory so it survives deep sleep
+struct TimeSyncState {
+  uint32_t magic;
+  uint8_t  valid;          // 1 once a network time answer was applied
+  uint8_t  token;          // TS003 token of the last request (4 bits)
+  int32_t  drift_ppm;      // Local clock error: positive = local clock runs fast
+  int64_t  sync_local_ms;  // Local clock at the last sync
+  int64_t  sync_unix_ms;   // Wall-clock time at the last sync
+};
+
+// Reset sync state (power-on or corrupted RTC memory)
+inline void time_sync_init(TimeSyncState& state) {
+  state.magic = TIME_SYNC_MAGIC;
+  state.valid = 0;
+  state.token = 0;
+  state.drift_ppm = 0;
+  state.sync_local_ms = 0;
+  state.sync_unix_ms = 0;
+}
+
+// Wall-clock time in Unix milliseconds, or -1 if the clock was never synced
+inline int64_t time_sync_now_unix_ms(const TimeSyncState& state, int64_t local_ms) {
+  if (!state.valid) return -1;
+  int64_t elapsed_local = local_ms - state.sync_local_ms;
+  // Remove the estimated drift from the locally measured elapsed time
+  int64_t elapsed_true = elapsed_local - (elapsed_local * state.drift_ppm) / 1000000LL;
+  return state.sync_unix_ms + elapsed_true;
+}
+
+// Device time as reported in AppTimeReq: wall-clock when synced, otherwise
+// the raw local clock (the server correction then carries the full offset)
+inline int64_t time_sync_device_unix_ms(const TimeSyncState& state, int64_t local_ms) {
+  return state.valid ? time_sync_now_unix_ms(state, local_ms) : local_ms;
+}
+
+// True when the clock was never synced or the last sync is too old
+inline bool time_sync_needed(const TimeSyncState& state, int64_t local_ms) {
+  return !state.valid || (local_ms - state.sync_local_ms) >= TIME_SYNC_RESYNC_MS;
+}
+
+// Apply a known wall-clock time at the given local time, updating the drift estimate
+inline void time_sync_apply(TimeSyncState& state, int64_t local_ms, int64_t true_unix_ms) {
+  if (state.valid) {
+    int64_t elapsed_local = local_ms - state.sync_local_ms;
+    int64_t elapsed_true = true_unix_ms - state.sync_unix_ms;
+
+    if (elapsed_true >= TIME_SYNC_MIN_DRIFT_BASE_MS) {
+      int64_t measured_ppm = ((elapsed_local - elapsed_true) * 1000000LL) / elapsed_true;
+      if (measured_ppm > TIME_SYNC_MAX_DRIFT_PPM) measured_ppm = TIME_SYNC_MAX_DRIFT_PPM;
+      if (measured_ppm < -TIME_SYNC_MAX_DRIFT_PPM) measured_ppm = -TIME_SYNC_MAX_DRIFT_PPM;
+
+      // Exponential average: the RC oscillator drifts with temperature
+      state.drift_ppm = (int32_t)((state.drift_ppm + measured_ppm) / 2);
+    }
+  }
+
+  state.sync_local_ms = local_ms;
+  state.sync_unix_ms = true_unix_ms;
+  state.valid = 1;
+}
+
+// Build an AppTimeReq payload, returns its length
+// Format: [CID (1)] [DEVICE_TIME GPS seconds LE (4)] [PARAM: TokenReq (bits 0-3), AnsRequired (bit 4)]
+inline size_t time_sync_build_request(TimeSyncState& state, int64_t local_ms, uint8_t* out) {
+  int64_t device_s = time_sync_device_unix_ms(state, local_ms) / 1000;
+  uint32_t gps_s = (uint32_t)(device_s - GPS_UNIX_OFFSET_S + GPS_LEAP_SECONDS);
+
+  state.token = (state.token + 1) & 0x0F;
+
+  out[0] = CLOCK_SYNC_CID_APP_TIME;
+  out[1] = (uint8_t)(gps_s & 0xFF);
+  out[2] = (uint8_t)((gps_s >> 8) & 0xFF);
+  out[3] = (uint8_t)((gps_s >> 16) & 0xFF);
+  out[4] = (uint8_t)((gps_s >> 24) & 0xFF);
+  out[5] = (uint8_t)(state.token | 0x10);  // AnsRequired: answer even if the clock is already right
+  return CLOCK_SYNC_REQ_LENGTH;
+}
+
+// Handle an AppTimeAns payload, returns true if the correction was applied
+// Format: [CID (1)] [TIME_CORRECTION int32 seconds LE (4)] [PARAM: TokenAns (bits 0-3)]
+inline bool time_sync_handle_answer(TimeSyncState& state, int64_t local_ms,
+                                    const uint8_t* data, size_t length) {
+  if (length != CLOCK_SYNC_ANS_LENGTH || data[0] != CLOCK_SYNC_CID_APP_TIME) return false;
+  if ((data[5] & 0x0F) != state.token) return false;  // Answer to an older request
+
+  int32_t correction_s = (int32_t)((uint32_t)data[1] |
+                                   ((uint32_t)data[2] << 8) |
+                                   ((uint32_t)data[3] << 16) |
+                                   ((uint32_t)data[4] << 24));
+
+  int64_t true_unix_ms = time_sync_device_unix_ms(state, local_ms) + (int64_t)correction_s * 1000;
+  time_sync_apply(state, local_ms, true_unix_ms);
+  return true;
+}
+
+// Per-device phase offset within the report period (FNV-1a of the device name)
+// Spreads the fleet over the period so bins don't collide at the gateway
+inline uint32_t time_sync_phase_offset_s(const char* device_name, uint32_t period_s) {
+  uint32_t hash = 2166136261UL;
+  for (const char* p = device_name; *p; p++) {
+    hash ^= (uint8_t)*p;
+    hash *= 16777619UL;
+  }
+  return period_s > 0 ? hash % period_s : 0;
+}
+
+// Local-clock sleep duration until the slots_ahead-th upcoming slot at
+// (k * period + phase). Slots are aligned to Unix time, so a period that
+// divides one hour always lands in the same place inside each hour bucket.
+// Returns 0 if unsynced.
+inline uint64_t time_sync_sleep_ms_to_next_slot(const TimeSyncState& state, int64_t local_ms,
+                                                uint32_t period_s, uint32_t phase_s,
+                                                uint32_t slots_ahead = 1) {
+  int64_t now_ms = time_sync_now_unix_ms(state, local_ms);
+  if (now_ms < 0 || period_s == 0) return 0;
+
+  int64_t period_ms = (int64_t)period_s * 1000;
+  int64_t phase_ms = (int64_t)(phase_s % period_s) * 1000;
+
+  int64_t target_ms = ((now_ms - phase_ms) / period_ms + 1) * period_ms + phase_ms;
+  while (target_ms - now_ms < TIME_SYNC_MIN_SLEEP_MS) {
+    target_ms += period_ms;
+  }
+  if (slots_ahead > 1) {
+    target_ms += (int64_t)(slots_ahead - 1) * period_ms;
+  }
+
+  // The sleep timer runs on the local clock, so stretch/shrink by the drift
+  int64_t true_delta_ms = target_ms - now_ms;
+  int64_t local_delta_ms = true_delta_ms + (true_delta_ms * state.drift_ppm) / 1000000LL;
+  return local_delta_ms > 0 ? (uint64_t)local_delta_ms : 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ============================================
+// Usage Histogram
+// ============================================
+//
+// Motion wakes per 10-minute bin since the last report, so the dashboard sees
+// when a bin was busy and not just how busy it was over the whole interval.
+// The bins start at the last report; when an interval outgrows them (stretched
+// or deferred reports), neighbouring bins are merged and the bin width doubles.
+//
+// The report carries the histogram after its fixed fields:
+//   [SCALE (3 bits) | BINS (5 bits)] [counts, Elias gamma coded, MSB first]
+// Bin width is USAGE_BIN_MINUTES << SCALE. Each count is sent as the gamma
+// code of count + 1 (2 * floor(log2(count + 1)) + 1 bits): an idle bin costs
+// one bit and a typical hour of 6 bins takes 2-5 bytes. Trailing pad bits
+// are zero.
+
+#define USAGE_BIN_MINUTES        10
+#define USAGE_BIN_MS             ((int64_t)USAGE_BIN_MINUTES * 60 * 1000)
+#define USAGE_HISTOGRAM_BINS     24    // 4 hours at the base width
+#define USAGE_HISTOGRAM_MAX_SCALE 7
+#define USAGE_BIN_MAX_COUNT      31    // Counts saturate here (11-bit gamma code)
+#define USAGE_HISTOGRAM_MAX_BYTES (1 + (USAGE_HISTOGRAM_BINS * 11 + 7) / 8)
+
+// Kept in RTC memory
+struct UsageHistogramState {
+  int64_t start_ms;      // Local clock at the start of the interval
+  uint8_t scale;         // Bin width is USAGE_BIN_MS << scale
+  uint8_t counts[USAGE_HISTOGRAM_BINS];
+};
+
+// Start a new interval (report sent, power-on or corrupted RTC memory)
+inline void usage_histogram_reset(UsageHistogramState& state, int64_t local_ms) {
+  memset(&state, 0, sizeof(state));
+  state.start_ms = local_ms;
+}
+
+// Bin index of a local clock time, widening the bins until it fits
+inline uint8_t usage_histogram_bin(UsageHistogramState& state, int64_t local_ms) {
+  if (local_ms < state.start_ms) return 0;
+  for (;;) {
+    int64_t index = (local_ms - state.start_ms) / (USAGE_BIN_MS << state.scale);
+    if (index < USAGE_HISTOGRAM_BINS) return (uint8_t)index;
+    if (state.scale >= USAGE_HISTOGRAM_MAX_SCALE) return USAGE_HISTOGRAM_BINS - 1;
+
+    // Merge neighbouring bins and double the width
+    for (int i = 0; i < USAGE_HISTOGRAM_BINS / 2; i++) {
+      uint32_t sum = (uint32_t)state.counts[2 * i] + state.counts[2 * i + 1];
+      state.counts[i] = sum > USAGE_BIN_MAX_COUNT ? USAGE_BIN_MAX_COUNT : (uint8_t)sum;
+    }
+    memset(state.counts + USAGE_HISTOGRAM_BINS / 2, 0, USAGE_HISTOGRAM_BINS / 2);
+    state.scale++;
+  }
+}
+
+// Count one motion wake
+inline void usage_histogram_add(UsageHistogramState& state, int64_t local_ms) {
+  uint8_t& count = state.counts[usage_histogram_bin(state, local_ms)];
+  if (count < USAGE_BIN_MAX_COUNT) count++;
+}
+
+struct UsageBitWriter {
+  uint8_t* out;
+  size_t   bits;
+
+  void put(uint32_t value, uint8_t width) {
+    while (width-- > 0) {
+      if ((bits & 7) == 0) out[bits >> 3] = 0;
+      if ((value >> width) & 1) out[bits >> 3] |= (uint8_t)(0x80 >> (bits & 7));
+      bits++;
+    }
+  }
+};
+
+// Encode the bins up to the report time; returns the bytes written (at most
+// USAGE_HISTOGRAM_MAX_BYTES)
+inline size_t usage_histogram_encode(UsageHistogramState& state, int64_t local_ms, uint8_t* out) {
+  // A report right on a bin boundary does not open a new (empty) bin
+  uint8_t bins = usage_histogram_bin(state, local_ms > state.start_ms ? local_ms - 1 : local_ms) + 1;
+  while (bins < USAGE_HISTOGRAM_BINS && state.counts[bins] != 0) bins++;
+  out[0] = (uint8_t)((state.scale << 5) | bins);
+
+  UsageBitWriter writer = {out + 1, 0};
+  for (uint8_t i = 0; i < bins; i++) {
+    uint32_t value = (uint32_t)state.counts[i] + 1;
+    uint8_t length = 0;
+    while ((value >> (length + 1)) != 0) length++;
+    writer.put(0, length);           // floor(log2(value)) zeros...
+    writer.put(value, length + 1);   // ...then value, leading 1 first
+  }
+  return 1 + (writer.bits + 7) / 8;
+}
+
+// Decode a histogram, as the payload formatter does (host tools); returns
+// the number of bins, or -1 when the data is truncated or malformed
+inline int usage_histogram_decode(const uint8_t* in, size_t length, uint8_t* counts, uint32_t* bin_minutes) {
+  if (length < 1) return -1;
+  uint8_t bins = in[0] & 0x1F;
+  if (bins > USAGE_HISTOGRAM_BINS) return -1;
+  *bin_minutes = (uint32_t)USAGE_BIN_MINUTES << (in[0] >> 5);
+
+  size_t bit = 0;
+  size_t total = (length - 1) * 8;
+  for (uint8_t i = 0; i < bins; i++) {
+    uint8_t zeros = 0;
+    while (bit < total && !((in[1 + (bit >> 3)] >> (7 - (bit & 7))) & 1)) {
+      zeros++;
+      bit++;
+    }
+    if (zeros > 7 || bit + zeros + 1 > total) return -1;
+    uint32_t value = 0;
+    for (uint8_t b = 0; b <= zeros; b++, bit++) {
+      value = (value << 1) | ((in[1 + (bit >> 3)] >> (7 - (bit & 7))) & 1);
+    }
+    counts[i] = (uint8_t)(value - 1 > 255 ? 255 : value - 1);
+  }
+  return bins;
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rtc_state.h"
+#include "power_profile.h"
+
+// ============================================
+// Wake Cycle Logic
+// ============================================
+//
+// Hardware-independent part of a wake cycle: uplink frames, counter
+// bookkeeping, what a wake does and in which order (NVS flushes, report,
+// queued uplinks, multicast windows, cleanup detector readings), the airtime
+// gate and the next timer wake-up. main.cpp wraps these with the sensors,
+// the modem and the serial log; the host-side fleet simulator
+// (tools/fleet_sim) runs the very same functions for thousands of virtual
+// bins, with stand-ins for the sensors and the radio only.
+
+// Uplink operation codes (port 1)
+#define OP_WORKER_CLEANUP  0x01
+#define OP_HOURLY_REPORT   0x02
+#define OP_CONFIG_ACK      0x03
+#define OP_DOWNLINK_POLL   0x04
+#define OP_DIAGNOSTICS     0x05
+#define OP_RECOVERY        0x06
+#define OP_OTA_STATUS      0x07
+#define OP_JOURNAL         0x08
+#define OP_INFERRED_CLEANUP 0x09
+#define OP_MULTI_REPORT    0x0A
+#define OP_MULTICAST_ACK   0x0B
+
+#define UPLINK_FRAME_LENGTH  11  // Cleanup frames and the fixed part of the report
+#define REPORT_FRAME_MAX_LENGTH  (UPLINK_FRAME_LENGTH + USAGE_HISTOGRAM_MAX_BYTES)  // Report with its usage histogram
+#define MULTI_REPORT_FRAME_MAX_LENGTH  (9 + 3 * SENSOR_CHANNELS_MAX + USAGE_HISTOGRAM_MAX_BYTES)  // Multi-channel report
+#define INFERRED_CLEANUP_FRAME_MAX_LENGTH  (UPLINK_FRAME_LENGTH + 1)  // With the channel byte
+#define POLL_FRAME_LENGTH    7   // Downlink poll frame
+#define MULTICAST_ACK_MAX_LENGTH  (10 + MC_BITMAP_BYTES)  // Multicast batch ack frame
+#define DIAG_FRAME_LENGTH    27  // Memory diagnostics frame
+#define OTA_FRAME_LENGTH     12  // Firmware update result frame
+#define JOURNAL_FRAME_RECORDS    3   // Journal records per upload frame
+#define JOURNAL_FRAME_MAX_LENGTH (8 + 12 * JOURNAL_FRAME_RECORDS)  // Journal upload frame
+#define RFID_UID_LENGTH      4   // Bytes of the card UID carried in a cleanup frame
+
+// Fill percentage as carried in the report (0-100, invalid readings as 0)
+inline uint8_t wake_cycle_fill_byte(float fill_percentage) {
+  if (fill_percentage < 0) return 0;
+  if (fill_percentage > 100) return 100;
+  return (uint8_t)fill_percentage;
+}
+
+// Usage counter as carried in the report (capped at one byte)
+inline uint8_t wake_cycle_usage_byte(int32_t usage_counter) {
+  if (usage_counter < 0) return 0;
+  return usage_counter > 255 ? 255 : (uint8_t)usage_counter;
+}
+
+// Feed a fill reading to the forecast and build the report frame
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [FILL_PCT (1)] [USAGE_COUNT (1)] [MINUTES_TO_FULL (2, big-endian)]
+//         [USAGE_HISTOGRAM (2-34, see usage_histogram.h)]
+// Returns the frame length
+inline size_t wake_cycle_build_report(RtcState& state, const DeviceConfig& config,
+                                      int64_t local_ms, float fill_percentage, uint8_t* out) {
+  fill_forecast_update(state.forecast[0], local_ms, fill_percentage);
+  uint16_t minutes_to_full = fill_forecast_minutes_to_full(state.forecast[0]);
+
+  out[0] = OP_HOURLY_REPORT;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  out[7] = wake_cycle_fill_byte(fill_percentage);
+  out[8] = wake_cycle_usage_byte(state.usage_counter);
+  out[9] = (uint8_t)(minutes_to_full >> 8);
+  out[10] = (uint8_t)(minutes_to_full & 0xFF);
+  return UPLINK_FRAME_LENGTH + usage_histogram_encode(state.usage_histogram, local_ms, out + UPLINK_FRAME_LENGTH);
+}
+
+// Feed one fill reading per channel to the forecasts and build the report of
+// a multi-channel station (config.channel_count > 1); the usage counter and
+// histogram belong to the station, which has a single PIR sensor
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [USAGE_COUNT (1)] [COUNT (1)]
+//         { [FILL_PCT (1)] [MINUTES_TO_FULL (2, big-endian)] } x COUNT
+//         [USAGE_HISTOGRAM (2-34, see usage_histogram.h)]
+// Returns the frame length
+inline size_t wake_cycle_build_multi_report(RtcState& state, const DeviceConfig& config, int64_t local_ms,
+                                            const float* fill_percentages, uint8_t* out) {
+  uint8_t count = config.channel_count > SENSOR_CHANNELS_MAX ? SENSOR_CHANNELS_MAX : config.channel_count;
+  out[0] = OP_MULTI_REPORT;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  out[7] = wake_cycle_usage_byte(state.usage_counter);
+  out[8] = count;
+  size_t length = 9;
+  for (uint8_t i = 0; i < count; i++) {
+    fill_forecast_update(state.forecast[i], local_ms, fill_percentages[i]);
+    uint16_t minutes_to_full = fill_forecast_minutes_to_full(state.forecast[i]);
+    out[length] = wake_cycle_fill_byte(fill_percentages[i]);
+    out[length + 1] = (uint8_t)(minutes_to_full >> 8);
+    out[length + 2] = (uint8_t)(minutes_to_full & 0xFF);
+    length += 3;
+  }
+  return length + usage_histogram_encode(state.usage_histogram, local_ms, out + length);
+}
+
+// Build the worker cleanup frame
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [RFID_UID (4)] = 11 bytes
+inline size_t wake_cycle_build_cleanup(const DeviceConfig& config, const uint8_t* uid,
+                                       uint8_t uid_size, uint8_t* out) {
+  out[0] = OP_WORKER_CLEANUP;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  for (int i = 0; i < RFID_UID_LENGTH; i++) {
+    out[7 + i] = i < uid_size ? uid[i] : 0;
+  }
+  return UPLINK_FRAME_LENGTH;
+}
+
+// Build the downlink poll frame: an uplink whose only purpose is to open
+// receive windows for a downlink the server flagged as pending
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] = 7 bytes
+inline size_t wake_cycle_build_poll(const DeviceConfig& config, uint8_t* out) {
+  out[0] = OP_DOWNLINK_POLL;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  return POLL_FRAME_LENGTH;
+}
+
+// Big-endian 16-bit field, saturating
+inline void wake_cycle_put_u16(uint8_t* p, uint32_t value) {
+  if (value > 0xFFFF) value = 0xFFFF;
+  p[0] = (uint8_t)(value >> 8);
+  p[1] = (uint8_t)(value & 0xFF);
+}
+
+// Build the memory diagnostics frame from the worst values since the last one
+// (sent only when enabled with CFG_PARAM_DIAGNOSTICS)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [HEAP_FREE_KB (2)] [HEAP_MIN_FREE_KB (2)]
+//         [HEAP_LARGEST_BLOCK_KB (2)] [PSRAM_MIN_FREE_KB (2)] [SQLITE_MEMORY_KB (2)]
+//         [SQLITE_CACHE_KB (2)] [STACK_FREE main, rfid, modem (2 each, bytes)]
+//         [SAMPLES (2)] = 27 bytes, big-endian
+inline size_t wake_cycle_build_diagnostics(const RtcState& state, const DeviceConfig& config,
+                                           uint8_t* out) {
+  const MemSample& w = state.memory.worst;
+  out[0] = OP_DIAGNOSTICS;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  wake_cycle_put_u16(out + 7, w.heap_free / 1024);
+  wake_cycle_put_u16(out + 9, w.heap_min_free / 1024);
+  wake_cycle_put_u16(out + 11, w.heap_largest_block / 1024);
+  wake_cycle_put_u16(out + 13, w.psram_min_free / 1024);
+  wake_cycle_put_u16(out + 15, (w.sqlite_memory + 1023) / 1024);
+  wake_cycle_put_u16(out + 17, (w.sqlite_cache + 1023) / 1024);
+  wake_cycle_put_u16(out + 19, w.stack_free[MEM_TASK_MAIN]);
+  wake_cycle_put_u16(out + 21, w.stack_free[MEM_TASK_RFID]);
+  wake_cycle_put_u16(out + 23, w.stack_free[MEM_TASK_MODEM]);
+  wake_cycle_put_u16(out + 25, state.memory.samples);
+  return DIAG_FRAME_LENGTH;
+}
+
+// Build the recovery frame for a rebuilt whitelist database (golden_whitelist.h)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [REASON (1)] [USERS_RESTORED (2, big-endian)]
+//         [DURATION (1, 100 ms units)] = 11 bytes
+inline size_t wake_cycle_build_recovery(const RecoveryReport& report, const DeviceConfig& config,
+                                        uint8_t* out) {
+  uint32_t duration = (report.duration_ms + 99) / 100;
+  out[0] = OP_RECOVERY;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  out[7] = report.reason;
+  wake_cycle_put_u16(out + 8, report.users);
+  out[10] = duration > 0xFF ? 0xFF : (uint8_t)duration;
+  return UPLINK_FRAME_LENGTH;
+}
+
+// Build the firmware update result frame
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [STATUS (1, PATCH_*)] [IMAGE_CRC (4, big-endian)] = 12 bytes
+// IMAGE_CRC is the CRC-32 of the image the patch targeted, which the backend
+// matches against the builds it sent
+inline size_t wake_cycle_build_ota_status(const OtaReport& report, const DeviceConfig& config, uint8_t* out) {
+  out[0] = OP_OTA_STATUS;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  out[7] = report.status;
+  out[8] = (uint8_t)(report.new_crc >> 24);
+  out[9] = (uint8_t)(report.new_crc >> 16);
+  out[10] = (uint8_t)(report.new_crc >> 8);
+  out[11] = (uint8_t)report.new_crc;
+  return OTA_FRAME_LENGTH;
+}
+
+// Build one frame of a journal upload (event_journal.h)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [COUNT (1)]
+//         { [SEQUENCE (2, low bits)] [TIME (4)] [TYPE (1)] [FLAGS (1)] [DATA (4)] } x COUNT, big-endian
+// A frame with fewer than JOURNAL_FRAME_RECORDS records ends the upload; the
+// backend drops repeated records by sequence
+inline size_t wake_cycle_build_journal(const JournalRecord* records, uint8_t count, const DeviceConfig& config,
+                                       uint8_t* out) {
+  out[0] = OP_JOURNAL;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  out[7] = count;
+  size_t length = 8;
+  for (uint8_t i = 0; i < count; i++) {
+    const JournalRecord& record = records[i];
+    wake_cycle_put_u16(out + length, record.sequence & 0xFFFF);
+    out[length + 2] = (uint8_t)(record.time >> 24);
+    out[length + 3] = (uint8_t)(record.time >> 16);
+    out[length + 4] = (uint8_t)(record.time >> 8);
+    out[length + 5] = (uint8_t)record.time;
+    out[length + 6] = record.type;
+    out[length + 7] = record.flags;
+    memcpy(out + length + 8, record.data, sizeof(record.data));
+    length += 12;
+  }
+  return length;
+}
+
+// Build the inferred cleanup frame (cleanup_detect.h)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [FILL_BEFORE (1)] [FILL_AFTER (1)]
+//         [MINUTES_AGO (2, big-endian)] [CHANNEL (1, only for channels other than 0)] = 11-12 bytes
+// MINUTES_AGO dates the drop, which may have been detected wakes before the frame went out
+// Returns the frame length
+inline size_t wake_cycle_build_inferred_cleanup(const InferredCleanupReport& report, const DeviceConfig& config,
+                                                int64_t local_ms, uint8_t* out) {
+  int64_t age_ms = local_ms - report.detected_ms;
+  out[0] = OP_INFERRED_CLEANUP;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  out[7] = report.before_pct;
+  out[8] = report.after_pct;
+  wake_cycle_put_u16(out + 9, age_ms > 0 ? (uint32_t)(age_ms / 60000) : 0);
+  if (report.channel == 0) return UPLINK_FRAME_LENGTH;
+  out[11] = report.channel;
+  return INFERRED_CLEANUP_FRAME_MAX_LENGTH;
+}
+
+// Build the ack of a multicast whitelist batch (multicast_session.h)
+// Format: [OP_ID (1)] [TRASHCAN_NAME (6)] [BATCH_ID (2, big-endian)] [FRAME_COUNT (1)]
+//         [BITMAP (FRAME_COUNT / 8 rounded up, bit i = frame i heard, LSB first)]
+// Returns the frame length
+inline size_t wake_cycle_build_multicast_ack(const MulticastBatchState& batch, const DeviceConfig& config,
+                                             uint8_t* out) {
+  out[0] = OP_MULTICAST_ACK;
+  memcpy(out + 1, config.name, DEVICE_NAME_LENGTH);
+  wake_cycle_put_u16(out + 7, batch.batch_id);
+  out[9] = batch.frame_count;
+  size_t bitmap_length = (batch.frame_count + 7) / 8;
+  memcpy(out + 10, batch.bitmap, bitmap_length);
+  return 10 + bitmap_length;
+}
+
+// Feed a fill reading of one channel to its cleanup detector (only the first
+// of a wake is taken); on a detection the compartment counts as emptied
+// (forecast restarts) and an inferred cleanup report is queued, dated at the
+// first low reading. Returns CLEANUP_DETECT_*
+inline uint8_t wake_cycle_check_emptied(RtcState& state, uint8_t channel, int64_t local_ms, float fill_percentage) {
+  CleanupDetectState& detect = state.cleanup_detect[channel];
+  if (fill_percentage >= 0 && detect.read_wake == state.wake_count) {
+    return detect.low_readings > 0 ? CLEANUP_DETECT_PENDING : CLEANUP_DETECT_NONE;
+  }
+  if (fill_percentage >= 0) detect.read_wake = state.wake_count;
+
+  uint8_t before_pct = 0;
+  uint8_t after_pct = 0;
+  uint8_t result = cleanup_detect_update(detect, fill_percentage, local_ms, before_pct, after_pct);
+  if (result == CLEANUP_DETECT_DETECTED) {
+    InferredCleanupReport& report = state.inferred_cleanup[channel];
+    fill_forecast_reset(state.forecast[channel]);
+    report.pending = 1;
+    report.channel = channel;
+    report.before_pct = before_pct;
+    report.after_pct = after_pct;
+    report.detected_ms = detect.low_since_ms;
+  }
+  return result;
+}
+
+// Report went out: usage restarts from zero
+inline void wake_cycle_report_sent(RtcState& state, int64_t local_ms) {
+  state.usage_counter = 0;
+  usage_histogram_reset(state.usage_histogram, local_ms);
+}
+
+// Worker emptied the bin (every compartment of a station): restart the
+// fill-rate models and the cleanup detectors from the next reading
+inline void wake_cycle_bin_emptied(RtcState& state) {
+  for (int i = 0; i < SENSOR_CHANNELS_MAX; i++) {
+    fill_forecast_reset(state.forecast[i]);
+    cleanup_detect_reset(state.cleanup_detect[i]);
+  }
+}
+
+// Active window ended; a motion wake without a cleanup counts as one use
+// Returns true when the fill level should be read for the cleanup detectors
+// (someone may have emptied the bin without tapping a card): they take one
+// reading per wake, so not after a report
+inline bool wake_cycle_window_expired(RtcState& state, int64_t local_ms, bool worker_authenticated) {
+  if (worker_authenticated) return false;
+  state.usage_counter++;
+  usage_histogram_add(state.usage_histogram, local_ms);
+  return state.cleanup_detect[0].read_wake != state.wake_count;
+}
+
+// ============================================
+// Wake Sequence
+// ============================================
+//
+// setup() in order: wake_cycle_start(), clock sync when time_sync_needed(),
+// the boot flush, the queued uplinks of wake_cycle_boot_uplinks(), then
+// wake_cycle_action() decides between a report, a multicast window and the
+// active window. enter_deep_sleep() flushes when rtc_state_flush_due() and
+// arms the timer with wake_cycle_schedule_sleep_ms().
+
+// What a wake does once setup() is through the boot
+#define WAKE_ACTION_WINDOW         0  // Power-on: straight into the active window
+#define WAKE_ACTION_REPORT         1  // Report slot: report, then back to sleep
+#define WAKE_ACTION_REPORT_WINDOW  2  // Motion: report, then the active window for a card tap
+#define WAKE_ACTION_MULTICAST      3  // Ahead of a multicast window: listen, no report
+
+// Uplinks queued in RTC memory (bit set)
+#define WAKE_UPLINK_RECOVERY          0x01
+#define WAKE_UPLINK_INFERRED_CLEANUP  0x02
+#define WAKE_UPLINK_OTA_STATUS        0x04
+#define WAKE_UPLINK_DIAGNOSTICS       0x08
+#define WAKE_UPLINK_JOURNAL           0x10
+#define WAKE_UPLINK_MULTICAST_ACK     0x20
+
+// Wake bookkeeping, once per boot after the RTC state is restored
+inline void wake_cycle_start(RtcState& state) {
+  state.wake_count++;
+  state.wakes_since_flush++;
+}
+
+// Flush before mounting the filesystem (a failed mount may format or halt):
+// on a cold boot or RTC recovery (wake_count restarts at 1), or when a
+// batched flush is due anyway - PIR wakes leave the counter dirty every time
+inline bool wake_cycle_boot_flush_due(const RtcState& state, int64_t local_ms) {
+  return state.wake_count == 1 || rtc_state_flush_due(state, local_ms);
+}
+
+// Record a flush; returns true when the usage counter has to be written to
+// NVS (only a dirty counter is)
+inline bool wake_cycle_flush(RtcState& state, int64_t local_ms) {
+  bool dirty = rtc_state_dirty(state);
+  rtc_state_mark_flushed(state, local_ms);
+  return dirty;
+}
+
+// What this wake does, by its cause (POWER_WAKE_*); a timer wake ahead of a
+// multicast window is consumed here
+inline uint8_t wake_cycle_action(RtcState& state, uint8_t wake) {
+  if (wake == POWER_WAKE_MOTION) return WAKE_ACTION_REPORT_WINDOW;
+  if (wake != POWER_WAKE_TIMER) return WAKE_ACTION_WINDOW;
+  if (state.multicast.window_wake) {
+    state.multicast.window_wake = 0;
+    return WAKE_ACTION_MULTICAST;
+  }
+  return WAKE_ACTION_REPORT;
+}
+
+inline bool wake_cycle_inferred_cleanup_pending(const RtcState& state) {
+  for (int i = 0; i < SENSOR_CHANNELS_MAX; i++) {
+    if (state.inferred_cleanup[i].pending) return true;
+  }
+  return false;
+}
+
+// Uplinks sent in setup() before the report: results of the last wake or
+// the last boot that have not gone out yet (WAKE_UPLINK_*)
+inline uint8_t wake_cycle_boot_uplinks(const RtcState& state) {
+  uint8_t uplinks = 0;
+  if (state.recovery.reason != RECOVERY_NONE) uplinks |= WAKE_UPLINK_RECOVERY;
+  if (wake_cycle_inferred_cleanup_pending(state)) uplinks |= WAKE_UPLINK_INFERRED_CLEANUP;
+  if (state.ota.pending) uplinks |= WAKE_UPLINK_OTA_STATUS;
+  return uplinks;
+}
+
+// Uplinks sent after the report, in bit order (WAKE_UPLINK_*): an inferred
+// cleanup its reading confirmed, and on a report slot the diagnostics (when
+// enabled), the rest of a journal upload and a multicast ack
+inline uint8_t wake_cycle_report_uplinks(const RtcState& state, const DeviceConfig& config, uint8_t action) {
+  uint8_t uplinks = 0;
+  if (wake_cycle_inferred_cleanup_pending(state)) uplinks |= WAKE_UPLINK_INFERRED_CLEANUP;
+  if (action != WAKE_ACTION_REPORT) return uplinks;
+  if (config.diagnostics) uplinks |= WAKE_UPLINK_DIAGNOSTICS;
+  if (state.journal_upload.active) uplinks |= WAKE_UPLINK_JOURNAL;
+  if (state.multicast.ack_pending) uplinks |= WAKE_UPLINK_MULTICAST_ACK;
+  return uplinks;
+}
+
+// Local-clock time until the multicast window closes, 0 when there is none
+// to listen to (no group or synced clock, or the window is over)
+inline int64_t wake_cycle_multicast_window_left_ms(const RtcState& state, int64_t local_ms) {
+  int64_t to_window_ms = multicast_ms_to_window(state.multicast_group, state.time_sync, local_ms);
+  if (to_window_ms == INT64_MIN) return 0;
+  int64_t left_ms = to_window_ms + state.multicast_group.window_s * 1000LL;
+  return left_ms > 0 ? left_ms : 0;
+}
+
+// Airtime gate for one uplink: returns true if it may be sent and stores
+// its estimated airtime; deferred uplinks are counted in the budget state
+inline bool wake_cycle_uplink_allowed(RtcState& state, int64_t local_ms, size_t length,
+                                      uint8_t priority, uint32_t& airtime_ms) {
+  airtime_ms = lora_airtime_ms_for_data_rate(length, state.airtime.data_rate);
+  if (!airtime_budget_allow(state.airtime, local_ms, airtime_ms, priority)) {
+    state.airtime.deferred_uplinks++;
+    return false;
+  }
+  return true;
+}
+
+// How long to keep listening after the module accepted an uplink: until
+// both class A receive windows have closed (RX1 after rx1_delay_ms), never
+// longer than the configured downlink wait
+inline uint32_t wake_cycle_listen_ms(const DeviceConfig& config, uint32_t airtime_ms, uint32_t rx1_delay_ms) {
+  uint32_t windows_ms = lorawan_rx_windows_ms(airtime_ms, rx1_delay_ms);
+  return windows_ms < config.downlink_wait_ms ? windows_ms : config.downlink_wait_ms;
+}
+
+// Local-clock sleep until the next report, in milliseconds
+// The fill forecast decides how many report periods to skip (busy bins report
+// every period, slow bins stretch; a station follows its fastest compartment). Synced clock: sleep until that wall-clock-
+// aligned report slot, offset by a per-device phase. Unsynced clock: fall back
+// to multiples of the configured report interval.
+inline uint64_t wake_cycle_next_sleep_ms(const RtcState& state, const DeviceConfig& config,
+                                         int64_t local_ms, uint32_t* periods_out = NULL) {
+  uint32_t period_s = config.sleep_interval_s;
+  uint32_t phase_s = time_sync_phase_offset_s(config.name, period_s);
+  uint32_t periods = fill_forecast_report_periods(state.forecast[0], period_s);
+  for (uint8_t i = 1; i < config.channel_count && i < SENSOR_CHANNELS_MAX; i++) {
+    uint32_t channel_periods = fill_forecast_report_periods(state.forecast[i], period_s);
+    if (channel_periods < periods) periods = channel_periods;
+  }
+  if (periods_out) *periods_out = periods;
+
+  uint64_t sleep_ms = time_sync_sleep_ms_to_next_slot(state.time_sync, local_ms, period_s, phase_s, periods);
+  if (sleep_ms == 0) {
+    return (uint64_t)period_s * 1000ULL * periods;
+  }
+  return sleep_ms;
+}
+
+// Sleep until the next report or the next multicast window, whichever comes
+// first, and remember which one the timer wake is for
+inline uint64_t wake_cycle_schedule_sleep_ms(RtcState& state, const DeviceConfig& config, int64_t local_ms,
+                                             uint32_t* periods_out = NULL) {
+  uint64_t sleep_ms = wake_cycle_next_sleep_ms(state, config, local_ms, periods_out);
+  uint64_t window_ms = multicast_sleep_ms_to_window(state.multicast_group, state.time_sync, local_ms);
+  state.multicast.window_wake = window_ms > 0 && window_ms < sleep_ms;
+  return state.multicast.window_wake ? window_ms : sleep_ms;
+}
@@ -2,6 +2,7 @@ import { UserRound, UserRoundCog } from "lucide-react"
 import { notFound } from "next/navigation"
 
 import { db } from "~/server/db"
+import { getDailyCleanups } from "~/server/analytics"
 import { Badge } from "~/components/ui/badge"
 import { EmployeeCleanupsChart } from "~/components/employees/employee-cleanups-chart"
 import { EmployeeMonthlyCleanupsCard } from "~/components/employees/employee-monthly-cleanups-card"
@@ -29,7 +30,10 @@ export default async function EmployeeDetailsPage({
   const since14 = new Date(now)
   since14.setDate(since14.getDate() - 13)
 
-  const cleanupsLast14 = await db.cleanup.findMany({
+  // Chart data from the analytics server when it runs, raw Cleanup rows otherwise
+  const analyticsDaily = await getDailyCleanups(params.id)
+
+  const cleanupsLast14 = analyticsDaily ? [] : await db.cleanup.findMany({
     where: {
       userId: params.id,
       createdAt: {
@@ -135,7 +139,7 @@ export default async function EmployeeDetailsPage({
       <div className="px-2">
         <div className="flex flex-col gap-8 lg:flex-row lg:items-stretch">
           <div className="flex-1 flex flex-col gap-4">
-            <EmployeeCleanupsChart dailyData={dailyCleanupChartData} />
+            <EmployeeCleanupsChart dailyData={analyticsDaily ?? dailyCleanupChartData} />
             <EmployeeRecentTrashcansCard rows={recentTrashcanRows} />
           </div>
           <div className="w-full lg:w-72 xl:w-100 flex flex-col gap-4">
@@ -1,5 +1,6 @@
 import { auth } from "~/server/auth"
 import { db } from "~/server/db"
+import { getDailyUsage, getHourlyUsage } from "~/server/analytics"
 import { DashboardUsageChart } from "~/components/dashboard/dashboard-usage-chart"
 import { DashboardCapacityChart } from "~/components/dashboard/dashboard-capacity-chart"
 import { DashboardMostFullTrashcansCard } from "~/components/dashboard/dashboard-most-full-trashcans-card"
@@ -16,7 +17,12 @@ export default async function DashboardPage() {
   const startWindow = new Date()
   startWindow.setDate(now.getDate() - 13)
 
-  const statuses = await db.status.findMany({
+  // Chart data from the analytics server when it runs, raw Status rows otherwise
+  const analyticsDaily = await getDailyUsage(null)
+  const analyticsHourly = await getHourlyUsage(null)
+  const analyticsReady = analyticsDaily !== null && analyticsHourly !== null
+
+  const statuses = analyticsReady ? [] : await db.status.findMany({
     where: {
       hour: {
         gte: startWindow,
@@ -174,8 +180,8 @@ export default async function DashboardPage() {
         <div className="flex flex-col gap-8 lg:flex-row lg:items-stretch">
           <div className="flex-1 flex flex-col gap-4">
             <DashboardUsageChart
-              dailyData={dailyUsageChartData}
-              hourlyTodayData={hourlyUsageChartData}
+              dailyData={analyticsReady ? analyticsDaily : dailyUsageChartData}
+              hourlyTodayData={analyticsReady ? analyticsHourly : hourlyUsageChartData}
             />
             <DashboardMostFullTrashcansCard rows={mostFullTrashcans} />
           </div>
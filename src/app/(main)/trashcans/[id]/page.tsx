@@ -1,5 +1,6 @@
 import { Trash, Recycle, Trash2 } from "lucide-react"
 import { db } from "~/server/db"
+import { getDailyUsage, getHourlyUsage, getPeakSlot } from "~/server/analytics"
 import { notFound } from "next/navigation"
 import { Badge } from "~/components/ui/badge"
 import { TrashcanUsageChart } from "~/components/trashcans/trashcan-usage-chart"
@@ -26,7 +27,12 @@ export default async function TrashcanDetailsPage({
   const startWindow = new Date()
   startWindow.setDate(now.getDate() - 13)
 
-  const statuses = await db.status.findMany({
+  // Chart data from the analytics server when it runs, raw Status rows otherwise
+  const analyticsDaily = await getDailyUsage(params.id)
+  const analyticsHourly = await getHourlyUsage(params.id)
+  const analyticsReady = analyticsDaily !== null && analyticsHourly !== null
+
+  const statuses = analyticsReady ? [] : await db.status.findMany({
     where: {
       trashcanId: params.id,
       hour: {
@@ -88,7 +94,35 @@ export default async function TrashcanDetailsPage({
     useCount: count,
   }))
 
-  const lastStatus = statuses[statuses.length - 1]
+  // Busiest 10 minutes of the day, from the reports' usage histograms
+  let peakSlot = await getPeakSlot(params.id)
+  if (peakSlot === undefined) {
+    const histograms = await db.usageHistogram.findMany({
+      where: { trashcanId: params.id, reportedAt: { gte: startWindow } },
+      select: { reportedAt: true, binMinutes: true, bins: true },
+    })
+    const slotUse = new Array<number>(24 * 6).fill(0)
+    for (const h of histograms) {
+      // The last bin ends at the report time; each bin counts in the slot of its midpoint
+      h.bins.forEach((count, i) => {
+        const middle = new Date(h.reportedAt.getTime() - (h.bins.length - i - 0.5) * h.binMinutes * 60 * 1000)
+        const slot = middle.getHours() * 6 + Math.floor(middle.getMinutes() / 10)
+        slotUse[slot] = (slotUse[slot] ?? 0) + count
+      })
+    }
+    const peak = slotUse.reduce((best, count, slot) => (count > (slotUse[best] ?? 0) ? slot : best), 0)
+    peakSlot = (slotUse[peak] ?? 0) > 0
+      ? `${Math.floor(peak / 6).toString().padStart(2, "0")}:${((peak % 6) * 10).toString().padStart(2, "0")}`
+      : null
+  }
+
+  const lastStatus = analyticsReady
+    ? await db.status.findFirst({
+        where: { trashcanId: params.id },
+        orderBy: { hour: "desc" },
+        select: { capacityPct: true },
+      })
+    : statuses[statuses.length - 1]
   const lastCapacityPct =
     lastStatus && typeof lastStatus.capacityPct === "number"
       ? lastStatus.capacityPct
@@ -155,8 +189,9 @@ export default async function TrashcanDetailsPage({
         <div className="flex flex-col gap-8 lg:flex-row lg:items-stretch">
           <div className="flex-1 flex flex-col gap-4">
             <TrashcanUsageChart
-              dailyData={dailyUsageChartData}
-              hourlyTodayData={hourlyUsageChartData}
+              dailyData={analyticsReady ? analyticsDaily : dailyUsageChartData}
+              hourlyTodayData={analyticsReady ? analyticsHourly : hourlyUsageChartData}
+              peakSlot={peakSlot}
             />
             <TrashcanRecentCleanupsCard rows={recentCleanupRows} />
           </div>
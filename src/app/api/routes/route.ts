@@ -0,0 +1,42 @@
+import { routePlanQuerySchema } from "~/server/api/schemas/route";
+import { isAuthenticated } from "~/server/services/authentication";
+import { planCleanupRoutes } from "~/server/route-planner";
+import { NextResponse } from "next/server";
+import { z } from "zod";
+
+// Plan a Cleanup Round (?crews=&capacity=&minFill=&horizon=)
+export async function GET(request: Request) {
+  try {
+    if (!(await isAuthenticated(request))) {
+      return NextResponse.json({ error: "Unauthorized" }, { status: 401 });
+    }
+    const searchParams = new URL(request.url).searchParams;
+    const query = routePlanQuerySchema.parse(
+      Object.fromEntries(
+        ["crews", "capacity", "minFill", "horizon"]
+          .filter((key) => searchParams.has(key))
+          .map((key) => [key, searchParams.get(key)])
+      )
+    );
+    const plan = await planCleanupRoutes(query);
+    if (!plan) {
+      return NextResponse.json(
+        { error: "Route planner not configured" },
+        { status: 503 }
+      );
+    }
+    return NextResponse.json(plan);
+  } catch (error) {
+    if (error instanceof z.ZodError) {
+      return NextResponse.json(
+        { error: "Validation error", details: error.errors },
+        { status: 400 }
+      );
+    }
+    console.error("Error planning routes:", error);
+    return NextResponse.json(
+      { error: "Internal server error" },
+      { status: 500 }
+    );
+  }
+}
@@ -28,11 +28,13 @@ export type TrashcanUsagePoint = {
 interface TrashcanUsageChartProps {
   dailyData: TrashcanUsagePoint[]
   hourlyTodayData: TrashcanUsagePoint[]
+  peakSlot?: string | null // Busiest 10 minutes of the day (HH:MM)
 }
 
 export function TrashcanUsageChart({
   dailyData,
   hourlyTodayData,
+  peakSlot,
 }: TrashcanUsageChartProps) {
   const [range, setRange] = React.useState<"14d" | "7d" | "1d">("14d")
 
@@ -79,6 +81,7 @@ export function TrashcanUsageChart({
           <CardTitle className="text-base">{title}</CardTitle>
           <CardDescription>
             Total number of uses per day for this trashcan.
+            {peakSlot ? ` Busiest around ${peakSlot}.` : ""}
           </CardDescription>
         </div>
         <div className="flex items-center">
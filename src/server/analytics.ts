@@ -0,0 +1,108 @@
+// ============================================
+// ANALYTICS SERVER
+// ============================================
+
+// Chart data from tools/analytics (set ANALYTICS_URL, e.g. http://127.0.0.1:8090).
+// It answers from in-memory rollups, so the pages do not read and aggregate raw
+// Status and Cleanup rows. Every helper returns null when the server is not
+// configured or does not answer, and the pages fall back to the database.
+
+const ANALYTICS_TIMEOUT_MS = 2000
+
+type AnalyticsUsagePoint = {
+  start: string // YYYY-MM-DD, local day (or first day of the week/month)
+  useCount: number
+  avgFill: number | null
+  maxFill: number
+  hours: number
+  cleanups: number
+}
+
+type AnalyticsHourPoint = {
+  hour: number
+  useCount: number
+  fill: number | null
+}
+
+type AnalyticsPeakHours = {
+  peakHour: number
+  bySlot: number[] // Mean motion wakes per 10 minutes of the day (usage histograms)
+  peakSlot: string | null // HH:MM, null without histograms
+}
+
+type AnalyticsCleanupPoint = {
+  start: string
+  count: number
+}
+
+export type UsageChartPoint = {
+  rawKey: string
+  date: string
+  useCount: number
+}
+
+export type CleanupChartPoint = {
+  rawKey: string
+  date: string
+  count: number
+}
+
+async function fetchAnalytics<T>(path: string): Promise<T | null> {
+  const baseUrl = process.env.ANALYTICS_URL
+  if (!baseUrl) return null
+
+  try {
+    const response = await fetch(`${baseUrl}${path}`, {
+      cache: "no-store",
+      signal: AbortSignal.timeout(ANALYTICS_TIMEOUT_MS),
+    })
+    if (!response.ok) {
+      console.error(`[Analytics] ${path}: HTTP ${response.status}`)
+      return null
+    }
+    return (await response.json()) as T
+  } catch (error) {
+    console.error(`[Analytics] ${path} failed:`, error)
+    return null
+  }
+}
+
+function dayLabel(day: string) {
+  return new Date(day).toLocaleDateString("en-US", { month: "short", day: "numeric" })
+}
+
+function scopePath(trashcanId: string | null) {
+  return trashcanId ? `/trashcans/${encodeURIComponent(trashcanId)}` : "/fleet"
+}
+
+// Uses per day over the last 14 days, of one trashcan or (null) the whole fleet
+export async function getDailyUsage(trashcanId: string | null): Promise<UsageChartPoint[] | null> {
+  const points = await fetchAnalytics<AnalyticsUsagePoint[]>(`${scopePath(trashcanId)}/usage`)
+  return (
+    points?.map((p) => ({ rawKey: p.start, date: dayLabel(p.start), useCount: p.useCount })) ?? null
+  )
+}
+
+// Uses per hour today
+export async function getHourlyUsage(trashcanId: string | null): Promise<UsageChartPoint[] | null> {
+  const points = await fetchAnalytics<AnalyticsHourPoint[]>(`${scopePath(trashcanId)}/hours`)
+  return (
+    points?.map((p) => {
+      const label = `${p.hour.toString().padStart(2, "0")}:00`
+      return { rawKey: label, date: label, useCount: p.useCount }
+    }) ?? null
+  )
+}
+
+// Busiest 10 minutes of the day ("HH:MM") over the whole history, from the
+// reports' usage histograms; undefined when the server does not answer
+export async function getPeakSlot(trashcanId: string | null): Promise<string | null | undefined> {
+  const peak = await fetchAnalytics<AnalyticsPeakHours>(`${scopePath(trashcanId)}/peak-hours`)
+  return peak === null ? undefined : peak.peakSlot
+}
+
+// Cleanups per day of one worker over the last 14 days
+export async function getDailyCleanups(userId: string): Promise<CleanupChartPoint[] | null> {
+  const points = await fetchAnalytics<AnalyticsCleanupPoint[]>(`/users/${encodeURIComponent(userId)}/cleanups`)
+  return points?.map((p) => ({ rawKey: p.start, date: dayLabel(p.start), count: p.count })) ?? null
+}
@@ -0,0 +1,27 @@
+import { z } from "zod";
+
+export const routePlanQuerySchema = z.object({
+  crews: z.coerce
+    .number({ message: "Crews must be a number" })
+    .int("Crews must be an integer")
+    .min(1, "Crews must be at least 1")
+    .max(50, "Crews cannot exceed 50")
+    .default(2),
+  capacity: z.coerce
+    .number({ message: "Capacity must be a number" })
+    .positive("Capacity must be positive")
+    .default(400),
+  minFill: z.coerce
+    .number({ message: "Minimum fill must be a number" })
+    .min(0, "Minimum fill must be at least 0")
+    .max(100, "Minimum fill cannot exceed 100")
+    .default(60),
+  horizon: z.coerce
+    .number({ message: "Horizon must be a number" })
+    .int("Horizon must be an integer")
+    .min(0, "Horizon cannot be negative")
+    .max(24 * 60, "Horizon cannot exceed one day")
+    .default(30),
+});
+
+export type RoutePlanQuery = z.infer<typeof routePlanQuerySchema>;
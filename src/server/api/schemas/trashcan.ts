@@ -20,6 +20,13 @@ export const createTrashcanSchema = z.object({
       errorMap: () => ({ message: 'Bin type must be either "COMMON" or "RECYCLE"' }),
     })
     .default("COMMON"),
+  // Ultrasound channel of a multi-compartment station (see SENSOR_CHANNELS_MAX in ESP32/device_config.h)
+  channel: z
+    .number({ message: "Channel must be a number" })
+    .int("Channel must be an integer")
+    .min(0, "Channel must be between 0 and 3")
+    .max(3, "Channel must be between 0 and 3")
+    .default(0),
 });
 
 export const updateTrashcanSchema = createTrashcanSchema.partial();
@@ -12,6 +12,46 @@ const OPERATION_DELETE = 0x02
 const ROLE_WORKER = 0x01
 const ROLE_ADMIN = 0x02
 
+// Operation downlinks are numbered per device so a bin applies each one once
+// and in order (see ESP32/downlink_sequence.h):
+//   [OP | FLAG_SEQUENCED] [SESSION (1)] [SEQ (2)] [rest of the operation]
+// Each device's session and next sequence are kept in the DownlinkSequence
+// table, so a restart carries on with the numbering. A device without a row
+// gets a random session, and the bin restarts its numbering instead of
+// taking the new numbers for copies of old downlinks
+const FLAG_SEQUENCED = 0x40
+// A numbered downlink that failed after a later number was taken is sent again
+const OPERATION_RESEND_ATTEMPTS = 3
+const OPERATION_RESEND_DELAY_MS = 5 * 1000 // Times the attempt number
+
+// LoRaWAN Application Layer Clock Synchronization (TS003)
+const CLOCK_SYNC_PORT = 202
+const CLOCK_SYNC_CID_APP_TIME = 0x01
+const GPS_UNIX_OFFSET_S = 315964800 // 1980-01-06 00:00:00 UTC
+const GPS_LEAP_SECONDS = 18
+
+// An inferred cleanup and an RFID cleanup this close together are the same visit
+const INFERRED_CLEANUP_MATCH_MS = 2 * 60 * 60 * 1000
+
+// Status rows are kept per trashcan per hour (StatusBatch::hour_of in tools/ingest)
+const STATUS_HOUR_MS = 60 * 60 * 1000
+
+// Reports and RFID cleanups are written in batches by tools/ingest, which
+// subscribes to the same topic; the listener leaves them alone
+const INGEST_DAEMON = process.env.UPLINK_INGEST_DAEMON === "1"
+
+// Multicast whitelist distribution (see ESP32/multicast_session.h)
+const OPERATION_MULTICAST_SETUP = 0x05
+const FLAG_MORE_PENDING = 0x80 // On the operation byte: another downlink is queued
+const MULTICAST_WHITELIST_PORT = 10
+const MULTICAST_FRAME_MAX_LENGTH = 51
+const MULTICAST_BATCH_HEADER_LENGTH = 4
+const MULTICAST_BATCH_MAX_FRAMES = 64
+const MULTICAST_PUBLISH_LEAD_MS = 60 * 1000 // Queue the frames this long before the window
+const MULTICAST_FIRST_FRAME_MS = 5 * 1000 // First frame this far into the window (bins switching to class C)
+const MULTICAST_FRAME_SPACING_MS = 3 * 1000 // A 51-byte frame takes ~0.6 s at DR8; the module prints it meanwhile
+const MULTICAST_ACK_GRACE_MS = 3 * 60 * 60 * 1000 // Bins that have not acked by then get the batch by unicast
+
 type UserLike = {
   name: string
   rfidTag: string | null
@@ -65,7 +105,7 @@ function rfidTagToBytes(rfidTag: string): number[] {
  *   bytes 2-5: 4 bytes of RFID tag
  *   byte 6: 0x01 for WORKER, 0x02 for ADMIN
  */
-function buildInsertPayload(user: UserLike): string {
+function buildInsertBytes(user: UserLike): number[] {
   const bytes: number[] = []
   
   // Byte 1: Operation (INSERT = 0x01)
@@ -79,9 +119,7 @@ function buildInsertPayload(user: UserLike): string {
   const roleValue = user.role.toUpperCase() === "ADMIN" ? ROLE_ADMIN : ROLE_WORKER
   bytes.push(roleValue)
   
-  // Convert to base64
-  const buffer = Buffer.from(bytes)
-  return buffer.toString("base64")
+  return bytes
 }
 
 /**
@@ -91,7 +129,7 @@ function buildInsertPayload(user: UserLike): string {
  *   bytes 2-5: 4 bytes of RFID tag
  *   (no role byte for delete)
  */
-function buildDeletePayload(user: UserLike): string {
+function buildDeleteBytes(user: UserLike): number[] {
   const bytes: number[] = []
   
   // Byte 1: Operation (DELETE = 0x02)
@@ -103,18 +141,16 @@ function buildDeletePayload(user: UserLike): string {
   
   // No byte 6 for DELETE operation
   
-  // Convert to base64
-  const buffer = Buffer.from(bytes)
-  return buffer.toString("base64")
+  return bytes
 }
 
 /**
  * Build the JSON payload for TTN/TTS downlink
  */
-function buildDownlinkMessage(frmPayload: string) {
+function buildDownlinkMessage(frmPayload: string, fPort = 5) {
   return JSON.stringify({
     downlinks: [{
-      f_port: 5,
+      f_port: fPort,
       frm_payload: frmPayload,
       priority: "HIGH",
     }],
@@ -122,68 +158,409 @@ function buildDownlinkMessage(frmPayload: string) {
 }
 
 /**
- * Publish a message to all LoRaWAN devices
+ * Publish a message to a single LoRaWAN device
+ * Resolves true once the broker has acknowledged it (QoS 1), false if it was
+ * not sent (MQTT not configured, connection or publish error)
  */
-async function publishToAllDevices(message: string, operationName: string) {
+function publishToDevice(lorawanId: string, message: string, operationName: string) {
   const config = getMqttConfig()
 
   // If MQTT is not configured, just skip without failing the request
-  if (!config) return
+  if (!config) return Promise.resolve(false)
 
-  // Send to all LoRaWAN devices
-  const publishPromises = LORAWAN_IDS.map((lorawanId) => {
-    const topic = config.topicTemplate.replace("LORAWAN-ID", lorawanId)
-    
-    return new Promise<void>((resolve) => {
+  const topic = config.topicTemplate.replace("LORAWAN-ID", lorawanId)
+
+  return new Promise<boolean>((resolve) => {
     try {
       const client = mqtt.connect(config.brokerUrl, {
         username: config.username,
         password: config.password,
+        reconnectPeriod: 0,
       })
 
       client.on("connect", () => {
-          client.publish(topic, message, { qos: 0 }, () => {
+        client.publish(topic, message, { qos: 1 }, (err) => {
+          if (err) {
+            console.error(`MQTT ${operationName} downlink to device ${lorawanId} failed:`, err)
+          } else {
             console.log(`MQTT ${operationName} downlink sent to device ${lorawanId}`)
+          }
           client.end()
-          resolve()
+          resolve(!err)
         })
       })
 
       client.on("error", (err) => {
-          console.error(`MQTT connection error for device ${lorawanId} (${operationName}):`, err)
+        console.error(`MQTT connection error for device ${lorawanId} (${operationName}):`, err)
         try {
           client.end(true)
         } catch {
           // ignore
         }
-        resolve()
+        resolve(false)
       })
+
+      // Closed before the publish was acknowledged (no-op once resolved)
+      client.on("close", () => resolve(false))
     } catch (err) {
-        console.error(`MQTT publish setup error for device ${lorawanId} (${operationName}):`, err)
-      resolve()
-      }
-    })
+      console.error(`MQTT publish setup error for device ${lorawanId} (${operationName}):`, err)
+      resolve(false)
+    }
+  })
+}
+
+/**
+ * Take the next operation sequence for one device from the database
+ */
+async function takeSequence(lorawanId: string) {
+  const row = await db.downlinkSequence.upsert({
+    where: { lorawanId },
+    create: { lorawanId, session: 1 + Math.floor(Math.random() * 255), next: 1 },
+    update: { next: { increment: 1 } },
+  })
+  return { session: row.session, next: row.next }
+}
+
+/**
+ * Give back a sequence that was taken but never sent, unless a later one has
+ * been taken since. Returns whether it was given back
+ */
+async function returnSequence(lorawanId: string, next: number) {
+  const { count } = await db.downlinkSequence.updateMany({
+    where: { lorawanId, next },
+    data: { next: { decrement: 1 } },
   })
+  return count > 0
+}
+
+/**
+ * Number an operation downlink for one device
+ */
+function buildSequencedBytes(bytes: number[], session: number, next: number): number[] {
+  const sequence = (next - 1) & 0xffff
+  return [bytes[0]! | FLAG_SEQUENCED, session, sequence >> 8, sequence & 0xff, ...bytes.slice(1)]
+}
+
+/**
+ * Publish an operation downlink to one device, numbered
+ * A number that never reached the broker would leave a gap the bin waits on
+ * (it holds later frames back until its buffer fills), so on failure it is
+ * given back, or, if a later number has been taken meanwhile, the same frame
+ * is sent again
+ */
+async function publishOperationToDevice(lorawanId: string, bytes: number[], operationName: string) {
+  // Nothing is sent without MQTT, so no number is taken either
+  if (!getMqttConfig()) return
+
+  const { session, next } = await takeSequence(lorawanId)
+  const message = buildDownlinkMessage(Buffer.from(buildSequencedBytes(bytes, session, next)).toString("base64"))
 
-  await Promise.all(publishPromises)
+  if (await publishToDevice(lorawanId, message, operationName)) return
+  if (await returnSequence(lorawanId, next)) return
+
+  for (let attempt = 1; attempt <= OPERATION_RESEND_ATTEMPTS; attempt++) {
+    await new Promise((resolve) => setTimeout(resolve, OPERATION_RESEND_DELAY_MS * attempt))
+    if (await publishToDevice(lorawanId, message, `${operationName} (resend ${attempt})`)) return
+  }
+  console.error(`MQTT ${operationName} downlink to device ${lorawanId} lost; sequence ${(next - 1) & 0xffff} is a gap`)
+}
+
+/**
+ * Publish an operation downlink to all LoRaWAN devices, numbered per device
+ */
+async function publishOperationToAllDevices(bytes: number[], operationName: string) {
+  await Promise.all(
+    LORAWAN_IDS.map((lorawanId) => publishOperationToDevice(lorawanId, bytes, operationName))
+  )
 }
 
 /**
  * Publish INSERT message when a user is created
+ * With a multicast group configured, the change waits for the next window instead
  */
 export async function publishUserCreatedMqtt(user: UserLike) {
-  const frmPayload = buildInsertPayload(user)
-  const message = buildDownlinkMessage(frmPayload)
-  await publishToAllDevices(message, "INSERT")
+  if (await queueMulticastEntry(buildInsertBytes(user), "INSERT")) return
+  await publishOperationToAllDevices(buildInsertBytes(user), "INSERT")
 }
 
 /**
  * Publish DELETE message when a user is deleted
  */
 export async function publishUserDeletedMqtt(user: UserLike) {
-  const frmPayload = buildDeletePayload(user)
-  const message = buildDownlinkMessage(frmPayload)
-  await publishToAllDevices(message, "DELETE")
+  if (await queueMulticastEntry(buildDeleteBytes(user), "DELETE")) return
+  await publishOperationToAllDevices(buildDeleteBytes(user), "DELETE")
+}
+
+// ============================================
+// MULTICAST WHITELIST
+// ============================================
+//
+// Whitelist changes go to the whole fleet at once: every bin opens a class C
+// window at the same wall-clock time (every MULTICAST_PERIOD_MIN minutes,
+// MULTICAST_OFFSET_MIN minutes into the period) and the changes collected
+// since the last window are sent there once, to the multicast group, as a
+// batch of frames. Bins answer with the frames they heard; missing entries
+// follow by unicast, and the whole batch goes by unicast to the bins that did
+// not answer within MULTICAST_ACK_GRACE_MS. The group is a class C device
+// registered on the network server (MULTICAST_DEVICE_ID) with the same
+// address and session keys given to the bins in the MULTICAST_SETUP downlink.
+// Pending entries and open batches live in the database (MulticastEntry,
+// MulticastBatch), so a restart neither drops changes nor forgets stragglers.
+
+type MulticastConfig = {
+  deviceId: string
+  groupAddr: number
+  nwkSKey: Buffer
+  appSKey: Buffer
+  frequencyHz: number
+  dataRate: number
+  periodMin: number
+  offsetMin: number
+  windowS: number
+}
+
+function getMulticastConfig(): MulticastConfig | null {
+  const deviceId = process.env.MULTICAST_DEVICE_ID
+  const groupAddr = process.env.MULTICAST_GROUP_ADDR
+  const nwkSKey = process.env.MULTICAST_NWK_SKEY
+  const appSKey = process.env.MULTICAST_APP_SKEY
+  const isKey = (key?: string) => !!key && /^[0-9a-fA-F]{32}$/.test(key)
+
+  if (!deviceId || !groupAddr || !/^[0-9a-fA-F]{1,8}$/.test(groupAddr) || !isKey(nwkSKey) || !isKey(appSKey)) {
+    return null
+  }
+
+  const config = {
+    deviceId,
+    groupAddr: parseInt(groupAddr, 16),
+    nwkSKey: Buffer.from(nwkSKey!, "hex"),
+    appSKey: Buffer.from(appSKey!, "hex"),
+    frequencyHz: Number(process.env.MULTICAST_FREQUENCY_HZ ?? 923300000), // AU915 RX2 channel
+    dataRate: Number(process.env.MULTICAST_DATA_RATE ?? 8), // SF12 at 500 kHz
+    periodMin: Number(process.env.MULTICAST_PERIOD_MIN ?? 60),
+    offsetMin: Number(process.env.MULTICAST_OFFSET_MIN ?? 0),
+    windowS: Number(process.env.MULTICAST_WINDOW_S ?? 30),
+  }
+
+  // Same limits as multicast_group_parse_setup() on the device
+  if (
+    config.periodMin < 15 || config.periodMin > 10080 || config.offsetMin < 0 ||
+    config.offsetMin >= config.periodMin || config.windowS < 10 || config.windowS > 255 ||
+    config.dataRate < 0 || config.dataRate > 15 || config.frequencyHz <= 0
+  ) {
+    console.error("[Multicast] Invalid schedule, frequency or data rate - multicast disabled")
+    return null
+  }
+  return config
+}
+
+/**
+ * Queue a whitelist entry (INSERT or DELETE bytes) for the next multicast window
+ * Returns false when no multicast group is configured
+ */
+async function queueMulticastEntry(entry: number[], operationName: string): Promise<boolean> {
+  if (!multicastSchedulerRunning) return false
+  await db.multicastEntry.create({ data: { bytes: Buffer.from(entry) } })
+  const pending = await db.multicastEntry.count({ where: { batchId: null } })
+  console.log(`[Multicast] ${operationName} queued for the next window (${pending} pending)`)
+  return true
+}
+
+/**
+ * Build the MULTICAST_SETUP downlink (big-endian):
+ *   [OP (1)] [GROUP_ADDR (4)] [NWK_SKEY (16)] [APP_SKEY (16)] [FREQUENCY (3, 100 Hz units)]
+ *   [DATA_RATE (1)] [PERIOD_MIN (2)] [OFFSET_MIN (2)] [WINDOW_S (1)]
+ */
+function buildMulticastSetupBytes(config: MulticastConfig): number[] {
+  const setup = Buffer.alloc(46)
+  setup[0] = OPERATION_MULTICAST_SETUP
+  setup.writeUInt32BE(config.groupAddr >>> 0, 1)
+  config.nwkSKey.copy(setup, 5)
+  config.appSKey.copy(setup, 21)
+  setup.writeUIntBE(Math.round(config.frequencyHz / 100), 37, 3)
+  setup[40] = config.dataRate
+  setup.writeUInt16BE(config.periodMin, 41)
+  setup.writeUInt16BE(config.offsetMin, 43)
+  setup[45] = config.windowS
+  return [...setup]
+}
+
+/**
+ * Send entries to one device by unicast, flagging all but the last as
+ * followed by another downlink so the device polls for them
+ */
+async function publishEntriesToDevice(lorawanId: string, entries: number[][], operationName: string) {
+  for (const [i, entry] of entries.entries()) {
+    const bytes = [...entry]
+    if (i < entries.length - 1) bytes[0] = bytes[0]! | FLAG_MORE_PENDING
+    await publishOperationToDevice(lorawanId, bytes, operationName)
+  }
+}
+
+// Wall-clock start of the next window at or after nowMs
+function nextMulticastWindowMs(config: MulticastConfig, nowMs: number): number {
+  const periodMs = config.periodMin * 60 * 1000
+  const offsetMs = config.offsetMin * 60 * 1000
+  const startMs = Math.floor((nowMs - offsetMs) / periodMs) * periodMs + offsetMs
+  return startMs < nowMs ? startMs + periodMs : startMs
+}
+
+/**
+ * Send the pending entries to the multicast group in the window starting at windowMs
+ * Frames: [BATCH_ID (2)] [FRAME_INDEX (1)] [FRAME_COUNT (1)] { entry } ...
+ */
+async function sendMulticastBatch(config: MulticastConfig, windowMs: number) {
+  const pending = await db.multicastEntry.findMany({ where: { batchId: null }, orderBy: { id: "asc" } })
+  if (pending.length === 0) return
+
+  // As many frames as fit in the window; the rest waits for the next one
+  const maxFrames = Math.min(
+    MULTICAST_BATCH_MAX_FRAMES,
+    Math.floor((config.windowS * 1000 - MULTICAST_FIRST_FRAME_MS) / MULTICAST_FRAME_SPACING_MS)
+  )
+  const frames: (typeof pending)[] = []
+  let frameLength = MULTICAST_FRAME_MAX_LENGTH
+  let taken = 0
+  for (const entry of pending) {
+    if (frameLength + entry.bytes.length > MULTICAST_FRAME_MAX_LENGTH) {
+      if (frames.length === maxFrames) break
+      frames.push([])
+      frameLength = MULTICAST_BATCH_HEADER_LENGTH
+    }
+    frames[frames.length - 1]!.push(entry)
+    frameLength += entry.bytes.length
+    taken++
+  }
+
+  const batch = await db.$transaction(async (tx) => {
+    const created = await tx.multicastBatch.create({
+      data: { frameCount: frames.length, dueAt: new Date(Date.now() + MULTICAST_ACK_GRACE_MS) },
+    })
+    for (const [index, entries] of frames.entries()) {
+      await tx.multicastEntry.updateMany({
+        where: { id: { in: entries.map((entry) => entry.id) } },
+        data: { batchId: created.id, frame: index },
+      })
+    }
+    return created
+  })
+  const batchId = batch.id & 0xffff
+
+  for (const [index, entries] of frames.entries()) {
+    const frame = [batchId >> 8, batchId & 0xff, index, frames.length, ...entries.flatMap((entry) => [...entry.bytes])]
+    const message = JSON.stringify({
+      downlinks: [{
+        f_port: MULTICAST_WHITELIST_PORT,
+        frm_payload: Buffer.from(frame).toString("base64"),
+        priority: "HIGH",
+        class_b_c: {
+          absolute_time: new Date(windowMs + MULTICAST_FIRST_FRAME_MS + index * MULTICAST_FRAME_SPACING_MS).toISOString(),
+        },
+      }],
+    })
+    await publishToDevice(config.deviceId, message, `MULTICAST batch ${batchId} frame ${index + 1}/${frames.length}`)
+  }
+  console.log(`[Multicast] Batch ${batchId}: ${taken} entries in ${frames.length} frames, ${pending.length - taken} left`)
+
+  scheduleMulticastStragglers(batch.id, batch.dueAt)
+}
+
+/**
+ * Once a batch is due, send it by unicast to the bins that did not ack it (no
+ * synced clock, no setup, missed the window or lost the ack), then drop it
+ */
+function scheduleMulticastStragglers(id: number, dueAt: Date) {
+  setTimeout(() => {
+    void sendMulticastStragglers(id).catch((err) => {
+      console.error(`[Multicast] Straggler unicast for batch ${id & 0xffff} failed:`, err)
+    })
+  }, Math.max(0, dueAt.getTime() - Date.now()))
+}
+
+async function sendMulticastStragglers(id: number) {
+  const batch = await db.multicastBatch.findUnique({
+    where: { id },
+    include: { entries: { orderBy: { id: "asc" } } },
+  })
+  if (!batch) return
+
+  const entries = batch.entries.map((entry) => [...entry.bytes])
+  const stragglers = LORAWAN_IDS.filter((lorawanId) => !batch.acked.includes(lorawanId))
+  for (const lorawanId of stragglers) {
+    console.log(`[Multicast] No ack for batch ${id & 0xffff} from ${lorawanId} - sending it by unicast`)
+    await publishEntriesToDevice(lorawanId, entries, "MULTICAST STRAGGLER")
+  }
+  await db.multicastBatch.delete({ where: { id } })
+}
+
+/**
+ * Handle the ack of a multicast batch: unicast the entries of the frames the device missed
+ * Bitmap: bit i of byte i / 8 (LSB first) set when frame i was heard
+ */
+async function handleMulticastAck(deviceId: string, batchId: number, frameCount: number, bitmap: number[]) {
+  const open = await db.multicastBatch.findMany({
+    include: { entries: { orderBy: { id: "asc" } } },
+    orderBy: { id: "desc" },
+  })
+  const batch = open.find((candidate) => (candidate.id & 0xffff) === batchId)
+  if (!batch || batch.frameCount !== frameCount) {
+    console.log(`[Multicast] Ack from ${deviceId} for unknown or expired batch ${batchId}`)
+    return
+  }
+  if (!batch.acked.includes(deviceId)) {
+    await db.multicastBatch.update({ where: { id: batch.id }, data: { acked: { push: deviceId } } })
+  }
+
+  const heard = (frame: number) => ((bitmap[frame >> 3] ?? 0) >> (frame & 7)) & 1
+  const missing = batch.entries.filter((entry) => !heard(entry.frame ?? 0))
+  const missingFrames = new Set(missing.map((entry) => entry.frame)).size
+  console.log(`[Multicast] Ack from ${deviceId} for batch ${batchId}: ${frameCount - missingFrames}/${frameCount} frames`)
+  if (missing.length > 0) {
+    await publishEntriesToDevice(deviceId, missing.map((entry) => [...entry.bytes]), "MULTICAST REPAIR")
+  }
+}
+
+let multicastSchedulerRunning = false
+
+/**
+ * Start the multicast window scheduler
+ * Sends the MULTICAST_SETUP to every device, then the pending whitelist
+ * changes in every window
+ */
+export function startMulticastScheduler() {
+  if (multicastSchedulerRunning) {
+    console.log("[Multicast] Scheduler already running")
+    return
+  }
+
+  const config = getMulticastConfig()
+  if (!config) {
+    console.log("[Multicast] Not configured, whitelist changes go by unicast")
+    return
+  }
+
+  console.log(
+    `[Multicast] Group ${config.groupAddr.toString(16)}: window every ${config.periodMin} min ` +
+      `at +${config.offsetMin} min for ${config.windowS} s`
+  )
+  multicastSchedulerRunning = true
+  void publishOperationToAllDevices(buildMulticastSetupBytes(config), "MULTICAST_SETUP")
+
+  // Batches sent before a restart still get their stragglers served
+  void db.multicastBatch
+    .findMany({ select: { id: true, dueAt: true } })
+    .then((batches) => {
+      for (const batch of batches) scheduleMulticastStragglers(batch.id, batch.dueAt)
+    })
+    .catch((err) => console.error("[Multicast] Could not load the open batches:", err))
+
+  const scheduleNext = () => {
+    const windowMs = nextMulticastWindowMs(config, Date.now() + MULTICAST_PUBLISH_LEAD_MS)
+    setTimeout(() => {
+      void sendMulticastBatch(config, windowMs).finally(scheduleNext)
+    }, windowMs - MULTICAST_PUBLISH_LEAD_MS - Date.now())
+  }
+  scheduleNext()
 }
 
 // ============================================
@@ -213,7 +590,13 @@ function getUplinkConfig() {
  * TTN Uplink message structure (partial)
  */
 interface TtnUplinkMessage {
+  end_device_ids?: {
+    device_id?: string
+  }
+  received_at?: string
   uplink_message?: {
+    f_port?: number
+    frm_payload?: string
     decoded_payload?: {
       operation?: string
       // Cleanup fields
@@ -222,6 +605,41 @@ interface TtnUplinkMessage {
       // Status fields
       fillPercentage?: number
       usageCount?: number
+      minutesToFull?: number
+      usageBins?: number[] // Motion wakes per bin since the last report (see ESP32/usage_histogram.h)
+      usageBinMinutes?: number
+      // Multi-channel status fields: one entry per compartment of a station (see
+      // wake_cycle_build_multi_report in ESP32/wake_cycle.h), usage fields as above
+      channels?: { fillPercentage: number; minutesToFull: number }[]
+      // Config ack fields
+      acks?: { param: number; status: number }[]
+      // Diagnostics fields (see wake_cycle_build_diagnostics in ESP32/wake_cycle.h)
+      heapFreeKb?: number
+      heapMinFreeKb?: number
+      heapLargestBlockKb?: number
+      psramMinFreeKb?: number
+      sqliteMemoryKb?: number
+      sqliteCacheKb?: number
+      stackFree?: { main: number; rfid: number; modem: number }
+      samples?: number
+      // Recovery fields (see wake_cycle_build_recovery in ESP32/wake_cycle.h)
+      reason?: number
+      usersRestored?: number
+      durationMs?: number
+      // Firmware update fields (see wake_cycle_build_ota_status in ESP32/wake_cycle.h)
+      status?: number
+      imageCrc?: number
+      // Inferred cleanup fields (see wake_cycle_build_inferred_cleanup in ESP32/wake_cycle.h)
+      fillBefore?: number
+      fillAfter?: number
+      minutesAgo?: number
+      channel?: number // Compartment of a multi-channel station, 0 when absent
+      // Journal upload fields (see wake_cycle_build_journal in ESP32/wake_cycle.h)
+      records?: { sequence: number; time: number; type: number; flags: number; data: number[] }[]
+      // Multicast ack fields (see wake_cycle_build_multicast_ack in ESP32/wake_cycle.h)
+      batchId?: number
+      frameCount?: number
+      bitmap?: number[]
     }
   }
 }
@@ -241,27 +659,124 @@ async function handleCleanupOperation(rfidTag: string, trashcanName: string) {
       return
     }
 
-    // Find trashcan by name
-    const trashcan = await db.trashcan.findFirst({
+    // A multi-channel station is one trashcan per compartment; the worker empties them all
+    const trashcans = await db.trashcan.findMany({
       where: { name: trashcanName },
+      orderBy: { channel: "asc" },
     })
 
-    if (!trashcan) {
+    if (trashcans.length === 0) {
       console.error(`[MQTT Uplink] Trashcan not found with name: ${trashcanName}`)
       return
     }
 
-    // Create cleanup record
-    const cleanup = await db.cleanup.create({
+    for (const trashcan of trashcans) {
+      // Create cleanup record
+      const cleanup = await db.cleanup.create({
+        data: {
+          userId: user.id,
+          trashcanId: trashcan.id,
+        },
+      })
+
+      console.log(
+        `[MQTT Uplink] Cleanup created: ${cleanup.id} (user: ${user.name}, trashcan: ${trashcan.name}, channel: ${trashcan.channel})`
+      )
+
+      // The worker tapped after the device had already seen the bin emptied
+      const inferred = await db.inferredCleanup.findFirst({
+        where: {
+          trashcanId: trashcan.id,
+          cleanupId: null,
+          detectedAt: { gte: new Date(cleanup.createdAt.getTime() - INFERRED_CLEANUP_MATCH_MS) },
+        },
+        orderBy: { detectedAt: "desc" },
+      })
+      if (inferred) {
+        await db.inferredCleanup.update({ where: { id: inferred.id }, data: { cleanupId: cleanup.id } })
+        console.log(`[MQTT Uplink] Inferred cleanup ${inferred.id} confirmed by ${user.name}`)
+      }
+    }
+  } catch (error) {
+    console.error("[MQTT Uplink] Error handling cleanup operation:", error)
+  }
+}
+
+/**
+ * Start of the hour a status row belongs to
+ */
+function statusHour(date: Date) {
+  return new Date(date.getTime() - (date.getTime() % STATUS_HOUR_MS))
+}
+
+/**
+ * Handle an inferred cleanup: the device saw its fill level drop sharply
+ * without a card tap (see ESP32/cleanup_detect.h). The bin is shown as emptied
+ * right away; an RFID cleanup of the same visit, before or after, is linked to it.
+ */
+async function handleInferredCleanupOperation(
+  trashcanName: string,
+  fillBefore: number,
+  fillAfter: number,
+  minutesAgo: number,
+  channel = 0
+) {
+  try {
+    const trashcan = await db.trashcan.findFirst({
+      where: { name: trashcanName, channel },
+    })
+
+    if (!trashcan) {
+      console.error(`[MQTT Uplink] Trashcan not found with name: ${trashcanName}, channel: ${channel}`)
+      return
+    }
+
+    const now = new Date()
+    const detectedAt = new Date(now.getTime() - minutesAgo * 60 * 1000)
+
+    // The RFID cleanup of the same visit may have arrived first (this uplink was retried)
+    const cleanup = await db.cleanup.findFirst({
+      where: {
+        trashcanId: trashcan.id,
+        inferred: null,
+        createdAt: {
+          gte: new Date(detectedAt.getTime() - INFERRED_CLEANUP_MATCH_MS),
+          lte: new Date(detectedAt.getTime() + INFERRED_CLEANUP_MATCH_MS),
+        },
+      },
+      orderBy: { createdAt: "desc" },
+    })
+
+    const inferred = await db.inferredCleanup.create({
       data: {
-        userId: user.id,
         trashcanId: trashcan.id,
+        fillBefore,
+        fillAfter,
+        detectedAt,
+        cleanupId: cleanup?.id ?? null,
+      },
+    })
+
+    // Show the bin as emptied now instead of at its next report
+    const hour = statusHour(now)
+    await db.status.upsert({
+      where: { trashcanId_hour: { trashcanId: trashcan.id, hour } },
+      create: {
+        trashcanId: trashcan.id,
+        capacityPct: fillAfter,
+        useCount: 0,
+        hour,
+        reportedAt: now,
       },
+      update: { capacityPct: fillAfter, reportedAt: now },
     })
 
-    console.log(`[MQTT Uplink] Cleanup created: ${cleanup.id} (user: ${user.name}, trashcan: ${trashcan.name})`)
+    console.log(
+      `[MQTT Uplink] Inferred cleanup created: ${inferred.id} (trashcan: ${trashcan.name}, ` +
+        `${fillBefore}% -> ${fillAfter}%, ${minutesAgo} min ago${cleanup ? ", matches an RFID cleanup" : ""})`
+    )
   } catch (error) {
-    console.error("[MQTT Uplink] Error handling cleanup operation:", error)
+    console.error("[MQTT Uplink] Error handling inferred cleanup operation:", error)
   }
 }
 
@@ -271,30 +786,50 @@ async function handleCleanupOperation(rfidTag: string, trashcanName: string) {
 async function handleStatusOperation(
   trashcanName: string,
   fillPercentage: number,
-  usageCount: number
+  usageCount: number,
+  minutesToFull?: number,
+  usageBins?: number[],
+  usageBinMinutes?: number,
+  channel = 0
 ) {
   try {
-    // Find trashcan by name
+    // Find trashcan by name (and compartment, on a multi-channel station)
     const trashcan = await db.trashcan.findFirst({
-      where: { name: trashcanName },
+      where: { name: trashcanName, channel },
     })
 
     if (!trashcan) {
-      console.error(`[MQTT Uplink] Trashcan not found with name: ${trashcanName}`)
+      console.error(`[MQTT Uplink] Trashcan not found with name: ${trashcanName}, channel: ${channel}`)
       return
     }
 
-    // Create status record with hour set to current time
+    // The usage byte saturates at 255; the bins (up to 31 each) may add up to more
+    const binTotal = (usageBins ?? []).reduce((sum, count) => sum + count, 0)
+
+    // One status row per hour, merged as tools/ingest does: usage adds up
+    // within the hour; fill level and forecast are the latest
     const now = new Date()
-    const status = await db.status.create({
-      data: {
-        trashcanId: trashcan.id,
-        capacityPct: fillPercentage,
-        useCount: usageCount,
-        hour: now,
-      },
+    const hour = statusHour(now)
+    const useCount = Math.max(usageCount, binTotal)
+    const latest = {
+      capacityPct: fillPercentage,
+      reportedAt: now,
+      // 0xFFFF means the device sees the bin as not filling
+      minutesToFull: minutesToFull === undefined || minutesToFull === 0xffff ? null : minutesToFull,
+    }
+    const status = await db.status.upsert({
+      where: { trashcanId_hour: { trashcanId: trashcan.id, hour } },
+      create: { trashcanId: trashcan.id, useCount, hour, ...latest },
+      update: { useCount: { increment: useCount }, ...latest },
     })
 
+    // The histogram is kept per report, ending at the report time
+    if (usageBins && usageBins.length > 0 && usageBinMinutes) {
+      await db.usageHistogram.create({
+        data: { trashcanId: trashcan.id, reportedAt: now, binMinutes: usageBinMinutes, bins: usageBins },
+      })
+    }
+
     console.log(
       `[MQTT Uplink] Status created: ${status.id} (trashcan: ${trashcan.name}, capacity: ${fillPercentage}%, useCount: ${usageCount})`
     )
@@ -303,6 +838,43 @@ async function handleStatusOperation(
   }
 }
 
+/**
+ * Answer a clock sync request (AppTimeReq) with AppTimeAns
+ * Request: [CID (1)] [DEVICE_TIME GPS seconds LE (4)] [PARAM: TokenReq bits 0-3 (1)]
+ * Answer:  [CID (1)] [TIME_CORRECTION int32 seconds LE (4)] [PARAM: TokenAns bits 0-3 (1)]
+ */
+async function handleClockSyncRequest(deviceId: string, frmPayload: string, receivedAt?: string) {
+  const request = Buffer.from(frmPayload, "base64")
+
+  if (request.length < 6 || request[0] !== CLOCK_SYNC_CID_APP_TIME) {
+    console.error(`[MQTT Uplink] Invalid clock sync request from device ${deviceId}`)
+    return
+  }
+
+  const deviceGpsSeconds = request.readUInt32LE(1)
+  const token = request.readUInt8(5) & 0x0f
+
+  // Use the network reception time so broker/queue latency doesn't skew the clock
+  const receivedMs = receivedAt ? Date.parse(receivedAt) : Date.now()
+  const serverGpsSeconds =
+    Math.floor((Number.isNaN(receivedMs) ? Date.now() : receivedMs) / 1000) -
+    GPS_UNIX_OFFSET_S +
+    GPS_LEAP_SECONDS
+
+  // Correction wraps like the device's 32-bit GPS counter
+  const correction = (serverGpsSeconds - deviceGpsSeconds) | 0
+
+  const answer = Buffer.alloc(6)
+  answer[0] = CLOCK_SYNC_CID_APP_TIME
+  answer.writeInt32LE(correction, 1)
+  answer[5] = token
+
+  console.log(`[MQTT Uplink] Clock sync for device ${deviceId}: correction ${correction}s (token ${token})`)
+
+  const message = buildDownlinkMessage(answer.toString("base64"), CLOCK_SYNC_PORT)
+  await publishToDevice(deviceId, message, "CLOCK_SYNC")
+}
+
 /**
  * Process incoming uplink message
  */
@@ -311,6 +883,20 @@ async function processUplinkMessage(messageBuffer: Buffer) {
     const messageStr = messageBuffer.toString("utf-8")
     const message = JSON.parse(messageStr) as TtnUplinkMessage
 
+    // Clock sync requests are raw TS003 frames, not decoded by the payload formatter
+    if (message.uplink_message?.f_port === CLOCK_SYNC_PORT) {
+      const deviceId = message.end_device_ids?.device_id
+      const frmPayload = message.uplink_message.frm_payload
+
+      if (!deviceId || !frmPayload) {
+        console.error("[MQTT Uplink] Clock sync request missing device_id or frm_payload")
+        return
+      }
+
+      await handleClockSyncRequest(deviceId, frmPayload, message.received_at)
+      return
+    }
+
     const decodedPayload = message.uplink_message?.decoded_payload
     if (!decodedPayload) {
       console.log("[MQTT Uplink] No decoded_payload in message")
@@ -320,6 +906,10 @@ async function processUplinkMessage(messageBuffer: Buffer) {
     const operation = decodedPayload.operation
     console.log(`[MQTT Uplink] Received operation: ${operation}`)
 
+    if (INGEST_DAEMON && (operation === "STATUS" || operation === "MULTI_STATUS" || operation === "CLEANUP")) {
+      return
+    }
+
     if (operation === "CLEANUP") {
       const rfidTag = decodedPayload.rfidTag
       const trashcanName = decodedPayload.trashcanName
@@ -340,7 +930,119 @@ async function processUplinkMessage(messageBuffer: Buffer) {
         return
       }
 
-      await handleStatusOperation(trashcanName, fillPercentage, usageCount)
+      await handleStatusOperation(
+        trashcanName,
+        fillPercentage,
+        usageCount,
+        decodedPayload.minutesToFull,
+        decodedPayload.usageBins,
+        decodedPayload.usageBinMinutes
+      )
+    } else if (operation === "MULTI_STATUS") {
+      // One report for every compartment of a station. The station has a single
+      // PIR sensor: its usage is recorded on channel 0 only, so totals are not doubled.
+      const { trashcanName, usageCount, channels } = decodedPayload
+
+      if (!trashcanName || usageCount === undefined || !channels) {
+        console.error("[MQTT Uplink] Multi-channel status message missing trashcanName, usageCount, or channels")
+        return
+      }
+
+      for (const [channel, reading] of channels.entries()) {
+        await handleStatusOperation(
+          trashcanName,
+          reading.fillPercentage,
+          channel === 0 ? usageCount : 0,
+          reading.minutesToFull,
+          channel === 0 ? decodedPayload.usageBins : undefined,
+          decodedPayload.usageBinMinutes,
+          channel
+        )
+      }
+    } else if (operation === "CONFIG_ACK") {
+      // Status 0x00 = applied, anything else = rejected (see ESP32/device_config.h)
+      const acks = decodedPayload.acks ?? []
+      for (const ack of acks) {
+        const result = ack.status === 0 ? "applied" : `rejected (0x${ack.status.toString(16)})`
+        console.log(`[MQTT Uplink] Config param 0x${ack.param.toString(16)} on ${decodedPayload.trashcanName}: ${result}`)
+      }
+    } else if (operation === "DIAGNOSTICS") {
+      // Worst memory figures since the previous diagnostics uplink (opt-in per device)
+      const d = decodedPayload
+      console.log(
+        `[MQTT Uplink] Diagnostics from ${d.trashcanName} (${d.samples} samples): ` +
+          `heap ${d.heapFreeKb} KB free, min ${d.heapMinFreeKb} KB, largest block ${d.heapLargestBlockKb} KB, ` +
+          `PSRAM min ${d.psramMinFreeKb} KB, SQLite ${d.sqliteMemoryKb} KB (cache ${d.sqliteCacheKb} KB), ` +
+          `stack free main/rfid/modem ${d.stackFree?.main}/${d.stackFree?.rfid}/${d.stackFree?.modem} B`
+      )
+    } else if (operation === "RECOVERY") {
+      // The device rebuilt its whitelist database (reasons in ESP32/golden_whitelist.h).
+      // Users added or removed after its last golden snapshot must be sent again.
+      const reason = decodedPayload.reason ?? 0
+      const reasons: Record<number, string> = {
+        0x01: "filesystem formatted",
+        0x02: "database did not open",
+        0x03: "database failed its integrity check",
+        0x04: "database unusable, running without a whitelist",
+      }
+      const snapshot = reason & 0x80 ? "no golden snapshot" : `${decodedPayload.usersRestored} users restored`
+      console.warn(
+        `[MQTT Uplink] Recovery on ${decodedPayload.trashcanName}: ${reasons[reason & 0x7f] ?? "unknown"}, ` +
+          `${snapshot}, ${decodedPayload.durationMs} ms - resend its whitelist changes`
+      )
+    } else if (operation === "OTA_STATUS") {
+      // Result of a delta firmware update (PATCH_* codes in ESP32/delta_patch.h)
+      const statuses: Record<number, string> = {
+        0x00: "installed",
+        0x01: "bad patch header",
+        0x02: "patch made for a different running image",
+        0x03: "corrupt patch",
+        0x04: "flash I/O error",
+        0x05: "rebuilt image did not match",
+        0x06: "image rejected by the bootloader checks",
+      }
+      const status = decodedPayload.status ?? 0
+      const image = (decodedPayload.imageCrc ?? 0).toString(16).padStart(8, "0")
+      const result = statuses[status] ?? `unknown status 0x${status.toString(16)}`
+      const log = status === 0 ? console.log : console.warn
+      log(`[MQTT Uplink] Firmware update on ${decodedPayload.trashcanName}: ${result} (image ${image})`)
+    } else if (operation === "INFERRED_CLEANUP") {
+      const { trashcanName, fillBefore, fillAfter, minutesAgo, channel } = decodedPayload
+
+      if (!trashcanName || fillBefore === undefined || fillAfter === undefined) {
+        console.error("[MQTT Uplink] Inferred cleanup message missing trashcanName, fillBefore, or fillAfter")
+        return
+      }
+
+      await handleInferredCleanupOperation(trashcanName, fillBefore, fillAfter, minutesAgo ?? 0, channel ?? 0)
+    } else if (operation === "JOURNAL") {
+      // Records of a journal upload requested by downlink (ESP32/event_journal.h).
+      // Frames may repeat after a retry; the 16-bit sequence identifies a record.
+      // Flag 0x80: time is device clock seconds (no network time yet), else Unix seconds.
+      const types: Record<number, string> = { 0x01: "cleanup", 0x02: "denied tap", 0x03: "report", 0x04: "reboot" }
+      const records = decodedPayload.records ?? []
+      for (const r of records) {
+        const time = r.flags & 0x80 ? `device clock ${r.time}s` : new Date(r.time * 1000).toISOString()
+        const data = r.data.map((b) => b.toString(16).padStart(2, "0")).join(" ")
+        console.log(
+          `[MQTT Uplink] Journal ${decodedPayload.trashcanName} #${r.sequence} ${time} ` +
+            `${types[r.type] ?? `type 0x${r.type.toString(16)}`} flags 0x${r.flags.toString(16)} [${data}]`
+        )
+      }
+      if (records.length < 3) {
+        console.log(`[MQTT Uplink] Journal upload from ${decodedPayload.trashcanName} complete`)
+      }
+    } else if (operation === "MULTICAST_ACK") {
+      // Downlinks are addressed by device ID, not by trashcan name
+      const deviceId = message.end_device_ids?.device_id
+      const { batchId, frameCount, bitmap } = decodedPayload
+
+      if (!deviceId || batchId === undefined || frameCount === undefined || !bitmap) {
+        console.error("[MQTT Uplink] Multicast ack missing device_id, batchId, frameCount, or bitmap")
+        return
+      }
+
+      await handleMulticastAck(deviceId, batchId, frameCount, bitmap)
     }
   } catch (error) {
     console.error("[MQTT Uplink] Error processing uplink message:", error)
@@ -0,0 +1,170 @@
+import { execFile } from "node:child_process"
+import { db } from "~/server/db"
+import type { RoutePlanQuery } from "~/server/api/schemas/route"
+
+// ============================================
+// ROUTE PLANNER
+// ============================================
+
+// Cleanup rounds from tools/route_planner (set ROUTE_PLANNER_BIN to its path).
+// Every trashcan with coordinates goes in with its last fill level and the
+// level its device forecast (minutesToFull) gives for when the round starts;
+// the planner picks the bins at or above minFill, splits them into cart trips
+// from the depot (ROUTE_DEPOT="lat,lng") and deals the trips to the crews.
+
+const ROUTE_PLANNER_TIMEOUT_MS = 5000
+
+type PlannerTrip = {
+  meters: number
+  minutes: number
+  load: number
+  bins: string[]
+}
+
+type PlannerOutput = {
+  bins: number
+  selected: number
+  meters: number
+  minutes: number
+  crews: { crew: number; meters: number; minutes: number; trips: PlannerTrip[] }[]
+  solver: { initialMeters: number; threads: number; iterations: number; ms: number }
+}
+
+export type RouteStop = {
+  id: string
+  name: string
+  location: string | null
+  latitude: number
+  longitude: number
+  capacityPct: number | null
+  forecastPct: number
+}
+
+export type RoutePlan = {
+  generatedAt: string
+  startsAt: string
+  bins: number
+  selected: number
+  meters: number
+  minutes: number // Until the last crew is done
+  crews: {
+    crew: number
+    meters: number
+    minutes: number
+    trips: { meters: number; minutes: number; load: number; stops: RouteStop[] }[]
+  }[]
+}
+
+// Fill level at a time, from the last report and its minutes-to-full forecast
+function forecastFill(capacityPct: number, minutesToFull: number | null, reportedAt: Date, at: Date) {
+  if (minutesToFull == null) return capacityPct
+  if (minutesToFull <= 0) return 100
+  const elapsedMin = Math.max(0, (at.getTime() - reportedAt.getTime()) / 60000)
+  return Math.min(100, capacityPct + ((100 - capacityPct) * elapsedMin) / minutesToFull)
+}
+
+function parseDepot(value: string | undefined): { lat: number; lng: number } | null {
+  if (!value) return null
+  const [lat, lng] = value.split(",").map((part) => Number(part.trim()))
+  if (lat === undefined || lng === undefined || !Number.isFinite(lat) || !Number.isFinite(lng)) return null
+  return { lat, lng }
+}
+
+function runPlanner(bin: string, args: string[], input: string): Promise<string> {
+  return new Promise((resolve, reject) => {
+    const child = execFile(
+      bin,
+      args,
+      { timeout: ROUTE_PLANNER_TIMEOUT_MS, maxBuffer: 16 * 1024 * 1024 },
+      (error, stdout, stderr) => {
+        if (error) reject(new Error(stderr.trim() || error.message))
+        else resolve(stdout)
+      }
+    )
+    child.stdin?.end(input)
+  })
+}
+
+/**
+ * Plan a cleanup round; null when ROUTE_PLANNER_BIN is not set
+ */
+export async function planCleanupRoutes(query: RoutePlanQuery): Promise<RoutePlan | null> {
+  const plannerBin = process.env.ROUTE_PLANNER_BIN
+  if (!plannerBin) return null
+
+  const trashcans = await db.trashcan.findMany({
+    where: {
+      latitude: { not: null },
+      longitude: { not: null },
+    },
+    orderBy: { name: "asc" },
+    include: {
+      statuses: {
+        orderBy: { hour: "desc" },
+        take: 1,
+        select: { capacityPct: true, minutesToFull: true, reportedAt: true },
+      },
+    },
+  })
+
+  const now = new Date()
+  const startsAt = new Date(now.getTime() + query.horizon * 60000)
+  const stops = new Map<string, RouteStop>()
+  for (const trashcan of trashcans) {
+    const status = trashcan.statuses[0]
+    stops.set(trashcan.id, {
+      id: trashcan.id,
+      name: trashcan.name,
+      location: trashcan.location,
+      latitude: trashcan.latitude!,
+      longitude: trashcan.longitude!,
+      capacityPct: status?.capacityPct ?? null,
+      forecastPct: status ? forecastFill(status.capacityPct, status.minutesToFull, status.reportedAt, startsAt) : 0,
+    })
+  }
+
+  // Without a configured depot, trips start from the middle of the bins
+  const depot = parseDepot(process.env.ROUTE_DEPOT) ?? {
+    lat: trashcans.reduce((sum, t) => sum + t.latitude!, 0) / Math.max(1, trashcans.length),
+    lng: trashcans.reduce((sum, t) => sum + t.longitude!, 0) / Math.max(1, trashcans.length),
+  }
+
+  const lines = [`depot ${depot.lat} ${depot.lng}`]
+  for (const stop of stops.values()) {
+    // Bins that never reported are left out of the round
+    if (stop.capacityPct == null) continue
+    lines.push(
+      `bin ${stop.id} ${stop.latitude} ${stop.longitude} ${stop.capacityPct.toFixed(1)} ${stop.forecastPct.toFixed(1)}`
+    )
+  }
+
+  const args = [
+    "--crews", String(query.crews),
+    "--capacity", String(query.capacity),
+    "--min-fill", String(query.minFill),
+  ]
+  const output = JSON.parse(await runPlanner(plannerBin, args, lines.join("\n") + "\n")) as PlannerOutput
+  console.log(
+    `[Route Planner] ${output.selected} of ${output.bins} bins, ${output.meters} m, ${output.solver.iterations} iterations in ${output.solver.ms} ms`
+  )
+
+  return {
+    generatedAt: now.toISOString(),
+    startsAt: startsAt.toISOString(),
+    bins: output.bins,
+    selected: output.selected,
+    meters: output.meters,
+    minutes: output.minutes,
+    crews: output.crews.map((crew) => ({
+      crew: crew.crew,
+      meters: crew.meters,
+      minutes: crew.minutes,
+      trips: crew.trips.map((trip) => ({
+        meters: trip.meters,
+        minutes: trip.minutes,
+        load: trip.load,
+        stops: trip.bins.map((id) => stops.get(id)).filter((stop): stop is RouteStop => stop !== undefined),
+      })),
+    })),
+  }
+}
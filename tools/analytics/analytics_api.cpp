@@ -0,0 +1,278 @@
+#include "analytics_api.h"
+
+#include <cstdio>
+#include <vector>
+
+#define API_DEFAULT_DAYS  14
+#define API_MAX_KEYS      4000   // Longest series one request may ask for
+
+bool parse_date(const std::string& text, int32_t& day) {
+  int year;
+  unsigned month, dom;
+  char tail;
+  if (sscanf(text.c_str(), "%4d-%2u-%2u%c", &year, &month, &dom, &tail) != 3) return false;
+  if (month < 1 || month > 12 || dom < 1 || dom > 31) return false;
+  day = days_from_civil(year, month, dom);
+  int32_t check_year;
+  uint32_t check_month, check_dom;
+  civil_from_days(day, check_year, check_month, check_dom);
+  return check_month == month && check_dom == dom;  // Rejects 2026-02-30
+}
+
+std::string format_date(int32_t day) {
+  int32_t year;
+  uint32_t month, dom;
+  civil_from_days(day, year, month, dom);
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%04d-%02u-%02u", (int)year, month, dom);
+  return buffer;
+}
+
+static void append_number(std::string& out, double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.10g", value);
+  out += buffer;
+}
+
+static void append_error(std::string& body, const char* message) {
+  body = "{\"error\":\"";
+  body += message;
+  body += "\"}";
+}
+
+// Range of rollup keys from the query; false (and body set) if invalid
+static bool parse_range(const AnalyticsEngine& engine, const HttpRequest& request, int64_t now_unix_ms,
+                        RollupLevel& level, int32_t& first, int32_t& last, std::string& body) {
+  auto by = request.query.find("by");
+  level = ROLLUP_DAY;
+  if (by != request.query.end()) {
+    if (by->second == "week") level = ROLLUP_WEEK;
+    else if (by->second == "month") level = ROLLUP_MONTH;
+    else if (by->second != "day") {
+      append_error(body, "by must be day, week or month");
+      return false;
+    }
+  }
+
+  int32_t to_day = engine.local_day(now_unix_ms);
+  int32_t from_day = to_day - (API_DEFAULT_DAYS - 1);
+  auto from = request.query.find("from");
+  auto to = request.query.find("to");
+  if ((from != request.query.end() && !parse_date(from->second, from_day)) ||
+      (to != request.query.end() && !parse_date(to->second, to_day))) {
+    append_error(body, "dates must be YYYY-MM-DD");
+    return false;
+  }
+  first = rollup_key(level, from_day);
+  last = rollup_key(level, to_day);
+  if (last < first || last - first >= API_MAX_KEYS) {
+    append_error(body, "from must not be after to, nor too far before it");
+    return false;
+  }
+  return true;
+}
+
+static void usage_json(const RollupSet* rollups, RollupLevel level, int32_t first, int32_t last, std::string& body) {
+  static const Rollup empty;
+  body = "[";
+  for (int32_t key = first; key <= last; key++) {
+    const Rollup* rollup = rollups ? rollups->table(level).find(key) : nullptr;
+    if (!rollup) rollup = &empty;
+    if (key > first) body += ',';
+    body += "{\"start\":\"" + format_date(rollup_first_day(level, key)) + "\",\"useCount\":";
+    body += std::to_string(rollup->use);
+    body += ",\"avgFill\":";
+    if (rollup->hours > 0) append_number(body, fill_pct_of(1) * (double)rollup->fill_sum / rollup->hours);
+    else body += "null";
+    body += ",\"maxFill\":";
+    append_number(body, fill_pct_of(rollup->fill_max));
+    body += ",\"hours\":" + std::to_string(rollup->hours);
+    body += ",\"cleanups\":" + std::to_string(rollup->cleanups) + "}";
+  }
+  body += "]";
+}
+
+static void cleanups_json(const RollupSet* rollups, RollupLevel level, int32_t first, int32_t last,
+                          std::string& body) {
+  body = "[";
+  for (int32_t key = first; key <= last; key++) {
+    const Rollup* rollup = rollups ? rollups->table(level).find(key) : nullptr;
+    if (key > first) body += ',';
+    body += "{\"start\":\"" + format_date(rollup_first_day(level, key)) + "\",\"count\":";
+    body += std::to_string(rollup ? rollup->cleanups : 0) + "}";
+  }
+  body += "]";
+}
+
+static int hours_json(const AnalyticsEngine& engine, const TrashcanHistory* trashcan, bool fleet,
+                      const HttpRequest& request, int64_t now_unix_ms, std::string& body) {
+  int32_t day = engine.local_day(now_unix_ms);
+  auto date = request.query.find("date");
+  if (date != request.query.end() && !parse_date(date->second, day)) {
+    append_error(body, "date must be YYYY-MM-DD");
+    return 400;
+  }
+
+  uint64_t use[24] = {};
+  float fill[24];
+  for (float& f : fill) f = -1.0f;
+  if (trashcan || fleet) engine.day_hours(trashcan, day, use, fill);
+
+  body = "[";
+  for (int h = 0; h < 24; h++) {
+    if (h > 0) body += ',';
+    body += "{\"hour\":" + std::to_string(h) + ",\"useCount\":" + std::to_string(use[h]) + ",\"fill\":";
+    if (fill[h] >= 0) append_number(body, fill[h]);
+    else body += "null";
+    body += "}";
+  }
+  body += "]";
+  return 200;
+}
+
+// Mean uses per reported hour, by hour of day and by weekday and hour, and
+// mean motion wakes per 10 minutes of the day (histograms, over the same
+// reported hours)
+static void peak_hours_json(const RollupSet* rollups, std::string& body) {
+  static const uint64_t no_use[HOURS_PER_WEEK] = {};
+  static const uint32_t no_hours[HOURS_PER_WEEK] = {};
+  static const uint32_t no_slots[SLOTS_PER_WEEK] = {};
+  const uint64_t* use = rollups ? rollups->hour_of_week_use() : no_use;
+  const uint32_t* hours = rollups ? rollups->hour_of_week_hours() : no_hours;
+  const uint32_t* slots = rollups ? rollups->slot_of_week_use() : no_slots;
+
+  double by_hour[24];
+  int peak_hour = 0;
+  for (int h = 0; h < 24; h++) {
+    uint64_t use_sum = 0, hour_sum = 0;
+    for (int d = 0; d < 7; d++) {
+      use_sum += use[d * 24 + h];
+      hour_sum += hours[d * 24 + h];
+    }
+    by_hour[h] = hour_sum ? (double)use_sum / hour_sum : 0.0;
+    if (by_hour[h] > by_hour[peak_hour]) peak_hour = h;
+  }
+  int peak_slot = 0;
+  double peak_slot_mean = 0;
+  for (int s = 0; s < HOURS_PER_WEEK; s++) {
+    double mean = hours[s] ? (double)use[s] / hours[s] : 0.0;
+    if (mean > peak_slot_mean) {
+      peak_slot_mean = mean;
+      peak_slot = s;
+    }
+  }
+
+  double by_slot[SLOTS_PER_DAY];
+  int peak_day_slot = -1;
+  for (int s = 0; s < SLOTS_PER_DAY; s++) {
+    int h = s * SLOT_MINUTES / 60;
+    uint64_t slot_sum = 0, hour_sum = 0;
+    for (int d = 0; d < 7; d++) {
+      slot_sum += slots[d * SLOTS_PER_DAY + s];
+      hour_sum += hours[d * 24 + h];
+    }
+    by_slot[s] = hour_sum ? (double)slot_sum / hour_sum : 0.0;
+    if (by_slot[s] > 0 && (peak_day_slot < 0 || by_slot[s] > by_slot[peak_day_slot])) peak_day_slot = s;
+  }
+
+  body = "{\"byHour\":[";
+  for (int h = 0; h < 24; h++) {
+    if (h > 0) body += ',';
+    append_number(body, by_hour[h]);
+  }
+  body += "],\"byWeekday\":[";  // Monday first
+  for (int d = 0; d < 7; d++) {
+    body += d > 0 ? ",[" : "[";
+    for (int h = 0; h < 24; h++) {
+      if (h > 0) body += ',';
+      int s = d * 24 + h;
+      append_number(body, hours[s] ? (double)use[s] / hours[s] : 0.0);
+    }
+    body += "]";
+  }
+  body += "],\"peakHour\":" + std::to_string(peak_hour);
+  body += ",\"peakWeekday\":" + std::to_string(peak_slot / 24);
+  body += ",\"peakWeekdayHour\":" + std::to_string(peak_slot % 24);
+  body += ",\"bySlot\":[";
+  for (int s = 0; s < SLOTS_PER_DAY; s++) {
+    if (s > 0) body += ',';
+    append_number(body, by_slot[s]);
+  }
+  body += "],\"peakSlot\":";
+  if (peak_day_slot < 0) {
+    body += "null}";
+  } else {
+    char label[16];
+    int minute = peak_day_slot * SLOT_MINUTES;
+    snprintf(label, sizeof(label), "%02d:%02d", minute / 60, minute % 60);
+    body += "\"" + std::string(label) + "\"}";
+  }
+}
+
+static void stats_json(const AnalyticsEngine& engine, std::string& body) {
+  EngineStats stats = engine.stats();
+  body = "{\"trashcans\":" + std::to_string(stats.trashcans);
+  body += ",\"users\":" + std::to_string(stats.users);
+  body += ",\"rows\":" + std::to_string(stats.rows);
+  body += ",\"blocks\":" + std::to_string(stats.blocks);
+  body += ",\"cleanups\":" + std::to_string(stats.cleanups);
+  body += ",\"histograms\":" + std::to_string(stats.histograms);
+  body += ",\"columnBytes\":" + std::to_string(stats.column_bytes);
+  body += ",\"rowStoreBytes\":" + std::to_string(stats.rows * ENGINE_ROW_BYTES);
+  body += ",\"rollupBytes\":" + std::to_string(stats.rollup_bytes) + "}";
+}
+
+int analytics_handle(const AnalyticsEngine& engine, const HttpRequest& request, int64_t now_unix_ms,
+                     std::string& body) {
+  // /{collection}/{id}/{view} or /fleet/{view}
+  std::vector<std::string> parts;
+  for (size_t start = 1; start <= request.path.size();) {
+    size_t slash = request.path.find('/', start);
+    if (slash == std::string::npos) slash = request.path.size();
+    if (slash > start) parts.push_back(request.path.substr(start, slash - start));
+    start = slash + 1;
+  }
+
+  if (parts.size() == 1 && parts[0] == "stats") {
+    stats_json(engine, body);
+    return 200;
+  }
+
+  const RollupSet* rollups = nullptr;
+  const TrashcanHistory* trashcan = nullptr;
+  bool fleet = false;
+  std::string view;
+  if (parts.size() == 2 && parts[0] == "fleet") {
+    rollups = &engine.fleet();
+    fleet = true;
+    view = parts[1];
+  } else if (parts.size() == 3 && parts[0] == "trashcans") {
+    trashcan = engine.trashcan(parts[1]);
+    rollups = trashcan ? &trashcan->rollups : nullptr;
+    view = parts[2];
+  } else if (parts.size() == 3 && parts[0] == "users" && parts[2] == "cleanups") {
+    RollupLevel level;
+    int32_t first, last;
+    if (!parse_range(engine, request, now_unix_ms, level, first, last, body)) return 400;
+    cleanups_json(engine.user(parts[1]), level, first, last, body);
+    return 200;
+  } else {
+    append_error(body, "not found");
+    return 404;
+  }
+
+  if (view == "usage") {
+    RollupLevel level;
+    int32_t first, last;
+    if (!parse_range(engine, request, now_unix_ms, level, first, last, body)) return 400;
+    usage_json(rollups, level, first, last, body);
+    return 200;
+  }
+  if (view == "hours") return hours_json(engine, trashcan, fleet, request, now_unix_ms, body);
+  if (view == "peak-hours") {
+    peak_hours_json(rollups, body);
+    return 200;
+  }
+  append_error(body, "not found");
+  return 404;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "analytics_engine.h"
+#include "http_server.h"
+
+// ============================================
+// Analytics API
+// ============================================
+//
+// JSON answers for the dashboard, straight from the rollups (dates are
+// local YYYY-MM-DD; from/to default to the last 14 days, both included):
+//   GET /trashcans/{id}/usage?by=day|week|month&from=&to=
+//       [{"start","useCount","avgFill","maxFill","hours","cleanups"}]
+//   GET /trashcans/{id}/hours?date=         24 x {"hour","useCount","fill"}
+//   GET /trashcans/{id}/peak-hours          mean uses per reported hour, and
+//       per 10 minutes of the day ("bySlot", "peakSlot" HH:MM or null)
+//   GET /fleet/usage, /fleet/hours, /fleet/peak-hours   (all trashcans)
+//   GET /users/{id}/cleanups?by=&from=&to=  [{"start","count"}]
+//   GET /stats
+// Fill levels are percents; avgFill and fill are null without reports.
+// Unknown ids answer with empty (all-zero) series, like a trashcan that
+// has not reported yet.
+
+// Route one request; returns the HTTP status
+int analytics_handle(const AnalyticsEngine& engine, const HttpRequest& request, int64_t now_unix_ms,
+                     std::string& body);
+
+// YYYY-MM-DD <-> days since the epoch; false if invalid
+bool parse_date(const std::string& text, int32_t& day);
+std::string format_date(int32_t day);
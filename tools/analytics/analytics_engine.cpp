@@ -0,0 +1,129 @@
+#include "analytics_engine.h"
+
+void AnalyticsEngine::set_hour(const std::string& trashcan_id, int32_t utc_hour, float fill_pct, uint32_t use) {
+  std::unique_ptr<TrashcanHistory>& entry = trashcans_[trashcan_id];
+  if (!entry) entry.reset(new TrashcanHistory());
+  TrashcanHistory& history = *entry;
+
+  HourValue value = {fill_quantize(fill_pct), use};
+  HourValue previous;
+  bool existed = history.series.set(utc_hour, value, &previous);
+  if (existed && previous.fill == value.fill && previous.use == value.use) return;
+
+  int32_t local_hour = utc_hour + utc_offset_h_;
+  int32_t day = floor_div(local_hour, 24);
+  if (history.rollups.apply(local_hour, existed ? &previous : nullptr, value)) {
+    recompute_day_max(history, day);
+  }
+
+  // The fleet's maximum is the largest of the trashcans' maxima
+  if (fleet_.apply(local_hour, existed ? &previous : nullptr, value)) {
+    uint8_t max = 0;
+    for (const auto& other : trashcans_) {
+      const Rollup* rollup = other.second->rollups.table(ROLLUP_DAY).find(day);
+      if (rollup && rollup->fill_max > max) max = rollup->fill_max;
+    }
+    fleet_.set_day_fill_max(day, max);
+  }
+}
+
+void AnalyticsEngine::recompute_day_max(TrashcanHistory& history, int32_t day) {
+  int32_t from = day * 24 - utc_offset_h_;
+  uint8_t max = 0;
+  history.series.scan(from, from + 24, [&](int32_t, uint8_t fill, uint32_t) {
+    if (fill > max) max = fill;
+  });
+  history.rollups.set_day_fill_max(day, max);
+}
+
+void AnalyticsEngine::add_cleanup(const std::string& trashcan_id, const std::string& user_id, int64_t unix_ms) {
+  int32_t day = local_day(unix_ms);
+
+  std::unique_ptr<TrashcanHistory>& history = trashcans_[trashcan_id];
+  if (!history) history.reset(new TrashcanHistory());
+  history->rollups.add_cleanup(day);
+
+  std::unique_ptr<RollupSet>& user = users_[user_id];
+  if (!user) user.reset(new RollupSet());
+  user->add_cleanup(day);
+
+  fleet_.add_cleanup(day);
+  cleanups_++;
+}
+
+void AnalyticsEngine::add_histogram(const std::string& trashcan_id, int64_t reported_unix_ms, uint32_t bin_minutes,
+                                    const uint32_t* bins, size_t count) {
+  std::unique_ptr<TrashcanHistory>& history = trashcans_[trashcan_id];
+  if (!history) history.reset(new TrashcanHistory());
+
+  int64_t bin_ms = (int64_t)bin_minutes * 60000;
+  for (size_t i = 0; i < count; i++) {
+    if (bins[i] == 0) continue;
+    int64_t middle_ms = reported_unix_ms - (int64_t)(count - i) * bin_ms + bin_ms / 2;
+    int64_t local_minute = middle_ms / 60000 - (middle_ms % 60000 < 0) + (int64_t)utc_offset_h_ * 60;
+    history->rollups.add_slot_use(local_minute, bins[i]);
+    fleet_.add_slot_use(local_minute, bins[i]);
+  }
+  histograms_++;
+}
+
+void AnalyticsEngine::seal(int64_t now_unix_ms) {
+  int32_t now_hour = (int32_t)(now_unix_ms / 3600000);
+  for (auto& entry : trashcans_) entry.second->series.seal(now_hour);
+}
+
+const TrashcanHistory* AnalyticsEngine::trashcan(const std::string& id) const {
+  auto it = trashcans_.find(id);
+  return it == trashcans_.end() ? nullptr : it->second.get();
+}
+
+const RollupSet* AnalyticsEngine::user(const std::string& id) const {
+  auto it = users_.find(id);
+  return it == users_.end() ? nullptr : it->second.get();
+}
+
+void AnalyticsEngine::day_hours(const TrashcanHistory* trashcan, int32_t day, uint64_t use[24], float fill[24]) const {
+  uint64_t fill_sum[24] = {};
+  uint32_t reports[24] = {};
+  for (int h = 0; h < 24; h++) use[h] = 0;
+
+  int32_t from = day * 24 - utc_offset_h_;
+  auto add = [&](int32_t hour, uint8_t fill_q, uint32_t count) {
+    int h = hour - from;
+    use[h] += count;
+    fill_sum[h] += fill_q;
+    reports[h]++;
+  };
+  if (trashcan) {
+    trashcan->series.scan(from, from + 24, add);
+  } else {
+    for (const auto& entry : trashcans_) entry.second->series.scan(from, from + 24, add);
+  }
+
+  for (int h = 0; h < 24; h++) {
+    fill[h] = reports[h] ? fill_pct_of(1) * (float)fill_sum[h] / (float)reports[h] : -1.0f;
+  }
+}
+
+int32_t AnalyticsEngine::local_day(int64_t unix_ms) const {
+  int64_t local_hour = unix_ms / 3600000 - (unix_ms % 3600000 < 0) + utc_offset_h_;
+  return floor_div((int32_t)local_hour, 24);
+}
+
+EngineStats AnalyticsEngine::stats() const {
+  EngineStats stats;
+  stats.trashcans = trashcans_.size();
+  stats.users = users_.size();
+  stats.cleanups = cleanups_;
+  stats.histograms = histograms_;
+  stats.rollup_bytes = fleet_.bytes();
+  for (const auto& entry : trashcans_) {
+    const TrashcanHistory& history = *entry.second;
+    stats.rows += history.series.rows();
+    stats.blocks += history.series.blocks();
+    stats.column_bytes += history.series.bytes();
+    stats.rollup_bytes += history.rollups.bytes();
+  }
+  for (const auto& entry : users_) stats.rollup_bytes += entry.second->bytes();
+  return stats;
+}
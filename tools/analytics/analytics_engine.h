@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "hour_series.h"
+#include "rollup.h"
+
+// ============================================
+// Analytics Engine
+// ============================================
+//
+// Fill and usage history of every trashcan, its rollups, and the fleet's and
+// each worker's rollups, all in memory. Writes are idempotent: an hour is set
+// to the values of its Status row(s), so the source can re-read the recent
+// hours as often as it likes, and only the difference reaches the rollups.
+//
+// Hours are UTC hours since the epoch; days, weeks, months and hours of the
+// week are local, shifted by utc_offset_h.
+//
+// Usage histograms (one per report) feed the 10-minute slots of the week.
+// They only add up, so the source passes each one once. A bin is counted in
+// the slot of its midpoint; the last bin of a report ends at the report time.
+
+struct TrashcanHistory {
+  HourSeries series;
+  RollupSet  rollups;
+};
+
+struct EngineStats {
+  size_t   trashcans = 0;
+  size_t   users = 0;
+  uint64_t rows = 0;
+  size_t   blocks = 0;
+  size_t   column_bytes = 0;   // Column blocks and tails
+  size_t   rollup_bytes = 0;
+  uint64_t cleanups = 0;
+  uint64_t histograms = 0;
+};
+
+// Row-store size of the same rows, for comparison: hour, fill and use as
+// 32-bit fields
+#define ENGINE_ROW_BYTES  12
+
+class AnalyticsEngine {
+ public:
+  explicit AnalyticsEngine(int32_t utc_offset_h) : utc_offset_h_(utc_offset_h) {}
+
+  // Set one hour of a trashcan (fill in percent, use summed over the hour)
+  void set_hour(const std::string& trashcan_id, int32_t utc_hour, float fill_pct, uint32_t use);
+  void add_cleanup(const std::string& trashcan_id, const std::string& user_id, int64_t unix_ms);
+  void add_histogram(const std::string& trashcan_id, int64_t reported_unix_ms, uint32_t bin_minutes,
+                     const uint32_t* bins, size_t count);
+
+  // Compress settled hours (call now and then)
+  void seal(int64_t now_unix_ms);
+
+  const TrashcanHistory* trashcan(const std::string& id) const;
+  const RollupSet* user(const std::string& id) const;
+  const RollupSet& fleet() const { return fleet_; }
+
+  // Use and fill (percent, negative = no report) of each hour of a local
+  // day, for one trashcan or (nullptr) summed and averaged over the fleet
+  void day_hours(const TrashcanHistory* trashcan, int32_t day, uint64_t use[24], float fill[24]) const;
+
+  int32_t local_day(int64_t unix_ms) const;
+  int32_t utc_offset_h() const { return utc_offset_h_; }
+  EngineStats stats() const;
+
+ private:
+  void recompute_day_max(TrashcanHistory& history, int32_t day);
+
+  int32_t utc_offset_h_;
+  std::unordered_map<std::string, std::unique_ptr<TrashcanHistory>> trashcans_;
+  std::unordered_map<std::string, std::unique_ptr<RollupSet>> users_;
+  RollupSet fleet_;
+  uint64_t cleanups_ = 0;
+  uint64_t histograms_ = 0;
+};
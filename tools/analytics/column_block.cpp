@@ -0,0 +1,123 @@
+#include "column_block.h"
+
+static void put_varint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+static uint32_t get_varint(const uint8_t*& p) {
+  uint32_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t byte = *p++;
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return value;
+  }
+}
+
+static uint8_t packed_width(uint32_t range) {
+  uint8_t width = 0;
+  while (width < 32 && (uint64_t)range >= (1ULL << width)) width = width ? width * 2 : 1;
+  return width;
+}
+
+ColumnBlock column_block_encode(const int32_t* hours, const uint8_t* fill, const uint32_t* use, uint32_t rows) {
+  ColumnBlock block;
+  block.rows = rows;
+  if (rows == 0) return block;
+  block.first_hour = hours[0];
+  block.last_hour = hours[rows - 1];
+
+  // Hours: (delta, run)
+  for (uint32_t i = 1; i < rows;) {
+    uint32_t delta = (uint32_t)(hours[i] - hours[i - 1]);
+    uint32_t run = 1;
+    while (i + run < rows && (uint32_t)(hours[i + run] - hours[i + run - 1]) == delta) run++;
+    put_varint(block.hours, delta);
+    put_varint(block.hours, run);
+    i += run;
+  }
+
+  // Fill: (value, run)
+  for (uint32_t i = 0; i < rows;) {
+    uint32_t run = 1;
+    while (i + run < rows && run < 255 && fill[i + run] == fill[i]) run++;
+    block.fill.push_back(fill[i]);
+    block.fill.push_back((uint8_t)run);
+    block.fill_sum += (uint64_t)fill[i] * run;
+    if (fill[i] > block.fill_max) block.fill_max = fill[i];
+    i += run;
+  }
+
+  // Use: frame of reference, bit packed
+  uint32_t min = use[0], max = use[0];
+  for (uint32_t i = 0; i < rows; i++) {
+    if (use[i] < min) min = use[i];
+    if (use[i] > max) max = use[i];
+    block.use_sum += use[i];
+  }
+  block.use_base = min;
+  block.use_bits = packed_width(max - min);
+  if (block.use_bits > 0) {
+    uint32_t per_word = 64 / block.use_bits;
+    block.use.assign((rows + per_word - 1) / per_word, 0);
+    for (uint32_t i = 0; i < rows; i++) {
+      block.use[i / per_word] |= (uint64_t)(use[i] - min) << ((i % per_word) * block.use_bits);
+    }
+  }
+  return block;
+}
+
+template <unsigned Width>
+static void unpack(const uint64_t* words, size_t word_count, uint32_t base, uint32_t* out) {
+  constexpr unsigned per_word = 64 / Width;
+  constexpr uint64_t mask = Width == 64 ? ~0ULL : (1ULL << Width) - 1;
+  for (size_t w = 0; w < word_count; w++) {
+    uint64_t word = words[w];
+    for (unsigned j = 0; j < per_word; j++) {
+      out[w * per_word + j] = base + (uint32_t)((word >> (j * Width)) & mask);
+    }
+  }
+}
+
+void column_block_decode(const ColumnBlock& block, int32_t* hours, uint8_t* fill, uint32_t* use) {
+  if (block.rows == 0) return;
+
+  if (hours) {
+    const uint8_t* p = block.hours.data();
+    const uint8_t* end = p + block.hours.size();
+    uint32_t n = 0;
+    int32_t hour = block.first_hour;
+    hours[n++] = hour;
+    while (p < end) {
+      uint32_t delta = get_varint(p);
+      uint32_t run = get_varint(p);
+      for (uint32_t j = 0; j < run; j++) hours[n++] = hour += (int32_t)delta;
+    }
+  }
+
+  if (fill) {
+    uint32_t n = 0;
+    for (size_t i = 0; i + 1 < block.fill.size(); i += 2) {
+      for (uint8_t j = 0; j < block.fill[i + 1]; j++) fill[n++] = block.fill[i];
+    }
+  }
+
+  if (use) {
+    const uint64_t* words = block.use.data();
+    size_t count = block.use.size();
+    switch (block.use_bits) {
+      case 0:
+        for (uint32_t i = 0; i < block.rows; i++) use[i] = block.use_base;
+        break;
+      case 1:  unpack<1>(words, count, block.use_base, use); break;
+      case 2:  unpack<2>(words, count, block.use_base, use); break;
+      case 4:  unpack<4>(words, count, block.use_base, use); break;
+      case 8:  unpack<8>(words, count, block.use_base, use); break;
+      case 16: unpack<16>(words, count, block.use_base, use); break;
+      default: unpack<32>(words, count, block.use_base, use); break;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ============================================
+// Column Block
+// ============================================
+//
+// Up to a few thousand hourly rows of one trashcan, stored column by column:
+//   hours  first hour, then (delta, run) pairs of varints: a bin reporting
+//          every hour is a single pair
+//   fill   (value, run) byte pairs, in half-percent units: a bin's level
+//          holds still overnight and between uses
+//   use    frame of reference (block minimum) and bit packing at a power-of-
+//          two width (0, 1, 2, 4, 8, 16 or 32 bits), so a value never spans
+//          two 64-bit words and the unpack loop is a fixed shift-and-mask per
+//          lane that the compiler vectorizes
+// The block also keeps its sums and maxima (a zone map), so queries that
+// cover the whole block never decode it.
+
+#define COLUMN_BLOCK_ROWS   1024   // Rows per sealed block (about six weeks of hours)
+#define FILL_QUANTUM_PCT    0.5f   // Fill levels are stored in half percents
+
+struct ColumnBlock {
+  int32_t  first_hour = 0;         // UTC hours since the Unix epoch
+  int32_t  last_hour = 0;
+  uint32_t rows = 0;
+  uint64_t use_sum = 0;
+  uint64_t fill_sum = 0;           // Half percents
+  uint8_t  fill_max = 0;
+  uint8_t  use_bits = 0;
+  uint32_t use_base = 0;
+  std::vector<uint8_t>  hours;
+  std::vector<uint8_t>  fill;
+  std::vector<uint64_t> use;
+
+  size_t bytes() const { return sizeof(*this) + hours.size() + fill.size() + use.size() * sizeof(uint64_t); }
+};
+
+inline uint8_t fill_quantize(float fill_pct) {
+  if (!(fill_pct > 0)) return 0;
+  if (fill_pct >= 100) return (uint8_t)(100 / FILL_QUANTUM_PCT);
+  return (uint8_t)(fill_pct / FILL_QUANTUM_PCT + 0.5f);
+}
+
+inline float fill_pct_of(uint32_t quantized) {
+  return quantized * FILL_QUANTUM_PCT;
+}
+
+// Rows must be in increasing hour order
+ColumnBlock column_block_encode(const int32_t* hours, const uint8_t* fill, const uint32_t* use, uint32_t rows);
+
+// Decode the columns asked for (nullptr skips one). Outputs need
+// column_block_capacity(rows) entries: the use column unpacks whole words.
+void column_block_decode(const ColumnBlock& block, int32_t* hours, uint8_t* fill, uint32_t* use);
+
+inline size_t column_block_capacity(uint32_t rows) {
+  return ((size_t)rows + 63) / 64 * 64;
+}
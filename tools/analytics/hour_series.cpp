@@ -0,0 +1,118 @@
+#include "hour_series.h"
+
+#include <algorithm>
+
+bool HourSeries::set(int32_t hour, HourValue value, HourValue* previous) {
+  // Most writes are for the newest hours
+  if (blocks_.empty() || hour > blocks_.back().last_hour) {
+    auto at = std::lower_bound(tail_hours_.begin(), tail_hours_.end(), hour);
+    size_t i = (size_t)(at - tail_hours_.begin());
+    if (at != tail_hours_.end() && *at == hour) {
+      if (previous) *previous = {tail_fill_[i], tail_use_[i]};
+      tail_fill_[i] = value.fill;
+      tail_use_[i] = value.use;
+      return true;
+    }
+    tail_hours_.insert(at, hour);
+    tail_fill_.insert(tail_fill_.begin() + i, value.fill);
+    tail_use_.insert(tail_use_.begin() + i, value.use);
+    return false;
+  }
+
+  auto block = std::lower_bound(blocks_.begin(), blocks_.end(), hour,
+                                [](const ColumnBlock& b, int32_t h) { return b.last_hour < h; });
+  return set_sealed((size_t)(block - blocks_.begin()), hour, value, previous);
+}
+
+bool HourSeries::set_sealed(size_t index, int32_t hour, HourValue value, HourValue* previous) {
+  ColumnBlock& block = blocks_[index];
+  BlockBuffer buffer;
+  buffer.decode(block);
+
+  std::vector<int32_t> hours(buffer.hours.begin(), buffer.hours.begin() + block.rows);
+  std::vector<uint8_t> fill(buffer.fill.begin(), buffer.fill.begin() + block.rows);
+  std::vector<uint32_t> use(buffer.use.begin(), buffer.use.begin() + block.rows);
+
+  auto at = std::lower_bound(hours.begin(), hours.end(), hour);
+  size_t i = (size_t)(at - hours.begin());
+  bool existed = at != hours.end() && *at == hour;
+  if (existed) {
+    if (previous) *previous = {fill[i], use[i]};
+    fill[i] = value.fill;
+    use[i] = value.use;
+  } else {
+    hours.insert(at, hour);
+    fill.insert(fill.begin() + i, value.fill);
+    use.insert(use.begin() + i, value.use);
+  }
+  block = column_block_encode(hours.data(), fill.data(), use.data(), (uint32_t)hours.size());
+  return existed;
+}
+
+void HourSeries::seal(int32_t now_hour) {
+  size_t settled = (size_t)(std::lower_bound(tail_hours_.begin(), tail_hours_.end(),
+                                             now_hour - SERIES_SETTLE_HOURS) - tail_hours_.begin());
+  size_t sealed = 0;
+  while (settled - sealed >= COLUMN_BLOCK_ROWS) {
+    blocks_.push_back(column_block_encode(tail_hours_.data() + sealed, tail_fill_.data() + sealed,
+                                          tail_use_.data() + sealed, COLUMN_BLOCK_ROWS));
+    sealed += COLUMN_BLOCK_ROWS;
+  }
+  if (sealed == 0) return;
+  tail_hours_.erase(tail_hours_.begin(), tail_hours_.begin() + sealed);
+  tail_fill_.erase(tail_fill_.begin(), tail_fill_.begin() + sealed);
+  tail_use_.erase(tail_use_.begin(), tail_use_.begin() + sealed);
+}
+
+RangeTotals HourSeries::totals(int32_t from, int32_t to) const {
+  RangeTotals totals;
+  auto add = [&](int32_t, uint8_t fill, uint32_t use) {
+    totals.use += use;
+    totals.fill_sum += fill;
+    totals.hours++;
+    if (fill > totals.fill_max) totals.fill_max = fill;
+  };
+
+  thread_local BlockBuffer buffer;
+  for (const ColumnBlock& block : blocks_) {
+    if (block.last_hour < from) continue;
+    if (block.first_hour >= to) return totals;
+    if (block.first_hour >= from && block.last_hour < to) {
+      totals.use += block.use_sum;
+      totals.fill_sum += block.fill_sum;
+      totals.hours += block.rows;
+      if (block.fill_max > totals.fill_max) totals.fill_max = block.fill_max;
+      continue;
+    }
+    buffer.decode(block);
+    for (uint32_t i = 0; i < block.rows; i++) {
+      if (buffer.hours[i] >= from && buffer.hours[i] < to) add(buffer.hours[i], buffer.fill[i], buffer.use[i]);
+    }
+  }
+  for (size_t i = 0; i < tail_hours_.size() && tail_hours_[i] < to; i++) {
+    if (tail_hours_[i] >= from) add(tail_hours_[i], tail_fill_[i], tail_use_[i]);
+  }
+  return totals;
+}
+
+uint64_t HourSeries::rows() const {
+  uint64_t rows = tail_hours_.size();
+  for (const ColumnBlock& block : blocks_) rows += block.rows;
+  return rows;
+}
+
+size_t HourSeries::bytes() const {
+  size_t bytes = tail_hours_.size() * (sizeof(int32_t) + sizeof(uint8_t) + sizeof(uint32_t));
+  for (const ColumnBlock& block : blocks_) bytes += block.bytes();
+  return bytes;
+}
+
+int32_t HourSeries::first_hour() const {
+  if (!blocks_.empty()) return blocks_.front().first_hour;
+  return tail_hours_.empty() ? INT32_MAX : tail_hours_.front();
+}
+
+int32_t HourSeries::last_hour() const {
+  if (!tail_hours_.empty()) return tail_hours_.back();
+  return blocks_.empty() ? INT32_MIN : blocks_.back().last_hour;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "column_block.h"
+
+// ============================================
+// Hour Series
+// ============================================
+//
+// One trashcan's hourly history: sealed column blocks, oldest first, then an
+// uncompressed tail of the most recent rows. Status rows of the current hour
+// keep changing (every report upserts them), so rows stay in the tail until
+// they are SERIES_SETTLE_HOURS old and a whole block of them can be sealed.
+// A late change to a sealed hour decodes and re-encodes its block.
+
+#define SERIES_SETTLE_HOURS  48
+
+struct HourValue {
+  uint8_t  fill;     // Half percents
+  uint32_t use;
+};
+
+struct RangeTotals {
+  uint64_t use = 0;
+  uint64_t fill_sum = 0;
+  uint32_t hours = 0;
+  uint8_t  fill_max = 0;
+};
+
+class HourSeries {
+ public:
+  // Set an hour's values; returns true and the previous values if it had some
+  bool set(int32_t hour, HourValue value, HourValue* previous);
+
+  // Seal tail rows older than now_hour - SERIES_SETTLE_HOURS into blocks
+  void seal(int32_t now_hour);
+
+  // fn(hour, fill, use) for the rows with from <= hour < to, in order
+  template <typename Fn>
+  void scan(int32_t from, int32_t to, Fn fn) const;
+
+  // Totals over from <= hour < to; whole blocks come from their zone maps
+  RangeTotals totals(int32_t from, int32_t to) const;
+
+  uint64_t rows() const;
+  size_t blocks() const { return blocks_.size(); }
+  size_t bytes() const;            // Compressed blocks plus tail
+  int32_t first_hour() const;
+  int32_t last_hour() const;
+
+ private:
+  bool set_sealed(size_t block, int32_t hour, HourValue value, HourValue* previous);
+
+  std::vector<ColumnBlock> blocks_;
+  std::vector<int32_t>  tail_hours_;
+  std::vector<uint8_t>  tail_fill_;
+  std::vector<uint32_t> tail_use_;
+};
+
+// Decode buffers for scans (per thread)
+struct BlockBuffer {
+  std::vector<int32_t>  hours;
+  std::vector<uint8_t>  fill;
+  std::vector<uint32_t> use;
+
+  void decode(const ColumnBlock& block) {
+    size_t capacity = column_block_capacity(block.rows);
+    if (hours.size() < capacity) {
+      hours.resize(capacity);
+      fill.resize(capacity);
+      use.resize(capacity);
+    }
+    column_block_decode(block, hours.data(), fill.data(), use.data());
+  }
+};
+
+template <typename Fn>
+void HourSeries::scan(int32_t from, int32_t to, Fn fn) const {
+  thread_local BlockBuffer buffer;
+  for (const ColumnBlock& block : blocks_) {
+    if (block.last_hour < from) continue;
+    if (block.first_hour >= to) return;
+    buffer.decode(block);
+    for (uint32_t i = 0; i < block.rows; i++) {
+      if (buffer.hours[i] >= from && buffer.hours[i] < to) fn(buffer.hours[i], buffer.fill[i], buffer.use[i]);
+    }
+  }
+  for (size_t i = 0; i < tail_hours_.size(); i++) {
+    if (tail_hours_[i] >= to) return;
+    if (tail_hours_[i] >= from) fn(tail_hours_[i], tail_fill_[i], tail_use_[i]);
+  }
+}
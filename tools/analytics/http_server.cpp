@@ -0,0 +1,189 @@
+#include "http_server.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <chrono>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HTTP_MAX_CONNECTIONS   64
+#define HTTP_MAX_REQUEST       8192
+#define HTTP_REQUEST_TIMEOUT_MS 5000
+
+static int64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static std::string url_decode(const std::string& text) {
+  std::string out;
+  out.reserve(text.size());
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '%' && i + 2 < text.size() && hex_value(text[i + 1]) >= 0 && hex_value(text[i + 2]) >= 0) {
+      out += (char)(hex_value(text[i + 1]) * 16 + hex_value(text[i + 2]));
+      i += 2;
+    } else {
+      out += text[i] == '+' ? ' ' : text[i];
+    }
+  }
+  return out;
+}
+
+static const char* status_text(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default:  return "Internal Server Error";
+  }
+}
+
+HttpServer::~HttpServer() {
+  for (Connection& connection : connections_) close(connection.fd);
+  if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+bool HttpServer::listen(const std::string& address, uint16_t port) {
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    last_error_ = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  int one = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  fcntl(listen_fd_, F_SETFL, O_NONBLOCK);
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+    last_error_ = "invalid address " + address;
+    return false;
+  }
+  if (bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(listen_fd_, 64) != 0) {
+    last_error_ = "bind " + address + ":" + std::to_string(port) + ": " + strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+void HttpServer::accept_connections() {
+  for (;;) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) return;
+    if (connections_.size() >= HTTP_MAX_CONNECTIONS) {
+      close(fd);
+      continue;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    connections_.push_back({fd, steady_ms(), std::string()});
+  }
+}
+
+void HttpServer::serve(int timeout_ms, const HttpHandler& handler) {
+  int64_t deadline = steady_ms() + timeout_ms;
+  for (;;) {
+    std::vector<pollfd> fds;
+    fds.push_back({listen_fd_, POLLIN, 0});
+    for (const Connection& connection : connections_) fds.push_back({connection.fd, POLLIN, 0});
+
+    int64_t wait_ms = deadline - steady_ms();
+    if (wait_ms < 0) wait_ms = 0;
+    if (poll(fds.data(), fds.size(), (int)wait_ms) > 0) {
+      // Connections first: accepting appends to connections_
+      for (size_t i = connections_.size(); i-- > 0;) {
+        if (fds[i + 1].revents == 0) continue;
+        if (!read_request(connections_[i], handler)) {
+          close(connections_[i].fd);
+          connections_.erase(connections_.begin() + (ptrdiff_t)i);
+        }
+      }
+      if (fds[0].revents & POLLIN) accept_connections();
+    }
+
+    int64_t now = steady_ms();
+    for (size_t i = connections_.size(); i-- > 0;) {
+      if (now - connections_[i].opened_ms > HTTP_REQUEST_TIMEOUT_MS) {
+        close(connections_[i].fd);
+        connections_.erase(connections_.begin() + (ptrdiff_t)i);
+      }
+    }
+    if (now >= deadline) return;
+  }
+}
+
+bool HttpServer::read_request(Connection& connection, const HttpHandler& handler) {
+  char buffer[4096];
+  ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+  if (n <= 0) return n < 0 && (errno == EAGAIN || errno == EINTR);
+  connection.input.append(buffer, (size_t)n);
+  if (connection.input.size() > HTTP_MAX_REQUEST) return false;
+  if (connection.input.find("\r\n\r\n") == std::string::npos) return true;
+
+  // Request line: METHOD TARGET VERSION
+  HttpRequest request;
+  size_t line_end = connection.input.find("\r\n");
+  std::string line = connection.input.substr(0, line_end);
+  size_t space = line.find(' ');
+  size_t space2 = space == std::string::npos ? std::string::npos : line.find(' ', space + 1);
+  std::string body;
+  int status = 400;
+  if (space2 != std::string::npos) {
+    request.method = line.substr(0, space);
+    std::string target = line.substr(space + 1, space2 - space - 1);
+    size_t question = target.find('?');
+    request.path = url_decode(target.substr(0, question));
+    if (question != std::string::npos) {
+      std::string query = target.substr(question + 1);
+      for (size_t start = 0; start <= query.size();) {
+        size_t amp = query.find('&', start);
+        if (amp == std::string::npos) amp = query.size();
+        std::string pair = query.substr(start, amp - start);
+        size_t equals = pair.find('=');
+        if (!pair.empty()) {
+          request.query[url_decode(pair.substr(0, equals))] =
+              equals == std::string::npos ? "" : url_decode(pair.substr(equals + 1));
+        }
+        start = amp + 1;
+      }
+    }
+    if (request.method != "GET") {
+      status = 405;
+      body = "{\"error\":\"GET only\"}";
+    } else {
+      status = handler(request, body);
+    }
+  } else {
+    body = "{\"error\":\"malformed request\"}";
+  }
+  requests_++;
+
+  std::string response = "HTTP/1.1 " + std::to_string(status) + " " + status_text(status) +
+                         "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+                         "\r\nConnection: close\r\n\r\n" + body;
+  // Answers are small; give a slow reader one second
+  int flags = fcntl(connection.fd, F_GETFL);
+  fcntl(connection.fd, F_SETFL, flags & ~O_NONBLOCK);
+  timeval timeout = {1, 0};
+  setsockopt(connection.fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  for (size_t sent = 0; sent < response.size();) {
+    ssize_t written = send(connection.fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (written <= 0) break;
+    sent += (size_t)written;
+  }
+  return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Minimal HTTP/1.1 server for GET requests with JSON answers (plain TCP,
+// one request per connection). Runs inside the caller's loop, so handlers
+// never race with the code that updates the data they read.
+
+struct HttpRequest {
+  std::string method;
+  std::string path;                                   // Without the query string
+  std::unordered_map<std::string, std::string> query; // Decoded parameters
+};
+
+// Fill body and return the HTTP status
+using HttpHandler = std::function<int(const HttpRequest& request, std::string& body)>;
+
+class HttpServer {
+ public:
+  HttpServer() = default;
+  ~HttpServer();
+
+  HttpServer(const HttpServer&) = delete;
+  HttpServer& operator=(const HttpServer&) = delete;
+
+  bool listen(const std::string& address, uint16_t port);
+
+  // Accept and answer requests for up to timeout_ms
+  void serve(int timeout_ms, const HttpHandler& handler);
+
+  uint64_t requests() const { return requests_; }
+  const std::string& last_error() const { return last_error_; }
+
+ private:
+  struct Connection {
+    int fd;
+    int64_t opened_ms;
+    std::string input;
+  };
+
+  void accept_connections();
+  bool read_request(Connection& connection, const HttpHandler& handler);  // false = close
+
+  int listen_fd_ = -1;
+  std::vector<Connection> connections_;
+  uint64_t requests_ = 0;
+  std::string last_error_;
+};
@@ -0,0 +1,153 @@
+#include "pg_source.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+PgSource::~PgSource() {
+  if (conn_) PQfinish(conn_);
+}
+
+bool PgSource::fail(const char* what) {
+  last_error_ = std::string(what) + ": " + (conn_ ? PQerrorMessage(conn_) : "not connected");
+  while (!last_error_.empty() && (last_error_.back() == '\n' || last_error_.back() == ' ')) last_error_.pop_back();
+  if (conn_) {
+    PQfinish(conn_);
+    conn_ = nullptr;
+  }
+  return false;
+}
+
+bool PgSource::connect() {
+  if (conn_) return true;
+  conn_ = PQconnectdb(conninfo_.c_str());
+  if (PQstatus(conn_) != CONNECTION_OK) return fail("connect");
+  return true;
+}
+
+// Run COPY (query) TO STDOUT and split each text-format line into fields
+bool PgSource::copy_out(const std::string& sql, const std::function<void(char** fields, int count)>& row) {
+  if (!connect()) return false;
+  PGresult* result = PQexec(conn_, sql.c_str());
+  if (PQresultStatus(result) != PGRES_COPY_OUT) {
+    PQclear(result);
+    return fail("COPY");
+  }
+  PQclear(result);
+
+  std::vector<char*> fields;
+  char* line;
+  int length;
+  while ((length = PQgetCopyData(conn_, &line, 0)) > 0) {
+    fields.clear();
+    char* start = line;
+    for (int i = 0; i < length; i++) {
+      if (line[i] == '\t' || line[i] == '\n') {
+        line[i] = '\0';
+        fields.push_back(start);
+        start = line + i + 1;
+      }
+    }
+    row(fields.data(), (int)fields.size());
+    PQfreemem(line);
+  }
+  if (length == -2) return fail("COPY data");
+
+  bool ok = true;
+  while ((result = PQgetResult(conn_)) != nullptr) {
+    if (PQresultStatus(result) != PGRES_COMMAND_OK) ok = false;
+    PQclear(result);
+  }
+  return ok || fail("COPY end");
+}
+
+bool PgSource::read_status(AnalyticsEngine& engine, int32_t from_hour, SourceCounts& counts) {
+  std::string sql =
+      "COPY (SELECT \"trashcanId\", floor(extract(epoch FROM hour) / 3600)::int AS h,"
+      " (array_agg(\"capacityPct\" ORDER BY hour DESC))[1], sum(\"useCount\")"
+      " FROM \"Status\" WHERE hour >= timestamp 'epoch' + interval '1 hour' * " + std::to_string(from_hour) +
+      " GROUP BY 1, 2 ORDER BY 1, 2) TO STDOUT";
+  return copy_out(sql, [&](char** fields, int count) {
+    if (count != 4) return;
+    engine.set_hour(fields[0], atoi(fields[1]), (float)atof(fields[2]), (uint32_t)strtoul(fields[3], nullptr, 10));
+    counts.hours++;
+  });
+}
+
+bool PgSource::read_cleanups(AnalyticsEngine& engine, int64_t from_ms, SourceCounts& counts) {
+  std::string sql =
+      "COPY (SELECT id, \"trashcanId\", \"userId\", floor(extract(epoch FROM \"createdAt\") * 1000)::bigint"
+      " FROM \"Cleanup\" WHERE \"createdAt\" >= timestamp 'epoch' + interval '1 millisecond' * " +
+      std::to_string(from_ms) + ") TO STDOUT";
+  return copy_out(sql, [&](char** fields, int count) {
+    if (count != 4) return;
+    int64_t created_ms = strtoll(fields[3], nullptr, 10);
+    if (!cleanups_.add(fields[0], created_ms)) return;  // Seen in an earlier poll
+    engine.add_cleanup(fields[1], fields[2], created_ms);
+    counts.cleanups++;
+  });
+}
+
+bool PgSource::read_histograms(AnalyticsEngine& engine, int64_t from_ms, SourceCounts& counts) {
+  std::string sql =
+      "COPY (SELECT id, \"trashcanId\", floor(extract(epoch FROM \"reportedAt\") * 1000)::bigint, \"binMinutes\","
+      " array_to_string(bins, ',') FROM \"UsageHistogram\" WHERE \"reportedAt\" >= timestamp 'epoch'"
+      " + interval '1 millisecond' * " + std::to_string(from_ms) + ") TO STDOUT";
+  std::vector<uint32_t> bins;
+  return copy_out(sql, [&](char** fields, int count) {
+    if (count != 5) return;
+    int64_t reported_ms = strtoll(fields[2], nullptr, 10);
+    if (!histograms_.add(fields[0], reported_ms)) return;
+    bins.clear();
+    for (char* p = fields[4]; *p;) {
+      bins.push_back((uint32_t)strtoul(p, &p, 10));
+      if (*p == ',') p++;
+      else break;
+    }
+    engine.add_histogram(fields[1], reported_ms, (uint32_t)strtoul(fields[3], nullptr, 10), bins.data(), bins.size());
+    counts.histograms++;
+  });
+}
+
+bool AppendedRows::add(const char* id, int64_t ms) {
+  if (!recent.emplace(id, ms).second) return false;
+  if (ms > watermark_ms) watermark_ms = ms;
+  return true;
+}
+
+// Only the ids in the overlap window need to be remembered
+void AppendedRows::forget_old() {
+  int64_t keep_from = watermark_ms - SOURCE_APPEND_OVERLAP_MS;
+  for (auto it = recent.begin(); it != recent.end();) {
+    it = it->second < keep_from ? recent.erase(it) : std::next(it);
+  }
+}
+
+int64_t AppendedRows::poll_from_ms() const {
+  int64_t from_ms = watermark_ms - SOURCE_APPEND_OVERLAP_MS;
+  return from_ms > 0 ? from_ms : 0;
+}
+
+bool PgSource::load(AnalyticsEngine& engine, SourceCounts& counts) {
+  cleanups_.clear();
+  histograms_.clear();
+  if (!read_status(engine, 0, counts) || !read_cleanups(engine, 0, counts) ||
+      !read_histograms(engine, 0, counts)) {
+    return false;
+  }
+
+  cleanups_.forget_old();
+  histograms_.forget_old();
+  return true;
+}
+
+bool PgSource::poll(AnalyticsEngine& engine, int64_t now_unix_ms, SourceCounts& counts) {
+  int32_t now_hour = (int32_t)(now_unix_ms / 3600000);
+  if (!read_status(engine, now_hour - SOURCE_POLL_HOURS, counts)) return false;
+
+  if (!read_cleanups(engine, cleanups_.poll_from_ms(), counts)) return false;
+  if (!read_histograms(engine, histograms_.poll_from_ms(), counts)) return false;
+  cleanups_.forget_old();
+  histograms_.forget_old();
+  return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <libpq-fe.h>
+
+#include "analytics_engine.h"
+
+// ============================================
+// PostgreSQL Source
+// ============================================
+//
+// Feeds the engine from the backend's tables. load() streams the whole
+// history with COPY, one row per trashcan and hour (rows of the same hour,
+// as the backend wrote them before tools/ingest, are summed, the latest fill
+// level wins). poll() re-reads the last SOURCE_POLL_HOURS hours, where
+// reports still upsert their rows, and the cleanups and usage histograms
+// created since the last poll (each passed to the engine once). Rows written
+// later for older hours reach the engine at the next full reload.
+
+#define SOURCE_POLL_HOURS        3
+#define SOURCE_APPEND_OVERLAP_MS  (10 * 60 * 1000)  // Re-read window for cleanups and histograms committed late
+
+struct SourceCounts {
+  uint64_t hours = 0;
+  uint64_t cleanups = 0;
+  uint64_t histograms = 0;
+};
+
+// Rows that are only ever added (cleanups, usage histograms): the ids read in
+// the overlap window behind the newest one, so a re-read passes each row once
+struct AppendedRows {
+  int64_t watermark_ms = 0;                         // Newest row seen
+  std::unordered_map<std::string, int64_t> recent;  // Ids in the overlap window
+
+  void clear() {
+    watermark_ms = 0;
+    recent.clear();
+  }
+  bool add(const char* id, int64_t ms);             // false if seen before
+  void forget_old();
+  int64_t poll_from_ms() const;
+};
+
+class PgSource {
+ public:
+  explicit PgSource(std::string conninfo) : conninfo_(std::move(conninfo)) {}
+  ~PgSource();
+
+  PgSource(const PgSource&) = delete;
+  PgSource& operator=(const PgSource&) = delete;
+
+  bool load(AnalyticsEngine& engine, SourceCounts& counts);
+  bool poll(AnalyticsEngine& engine, int64_t now_unix_ms, SourceCounts& counts);
+
+  const std::string& last_error() const { return last_error_; }
+
+ private:
+  bool connect();
+  bool copy_out(const std::string& sql, const std::function<void(char** fields, int count)>& row);
+  bool read_status(AnalyticsEngine& engine, int32_t from_hour, SourceCounts& counts);
+  bool read_cleanups(AnalyticsEngine& engine, int64_t from_ms, SourceCounts& counts);
+  bool read_histograms(AnalyticsEngine& engine, int64_t from_ms, SourceCounts& counts);
+  bool fail(const char* what);
+
+  std::string conninfo_;
+  PGconn* conn_ = nullptr;
+  std::string last_error_;
+  AppendedRows cleanups_;
+  AppendedRows histograms_;
+};
@@ -0,0 +1,80 @@
+#include "rollup.h"
+
+#include "hour_series.h"
+
+Rollup& RollupTable::at(int32_t key) {
+  if (rows_.empty()) {
+    base_ = key;
+    rows_.resize(1);
+  } else if (key < base_) {
+    rows_.insert(rows_.begin(), (size_t)(base_ - key), Rollup());
+    base_ = key;
+  } else if ((size_t)(key - base_) >= rows_.size()) {
+    rows_.resize((size_t)(key - base_) + 1);
+  }
+  return rows_[(size_t)(key - base_)];
+}
+
+const Rollup* RollupTable::find(int32_t key) const {
+  if (rows_.empty() || key < base_ || (size_t)(key - base_) >= rows_.size()) return nullptr;
+  return &rows_[(size_t)(key - base_)];
+}
+
+bool RollupSet::apply(int32_t local_hour, const HourValue* previous, const HourValue& value) {
+  int32_t day = floor_div(local_hour, 24);
+  bool lowered = false;
+
+  for (int level = 0; level < ROLLUP_LEVELS; level++) {
+    Rollup& rollup = levels_[level].at(rollup_key((RollupLevel)level, day));
+    rollup.use += value.use;
+    rollup.fill_sum += value.fill;
+    if (previous) {
+      rollup.use -= previous->use;
+      rollup.fill_sum -= previous->fill;
+      lowered |= previous->fill == rollup.fill_max && value.fill < previous->fill;
+    } else {
+      rollup.hours++;
+    }
+    if (value.fill > rollup.fill_max) rollup.fill_max = value.fill;
+  }
+
+  uint32_t slot = weekday_of_day(day) * 24 + (uint32_t)(local_hour - day * 24);
+  hour_of_week_use_[slot] += value.use;
+  if (previous) hour_of_week_use_[slot] -= previous->use;
+  else hour_of_week_hours_[slot]++;
+  return lowered;
+}
+
+void RollupSet::add_cleanup(int32_t local_day) {
+  for (int level = 0; level < ROLLUP_LEVELS; level++) {
+    levels_[level].at(rollup_key((RollupLevel)level, local_day)).cleanups++;
+  }
+}
+
+void RollupSet::add_slot_use(int64_t local_minute, uint32_t use) {
+  int32_t day = (int32_t)(local_minute / 1440 - (local_minute % 1440 < 0));
+  uint32_t minute = (uint32_t)(local_minute - (int64_t)day * 1440);
+  slot_of_week_use_[weekday_of_day(day) * SLOTS_PER_DAY + minute / SLOT_MINUTES] += use;
+}
+
+void RollupSet::set_day_fill_max(int32_t day, uint8_t fill_max) {
+  levels_[ROLLUP_DAY].at(day).fill_max = fill_max;
+
+  for (int level = ROLLUP_WEEK; level < ROLLUP_LEVELS; level++) {
+    int32_t key = rollup_key((RollupLevel)level, day);
+    int32_t first = rollup_first_day((RollupLevel)level, key);
+    int32_t end = rollup_first_day((RollupLevel)level, key + 1);
+    uint8_t max = 0;
+    for (int32_t d = first; d < end; d++) {
+      const Rollup* rollup = levels_[ROLLUP_DAY].find(d);
+      if (rollup && rollup->fill_max > max) max = rollup->fill_max;
+    }
+    levels_[level].at(key).fill_max = max;
+  }
+}
+
+size_t RollupSet::bytes() const {
+  size_t bytes = sizeof(*this);
+  for (const RollupTable& table : levels_) bytes += table.bytes();
+  return bytes;
+}
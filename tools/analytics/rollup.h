@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ============================================
+// Rollups
+// ============================================
+//
+// Day, week (Monday first) and month totals of one trashcan, one user or the
+// whole fleet, kept up to date as hours change: every change is applied as a
+// difference to the three levels, so no query ever re-aggregates hours. The
+// one exception is the fill maximum, which cannot be lowered by a difference:
+// when the hour holding a day's maximum goes down, the owner recomputes that
+// day from its hours and the week and month from their days.
+//
+// Peak-hour statistics are the use totals per hour of the week (168 slots,
+// Monday 00:00 first) over the whole history, and the motion wakes per
+// 10-minute slot of the week (1008 slots) from the reports' usage histograms.
+//
+// Days are local days: hours are shifted by the UTC offset given to the
+// engine before they are bucketed.
+
+enum RollupLevel {
+  ROLLUP_DAY,
+  ROLLUP_WEEK,
+  ROLLUP_MONTH,
+  ROLLUP_LEVELS,
+};
+
+#define HOURS_PER_WEEK  168
+#define SLOT_MINUTES    10
+#define SLOTS_PER_DAY   (24 * 60 / SLOT_MINUTES)
+#define SLOTS_PER_WEEK  (7 * SLOTS_PER_DAY)
+
+struct HourValue;
+
+struct Rollup {
+  uint64_t use = 0;
+  uint64_t fill_sum = 0;     // Half percents, over the hours with a report
+  uint32_t hours = 0;        // Hours with a report
+  uint32_t cleanups = 0;
+  uint8_t  fill_max = 0;
+};
+
+// ---------- Calendar (days since 1970-01-01, proleptic Gregorian) ----------
+
+inline int32_t floor_div(int32_t a, int32_t b) {
+  return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+inline int32_t days_from_civil(int32_t year, uint32_t month, uint32_t day) {
+  year -= month <= 2;
+  int32_t era = floor_div(year, 400);
+  uint32_t year_of_era = (uint32_t)(year - era * 400);
+  uint32_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + (int32_t)day_of_era - 719468;
+}
+
+inline void civil_from_days(int32_t days, int32_t& year, uint32_t& month, uint32_t& day) {
+  days += 719468;
+  int32_t era = floor_div(days, 146097);
+  uint32_t day_of_era = (uint32_t)(days - era * 146097);
+  uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  uint32_t mp = (5 * day_of_year + 2) / 153;
+  day = day_of_year - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = (int32_t)year_of_era + era * 400 + (month <= 2);
+}
+
+// 1970-01-01 was a Thursday: day + 3 counts from Monday 1969-12-29
+inline int32_t week_of_day(int32_t day) { return floor_div(day + 3, 7); }
+inline int32_t first_day_of_week(int32_t week) { return week * 7 - 3; }
+inline uint32_t weekday_of_day(int32_t day) { return (uint32_t)(day + 3 - week_of_day(day) * 7); }  // 0 = Monday
+
+inline int32_t month_of_day(int32_t day) {
+  int32_t year;
+  uint32_t month, dom;
+  civil_from_days(day, year, month, dom);
+  return year * 12 + (int32_t)month - 1;
+}
+
+inline int32_t first_day_of_month(int32_t month) {
+  return days_from_civil(floor_div(month, 12), (uint32_t)(month - floor_div(month, 12) * 12) + 1, 1);
+}
+
+inline int32_t rollup_key(RollupLevel level, int32_t day) {
+  switch (level) {
+    case ROLLUP_WEEK:  return week_of_day(day);
+    case ROLLUP_MONTH: return month_of_day(day);
+    default:           return day;
+  }
+}
+
+inline int32_t rollup_first_day(RollupLevel level, int32_t key) {
+  switch (level) {
+    case ROLLUP_WEEK:  return first_day_of_week(key);
+    case ROLLUP_MONTH: return first_day_of_month(key);
+    default:           return key;
+  }
+}
+
+// ---------- Tables ----------
+
+// Rollups of one level, indexed by key; grows in both directions
+class RollupTable {
+ public:
+  Rollup& at(int32_t key);
+  const Rollup* find(int32_t key) const;
+  bool empty() const { return rows_.empty(); }
+  size_t bytes() const { return rows_.capacity() * sizeof(Rollup); }
+
+ private:
+  int32_t base_ = 0;
+  std::vector<Rollup> rows_;
+};
+
+class RollupSet {
+ public:
+  // Apply an hour's change: previous is nullptr for a new hour
+  // Returns true if the day's fill maximum may now be too high (recompute_day)
+  bool apply(int32_t local_hour, const HourValue* previous, const HourValue& value);
+  void add_cleanup(int32_t local_day);
+  void add_slot_use(int64_t local_minute, uint32_t use);
+
+  // Replace a day's fill maximum and refresh the week and month from their days
+  void set_day_fill_max(int32_t day, uint8_t fill_max);
+
+  const RollupTable& table(RollupLevel level) const { return levels_[level]; }
+  const uint64_t* hour_of_week_use() const { return hour_of_week_use_; }
+  const uint32_t* hour_of_week_hours() const { return hour_of_week_hours_; }
+  const uint32_t* slot_of_week_use() const { return slot_of_week_use_; }
+  size_t bytes() const;
+
+ private:
+  RollupTable levels_[ROLLUP_LEVELS];
+  uint64_t hour_of_week_use_[HOURS_PER_WEEK] = {};
+  uint32_t hour_of_week_hours_[HOURS_PER_WEEK] = {};
+  uint32_t slot_of_week_use_[SLOTS_PER_WEEK] = {};
+};
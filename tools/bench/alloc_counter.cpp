@@ -0,0 +1,97 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+#include <sqlite3.h>
+
+static AllocStats stats;
+
+AllocStats alloc_counter_snapshot() {
+  return stats;
+}
+
+void* counted_malloc(size_t size) {
+  stats.count++;
+  stats.bytes += size;
+  return malloc(size);
+}
+
+void* counted_realloc(void* ptr, size_t size) {
+  stats.count++;
+  stats.bytes += size;
+  return realloc(ptr, size);
+}
+
+void counted_free(void* ptr) {
+  free(ptr);
+}
+
+// ============================================
+// Global operator new / delete
+// ============================================
+
+void* operator new(size_t size) {
+  void* ptr = counted_malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  counted_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  counted_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  counted_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  counted_free(ptr);
+}
+
+// ============================================
+// SQLite allocator
+// ============================================
+
+static void* sqlite_malloc(int size) {
+  return counted_malloc((size_t)size);
+}
+
+static void sqlite_free(void* ptr) {
+  counted_free(ptr);
+}
+
+static void* sqlite_realloc(void* ptr, int size) {
+  return counted_realloc(ptr, (size_t)size);
+}
+
+static int sqlite_size(void* ptr) {
+  return (int)malloc_usable_size(ptr);
+}
+
+static int sqlite_roundup(int size) {
+  return (size + 7) & ~7;
+}
+
+static int sqlite_init(void*) {
+  return SQLITE_OK;
+}
+
+static void sqlite_shutdown(void*) {}
+
+bool alloc_counter_install_sqlite() {
+  static const sqlite3_mem_methods methods = {
+    sqlite_malloc, sqlite_free, sqlite_realloc, sqlite_size,
+    sqlite_roundup, sqlite_init, sqlite_shutdown, nullptr
+  };
+  return sqlite3_config(SQLITE_CONFIG_MALLOC, &methods) == SQLITE_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ============================================
+// Allocation Counter
+// ============================================
+//
+// Counts heap allocations made by the code under test. Global operator new
+// is replaced (alloc_counter.cpp), the Arduino String model allocates through
+// counted_malloc/counted_realloc, and SQLite is pointed at the same functions
+// by alloc_counter_install_sqlite(). Counting is process-wide and not
+// thread-safe; benchmarks run on a single thread.
+
+struct AllocStats {
+  uint64_t count = 0;  // malloc/realloc/new calls
+  uint64_t bytes = 0;  // Bytes requested by those calls
+};
+
+AllocStats alloc_counter_snapshot();
+
+void* counted_malloc(size_t size);
+void* counted_realloc(void* ptr, size_t size);
+void counted_free(void* ptr);
+
+// Route SQLite's allocator through the counter (call before any sqlite3_* use)
+bool alloc_counter_install_sqlite();
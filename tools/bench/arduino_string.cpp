@@ -0,0 +1,208 @@
+#include "arduino_string.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "alloc_counter.h"
+
+String::String(const char* cstr) {
+  if (cstr != nullptr) copy(cstr, (unsigned int)strlen(cstr));
+}
+
+String::String(const String& other) {
+  copy(other.buffer(), other.len_);
+}
+
+String::String(String&& other) noexcept {
+  move(other);
+}
+
+// Numeric constructors format into a small stack buffer first (utoa/itoa)
+String::String(unsigned char value, unsigned char base) {
+  char text[9];
+  snprintf(text, sizeof(text), base == HEX ? "%x" : "%u", (unsigned int)value);
+  copy(text, (unsigned int)strlen(text));
+}
+
+String::String(int value, unsigned char base) {
+  char text[34];
+  if (base == HEX) {
+    snprintf(text, sizeof(text), "%x", (unsigned int)value);
+  } else {
+    snprintf(text, sizeof(text), "%d", value);
+  }
+  copy(text, (unsigned int)strlen(text));
+}
+
+String::~String() {
+  invalidate();
+}
+
+String& String::operator=(const String& other) {
+  if (this != &other) copy(other.buffer(), other.len_);
+  return *this;
+}
+
+String& String::operator=(String&& other) noexcept {
+  if (this != &other) {
+    invalidate();
+    move(other);
+  }
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  if (cstr != nullptr) {
+    copy(cstr, (unsigned int)strlen(cstr));
+  } else {
+    invalidate();
+  }
+  return *this;
+}
+
+String& String::operator+=(const char* cstr) {
+  if (cstr != nullptr) concat(cstr, (unsigned int)strlen(cstr));
+  return *this;
+}
+
+String operator+(const String& lhs, const String& rhs) {
+  String sum(lhs);
+  sum += rhs;
+  return sum;
+}
+
+String operator+(const String& lhs, const char* rhs) {
+  String sum(lhs);
+  sum += rhs;
+  return sum;
+}
+
+String operator+(const char* lhs, const String& rhs) {
+  String sum(lhs);
+  sum += rhs;
+  return sum;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  if (from >= len_) return -1;
+  const char* found = strchr(buffer() + from, c);
+  return found == nullptr ? -1 : (int)(found - buffer());
+}
+
+int String::indexOf(const char* str, unsigned int from) const {
+  if (from >= len_) return -1;
+  const char* found = strstr(buffer() + from, str);
+  return found == nullptr ? -1 : (int)(found - buffer());
+}
+
+bool String::startsWith(const char* prefix) const {
+  size_t length = strlen(prefix);
+  return length <= len_ && strncmp(buffer(), prefix, length) == 0;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+  if (left > right) {
+    unsigned int temp = right;
+    right = left;
+    left = temp;
+  }
+  String out;
+  if (left >= len_) return out;
+  if (right > len_) right = len_;
+  out.copy(buffer() + left, right - left);
+  return out;
+}
+
+long String::toInt() const {
+  return atol(buffer());
+}
+
+void String::trim() {
+  if (len_ == 0) return;
+  char* begin = wbuffer();
+  char* end = begin + len_ - 1;
+  while (isspace((unsigned char)*begin)) begin++;
+  while (end >= begin && isspace((unsigned char)*end)) end--;
+  len_ = end + 1 - begin;
+  if (begin > wbuffer()) memmove(wbuffer(), begin, len_);
+  wbuffer()[len_] = '\0';
+}
+
+void String::toUpperCase() {
+  for (char* p = wbuffer(); *p; p++) {
+    *p = (char)toupper((unsigned char)*p);
+  }
+}
+
+bool String::reserve(unsigned int size) {
+  if (capacity() >= size) return true;
+  return change_buffer(size);
+}
+
+// Same policy as WString::changeBuffer(): inline below the SSO size,
+// otherwise a heap block rounded up to 16 bytes
+bool String::change_buffer(unsigned int max_length) {
+  if (max_length < SSO_SIZE - 1) {
+    if (heap_ != nullptr) {
+      memcpy(sso_, heap_, len_ + 1);
+      counted_free(heap_);
+      heap_ = nullptr;
+      cap_ = 0;
+    }
+    return true;
+  }
+
+  unsigned int new_size = (max_length + 16) & ~0xfu;
+  char* block;
+  if (heap_ == nullptr) {
+    block = (char*)counted_malloc(new_size);
+    if (block == nullptr) return false;
+    memcpy(block, sso_, len_ + 1);
+  } else {
+    block = (char*)counted_realloc(heap_, new_size);
+    if (block == nullptr) return false;
+  }
+  heap_ = block;
+  cap_ = new_size - 1;
+  return true;
+}
+
+void String::copy(const char* cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return;
+  }
+  memmove(wbuffer(), cstr, length);
+  len_ = length;
+  wbuffer()[len_] = '\0';
+}
+
+void String::concat(const char* cstr, unsigned int length) {
+  unsigned int new_length = len_ + length;
+  if (length == 0) return;
+  if (!reserve(new_length)) return;
+  memmove(wbuffer() + len_, cstr, length);
+  len_ = new_length;
+  wbuffer()[len_] = '\0';
+}
+
+void String::move(String& other) {
+  memcpy(sso_, other.sso_, sizeof(sso_));
+  heap_ = other.heap_;
+  cap_ = other.cap_;
+  len_ = other.len_;
+  other.heap_ = nullptr;
+  other.cap_ = 0;
+  other.len_ = 0;
+  other.sso_[0] = '\0';
+}
+
+void String::invalidate() {
+  if (heap_ != nullptr) counted_free(heap_);
+  heap_ = nullptr;
+  cap_ = 0;
+  len_ = 0;
+  sso_[0] = '\0';
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ============================================
+// Arduino String Model
+// ============================================
+//
+// Host model of the arduino-esp32 core's String (WString.h), reduced to the
+// members the firmware uses. It reproduces the core's allocation behaviour,
+// which is what the benchmarks measure:
+//   - up to 14 characters are stored inline (SSO, no heap block)
+//   - longer strings live in a heap block rounded up to 16 bytes
+//   - concatenation reserves the new length and grows with realloc
+//   - substring() and numeric constructors build a new String
+// Allocations go through counted_malloc/counted_realloc (alloc_counter.h).
+
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+
+class String {
+ public:
+  String(const char* cstr = "");
+  String(const String& other);
+  String(String&& other) noexcept;
+  explicit String(unsigned char value, unsigned char base = DEC);
+  explicit String(int value, unsigned char base = DEC);
+  ~String();
+
+  String& operator=(const String& other);
+  String& operator=(String&& other) noexcept;
+  String& operator=(const char* cstr);
+
+  String& operator+=(const String& other) { concat(other.buffer(), other.len_); return *this; }
+  String& operator+=(const char* cstr);
+  String& operator+=(char c) { concat(&c, 1); return *this; }
+
+  friend String operator+(const String& lhs, const String& rhs);
+  friend String operator+(const String& lhs, const char* rhs);
+  friend String operator+(const char* lhs, const String& rhs);
+
+  unsigned int length() const { return len_; }
+  const char* c_str() const { return buffer(); }
+  char operator[](unsigned int index) const { return index < len_ ? buffer()[index] : 0; }
+
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const char* str, unsigned int from = 0) const;
+  bool startsWith(const char* prefix) const;
+  String substring(unsigned int left) const { return substring(left, len_); }
+  String substring(unsigned int left, unsigned int right) const;
+  long toInt() const;
+  void trim();
+  void toUpperCase();
+
+ private:
+  enum { SSO_SIZE = 15 };  // sizeof(struct _ptr) + 4 - 1 on a 32-bit target
+
+  const char* buffer() const { return heap_ ? heap_ : sso_; }
+  char* wbuffer() { return heap_ ? heap_ : sso_; }
+  unsigned int capacity() const { return heap_ ? cap_ : SSO_SIZE - 1; }
+
+  bool reserve(unsigned int size);
+  bool change_buffer(unsigned int max_length);
+  void copy(const char* cstr, unsigned int length);
+  void concat(const char* cstr, unsigned int length);
+  void move(String& other);
+  void invalidate();
+
+  char sso_[SSO_SIZE] = {0};
+  char* heap_ = nullptr;
+  unsigned int cap_ = 0;
+  unsigned int len_ = 0;
+};
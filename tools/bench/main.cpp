@@ -0,0 +1,622 @@
+// Firmware micro-benchmarks: times the per-wake hot paths of ESP32/main.cpp
+// on the host and counts the heap allocations each call makes.
+//
+//   bench                          run everything
+//   bench --filter rx --min-time 500
+//   bench --csv baseline.csv       save results
+//   bench --compare baseline.csv   show the change against a saved run
+//
+// Host nanoseconds do not translate to ESP32 cycles; compare runs with each
+// other, not with the device. Allocation counts do carry over: the Arduino
+// String model (arduino_string.h) follows the arduino-esp32 core's policy.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+#include <unistd.h>
+
+#include "alloc_counter.h"
+#include "arduino_string.h"
+#include "at_modem.h"
+#include "db_tuning.h"
+#include "event_journal.h"
+#include "string_paths.h"
+#include "wake_cycle.h"
+
+// Keep a value alive so the optimizer cannot drop the work that produced it
+template <typename T>
+static inline void keep(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Benchmark {
+  std::string name;
+  std::function<void(uint64_t iterations)> body;
+};
+
+struct Result {
+  std::string name;
+  double ns_per_op = 0;
+  double allocs_per_op = 0;
+  double bytes_per_op = 0;
+};
+
+struct Options {
+  std::string filter;
+  uint32_t min_time_ms = 200;
+  uint32_t repetitions = 5;
+  std::string csv_path;
+  std::string compare_path;
+};
+
+static std::vector<Benchmark> benchmarks;
+
+static void add(const std::string& name, std::function<void(uint64_t)> body) {
+  benchmarks.push_back({name, std::move(body)});
+}
+
+// ============================================
+// Fixtures
+// ============================================
+
+static uint8_t sample_uid[RFID_UID_LENGTH] = {0x21, 0x47, 0xC2, 0x0C};
+
+// Factory defaults of a bin named LIX001
+static void bench_config(DeviceConfig& config) {
+  device_config_defaults(config, 3600, 60000, 1000, 15000, "LIX001");
+}
+
+static const char* insert_downlink_hex = "012147C20C01";
+
+// A module response to AT+SENDB that carries a downlink in RX1
+static const char* sendb_response =
+  "OK\r\n"
+  "RX:012147C20C01:1:-97:6.5\r\n";
+
+// Apply the firmware's journal, sync, cache and mmap settings (db_tuning.h)
+static void tune(sqlite3* db) {
+  for (size_t i = 0; i < DB_TUNING_PRAGMA_COUNT; i++) {
+    sqlite3_exec(db, db_tuning_pragmas[i], nullptr, nullptr, nullptr);
+  }
+}
+
+// Copy of the on-device schema (init_db.cpp) holding `users` tags, in memory
+// or in a file (path) with the SQLite defaults or the firmware settings
+struct Whitelist {
+  sqlite3* db = nullptr;
+  std::string path;
+  bool tuned = false;
+  std::vector<std::string> tags;
+
+  explicit Whitelist(int users, const std::string& file = ":memory:", bool tune_db = false)
+      : path(file), tuned(tune_db) {
+    remove_files();
+    open();
+    sqlite3_exec(db,
+      "PRAGMA page_size = " DB_TUNING_XSTR(DB_PAGE_SIZE) ";"
+      "CREATE TABLE role (role_code TEXT PRIMARY KEY);"
+      "INSERT INTO role VALUES ('WORKER'), ('ADMIN');"
+      "CREATE TABLE user ("
+      "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+      "name TEXT NOT NULL, "
+      "rfid_tag_id TEXT NOT NULL UNIQUE, "
+      "role TEXT NOT NULL, "
+      "FOREIGN KEY (role) REFERENCES role(role_code));"
+      "CREATE INDEX idx_user_rfid ON user(rfid_tag_id);",
+      nullptr, nullptr, nullptr);
+
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_prepare_v2(db, "INSERT INTO user (name, rfid_tag_id, role) VALUES (?, ?, ?);", -1, &insert, nullptr);
+    for (int i = 0; i < users; i++) {
+      uint8_t uid[RFID_UID_LENGTH] = {(uint8_t)(i >> 24), (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+      char tag[RFID_TAG_TEXT_SIZE];
+      text_format_rfid(uid, RFID_UID_LENGTH, tag, sizeof(tag));
+      tags.push_back(tag);
+      sqlite3_bind_text(insert, 1, "bench", -1, SQLITE_STATIC);
+      sqlite3_bind_text(insert, 2, tags.back().c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_text(insert, 3, i % 10 == 0 ? "ADMIN" : "WORKER", -1, SQLITE_STATIC);
+      sqlite3_step(insert);
+      sqlite3_reset(insert);
+    }
+    sqlite3_finalize(insert);
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+  }
+
+  ~Whitelist() {
+    close();
+    remove_files();
+  }
+
+  void open() {
+    sqlite3_open(path.c_str(), &db);
+    if (tuned) tune(db);
+  }
+
+  // Release the connection (an EXCLUSIVE lock would keep others out)
+  void close() {
+    if (db != nullptr) sqlite3_close(db);
+    db = nullptr;
+  }
+
+  void remove_files() {
+    if (path == ":memory:") return;
+    std::error_code ignored;
+    std::filesystem::remove(path, ignored);
+    std::filesystem::remove(path + "-journal", ignored);
+  }
+};
+
+// Scratch directory for the database fixtures (removed when the run ends)
+static std::filesystem::path db_dir() {
+  return std::filesystem::temp_directory_path() / ("bench-db-" + std::to_string(getpid()));
+}
+
+static std::string db_file(const std::string& name) {
+  std::filesystem::create_directories(db_dir());
+  return (db_dir() / (name + ".db")).string();
+}
+
+// Close the database fixtures and delete their files
+static void remove_db_fixtures() {
+  benchmarks.clear();
+  std::error_code ignored;
+  std::filesystem::remove_all(db_dir(), ignored);
+}
+
+// Journal segments as files in the fixture directory, opened per call like
+// the LittleFS storage in main.cpp
+struct JournalBenchFiles {
+  static int next_id;
+  std::string prefix;
+  JournalState state;
+
+  JournalBenchFiles() {
+    std::filesystem::create_directories(db_dir());
+    prefix = (db_dir() / ("journal-" + std::to_string(next_id++) + "-")).string();
+    journal_init(state);
+  }
+
+  std::string path(uint8_t segment) const { return prefix + std::to_string(segment) + ".bin"; }
+
+  uint32_t size(uint8_t segment) {
+    std::error_code ignored;
+    uintmax_t bytes = std::filesystem::file_size(path(segment), ignored);
+    return ignored ? 0 : (uint32_t)bytes;
+  }
+  bool read(uint8_t segment, uint32_t offset, void* data, size_t length) {
+    FILE* file = fopen(path(segment).c_str(), "rb");
+    if (file == nullptr) return false;
+    bool ok = fseek(file, (long)offset, SEEK_SET) == 0 && fread(data, 1, length, file) == length;
+    fclose(file);
+    return ok;
+  }
+  bool append(uint8_t segment, const void* data, size_t length) {
+    FILE* file = fopen(path(segment).c_str(), "ab");
+    if (file == nullptr) return false;
+    bool ok = fwrite(data, 1, length, file) == length;
+    return fclose(file) == 0 && ok;
+  }
+  bool clear(uint8_t segment) {
+    FILE* file = fopen(path(segment).c_str(), "wb");
+    return file != nullptr && fclose(file) == 0;
+  }
+};
+
+int JournalBenchFiles::next_id = 0;
+
+// check_access(): SQLiteManager::execute() prepares, binds and steps the
+// query on every call and hands the row back as an object
+static bool check_access(sqlite3* db, const char* rfid_tag_id) {
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db, "SELECT id, role FROM user WHERE rfid_tag_id = ?;", -1, &stmt, nullptr) != SQLITE_OK) {
+    return false;
+  }
+  sqlite3_bind_text(stmt, 1, rfid_tag_id, -1, SQLITE_TRANSIENT);
+  bool found = false;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    std::map<std::string, std::string> row;
+    row["id"] = std::to_string(sqlite3_column_int(stmt, 0));
+    row["role"] = (const char*)sqlite3_column_text(stmt, 1);
+    const char* role = row["role"].c_str();
+    keep(role);
+    found = true;
+  }
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+// ============================================
+// Benchmarks
+// ============================================
+
+static void register_benchmarks() {
+  add("format_rfid/string", [](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      String tag = legacy_format_rfid(sample_uid, RFID_UID_LENGTH);
+      keep(tag);
+    }
+  });
+
+  add("format_rfid/buffer", [](uint64_t n) {
+    char tag[RFID_TAG_TEXT_SIZE];
+    for (uint64_t i = 0; i < n; i++) {
+      size_t length = text_format_rfid(sample_uid, RFID_UID_LENGTH, tag, sizeof(tag));
+      keep(length);
+      keep(tag);
+    }
+  });
+
+  for (int users : {10, 100, 1000, 10000}) {
+    auto whitelist = std::make_shared<Whitelist>(users);
+    add("check_access/" + std::to_string(users), [whitelist](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        // Alternate known and unknown tags, as at a real bin
+        const char* tag = (i & 1) ? whitelist->tags[i % whitelist->tags.size()].c_str() : "FF FF FF FF";
+        bool granted = check_access(whitelist->db, tag);
+        keep(granted);
+      }
+    });
+  }
+
+  // The whitelist on a file with SQLite defaults and with the firmware
+  // settings (db_tuning.h); the PSRAM page cache pool is device-only
+  for (bool tuned : {false, true}) {
+    std::string variant = tuned ? "tuned" : "default";
+
+    // Boot: open the database and answer the first lookup (loads the schema)
+    auto closed = std::make_shared<Whitelist>(1000, db_file("open-" + variant), tuned);
+    closed->close();
+    add("db/open/" + variant, [closed](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        closed->open();
+        bool granted = check_access(closed->db, closed->tags[i % closed->tags.size()].c_str());
+        keep(granted);
+        closed->close();
+      }
+    });
+
+    auto whitelist = std::make_shared<Whitelist>(1000, db_file("lookup-" + variant), tuned);
+    add("db/lookup/" + variant, [whitelist](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        const char* tag = (i & 1) ? whitelist->tags[i % whitelist->tags.size()].c_str() : "FF FF FF FF";
+        bool granted = check_access(whitelist->db, tag);
+        keep(granted);
+      }
+    });
+
+    // One whitelist change as a downlink makes it: INSERT, then DELETE, each its own transaction
+    auto changes = std::make_shared<Whitelist>(1000, db_file("insert-" + variant), tuned);
+    add("db/insert/" + variant, [changes](uint64_t n) {
+      for (uint64_t i = 0; i < n; i++) {
+        sqlite3_exec(changes->db,
+          "INSERT INTO user (name, rfid_tag_id, role) VALUES ('bench', 'AA BB CC DD', 'WORKER');",
+          nullptr, nullptr, nullptr);
+        sqlite3_exec(changes->db, "DELETE FROM user WHERE rfid_tag_id = 'AA BB CC DD';", nullptr, nullptr, nullptr);
+      }
+    });
+
+    // 100 users in one transaction (provisioning), removed again in a second one
+    auto bulk = std::make_shared<Whitelist>(1000, db_file("bulk-" + variant), tuned);
+    add("db/bulk_insert/" + variant, [bulk](uint64_t n) {
+      sqlite3_stmt* insert = nullptr;
+      sqlite3_prepare_v2(bulk->db, "INSERT INTO user (name, rfid_tag_id, role) VALUES ('bulk', ?, 'WORKER');",
+                         -1, &insert, nullptr);
+      for (uint64_t i = 0; i < n; i++) {
+        sqlite3_exec(bulk->db, "BEGIN", nullptr, nullptr, nullptr);
+        for (int u = 0; u < 100; u++) {
+          uint8_t uid[RFID_UID_LENGTH] = {0xB0, 0x00, 0x00, (uint8_t)u};
+          char tag[RFID_TAG_TEXT_SIZE];
+          text_format_rfid(uid, RFID_UID_LENGTH, tag, sizeof(tag));
+          sqlite3_bind_text(insert, 1, tag, -1, SQLITE_TRANSIENT);
+          sqlite3_step(insert);
+          sqlite3_reset(insert);
+        }
+        sqlite3_exec(bulk->db, "COMMIT", nullptr, nullptr, nullptr);
+        sqlite3_exec(bulk->db, "DELETE FROM user WHERE name = 'bulk';", nullptr, nullptr, nullptr);
+      }
+      sqlite3_finalize(insert);
+    });
+  }
+
+  // Event journal records (event_journal.h) on files, opened per append as
+  // on the device; compare with db/insert for the cost of a logged event
+  auto journal = std::make_shared<JournalBenchFiles>();
+  add("journal/append", [journal](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      bool stored = journal_append(journal->state, *journal, (uint32_t)(1700000000 + i), JOURNAL_DENIED_TAP, 0,
+                                   sample_uid);
+      keep(stored);
+    }
+  });
+
+  // A one-hour window out of a full journal (every segment in use)
+  auto history = std::make_shared<JournalBenchFiles>();
+  for (uint32_t i = 0; i < JOURNAL_SEGMENTS * JOURNAL_SEGMENT_RECORDS; i++) {
+    journal_append(history->state, *history, 1700000000 + i * 60, JOURNAL_REPORT, JOURNAL_FLAG_SENT, nullptr);
+  }
+  add("journal/query_hour", [history](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      uint32_t from = 1700000000 + (uint32_t)(i % 1800) * 60;
+      uint32_t found = journal_query(history->state, *history, from, from + 3600, 0,
+                                     [](const JournalRecord&) { return true; });
+      keep(found);
+    }
+  });
+
+  add("process_downlink/decode_string", [](uint64_t n) {
+    String hex = insert_downlink_hex;
+    for (uint64_t i = 0; i < n; i++) {
+      UserDownlink user;
+      bool ok = legacy_decode_user_downlink(hex, user);
+      keep(ok);
+      keep(user);
+    }
+  });
+
+  // process_downlink_message() as it runs now: bytes from at_parse_rx_line()
+  add("process_downlink/decode_buffer", [](uint64_t n) {
+    AtDownlink downlink;
+    at_parse_rx_line(at_find_rx(sendb_response), downlink);
+    for (uint64_t i = 0; i < n; i++) {
+      char rfid_tag[RFID_TAG_TEXT_SIZE];
+      text_format_rfid(&downlink.data[1], RFID_UID_LENGTH, rfid_tag, sizeof(rfid_tag));
+      const char* role = downlink.data[5] == DL_ROLE_WORKER ? "WORKER" : "ADMIN";
+      keep(rfid_tag);
+      keep(role);
+    }
+  });
+
+  add("uplink/build_report", [](uint64_t n) {
+    RtcState state;
+    rtc_state_init(state, 0);
+    bench_config(state.config);
+    uint8_t frame[REPORT_FRAME_MAX_LENGTH];
+    for (uint64_t i = 0; i < n; i++) {
+      // One motion wake 20 minutes into each hourly interval
+      int64_t start_ms = (int64_t)i * 3600000LL;
+      wake_cycle_window_expired(state, start_ms + 1200000LL, false);
+      size_t length = wake_cycle_build_report(state, state.config, start_ms + 3600000LL, (float)(i % 100), frame);
+      wake_cycle_report_sent(state, start_ms + 3600000LL);
+      keep(length);
+      keep(frame);
+    }
+  });
+
+  add("uplink/build_cleanup", [](uint64_t n) {
+    DeviceConfig config;
+    bench_config(config);
+    uint8_t frame[UPLINK_FRAME_LENGTH];
+    for (uint64_t i = 0; i < n; i++) {
+      size_t length = wake_cycle_build_cleanup(config, sample_uid, RFID_UID_LENGTH, frame);
+      keep(length);
+      keep(frame);
+    }
+  });
+
+  add("uplink/sendb_hex_string", [](uint64_t n) {
+    uint8_t frame[UPLINK_FRAME_LENGTH] = {OP_HOURLY_REPORT, 'L', 'I', 'X', '0', '0', '1', 42, 7, 0x01, 0x2C};
+    for (uint64_t i = 0; i < n; i++) {
+      String command = legacy_sendb_command(frame, UPLINK_FRAME_LENGTH, 1);
+      keep(command);
+    }
+  });
+
+  add("uplink/sendb_hex_buffer", [](uint64_t n) {
+    uint8_t frame[UPLINK_FRAME_LENGTH] = {OP_HOURLY_REPORT, 'L', 'I', 'X', '0', '0', '1', 42, 7, 0x01, 0x2C};
+    char command[AT_SENDB_MAX_LENGTH];
+    for (uint64_t i = 0; i < n; i++) {
+      size_t length = at_format_sendb(command, sizeof(command), 1, frame, UPLINK_FRAME_LENGTH);
+      keep(length);
+      keep(command);
+    }
+  });
+
+  add("rx/parse_string", [](uint64_t n) {
+    String response = sendb_response;
+    for (uint64_t i = 0; i < n; i++) {
+      String hex;
+      int port = 0;
+      bool found = legacy_find_downlink(response, hex, port);
+      keep(found);
+      keep(hex);
+    }
+  });
+
+  add("rx/parse_buffer", [](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      AtDownlink downlink;
+      const char* line = at_find_rx(sendb_response);
+      bool found = line != nullptr && at_parse_rx_line(line, downlink);
+      keep(found);
+      keep(downlink);
+    }
+  });
+
+  // check_incoming_lorawan(): one RX line arriving character by character
+  add("rx/uart_line_string", [](uint64_t n) {
+    const char* line = sendb_response + 4;
+    for (uint64_t i = 0; i < n; i++) {
+      String rxBuffer = "";
+      bool complete = false;
+      for (const char* p = line; *p && !complete; p++) {
+        complete = legacy_read_line(rxBuffer, *p);
+      }
+      keep(complete);
+    }
+  });
+
+  add("rx/uart_line_buffer", [](uint64_t n) {
+    const char* line = sendb_response + 4;
+    TextLine buffer;
+    for (uint64_t i = 0; i < n; i++) {
+      text_line_clear(buffer);
+      AtDownlink downlink;
+      bool complete = false;
+      for (const char* p = line; *p && !complete; p++) {
+        complete = text_line_push(buffer, *p) && at_parse_rx_line(buffer.text, downlink);
+      }
+      keep(complete);
+      keep(downlink);
+    }
+  });
+}
+
+// ============================================
+// Runner
+// ============================================
+
+static double elapsed_ns(const std::function<void(uint64_t)>& body, uint64_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  body(iterations);
+  auto end = std::chrono::steady_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static Result run(const Benchmark& benchmark, const Options& options) {
+  // Grow the iteration count until one run takes at least min_time
+  uint64_t iterations = 1;
+  double min_ns = options.min_time_ms * 1e6;
+  for (;;) {
+    double ns = elapsed_ns(benchmark.body, iterations);
+    if (ns >= min_ns || iterations >= (1ULL << 40)) break;
+    double scale = ns > 0 ? std::min(10.0, 1.4 * min_ns / ns) : 10.0;
+    iterations = std::max(iterations + 1, (uint64_t)(iterations * scale));
+  }
+
+  std::vector<double> per_op;
+  AllocStats before = alloc_counter_snapshot();
+  for (uint32_t r = 0; r < options.repetitions; r++) {
+    per_op.push_back(elapsed_ns(benchmark.body, iterations) / iterations);
+  }
+  AllocStats after = alloc_counter_snapshot();
+  std::sort(per_op.begin(), per_op.end());
+
+  Result result;
+  result.name = benchmark.name;
+  result.ns_per_op = per_op[per_op.size() / 2];
+  double calls = (double)iterations * options.repetitions;
+  result.allocs_per_op = (after.count - before.count) / calls;
+  result.bytes_per_op = (after.bytes - before.bytes) / calls;
+  return result;
+}
+
+static std::map<std::string, Result> load_csv(const std::string& path) {
+  std::map<std::string, Result> results;
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    fprintf(stderr, "Cannot read %s\n", path.c_str());
+    return results;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char name[128];
+    Result result;
+    if (sscanf(line, "%127[^,],%lf,%lf,%lf", name, &result.ns_per_op, &result.allocs_per_op, &result.bytes_per_op) == 4) {
+      result.name = name;
+      results[result.name] = result;
+    }
+  }
+  fclose(file);
+  return results;
+}
+
+static void write_csv(const std::string& path, const std::vector<Result>& results) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "Cannot write %s\n", path.c_str());
+    return;
+  }
+  fprintf(file, "name,ns_per_op,allocs_per_op,bytes_per_op\n");
+  for (const Result& result : results) {
+    fprintf(file, "%s,%.2f,%.3f,%.1f\n", result.name.c_str(), result.ns_per_op, result.allocs_per_op, result.bytes_per_op);
+  }
+  fclose(file);
+}
+
+static void usage() {
+  printf(
+    "Usage: bench [options]\n"
+    "  --filter TEXT     only run benchmarks whose name contains TEXT\n"
+    "  --min-time MS     minimum time per measured run (default 200)\n"
+    "  --repetitions N   measured runs per benchmark, median reported (default 5)\n"
+    "  --csv FILE        write results as CSV\n"
+    "  --compare FILE    show the change against a CSV from an earlier run\n"
+    "  --list            list benchmark names\n");
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  bool list = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--filter" && has_value) {
+      options.filter = argv[++i];
+    } else if (arg == "--min-time" && has_value) {
+      options.min_time_ms = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--repetitions" && has_value) {
+      options.repetitions = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--csv" && has_value) {
+      options.csv_path = argv[++i];
+    } else if (arg == "--compare" && has_value) {
+      options.compare_path = argv[++i];
+    } else if (arg == "--list") {
+      list = true;
+    } else {
+      usage();
+      return arg == "--help" ? 0 : 1;
+    }
+  }
+
+  if (!alloc_counter_install_sqlite()) {
+    fprintf(stderr, "Could not install the SQLite allocator\n");
+    return 1;
+  }
+  register_benchmarks();
+
+  if (list) {
+    for (const Benchmark& benchmark : benchmarks) printf("%s\n", benchmark.name.c_str());
+    remove_db_fixtures();
+    return 0;
+  }
+
+  std::map<std::string, Result> baseline;
+  if (!options.compare_path.empty()) baseline = load_csv(options.compare_path);
+
+  printf("%-32s %12s %10s %10s", "benchmark", "ns/op", "allocs/op", "bytes/op");
+  if (!baseline.empty()) printf(" %10s %10s", "time", "allocs");
+  printf("\n");
+
+  std::vector<Result> results;
+  for (const Benchmark& benchmark : benchmarks) {
+    if (benchmark.name.find(options.filter) == std::string::npos) continue;
+    Result result = run(benchmark, options);
+    results.push_back(result);
+
+    printf("%-32s %12.1f %10.2f %10.1f", result.name.c_str(), result.ns_per_op, result.allocs_per_op, result.bytes_per_op);
+    auto before = baseline.find(result.name);
+    if (before != baseline.end()) {
+      double time_change = before->second.ns_per_op > 0
+        ? 100.0 * (result.ns_per_op - before->second.ns_per_op) / before->second.ns_per_op : 0;
+      printf(" %+9.1f%% %+10.2f", time_change, result.allocs_per_op - before->second.allocs_per_op);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  if (!options.csv_path.empty()) write_csv(options.csv_path, results);
+
+  remove_db_fixtures();
+  return 0;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "arduino_string.h"
+
+// ============================================
+// String-Based Firmware Paths
+// ============================================
+//
+// The parts of ESP32/main.cpp that worked on Arduino String before they
+// moved to fixed buffers (text.h, at_modem.h), copied without their Serial
+// logging and database calls. They are kept as the "before" figure next to
+// the benchmarks of the code the firmware runs now.
+
+#define DL_OP_INSERT_USER  0x01
+#define DL_OP_DELETE_USER  0x02
+#define DL_ROLE_WORKER     0x01
+#define DL_ROLE_ADMIN      0x02
+
+// format_rfid(): UID as spaced uppercase hex, e.g. "21 47 C2 4C"
+inline String legacy_format_rfid(byte* uid, byte size) {
+  String rfidString = "";
+  for (byte i = 0; i < size; i++) {
+    if (i > 0) rfidString += " ";
+    if (uid[i] < 0x10) rfidString += "0";
+    rfidString += String(uid[i], HEX);
+  }
+  rfidString.toUpperCase();
+  return rfidString;
+}
+
+// send_lorawan_data() before at_format_sendb(): hex by concatenation, then
+// "AT+SENDB=" + port + ":" + hex
+inline String legacy_sendb_command(byte* data, int length, int port) {
+  String hexData = "";
+  for (int i = 0; i < length; i++) {
+    if (data[i] < 0x10) hexData += "0";
+    hexData += String(data[i], HEX);
+  }
+  hexData.toUpperCase();
+  return "AT+SENDB=" + String(port) + ":" + hexData;
+}
+
+// check_response_for_downlink(): find the RX: line in a module response and
+// split it into hex data and port (RSSI and SNR are extracted for logging)
+inline bool legacy_find_downlink(String& response, String& hexData, int& port) {
+  int rxIndex = response.indexOf("RX:");
+  if (rxIndex < 0) return false;
+
+  int lineEnd = response.indexOf('\n', rxIndex);
+  if (lineEnd < 0) lineEnd = response.indexOf('\r', rxIndex);
+  if (lineEnd < 0) lineEnd = response.length();
+
+  String rxLine = response.substring(rxIndex, lineEnd);
+  rxLine.trim();
+
+  int firstColon = rxLine.indexOf(':');
+  int secondColon = rxLine.indexOf(':', firstColon + 1);
+  int thirdColon = rxLine.indexOf(':', secondColon + 1);
+  int fourthColon = rxLine.indexOf(':', thirdColon + 1);
+  if (secondColon <= 0) return false;
+
+  hexData = rxLine.substring(firstColon + 1, secondColon);
+  port = 0;
+  if (thirdColon > 0) {
+    String portStr = rxLine.substring(secondColon + 1, thirdColon);
+    port = portStr.toInt();
+  }
+  String rssi = "";
+  String snr = "";
+  if (fourthColon > 0) {
+    rssi = rxLine.substring(thirdColon + 1, fourthColon);
+    snr = rxLine.substring(fourthColon + 1);
+  }
+  return true;
+}
+
+// check_incoming_lorawan(): accumulate UART characters into a String line
+// Returns true when c completes an RX: line (left in rxBuffer)
+inline bool legacy_read_line(String& rxBuffer, char c) {
+  rxBuffer += c;
+  if (c == '\n' || c == '\r') {
+    rxBuffer.trim();
+    if (rxBuffer.startsWith("RX:")) return true;
+    rxBuffer = "";
+  }
+  if (rxBuffer.length() > 200) {
+    rxBuffer = "";
+  }
+  return false;
+}
+
+struct UserDownlink {
+  byte operation = 0;
+  String rfid_tag;
+  String role;
+};
+
+// process_downlink_message(): hex decode and user INSERT/DELETE decoding up
+// to the database call (the String passed by value is part of the cost)
+inline bool legacy_decode_user_downlink(String hexData, UserDownlink& out) {
+  int byteLength = hexData.length() / 2;
+
+  byte data[10];
+  for (int i = 0; i < byteLength && i < 10; i++) {
+    String byteStr = hexData.substring(i * 2, i * 2 + 2);
+    data[i] = (byte)strtol(byteStr.c_str(), NULL, 16);
+  }
+
+  out.operation = data[0];
+  if (out.operation != DL_OP_INSERT_USER && out.operation != DL_OP_DELETE_USER) return false;
+  if (byteLength != (out.operation == DL_OP_INSERT_USER ? 6 : 5)) return false;
+
+  String rfid_tag = "";
+  for (int i = 1; i <= 4; i++) {
+    if (i > 1) rfid_tag += " ";
+    if (data[i] < 0x10) rfid_tag += "0";
+    rfid_tag += String(data[i], HEX);
+  }
+  rfid_tag.toUpperCase();
+  out.rfid_tag = rfid_tag;
+
+  if (out.operation == DL_OP_INSERT_USER) {
+    byte roleByte = data[5];
+    if (roleByte == DL_ROLE_WORKER) {
+      out.role = "WORKER";
+    } else if (roleByte == DL_ROLE_ADMIN) {
+      out.role = "ADMIN";
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
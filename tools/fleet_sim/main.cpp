@@ -0,0 +1,269 @@
+// Fleet simulator: runs the firmware's wake-cycle logic for thousands of
+// virtual bins and publishes their uplinks the way TTN would, to load-test
+// the backend ingest (src/server/mqtt.ts -> Prisma Status/Cleanup).
+//
+//   fleet_sim --bins 3000 --days 1 --speed 60 --broker localhost:1883
+//
+// Without --broker the uplinks go to an in-process broker stand-in, which
+// reports the offered load without needing Mosquitto or the backend.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+#include "uplink_sink.h"
+#include "virtual_bin.h"
+
+struct SimOptions {
+  uint32_t bins = 1000;
+  double days = 1.0;
+  double speed = 0;              // Simulated seconds per wall second, 0 = as fast as possible
+  uint32_t threads = 0;          // 0 = one per core
+  uint32_t step_s = 60;          // Simulation step (bins are synchronized once per step)
+  uint64_t seed = 1;
+  BinParams bin = {180, 30000, 15000, -1, 1.0, 5000.0};  // Firmware factory defaults
+  std::string broker;            // host[:port], empty = broker stand-in
+  std::string topic = "smart-trashcan/uplink";
+  std::string username;
+  std::string password;
+};
+
+static void print_usage(const char* program) {
+  printf("Usage: %s [options]\n", program);
+  printf("  --bins N          virtual bins (default 1000)\n");
+  printf("  --days D          simulated days (default 1)\n");
+  printf("  --speed X         simulated seconds per wall second, 0 = unpaced (default 0)\n");
+  printf("  --threads N       worker threads (default: all cores)\n");
+  printf("  --step S          synchronization step in simulated seconds (default 60)\n");
+  printf("  --seed N          random seed (default 1)\n");
+  printf("  --interval S      report interval in seconds (default 180)\n");
+  printf("  --data-rate DR    fixed data rate 0-6, -1 = campus mix (default -1)\n");
+  printf("  --traffic X       foot traffic multiplier (default 1)\n");
+  printf("  --broker H[:P]    publish to an MQTT broker (default: in-process stand-in)\n");
+  printf("  --topic T         uplink topic (default smart-trashcan/uplink)\n");
+  printf("  --username U      broker username\n");
+  printf("  --password P      broker password\n");
+}
+
+static bool parse_options(int argc, char** argv, SimOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      exit(0);
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg.c_str());
+      return false;
+    }
+    const char* value = argv[++i];
+
+    if (arg == "--bins") options.bins = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--days") options.days = atof(value);
+    else if (arg == "--speed") options.speed = atof(value);
+    else if (arg == "--threads") options.threads = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--step") options.step_s = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--seed") options.seed = strtoull(value, nullptr, 10);
+    else if (arg == "--interval") options.bin.report_interval_s = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--data-rate") options.bin.data_rate = atoi(value);
+    else if (arg == "--traffic") options.bin.traffic_scale = atof(value);
+    else if (arg == "--broker") options.broker = value;
+    else if (arg == "--topic") options.topic = value;
+    else if (arg == "--username") options.username = value;
+    else if (arg == "--password") options.password = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  if (options.bins == 0 || options.bins > 99999) {
+    fprintf(stderr, "--bins must be between 1 and 99999 (names are S00000-S99999)\n");
+    return false;
+  }
+  if (options.days <= 0 || options.step_s == 0 || options.speed < 0) {
+    fprintf(stderr, "--days and --step must be positive, --speed must not be negative\n");
+    return false;
+  }
+  if (options.bin.report_interval_s < CFG_SLEEP_INTERVAL_MIN_S ||
+      options.bin.report_interval_s > CFG_SLEEP_INTERVAL_MAX_S) {
+    fprintf(stderr, "--interval must be between %d and %d seconds\n",
+            CFG_SLEEP_INTERVAL_MIN_S, CFG_SLEEP_INTERVAL_MAX_S);
+    return false;
+  }
+  if (options.bin.data_rate > 6) {
+    fprintf(stderr, "--data-rate must be 0-6 or -1\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  SimOptions options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  uint32_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+  int64_t duration_ms = (int64_t)(options.days * SIM_MS_PER_DAY);
+  int64_t step_ms = (int64_t)options.step_s * 1000;
+
+  // Simulated time starts at the most recent Monday 00:00 UTC, so the
+  // weekday profile lines up and received_at looks like live traffic
+  int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  int64_t days_since_epoch = now_ms / SIM_MS_PER_DAY;
+  int64_t epoch_unix_ms = (days_since_epoch - (days_since_epoch + 3) % 7) * SIM_MS_PER_DAY;  // 1970-01-01 was a Thursday
+
+  // Output
+  std::unique_ptr<UplinkSink> sink;
+  if (options.broker.empty()) {
+    sink.reset(new BrokerStandIn());
+  } else {
+    std::string host = options.broker;
+    uint16_t port = 1883;
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos) {
+      port = (uint16_t)atoi(host.c_str() + colon + 1);
+      host = host.substr(0, colon);
+    }
+    MqttSink* mqtt = new MqttSink(host, port, options.username, options.password);
+    sink.reset(mqtt);
+    if (!mqtt->connect()) {
+      fprintf(stderr, "Could not connect to %s: %s\n", options.broker.c_str(), mqtt->last_error().c_str());
+      return 1;
+    }
+  }
+
+  printf("Fleet simulator\n");
+  printf("  Bins: %u, simulated days: %.2f, threads: %u\n", options.bins, options.days, threads);
+  printf("  Report interval: %u s, data rate: %s\n", options.bin.report_interval_s,
+         options.bin.data_rate < 0 ? "campus mix" : std::to_string(options.bin.data_rate).c_str());
+  printf("  Speed: %s, output: %s\n",
+         options.speed > 0 ? (std::to_string((int)options.speed) + "x").c_str() : "unpaced", sink->name());
+
+  std::vector<VirtualBin> bins;
+  bins.reserve(options.bins);
+  for (uint32_t i = 0; i < options.bins; i++) {
+    bins.emplace_back(i, options.bin, epoch_unix_ms, options.seed);
+  }
+
+  // Several shards per thread keep the pool busy when some bins are hotter than others
+  ThreadPool pool(threads);
+  size_t shard_count = std::min<size_t>(bins.size(), (size_t)threads * 4);
+  std::vector<std::vector<SimUplink>> shard_uplinks(shard_count);
+
+  // Load statistics
+  uint64_t published = 0, failed = 0, reports = 0, cleanups = 0, inferred = 0, clock_syncs = 0;
+  uint64_t busiest_step = 0;
+  int64_t busiest_step_ms = 0;
+  std::vector<uint64_t> per_hour((size_t)(duration_ms / SIM_MS_PER_HOUR) + 1, 0);
+  double max_lag_s = 0;
+
+  std::vector<SimUplink> merged;
+  auto wall_start = std::chrono::steady_clock::now();
+
+  for (int64_t step_start = 0; step_start < duration_ms; step_start += step_ms) {
+    int64_t step_end = std::min(step_start + step_ms, duration_ms);
+
+    for (size_t s = 0; s < shard_count; s++) {
+      pool.submit([&, s] {
+        shard_uplinks[s].clear();
+        for (size_t i = s; i < bins.size(); i += shard_count) {
+          bins[i].advance(step_end, shard_uplinks[s]);
+        }
+      });
+    }
+    pool.wait_idle();
+
+    merged.clear();
+    for (const std::vector<SimUplink>& uplinks : shard_uplinks) {
+      merged.insert(merged.end(), uplinks.begin(), uplinks.end());
+    }
+    std::sort(merged.begin(), merged.end(), [](const SimUplink& a, const SimUplink& b) {
+      return a.sim_ms != b.sim_ms ? a.sim_ms < b.sim_ms : a.bin_index < b.bin_index;
+    });
+
+    if (merged.size() > busiest_step) {
+      busiest_step = merged.size();
+      busiest_step_ms = step_start;
+    }
+
+    for (const SimUplink& uplink : merged) {
+      if (options.speed > 0) {
+        auto target = wall_start + std::chrono::microseconds((int64_t)(uplink.sim_ms * 1000.0 / options.speed));
+        auto now = std::chrono::steady_clock::now();
+        if (now < target) {
+          std::this_thread::sleep_until(target);
+        } else {
+          max_lag_s = std::max(max_lag_s, std::chrono::duration<double>(now - target).count());
+        }
+      }
+
+      std::string json = ttn_uplink_json(uplink, bins[uplink.bin_index].device_id(),
+                                         epoch_unix_ms + uplink.sim_ms);
+      if (sink->publish(options.topic, json)) {
+        published++;
+      } else {
+        failed++;
+      }
+
+      if (uplink.port == CLOCK_SYNC_PORT) clock_syncs++;
+      else if (uplink.frame[0] == OP_HOURLY_REPORT) reports++;
+      else if (uplink.frame[0] == OP_WORKER_CLEANUP) cleanups++;
+      else if (uplink.frame[0] == OP_INFERRED_CLEANUP) inferred++;
+      per_hour[(size_t)(uplink.sim_ms / SIM_MS_PER_HOUR)]++;
+    }
+  }
+
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+  // Fleet-wide device statistics
+  BinStats total;
+  uint64_t flushes = 0;
+  for (const VirtualBin& bin : bins) {
+    const BinStats& stats = bin.stats();
+    total.wakes += stats.wakes;
+    total.uses += stats.uses;
+    total.reports_deferred += stats.reports_deferred;
+    total.airtime_ms += stats.airtime_ms;
+    flushes += stats.nvs_flushes;
+  }
+
+  size_t busiest_hour = (size_t)(std::max_element(per_hour.begin(), per_hour.end()) - per_hour.begin());
+  double sim_s = duration_ms / 1000.0;
+
+  printf("\nDevices\n");
+  printf("  Wakes: %u, uses: %u, NVS flushes: %llu\n", total.wakes, total.uses, (unsigned long long)flushes);
+  printf("  Reports deferred by the airtime governor: %u\n", total.reports_deferred);
+  printf("  Airtime: %.1f s per bin per day\n",
+         total.airtime_ms / 1000.0 / options.bins / options.days);
+
+  printf("\nUplinks\n");
+  printf("  Published: %llu (reports %llu, cleanups %llu, inferred cleanups %llu, clock syncs %llu), failed: %llu\n",
+         (unsigned long long)published, (unsigned long long)reports, (unsigned long long)cleanups,
+         (unsigned long long)inferred, (unsigned long long)clock_syncs, (unsigned long long)failed);
+  printf("  Mean rate: %.2f msg/s of simulated time\n", published / sim_s);
+  printf("  Busiest hour: %02zu:00 of day %zu, %.2f msg/s\n", busiest_hour % 24, busiest_hour / 24,
+         per_hour[busiest_hour] / 3600.0);
+  printf("  Busiest step: %llu uplinks at %.1f h (%.2f msg/s)\n", (unsigned long long)busiest_step,
+         busiest_step_ms / 3600000.0, busiest_step / (double)options.step_s);
+
+  printf("\nSimulator\n");
+  printf("  Wall time: %.2f s (%.0fx real time), %.0f msg/s published\n", wall_s, sim_s / wall_s,
+         published / wall_s);
+  if (options.speed > 0) {
+    printf("  Max publish lag behind schedule: %.3f s%s\n", max_lag_s,
+           max_lag_s > 1.0 ? " - simulator or broker can't keep up at this speed" : "");
+  }
+
+  return failed > 0 ? 2 : 0;
+}
@@ -0,0 +1,259 @@
+#include "mqtt_client.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <netdb.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Control packet types (fixed header, high nibble)
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30  // QoS 0, no retain
+#define MQTT_SUBSCRIBE   0x82  // Fixed header flags 0010
+#define MQTT_SUBACK      0x90
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+// CONNECT flags
+#define MQTT_FLAG_CLEAN_SESSION  0x02
+#define MQTT_FLAG_PASSWORD       0x40
+#define MQTT_FLAG_USERNAME       0x80
+
+static void put_string(std::vector<uint8_t>& out, const std::string& value) {
+  out.push_back((uint8_t)(value.size() >> 8));
+  out.push_back((uint8_t)(value.size() & 0xFF));
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+static int64_t steady_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MqttClient::~MqttClient() {
+  disconnect();
+}
+
+bool MqttClient::fail(const std::string& message) {
+  last_error_ = message;
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  return false;
+}
+
+bool MqttClient::connect(const std::string& host, uint16_t port, const std::string& client_id,
+                         const std::string& username, const std::string& password, uint16_t keep_alive_s) {
+  disconnect();
+  input_.clear();
+  packet_length_ = 0;
+  keep_alive_s_ = keep_alive_s;
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  std::string service = std::to_string(port);
+  int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+  if (rc != 0) {
+    return fail(std::string("resolve ") + host + ": " + gai_strerror(rc));
+  }
+
+  for (addrinfo* ai = result; ai != nullptr; ai = ai->ai_next) {
+    fd_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd_ < 0) continue;
+    if (::connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) break;
+    close(fd_);
+    fd_ = -1;
+  }
+  freeaddrinfo(result);
+  if (fd_ < 0) {
+    return fail("connect " + host + ":" + service + ": " + strerror(errno));
+  }
+
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  // Variable header: protocol name, level 4 (3.1.1), flags, keep alive (0 = disabled)
+  std::vector<uint8_t> body;
+  put_string(body, "MQTT");
+  body.push_back(4);
+  uint8_t flags = MQTT_FLAG_CLEAN_SESSION;
+  if (!username.empty()) flags |= MQTT_FLAG_USERNAME;
+  if (!username.empty() && !password.empty()) flags |= MQTT_FLAG_PASSWORD;
+  body.push_back(flags);
+  body.push_back((uint8_t)(keep_alive_s >> 8));
+  body.push_back((uint8_t)(keep_alive_s & 0xFF));
+
+  put_string(body, client_id);
+  if (flags & MQTT_FLAG_USERNAME) put_string(body, username);
+  if (flags & MQTT_FLAG_PASSWORD) put_string(body, password);
+
+  if (!send_packet(MQTT_CONNECT, body)) return false;
+
+  uint8_t connack[4];
+  size_t received = 0;
+  while (received < sizeof(connack)) {
+    ssize_t n = recv(fd_, connack + received, sizeof(connack) - received, 0);
+    if (n <= 0) return fail("broker closed the connection before CONNACK");
+    received += (size_t)n;
+  }
+  if (connack[0] != MQTT_CONNACK || connack[1] != 2) {
+    return fail("unexpected answer to CONNECT");
+  }
+  if (connack[3] != 0) {
+    return fail("broker refused the connection (return code " + std::to_string(connack[3]) + ")");
+  }
+  return true;
+}
+
+bool MqttClient::publish(const std::string& topic, const std::string& payload) {
+  if (fd_ < 0) return fail("not connected");
+
+  std::vector<uint8_t> body;
+  body.reserve(topic.size() + payload.size() + 2);
+  put_string(body, topic);
+  body.insert(body.end(), payload.begin(), payload.end());
+  return send_packet(MQTT_PUBLISH, body);
+}
+
+bool MqttClient::subscribe(const std::string& topic_filter) {
+  if (fd_ < 0) return fail("not connected");
+
+  // Packet identifier, then the filter with requested QoS 0
+  uint16_t packet_id = next_packet_id_++;
+  std::vector<uint8_t> body = {(uint8_t)(packet_id >> 8), (uint8_t)(packet_id & 0xFF)};
+  put_string(body, topic_filter);
+  body.push_back(0);
+  if (!send_packet(MQTT_SUBSCRIBE, body)) return false;
+
+  // PUBLISH packets may arrive before the SUBACK; they are dropped
+  uint8_t header = 0;
+  for (;;) {
+    if (!read_packet(10000, header)) return last_error_.empty() ? fail("no SUBACK from broker") : false;
+    if ((header & 0xF0) != MQTT_SUBACK) continue;
+    const uint8_t* ack = input_.data() + body_offset_;
+    size_t ack_length = packet_length_ - body_offset_;
+    if (ack_length < 3 || ack[0] != body[0] || ack[1] != body[1]) continue;
+    if (ack[2] == 0x80) return fail("broker refused the subscription to " + topic_filter);
+    return true;
+  }
+}
+
+bool MqttClient::receive(MqttMessage& message, int timeout_ms) {
+  int64_t deadline = steady_ms() + timeout_ms;
+  uint8_t header = 0;
+  for (;;) {
+    int64_t left = deadline - steady_ms();
+    if (left < 0) left = 0;
+    if (!read_packet((int)left, header)) return false;
+    if ((header & 0xF0) != MQTT_PUBLISH) continue;  // PINGRESP, late SUBACK
+
+    // QoS 0: topic, then the payload up to the end of the packet
+    const uint8_t* body = input_.data() + body_offset_;
+    size_t body_length = packet_length_ - body_offset_;
+    if (body_length < 2) return fail("malformed PUBLISH");
+    size_t topic_length = ((size_t)body[0] << 8) | body[1];
+    size_t payload_offset = 2 + topic_length + ((header & 0x06) ? 2 : 0);  // Packet id when QoS > 0
+    if (payload_offset > body_length) return fail("malformed PUBLISH");
+    message.topic = std::string_view((const char*)body + 2, topic_length);
+    message.payload = std::string_view((const char*)body + payload_offset, body_length - payload_offset);
+    return true;
+  }
+}
+
+// Read one complete control packet into the front of input_ (the previous
+// one is dropped first); false on timeout with last_error_ empty, or on error
+bool MqttClient::read_packet(int timeout_ms, uint8_t& header) {
+  if (fd_ < 0) return fail("not connected");
+  last_error_.clear();
+  if (packet_length_ > 0) {
+    input_.erase(input_.begin(), input_.begin() + packet_length_);
+    packet_length_ = 0;
+  }
+
+  int64_t deadline = steady_ms() + timeout_ms;
+  for (;;) {
+    // Fixed header: type and flags, then the remaining length (1-4 bytes)
+    if (input_.size() >= 2) {
+      size_t remaining = 0;
+      size_t offset = 1;
+      bool complete = false;
+      for (int shift = 0; offset < input_.size() && shift <= 21; shift += 7) {
+        uint8_t digit = input_[offset++];
+        remaining |= (size_t)(digit & 0x7F) << shift;
+        if (!(digit & 0x80)) {
+          complete = true;
+          break;
+        }
+      }
+      if (!complete && offset >= 5) return fail("malformed remaining length");
+      if (complete && input_.size() >= offset + remaining) {
+        header = input_[0];
+        body_offset_ = offset;
+        packet_length_ = offset + remaining;
+        return true;
+      }
+    }
+
+    int64_t now = steady_ms();
+    if (keep_alive_s_ > 0 && now - last_sent_ms_ >= (int64_t)keep_alive_s_ * 500) {
+      if (!send_packet(MQTT_PINGREQ, {})) return false;
+    }
+    if (now >= deadline) return false;
+
+    int wait_ms = (int)(deadline - now);
+    if (keep_alive_s_ > 0 && wait_ms > keep_alive_s_ * 500) wait_ms = keep_alive_s_ * 500;
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int ready = poll(&pfd, 1, wait_ms);
+    if (ready < 0 && errno != EINTR) return fail(std::string("poll: ") + strerror(errno));
+    if (ready <= 0) continue;
+
+    uint8_t buffer[16384];
+    ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return fail("broker closed the connection");
+    input_.insert(input_.end(), buffer, buffer + n);
+  }
+}
+
+void MqttClient::disconnect() {
+  if (fd_ < 0) return;
+  send_packet(MQTT_DISCONNECT, {});
+  close(fd_);
+  fd_ = -1;
+}
+
+bool MqttClient::send_packet(uint8_t header, const std::vector<uint8_t>& body) {
+  std::vector<uint8_t> packet;
+  packet.reserve(body.size() + 5);
+  packet.push_back(header);
+
+  // Remaining length: 7 bits per byte, high bit = more bytes follow
+  size_t remaining = body.size();
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) digit |= 0x80;
+    packet.push_back(digit);
+  } while (remaining > 0);
+  packet.insert(packet.end(), body.begin(), body.end());
+
+  size_t sent = 0;
+  while (sent < packet.size()) {
+    ssize_t n = send(fd_, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return fail(std::string("send: ") + strerror(errno));
+    sent += (size_t)n;
+  }
+  last_sent_ms_ = steady_ms();
+  return true;
+}
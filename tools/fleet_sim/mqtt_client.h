@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Received PUBLISH; topic and payload point into the client's receive buffer
+// and stay valid until the next receive()
+struct MqttMessage {
+  std::string_view topic;
+  std::string_view payload;
+};
+
+// Minimal MQTT 3.1.1 client (plain TCP, QoS 0 only)
+// Enough to push simulated uplinks into a local broker (e.g. Mosquitto) that
+// the backend's uplink listener is subscribed to, and to consume them again
+// (tools/ingest). No TLS.
+class MqttClient {
+ public:
+  MqttClient() = default;
+  ~MqttClient();
+
+  MqttClient(const MqttClient&) = delete;
+  MqttClient& operator=(const MqttClient&) = delete;
+
+  // keep_alive_s > 0: receive() sends PINGREQ when the connection is idle
+  bool connect(const std::string& host, uint16_t port, const std::string& client_id,
+               const std::string& username = "", const std::string& password = "",
+               uint16_t keep_alive_s = 0);
+  bool publish(const std::string& topic, const std::string& payload);
+  bool subscribe(const std::string& topic_filter);
+  void disconnect();
+
+  // Wait up to timeout_ms for the next PUBLISH; false on timeout (last_error()
+  // empty) or on a connection error
+  bool receive(MqttMessage& message, int timeout_ms);
+
+  bool connected() const { return fd_ >= 0; }
+  const std::string& last_error() const { return last_error_; }
+
+ private:
+  bool send_packet(uint8_t header, const std::vector<uint8_t>& body);
+  bool read_packet(int timeout_ms, uint8_t& header);
+  bool fail(const std::string& message);
+
+  int fd_ = -1;
+  std::string last_error_;
+  uint16_t keep_alive_s_ = 0;
+  uint16_t next_packet_id_ = 1;
+  int64_t last_sent_ms_ = 0;
+  std::vector<uint8_t> input_;      // Bytes received, not yet consumed
+  size_t packet_length_ = 0;        // Length of the packet at the front of input_ (consumed by the next read)
+  size_t body_offset_ = 0;
+};
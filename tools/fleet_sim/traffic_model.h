@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// ============================================
+// Synthetic Campus Traffic
+// ============================================
+//
+// Foot traffic is a non-homogeneous Poisson process with a weekday campus
+// profile (class changes and lunch peaks, almost nothing at night, quieter
+// weekends). Every use drops a random amount of trash into the bin; a worker
+// is dispatched once the bin crosses the dashboard's red threshold and
+// arrives after a random delay.
+
+#define SIM_MS_PER_HOUR  3600000LL
+#define SIM_MS_PER_DAY   (24LL * SIM_MS_PER_HOUR)
+
+// Relative foot traffic per hour of day (1.0 = busiest hour)
+inline double traffic_hour_weight(int hour) {
+  static const double weights[24] = {
+    0.01, 0.01, 0.01, 0.01, 0.01, 0.02,  // 00-05
+    0.08, 0.35, 0.70, 0.60, 0.80, 0.65,  // 06-11
+    1.00, 0.90, 0.60, 0.75, 0.70, 0.55,  // 12-17
+    0.45, 0.35, 0.20, 0.10, 0.05, 0.02   // 18-23
+  };
+  return weights[((hour % 24) + 24) % 24];
+}
+
+// Relative traffic for a simulated time (day 0 is a Monday)
+inline double traffic_weight(int64_t sim_ms) {
+  int64_t day = sim_ms / SIM_MS_PER_DAY;
+  int hour = (int)((sim_ms % SIM_MS_PER_DAY) / SIM_MS_PER_HOUR);
+  double weekday = (day % 7) >= 5 ? 0.25 : 1.0;
+  return traffic_hour_weight(hour) * weekday;
+}
+
+// Per-bin traffic parameters, drawn once per virtual bin
+struct TrafficProfile {
+  double peak_uses_per_hour;  // Uses during the busiest hour
+  double fill_per_use_pct;    // Mean fill added by one use
+  double worker_delay_h;      // Mean delay between dispatch and the worker's visit
+};
+
+inline TrafficProfile traffic_profile_random(std::mt19937_64& rng, double traffic_scale) {
+  // Log-normal spread: a few bins near entrances and canteens see most of the traffic
+  std::lognormal_distribution<double> uses(std::log(6.0), 0.8);
+  std::uniform_real_distribution<double> fill(0.3, 1.2);
+  std::uniform_real_distribution<double> delay(1.0, 6.0);
+
+  TrafficProfile profile;
+  profile.peak_uses_per_hour = uses(rng) * traffic_scale;
+  profile.fill_per_use_pct = fill(rng);
+  profile.worker_delay_h = delay(rng);
+  return profile;
+}
+
+// Next use after sim_ms (thinning against the peak rate), or -1 if the bin sees no traffic
+inline int64_t traffic_next_use_ms(const TrafficProfile& profile, int64_t sim_ms, std::mt19937_64& rng) {
+  if (profile.peak_uses_per_hour <= 0) return -1;
+
+  std::exponential_distribution<double> gap_h(profile.peak_uses_per_hour);
+  std::uniform_real_distribution<double> accept(0.0, 1.0);
+
+  int64_t t = sim_ms;
+  while (true) {
+    t += (int64_t)(gap_h(rng) * SIM_MS_PER_HOUR) + 1;
+    if (accept(rng) < traffic_weight(t)) return t;
+  }
+}
+
+// Fill added by one use (percent of the bin)
+inline double traffic_use_fill_pct(const TrafficProfile& profile, std::mt19937_64& rng) {
+  std::exponential_distribution<double> amount(1.0 / profile.fill_per_use_pct);
+  return amount(rng);
+}
+
+// Time of the worker's visit after a dispatch at sim_ms
+inline int64_t traffic_worker_visit_ms(const TrafficProfile& profile, int64_t sim_ms, std::mt19937_64& rng) {
+  std::exponential_distribution<double> delay_h(1.0 / profile.worker_delay_h);
+  return sim_ms + (int64_t)(delay_h(rng) * SIM_MS_PER_HOUR) + 60000;
+}
@@ -0,0 +1,110 @@
+#include "uplink_sink.h"
+
+#include <cstdio>
+#include <ctime>
+#include <unistd.h>
+
+static std::string base64_encode(const uint8_t* data, size_t length) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  out.reserve((length + 2) / 3 * 4);
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t chunk = (uint32_t)data[i] << 16;
+    if (i + 1 < length) chunk |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < length) chunk |= data[i + 2];
+    out += alphabet[(chunk >> 18) & 0x3F];
+    out += alphabet[(chunk >> 12) & 0x3F];
+    out += i + 1 < length ? alphabet[(chunk >> 6) & 0x3F] : '=';
+    out += i + 2 < length ? alphabet[chunk & 0x3F] : '=';
+  }
+  return out;
+}
+
+// RFC 3339 UTC timestamp with milliseconds, like TTN's received_at
+static std::string format_timestamp(int64_t unix_ms) {
+  time_t seconds = (time_t)(unix_ms / 1000);
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+           utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+           utc.tm_hour, utc.tm_min, utc.tm_sec, (int)(unix_ms % 1000));
+  return buffer;
+}
+
+static std::string frame_name(const SimUplink& uplink) {
+  return std::string((const char*)uplink.frame + 1, DEVICE_NAME_LENGTH);
+}
+
+std::string ttn_uplink_json(const SimUplink& uplink, const std::string& device_id,
+                            int64_t received_unix_ms) {
+  std::string decoded;
+  if (uplink.port == 1 && uplink.length >= UPLINK_FRAME_LENGTH) {
+    char buffer[160];
+    if (uplink.frame[0] == OP_HOURLY_REPORT) {
+      unsigned minutes_to_full = ((unsigned)uplink.frame[9] << 8) | uplink.frame[10];
+      snprintf(buffer, sizeof(buffer),
+               ",\"decoded_payload\":{\"operation\":\"STATUS\",\"trashcanName\":\"%s\","
+               "\"fillPercentage\":%u,\"usageCount\":%u,\"minutesToFull\":%u",
+               frame_name(uplink).c_str(), uplink.frame[7], uplink.frame[8], minutes_to_full);
+      decoded = buffer;
+
+      // Usage histogram, as the payload formatter decodes it
+      uint8_t counts[USAGE_HISTOGRAM_BINS];
+      uint32_t bin_minutes = 0;
+      int bins = usage_histogram_decode(uplink.frame + UPLINK_FRAME_LENGTH, uplink.length - UPLINK_FRAME_LENGTH,
+                                        counts, &bin_minutes);
+      if (bins >= 0) {
+        decoded += ",\"usageBinMinutes\":" + std::to_string(bin_minutes) + ",\"usageBins\":[";
+        for (int i = 0; i < bins; i++) {
+          if (i > 0) decoded += ",";
+          decoded += std::to_string(counts[i]);
+        }
+        decoded += "]";
+      }
+      decoded += "}";
+    } else if (uplink.length == UPLINK_FRAME_LENGTH && uplink.frame[0] == OP_WORKER_CLEANUP) {
+      snprintf(buffer, sizeof(buffer),
+               ",\"decoded_payload\":{\"operation\":\"CLEANUP\",\"trashcanName\":\"%s\","
+               "\"rfidTag\":\"%02X %02X %02X %02X\"}",
+               frame_name(uplink).c_str(), uplink.frame[7], uplink.frame[8],
+               uplink.frame[9], uplink.frame[10]);
+      decoded = buffer;
+    }
+  }
+
+  std::string json;
+  json.reserve(256);
+  json += "{\"end_device_ids\":{\"device_id\":\"";
+  json += device_id;
+  json += "\"},\"received_at\":\"";
+  json += format_timestamp(received_unix_ms);
+  json += "\",\"uplink_message\":{\"f_port\":";
+  json += std::to_string(uplink.port);
+  json += ",\"frm_payload\":\"";
+  json += base64_encode(uplink.frame, uplink.length);
+  json += "\"";
+  json += decoded;
+  json += "}}";
+  return json;
+}
+
+bool BrokerStandIn::publish(const std::string& topic, const std::string& payload) {
+  messages_++;
+  bytes_ += topic.size() + payload.size();
+  return true;
+}
+
+MqttSink::MqttSink(const std::string& host, uint16_t port, const std::string& username,
+                   const std::string& password)
+    : host_(host), port_(port), username_(username), password_(password) {}
+
+bool MqttSink::connect() {
+  std::string client_id = "fleet-sim-" + std::to_string((long)getpid());
+  return client_.connect(host_, port_, client_id, username_, password_);
+}
+
+bool MqttSink::publish(const std::string& topic, const std::string& payload) {
+  if (client_.connected() && client_.publish(topic, payload)) return true;
+  return connect() && client_.publish(topic, payload);
+}
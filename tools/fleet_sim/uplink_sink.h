@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "mqtt_client.h"
+#include "virtual_bin.h"
+
+// TTN-style uplink JSON for one simulated frame, with the decoded_payload the
+// application's payload formatter produces (fields read by processUplinkMessage()
+// in src/server/mqtt.ts). Clock sync frames carry only frm_payload.
+std::string ttn_uplink_json(const SimUplink& uplink, const std::string& device_id,
+                            int64_t received_unix_ms);
+
+// Destination for simulated uplinks
+class UplinkSink {
+ public:
+  virtual ~UplinkSink() = default;
+  virtual bool publish(const std::string& topic, const std::string& payload) = 0;
+  virtual const char* name() const = 0;
+};
+
+// In-process broker stand-in: accepts every message and only counts it
+// Measures the simulator itself and gives the offered load without a broker
+class BrokerStandIn : public UplinkSink {
+ public:
+  bool publish(const std::string& topic, const std::string& payload) override;
+  const char* name() const override { return "broker stand-in"; }
+
+  uint64_t messages() const { return messages_; }
+  uint64_t bytes() const { return bytes_; }
+
+ private:
+  uint64_t messages_ = 0;
+  uint64_t bytes_ = 0;
+};
+
+// Real broker over MQTT (reconnects once if the connection drops)
+class MqttSink : public UplinkSink {
+ public:
+  MqttSink(const std::string& host, uint16_t port, const std::string& username,
+           const std::string& password);
+
+  bool connect();
+  bool publish(const std::string& topic, const std::string& payload) override;
+  const char* name() const override { return "MQTT broker"; }
+  const std::string& last_error() const { return client_.last_error(); }
+
+ private:
+  MqttClient client_;
+  std::string host_;
+  uint16_t port_;
+  std::string username_;
+  std::string password_;
+};
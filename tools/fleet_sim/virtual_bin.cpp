@@ -0,0 +1,346 @@
+#include "virtual_bin.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+#include "at_modem.h"
+
+// Time spent in setup() before the first uplink (boot, join, sensors)
+#define SIM_BOOT_MS           3000
+// Time the worker takes to reach the reader after the PIR wake
+#define SIM_WORKER_SCAN_MS    5000
+// Ultrasound readings while the active window is open (SENSOR_TICK_MS in main.cpp)
+#define SIM_SENSOR_TICK_MS    2000
+// Ultrasound reading noise (standard deviation, percent of the bin)
+#define SIM_FILL_NOISE_PCT    1.0
+#define SIM_DEPTH_MM          300
+#define SIM_WORKER_TAGS       16
+
+#define SIM_NEVER             INT64_MAX
+
+VirtualBin::VirtualBin(uint32_t index, const BinParams& params, int64_t epoch_unix_ms, uint64_t seed)
+    : index_(index),
+      params_(params),
+      epoch_unix_ms_(epoch_unix_ms),
+      rng_(seed ^ ((uint64_t)(index + 1) * 0x9E3779B97F4A7C15ULL)),
+      boot_ms_(SIM_BOOT_MS) {
+  char id[16];
+  snprintf(id, sizeof(id), "sim-%05u", index % 100000);
+  device_id_ = id;
+
+  traffic_ = traffic_profile_random(rng_, params.traffic_scale);
+
+  std::normal_distribution<double> drift(0.0, params.drift_sd_ppm);
+  drift_ppm_ = std::clamp(drift(rng_), -(double)TIME_SYNC_MAX_DRIFT_PPM, (double)TIME_SYNC_MAX_DRIFT_PPM);
+
+  // Same layout the firmware builds on power-on
+  char name[DEVICE_NAME_LENGTH + 1];
+  snprintf(name, sizeof(name), "S%05u", index % 100000);
+  rtc_state_init(rtc_, 0);
+  device_config_defaults(rtc_.config, params.report_interval_s, params.active_window_ms,
+                         SIM_DEPTH_MM, params.downlink_wait_ms, name);
+
+  // Most campus bins are close to a gateway; a few sit at the edge of coverage
+  if (params.data_rate >= 0) {
+    rtc_.airtime.data_rate = (uint8_t)params.data_rate;
+  } else {
+    std::discrete_distribution<int> mix({5, 5, 10, 15, 25, 40});  // DR0..DR5
+    rtc_.airtime.data_rate = (uint8_t)mix(rng_);
+  }
+
+  std::uniform_real_distribution<double> initial_fill(0.0, 50.0);
+  fill_pct_ = initial_fill(rng_);
+
+  // Stagger power-on over the first minute; the power-on boot is the first timer event
+  std::uniform_int_distribution<int64_t> power_on(0, 60000);
+  power_on_ms_ = power_on(rng_);
+  next_timer_ms_ = power_on_ms_;
+  next_use_ms_ = traffic_next_use_ms(traffic_, power_on_ms_, rng_);
+  if (next_use_ms_ < 0) next_use_ms_ = SIM_NEVER;
+  next_worker_ms_ = SIM_NEVER;
+}
+
+void VirtualBin::set_traffic(const TrafficProfile& traffic) {
+  traffic_ = traffic;
+  next_use_ms_ = traffic_next_use_ms(traffic_, power_on_ms_, rng_);
+  if (next_use_ms_ < 0) next_use_ms_ = SIM_NEVER;
+}
+
+void VirtualBin::set_setup_ms(uint32_t boot_ms, uint32_t join_ms) {
+  boot_ms_ = boot_ms;
+  join_ms_ = std::min(join_ms, boot_ms);
+}
+
+// Local clock: starts at 0 on power-on and runs with the bin's drift
+int64_t VirtualBin::local_ms(int64_t sim_ms) const {
+  double elapsed = (double)(sim_ms - power_on_ms_);
+  return (int64_t)(elapsed * (1.0 + drift_ppm_ / 1e6));
+}
+
+// Simulated time that passes while the local clock advances by local_delta_ms
+int64_t VirtualBin::sim_delta_ms(uint64_t local_delta_ms) const {
+  int64_t delta = (int64_t)((double)local_delta_ms / (1.0 + drift_ppm_ / 1e6));
+  return delta > 0 ? delta : 1;
+}
+
+void VirtualBin::advance(int64_t until_ms, std::vector<SimUplink>& out) {
+  while (true) {
+    int64_t next_sleep_ms = awake_ ? awake_until_ms_ : SIM_NEVER;
+    int64_t t = std::min({next_sleep_ms, next_timer_ms_, next_worker_ms_, next_use_ms_});
+    if (t >= until_ms) return;
+
+    if (t == next_sleep_ms) {
+      on_sleep(t, out);
+    } else if (t == next_timer_ms_) {
+      next_timer_ms_ = SIM_NEVER;
+      uint8_t kind = powered_on_ ? POWER_WAKE_TIMER : POWER_WAKE_BOOT;
+      powered_on_ = true;
+      wake(t, kind, out);
+    } else if (t == next_worker_ms_) {
+      on_worker(t, out);
+    } else {
+      on_use(t, out);
+    }
+  }
+}
+
+// Someone throws trash in; the PIR wakes the bin if it is asleep
+void VirtualBin::on_use(int64_t sim_ms, std::vector<SimUplink>& out) {
+  stats_.uses++;
+  fill_pct_ = std::min(100.0, fill_pct_ + traffic_use_fill_pct(traffic_, rng_));
+
+  int64_t next = traffic_next_use_ms(traffic_, sim_ms, rng_);
+  next_use_ms_ = next < 0 ? SIM_NEVER : next;
+
+  if (fill_pct_ >= FORECAST_THRESHOLD_PCT && !worker_dispatched_) {
+    worker_dispatched_ = true;
+    next_worker_ms_ = traffic_worker_visit_ms(traffic_, sim_ms, rng_);
+  }
+
+  if (awake_) return;  // Already awake: motion doesn't start a new cycle
+
+  next_timer_ms_ = SIM_NEVER;
+  wake(sim_ms, POWER_WAKE_MOTION, out);
+}
+
+// A worker arrives, scans the card and empties the bin
+void VirtualBin::on_worker(int64_t sim_ms, std::vector<SimUplink>& out) {
+  if (awake_ && !window_open_) {
+    // Timer wake in progress - the reader is off, try again once the bin sleeps
+    next_worker_ms_ = awake_until_ms_ + SIM_WORKER_SCAN_MS;
+    return;
+  }
+
+  int64_t t = sim_ms;
+  if (!awake_) {
+    next_timer_ms_ = SIM_NEVER;
+    t = wake(t, POWER_WAKE_MOTION, out);
+  }
+
+  t = cleanup(t + SIM_WORKER_SCAN_MS, out);
+
+  // Authenticated worker: straight to sleep, no usage counted
+  worker_authenticated_ = true;
+  awake_until_ms_ = t;
+}
+
+// handle_window_timeout() and enter_deep_sleep(): close the window, batch
+// NVS, arm the timer
+void VirtualBin::on_sleep(int64_t sim_ms, std::vector<SimUplink>& out) {
+  if (window_open_) {
+    // Sensor ticks through the window
+    int64_t ticks = (sim_ms - window_opened_ms_) / SIM_SENSOR_TICK_MS;
+    profile_.ultrasound_readings += (uint16_t)std::min<int64_t>(ticks, 0xFFFF);
+
+    // A reading for the cleanup detector when this wake has not fed it yet
+    if (wake_cycle_window_expired(rtc_, local_ms(sim_ms), worker_authenticated_) &&
+        wake_cycle_check_emptied(rtc_, 0, local_ms(sim_ms), read_fill()) == CLEANUP_DETECT_DETECTED) {
+      sim_ms = send_queued(sim_ms, WAKE_UPLINK_INFERRED_CLEANUP, out);
+    }
+  }
+
+  profile_.awake_ms = (uint32_t)(sim_ms - wake_started_ms_);
+  profile_.rfid_ms = sim_ms > rfid_on_ms_ ? (uint32_t)(sim_ms - rfid_on_ms_) : 0;
+  if (wake_log_ != nullptr) wake_log_->push_back(profile_);
+
+  int64_t local = local_ms(sim_ms);
+  uint64_t sleep_ms = wake_cycle_schedule_sleep_ms(rtc_, rtc_.config, local);
+  next_timer_ms_ = sim_ms + sim_delta_ms(sleep_ms);
+
+  if (rtc_state_flush_due(rtc_, local) && wake_cycle_flush(rtc_, local)) {
+    stats_.nvs_flushes++;
+  }
+  rtc_state_seal(rtc_);
+
+  awake_ = false;
+  window_open_ = false;
+}
+
+// setup(): boot bookkeeping, clock sync, boot flush, queued uplinks, then
+// the wake's action (wake_cycle.h); returns the time setup() is done
+int64_t VirtualBin::wake(int64_t sim_ms, uint8_t kind, std::vector<SimUplink>& out) {
+  stats_.wakes++;
+  wake_cycle_start(rtc_);
+
+  // setup() turns the RFID reader on just before the PIR settle delay
+  wake_profile_reset(profile_, kind);
+  wake_started_ms_ = sim_ms;
+  rfid_on_ms_ = sim_ms + std::max<int64_t>(0, (int64_t)boot_ms_ - SETUP_PIR_SETTLE_MS);
+  profile_.rx_ms = join_ms_;
+
+  int64_t t = sim_ms + boot_ms_;
+  if (time_sync_needed(rtc_.time_sync, local_ms(t))) {
+    t = sync_clock(t, out);
+  }
+  if (wake_cycle_boot_flush_due(rtc_, local_ms(t)) && wake_cycle_flush(rtc_, local_ms(t))) {
+    stats_.nvs_flushes++;
+  }
+  t = send_queued(t, wake_cycle_boot_uplinks(rtc_), out);
+
+  uint8_t action = wake_cycle_action(rtc_, kind);
+  if (action == WAKE_ACTION_MULTICAST) {
+    // run_multicast_window(): class C until the window closes; the batch
+    // frames themselves are not simulated
+    int64_t left_ms = wake_cycle_multicast_window_left_ms(rtc_, local_ms(t));
+    profile_.rx_ms += (uint32_t)left_ms;
+    t += left_ms > 0 ? sim_delta_ms((uint64_t)left_ms) : 0;
+  }
+  if (action == WAKE_ACTION_REPORT || action == WAKE_ACTION_REPORT_WINDOW) {
+    t = report(t, out);
+    t = send_queued(t, wake_cycle_report_uplinks(rtc_, rtc_.config, action), out);
+  }
+
+  awake_ = true;
+  window_open_ = action == WAKE_ACTION_WINDOW || action == WAKE_ACTION_REPORT_WINDOW;
+  awake_until_ms_ = t;
+  if (window_open_) {
+    window_opened_ms_ = t;
+    worker_authenticated_ = false;
+    awake_until_ms_ = t + params_.active_window_ms;
+  }
+  return t;
+}
+
+// request_network_time() with the network server answering in the RX window
+int64_t VirtualBin::sync_clock(int64_t sim_ms, std::vector<SimUplink>& out) {
+  uint8_t request[CLOCK_SYNC_REQ_LENGTH];
+  size_t length = time_sync_build_request(rtc_.time_sync, local_ms(sim_ms), request);
+  if (!transmit(sim_ms, request, length, CLOCK_SYNC_PORT, UPLINK_PRIORITY_LOW, out)) {
+    return sim_ms;
+  }
+  stats_.clock_syncs++;
+
+  // Same arithmetic as handleClockSyncRequest() in src/server/mqtt.ts
+  uint32_t device_gps_s = (uint32_t)request[1] | ((uint32_t)request[2] << 8) |
+                          ((uint32_t)request[3] << 16) | ((uint32_t)request[4] << 24);
+  int64_t server_gps_s = (epoch_unix_ms_ + sim_ms) / 1000 - GPS_UNIX_OFFSET_S + GPS_LEAP_SECONDS;
+  uint32_t correction = (uint32_t)(server_gps_s - (int64_t)device_gps_s);
+
+  uint8_t answer[CLOCK_SYNC_ANS_LENGTH];
+  answer[0] = CLOCK_SYNC_CID_APP_TIME;
+  answer[1] = (uint8_t)(correction & 0xFF);
+  answer[2] = (uint8_t)((correction >> 8) & 0xFF);
+  answer[3] = (uint8_t)((correction >> 16) & 0xFF);
+  answer[4] = (uint8_t)((correction >> 24) & 0xFF);
+  answer[5] = request[5] & 0x0F;
+  time_sync_handle_answer(rtc_.time_sync, local_ms(sim_ms), answer, sizeof(answer));
+
+  return sim_ms + listen_ms_;
+}
+
+// Ultrasound stand-in: the fill level with reading noise
+float VirtualBin::read_fill() {
+  std::normal_distribution<double> noise(0.0, SIM_FILL_NOISE_PCT);
+  profile_.ultrasound_readings++;
+  return (float)std::clamp(fill_pct_ + noise(rng_), 0.0, 100.0);
+}
+
+// send_periodic_lorawan_data(): the cleanup detector sees the reading first
+int64_t VirtualBin::report(int64_t sim_ms, std::vector<SimUplink>& out) {
+  float reading = read_fill();
+  wake_cycle_check_emptied(rtc_, 0, local_ms(sim_ms), reading);
+
+  uint8_t frame[REPORT_FRAME_MAX_LENGTH];
+  size_t length = wake_cycle_build_report(rtc_, rtc_.config, local_ms(sim_ms), reading, frame);
+
+  if (!transmit(sim_ms, frame, length, 1, UPLINK_PRIORITY_LOW, out)) {
+    stats_.reports_deferred++;  // Counter keeps accumulating into the next report
+    return sim_ms;
+  }
+  stats_.reports_sent++;
+  wake_cycle_report_sent(rtc_, local_ms(sim_ms));
+  return sim_ms + listen_ms_;
+}
+
+// send_emptied_notification() after an authorized scan
+int64_t VirtualBin::cleanup(int64_t sim_ms, std::vector<SimUplink>& out) {
+  wake_cycle_bin_emptied(rtc_);
+  fill_pct_ = 0;
+  worker_dispatched_ = false;
+  next_worker_ms_ = SIM_NEVER;
+  stats_.cleanups++;
+  profile_.taps++;
+
+  std::uniform_int_distribution<int> worker(1, SIM_WORKER_TAGS);
+  uint8_t uid[RFID_UID_LENGTH] = {0x5A, 0x00, 0x00, (uint8_t)worker(rng_)};
+
+  // handle_rfid_tap(): the uplink keeps AT_UPLINK_GAP_MS after the last one
+  int64_t t = std::max(sim_ms, uplink_done_ms_ + AT_UPLINK_GAP_MS);
+  uint8_t frame[UPLINK_FRAME_LENGTH];
+  size_t length = wake_cycle_build_cleanup(rtc_.config, uid, RFID_UID_LENGTH, frame);
+  if (!transmit(t, frame, length, 1, UPLINK_PRIORITY_HIGH, out)) {
+    return t;
+  }
+  return t + listen_ms_;
+}
+
+// send_queued_uplinks(): the uplinks of the WAKE_UPLINK_* bits, one after
+// the other. Recovery and firmware reports, journal uploads and multicast
+// acks are never queued here: the simulator has no database, downloads,
+// journal or multicast batches
+int64_t VirtualBin::send_queued(int64_t sim_ms, uint8_t uplinks, std::vector<SimUplink>& out) {
+  int64_t t = sim_ms;
+  if (uplinks & WAKE_UPLINK_INFERRED_CLEANUP) {
+    for (int channel = 0; channel < SENSOR_CHANNELS_MAX; channel++) {
+      InferredCleanupReport& report = rtc_.inferred_cleanup[channel];
+      if (!report.pending) continue;
+      uint8_t frame[INFERRED_CLEANUP_FRAME_MAX_LENGTH];
+      size_t length = wake_cycle_build_inferred_cleanup(report, rtc_.config, local_ms(t), frame);
+      if (!transmit(t, frame, length, 1, UPLINK_PRIORITY_HIGH, out)) continue;
+      report.pending = 0;
+      t += listen_ms_;
+    }
+  }
+  if (uplinks & WAKE_UPLINK_DIAGNOSTICS) {
+    uint8_t frame[DIAG_FRAME_LENGTH];
+    size_t length = wake_cycle_build_diagnostics(rtc_, rtc_.config, frame);
+    if (transmit(t, frame, length, 1, UPLINK_PRIORITY_LOW, out)) {
+      mem_telemetry_reset_worst(rtc_.memory);
+      t += listen_ms_;
+    }
+  }
+  return t;
+}
+
+bool VirtualBin::transmit(int64_t sim_ms, const uint8_t* frame, size_t length, uint8_t port,
+                          uint8_t priority, std::vector<SimUplink>& out) {
+  uint32_t airtime_ms = 0;
+  if (!wake_cycle_uplink_allowed(rtc_, local_ms(sim_ms), length, priority, airtime_ms)) {
+    return false;
+  }
+  airtime_budget_charge(rtc_.airtime, airtime_ms);
+  stats_.airtime_ms += airtime_ms;
+  listen_ms_ = wake_cycle_listen_ms(rtc_.config, airtime_ms, lorawan_rx1_delay_ms(rtc_.airtime));
+  uplink_done_ms_ = sim_ms + listen_ms_;
+  wake_profile_uplink(profile_, airtime_ms, listen_ms_);
+
+  SimUplink uplink;
+  uplink.sim_ms = sim_ms;
+  uplink.bin_index = index_;
+  uplink.port = port;
+  uplink.length = (uint8_t)length;
+  memcpy(uplink.frame, frame, length);
+  out.push_back(uplink);
+  return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "power_profile.h"
+#include "traffic_model.h"
+#include "wake_cycle.h"
+
+// ============================================
+// Virtual Bin
+// ============================================
+//
+// One simulated trashcan. The firmware's wake-cycle logic (wake_cycle.h and
+// the state headers it pulls in) runs unchanged on a simulated local clock
+// with its own drift; sensors, the modem and the network server are
+// replaced by the traffic model and by instant answers.
+
+// Frame buffer large enough for every uplink the simulator produces
+#define SIM_MAX_FRAME_LENGTH  REPORT_FRAME_MAX_LENGTH
+
+struct SimUplink {
+  int64_t  sim_ms;            // Simulated time of the transmission
+  uint32_t bin_index;
+  uint8_t  port;
+  uint8_t  length;
+  uint8_t  frame[SIM_MAX_FRAME_LENGTH];
+};
+
+struct BinParams {
+  uint32_t report_interval_s;  // DeviceConfig.sleep_interval_s
+  uint32_t active_window_ms;   // DeviceConfig.active_window_ms
+  uint32_t downlink_wait_ms;   // DeviceConfig.downlink_wait_ms (caps the listen window)
+  int      data_rate;          // Fixed data rate, or -1 for a random campus mix
+  double   traffic_scale;      // Multiplier on the foot traffic model
+  double   drift_sd_ppm;       // Spread of the local clock error
+};
+
+struct BinStats {
+  uint32_t wakes = 0;
+  uint32_t uses = 0;
+  uint32_t reports_sent = 0;
+  uint32_t reports_deferred = 0;
+  uint32_t cleanups = 0;
+  uint32_t clock_syncs = 0;
+  uint32_t nvs_flushes = 0;
+  uint32_t airtime_ms = 0;
+};
+
+class VirtualBin {
+ public:
+  VirtualBin(uint32_t index, const BinParams& params, int64_t epoch_unix_ms, uint64_t seed);
+
+  // Run every event before until_ms, appending the transmitted uplinks
+  void advance(int64_t until_ms, std::vector<SimUplink>& out);
+
+  uint32_t index() const { return index_; }
+  const std::string& device_id() const { return device_id_; }
+  const RtcState& rtc_state() const { return rtc_; }
+  const BinStats& stats() const { return stats_; }
+  double fill_pct() const { return fill_pct_; }
+
+  // Fixed traffic instead of the random draw (call before the first advance())
+  void set_traffic(const TrafficProfile& traffic);
+
+  // Length of setup() before the first uplink, and the part of it the module
+  // spends listening for the join accept (the energy model's timing)
+  void set_setup_ms(uint32_t boot_ms, uint32_t join_ms);
+
+  // Append every finished wake's power profile (power_profile.h) to log
+  void set_wake_log(std::vector<WakeProfile>* log) { wake_log_ = log; }
+
+ private:
+  int64_t local_ms(int64_t sim_ms) const;
+  int64_t sim_delta_ms(uint64_t local_delta_ms) const;
+
+  void on_use(int64_t sim_ms, std::vector<SimUplink>& out);
+  void on_worker(int64_t sim_ms, std::vector<SimUplink>& out);
+  void on_sleep(int64_t sim_ms, std::vector<SimUplink>& out);
+
+  // setup() as wake_cycle.h sequences it; the steps return when they are done
+  int64_t wake(int64_t sim_ms, uint8_t kind, std::vector<SimUplink>& out);
+  int64_t sync_clock(int64_t sim_ms, std::vector<SimUplink>& out);
+  int64_t report(int64_t sim_ms, std::vector<SimUplink>& out);
+  int64_t send_queued(int64_t sim_ms, uint8_t uplinks, std::vector<SimUplink>& out);
+  int64_t cleanup(int64_t sim_ms, std::vector<SimUplink>& out);
+  float read_fill();
+
+  // send_lorawan_data(): airtime gate, then the frame goes on air
+  bool transmit(int64_t sim_ms, const uint8_t* frame, size_t length, uint8_t port,
+                uint8_t priority, std::vector<SimUplink>& out);
+
+  uint32_t index_;
+  std::string device_id_;
+  BinParams params_;
+  int64_t epoch_unix_ms_;
+  std::mt19937_64 rng_;
+  TrafficProfile traffic_;
+  double drift_ppm_;
+
+  RtcState rtc_;
+  BinStats stats_;
+
+  // Physical bin
+  double fill_pct_ = 0;
+  bool worker_dispatched_ = false;
+
+  // Device power state
+  int64_t power_on_ms_ = 0;
+  bool powered_on_ = false;
+  bool awake_ = false;
+  bool window_open_ = false;          // PIR active window (waiting for RFID)
+  bool worker_authenticated_ = false;
+  int64_t awake_until_ms_ = 0;
+  uint32_t listen_ms_ = 0;            // Receive windows of the last uplink
+  int64_t uplink_done_ms_ = INT64_MIN / 2;  // End of the last uplink's AT transaction
+  int64_t window_opened_ms_ = 0;
+
+  // Power profile of the current wake
+  uint32_t boot_ms_;
+  uint32_t join_ms_ = 0;
+  int64_t wake_started_ms_ = 0;
+  int64_t rfid_on_ms_ = 0;
+  WakeProfile profile_ = {};
+  std::vector<WakeProfile>* wake_log_ = nullptr;
+
+  // Pending events (simulated time, INT64_MAX = none)
+  int64_t next_use_ms_;
+  int64_t next_worker_ms_;
+  int64_t next_timer_ms_;
+};
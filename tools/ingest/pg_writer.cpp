@@ -0,0 +1,304 @@
+#include "pg_writer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+// Session temp tables the batches are copied into (emptied by every commit)
+static const char* CREATE_TEMP_TABLES =
+    "CREATE TEMP TABLE IF NOT EXISTS ingest_status ("
+    "  name text, channel int, hour timestamp(3), capacity double precision, use_count int,"
+    "  minutes_to_full int, reported_at timestamp(3)) ON COMMIT DELETE ROWS;"
+    "CREATE TEMP TABLE IF NOT EXISTS ingest_histogram ("
+    "  name text, channel int, reported_at timestamp(3), bin_minutes int, bins int[]) ON COMMIT DELETE ROWS;"
+    "CREATE TEMP TABLE IF NOT EXISTS ingest_cleanup ("
+    "  name text, rfid text, created_at timestamp(3)) ON COMMIT DELETE ROWS";
+
+// Usage adds up within the hour; fill level, forecast and report time are the latest
+#define STATUS_CONFLICT_UPDATE                                                  \
+  " ON CONFLICT (\"trashcanId\", hour) DO UPDATE SET"                           \
+  " \"capacityPct\" = EXCLUDED.\"capacityPct\","                                \
+  " \"useCount\" = \"Status\".\"useCount\" + EXCLUDED.\"useCount\","            \
+  " \"minutesToFull\" = EXCLUDED.\"minutesToFull\","                            \
+  " \"reportedAt\" = EXCLUDED.\"reportedAt\""
+
+static const char* UPSERT_STATUS =
+    "INSERT INTO \"Status\" (id, \"trashcanId\", \"capacityPct\", \"useCount\", \"minutesToFull\", hour,"
+    "  \"reportedAt\")"
+    " SELECT gen_random_uuid()::text, t.id, s.capacity, s.use_count, s.minutes_to_full, s.hour, s.reported_at"
+    " FROM ingest_status s JOIN \"Trashcan\" t ON t.name = s.name AND t.channel = s.channel"
+    STATUS_CONFLICT_UPDATE;
+
+static const char* INSERT_HISTOGRAMS =
+    "INSERT INTO \"UsageHistogram\" (id, \"trashcanId\", \"reportedAt\", \"binMinutes\", bins)"
+    " SELECT gen_random_uuid()::text, t.id, h.reported_at, h.bin_minutes, h.bins"
+    " FROM ingest_histogram h JOIN \"Trashcan\" t ON t.name = h.name AND t.channel = h.channel";
+
+// A station's compartments are all emptied by one tap; each cleanup takes the
+// latest unlinked inferred cleanup of its bin from the last two hours
+// (INFERRED_CLEANUP_MATCH_MS in src/server/mqtt.ts), one cleanup per inferred
+static const char* INSERT_CLEANUPS =
+    "WITH inserted AS ("
+    "  INSERT INTO \"Cleanup\" (id, \"trashcanId\", \"userId\", \"createdAt\")"
+    "  SELECT gen_random_uuid()::text, t.id, u.id, c.created_at"
+    "  FROM ingest_cleanup c"
+    "  JOIN \"User\" u ON u.\"rfidTag\" = c.rfid"
+    "  JOIN \"Trashcan\" t ON t.name = c.name"
+    "  RETURNING id, \"trashcanId\", \"createdAt\""
+    "), candidates AS ("
+    "  SELECT DISTINCT ON (ins.id) ins.id AS cleanup_id, i.id AS inferred_id"
+    "  FROM inserted ins JOIN \"InferredCleanup\" i ON i.\"trashcanId\" = ins.\"trashcanId\""
+    "   AND i.\"cleanupId\" IS NULL AND i.\"detectedAt\" >= ins.\"createdAt\" - interval '2 hours'"
+    "  ORDER BY ins.id, i.\"detectedAt\" DESC"
+    "), matched AS ("
+    "  SELECT DISTINCT ON (inferred_id) cleanup_id, inferred_id FROM candidates ORDER BY inferred_id, cleanup_id"
+    "), linked AS ("
+    "  UPDATE \"InferredCleanup\" SET \"cleanupId\" = matched.cleanup_id FROM matched"
+    "  WHERE \"InferredCleanup\".id = matched.inferred_id RETURNING 1"
+    ")"
+    " SELECT (SELECT count(*) FROM inserted), (SELECT count(*) FROM linked),"
+    "  (SELECT count(*) FROM ingest_cleanup c WHERE NOT EXISTS"
+    "   (SELECT 1 FROM \"Trashcan\" t WHERE t.name = c.name) OR NOT EXISTS"
+    "   (SELECT 1 FROM \"User\" u WHERE u.\"rfidTag\" = c.rfid))";
+
+static const char* FIND_TRASHCAN = "SELECT id FROM \"Trashcan\" WHERE name = $1 AND channel = $2 LIMIT 1";
+
+static const char* UPSERT_STATUS_ROW =
+    "INSERT INTO \"Status\" (id, \"trashcanId\", \"capacityPct\", \"useCount\", \"minutesToFull\", hour,"
+    "  \"reportedAt\")"
+    " VALUES (gen_random_uuid()::text, $1, $2, $3, $4, $5, $6)"
+    STATUS_CONFLICT_UPDATE;
+
+static const char* INSERT_HISTOGRAM_ROW =
+    "INSERT INTO \"UsageHistogram\" (id, \"trashcanId\", \"reportedAt\", \"binMinutes\", bins)"
+    " VALUES (gen_random_uuid()::text, $1, $2, $3, $4::int[])";
+
+// UTC timestamp as Prisma stores DateTime (timestamp(3) without time zone)
+static void format_timestamp(int64_t unix_ms, char* out, size_t size) {
+  time_t seconds = (time_t)(unix_ms / 1000);
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  snprintf(out, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+           utc.tm_hour, utc.tm_min, utc.tm_sec, (int)(unix_ms % 1000));
+}
+
+// COPY text format: backslash, tab and line breaks are escaped
+static void append_text(std::string& out, const char* text) {
+  for (const char* p = text; *p; p++) {
+    switch (*p) {
+      case '\\': out += "\\\\"; break;
+      case '\t': out += "\\t"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      default:   out += *p;
+    }
+  }
+}
+
+static void append_bins(std::string& out, const StatusRecord& record) {
+  out += '{';
+  for (uint8_t i = 0; i < record.bin_count; i++) {
+    if (i > 0) out += ',';
+    out += std::to_string(record.bins[i]);
+  }
+  out += '}';
+}
+
+PgWriter::~PgWriter() {
+  if (conn_) PQfinish(conn_);
+}
+
+bool PgWriter::fail(const char* what, PGresult* result) {
+  last_error_ = std::string(what) + ": " + (conn_ ? PQerrorMessage(conn_) : "not connected");
+  while (!last_error_.empty() && (last_error_.back() == '\n' || last_error_.back() == ' ')) last_error_.pop_back();
+  if (result) PQclear(result);
+  if (conn_) {
+    PQfinish(conn_);
+    conn_ = nullptr;
+  }
+  return false;
+}
+
+bool PgWriter::connect() {
+  if (conn_) PQfinish(conn_);
+  conn_ = PQconnectdb(conninfo_.c_str());
+  if (PQstatus(conn_) != CONNECTION_OK) return fail("connect");
+
+  PGresult* result = PQexec(conn_, CREATE_TEMP_TABLES);
+  if (PQresultStatus(result) != PGRES_COMMAND_OK) return fail("create temp tables", result);
+  PQclear(result);
+
+  result = PQprepare(conn_, "find_trashcan", FIND_TRASHCAN, 2, nullptr);
+  if (PQresultStatus(result) != PGRES_COMMAND_OK) return fail("prepare", result);
+  PQclear(result);
+  result = PQprepare(conn_, "upsert_status_row", UPSERT_STATUS_ROW, 6, nullptr);
+  if (PQresultStatus(result) != PGRES_COMMAND_OK) return fail("prepare", result);
+  PQclear(result);
+  result = PQprepare(conn_, "insert_histogram_row", INSERT_HISTOGRAM_ROW, 4, nullptr);
+  if (PQresultStatus(result) != PGRES_COMMAND_OK) return fail("prepare", result);
+  PQclear(result);
+  return true;
+}
+
+bool PgWriter::exec(const char* sql) {
+  if (!conn_ && !connect()) return false;
+  PGresult* result = PQexec(conn_, sql);
+  ExecStatusType status = PQresultStatus(result);
+  if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) return fail(sql, result);
+  PQclear(result);
+  return true;
+}
+
+bool PgWriter::copy(const char* sql, const std::string& data) {
+  PGresult* result = PQexec(conn_, sql);
+  if (PQresultStatus(result) != PGRES_COPY_IN) return fail("COPY", result);
+  PQclear(result);
+
+  if (PQputCopyData(conn_, data.data(), (int)data.size()) != 1 || PQputCopyEnd(conn_, nullptr) != 1) {
+    return fail("COPY data");
+  }
+  result = PQgetResult(conn_);
+  if (PQresultStatus(result) != PGRES_COMMAND_OK) return fail("COPY end", result);
+  PQclear(result);
+  while ((result = PQgetResult(conn_)) != nullptr) PQclear(result);
+  return true;
+}
+
+bool PgWriter::write(const StatusBatch& batch, PgWriteResult& out) {
+  if (batch.empty()) return true;
+  if (!conn_ && !connect()) return false;
+
+  PgWriteResult result;
+  char time[64];
+  if (!exec("BEGIN")) return false;
+
+  if (batch.status_rows() > 0) {
+    std::string data;
+    data.reserve(batch.status_rows() * 96);
+    for (const auto& entry : batch.status()) {
+      const StatusRow& row = entry.second;
+      const StatusRecord& latest = row.latest;
+      append_text(data, latest.name);
+      data += '\t';
+      data += std::to_string(latest.channel);
+      data += '\t';
+      format_timestamp(entry.first.hour_ms, time, sizeof(time));
+      data += time;
+      data += '\t';
+      data += std::to_string(latest.fill_pct);
+      data += '\t';
+      data += std::to_string(row.use_count);
+      data += '\t';
+      data += latest.minutes_to_full < 0 ? "\\N" : std::to_string(latest.minutes_to_full);
+      data += '\t';
+      format_timestamp(latest.received_ms, time, sizeof(time));
+      data += time;
+      data += '\n';
+    }
+    if (!copy("COPY ingest_status FROM STDIN", data)) return false;
+
+    PGresult* upsert = PQexec(conn_, UPSERT_STATUS);
+    if (PQresultStatus(upsert) != PGRES_COMMAND_OK) return fail("upsert Status", upsert);
+    result.status_rows = strtoull(PQcmdTuples(upsert), nullptr, 10);
+    result.unmatched += batch.status_rows() - result.status_rows;
+    PQclear(upsert);
+  }
+
+  if (batch.histogram_rows() > 0) {
+    std::string data;
+    data.reserve(batch.histogram_rows() * 64);
+    for (const StatusRecord& record : batch.histograms()) {
+      append_text(data, record.name);
+      data += '\t';
+      data += std::to_string(record.channel);
+      data += '\t';
+      format_timestamp(record.received_ms, time, sizeof(time));
+      data += time;
+      data += '\t';
+      data += std::to_string(record.bin_minutes);
+      data += '\t';
+      append_bins(data, record);
+      data += '\n';
+    }
+    if (!copy("COPY ingest_histogram FROM STDIN", data)) return false;
+
+    PGresult* insert = PQexec(conn_, INSERT_HISTOGRAMS);
+    if (PQresultStatus(insert) != PGRES_COMMAND_OK) return fail("insert UsageHistogram", insert);
+    result.histograms = strtoull(PQcmdTuples(insert), nullptr, 10);
+    PQclear(insert);
+  }
+
+  if (batch.cleanup_rows() > 0) {
+    std::string data;
+    data.reserve(batch.cleanup_rows() * 48);
+    for (const CleanupRecord& cleanup : batch.cleanups()) {
+      append_text(data, cleanup.name);
+      data += '\t';
+      append_text(data, cleanup.rfid);
+      data += '\t';
+      format_timestamp(cleanup.received_ms, time, sizeof(time));
+      data += time;
+      data += '\n';
+    }
+    if (!copy("COPY ingest_cleanup FROM STDIN", data)) return false;
+
+    PGresult* insert = PQexec(conn_, INSERT_CLEANUPS);
+    if (PQresultStatus(insert) != PGRES_TUPLES_OK || PQntuples(insert) != 1) return fail("insert Cleanup", insert);
+    result.cleanups = strtoull(PQgetvalue(insert, 0, 0), nullptr, 10);
+    result.linked = strtoull(PQgetvalue(insert, 0, 1), nullptr, 10);
+    result.unmatched += strtoull(PQgetvalue(insert, 0, 2), nullptr, 10);
+    PQclear(insert);
+  }
+
+  if (!exec("COMMIT")) return false;
+  out.status_rows += result.status_rows;
+  out.histograms += result.histograms;
+  out.cleanups += result.cleanups;
+  out.linked += result.linked;
+  out.unmatched += result.unmatched;
+  return true;
+}
+
+bool PgWriter::write_row(const StatusRecord& record, PgWriteResult& out) {
+  if (!conn_ && !connect()) return false;
+
+  std::string channel = std::to_string(record.channel);
+  const char* find_params[2] = {record.name, channel.c_str()};
+  PGresult* found = PQexecPrepared(conn_, "find_trashcan", 2, find_params, nullptr, nullptr, 0);
+  if (PQresultStatus(found) != PGRES_TUPLES_OK) return fail("find Trashcan", found);
+  if (PQntuples(found) == 0) {
+    PQclear(found);
+    out.unmatched++;
+    return true;
+  }
+  std::string trashcan_id = PQgetvalue(found, 0, 0);
+  PQclear(found);
+
+  char hour[64];
+  format_timestamp(StatusBatch::hour_of(record.received_ms), hour, sizeof(hour));
+  std::string fill = std::to_string(record.fill_pct);
+  std::string use = std::to_string(record.use_count);
+  std::string minutes = std::to_string(record.minutes_to_full);
+  char reported[64];
+  format_timestamp(record.received_ms, reported, sizeof(reported));
+  const char* params[6] = {
+      trashcan_id.c_str(), fill.c_str(), use.c_str(),
+      record.minutes_to_full < 0 ? nullptr : minutes.c_str(), hour, reported,
+  };
+  PGresult* upsert = PQexecPrepared(conn_, "upsert_status_row", 6, params, nullptr, nullptr, 0);
+  if (PQresultStatus(upsert) != PGRES_COMMAND_OK) return fail("upsert Status", upsert);
+  PQclear(upsert);
+  out.status_rows++;
+
+  if (record.bin_count > 0) {
+    std::string bin_minutes = std::to_string(record.bin_minutes);
+    std::string bins;
+    append_bins(bins, record);
+    const char* histogram_params[4] = {trashcan_id.c_str(), reported, bin_minutes.c_str(), bins.c_str()};
+    PGresult* insert = PQexecPrepared(conn_, "insert_histogram_row", 4, histogram_params, nullptr, nullptr, 0);
+    if (PQresultStatus(insert) != PGRES_COMMAND_OK) return fail("insert UsageHistogram", insert);
+    PQclear(insert);
+    out.histograms++;
+  }
+  return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <libpq-fe.h>
+
+#include "status_batch.h"
+
+// ============================================
+// PostgreSQL Writer
+// ============================================
+//
+// Writes a StatusBatch into the backend's tables (prisma/schema.prisma) in
+// one transaction: the rows are streamed into session temp tables with COPY,
+// then one INSERT ... SELECT joins them to Trashcan (by name and channel)
+// and User (by RFID tag). Status rows are upserted on (trashcanId, hour),
+// usage histograms are inserted one row per report, cleanups are inserted and linked to an open inferred cleanup of the same
+// bin, as handleCleanupOperation() does. Ids come from gen_random_uuid()
+// (PostgreSQL 13+), in place of Prisma's client-side uuid().
+//
+// Rows of unknown trashcans or RFID tags are dropped by the joins and
+// counted as unmatched.
+
+struct PgWriteResult {
+  uint64_t status_rows = 0;     // Status rows inserted or updated
+  uint64_t histograms = 0;      // UsageHistogram rows inserted
+  uint64_t cleanups = 0;        // Cleanup rows inserted
+  uint64_t linked = 0;          // Inferred cleanups linked to one of them
+  uint64_t unmatched = 0;       // Rows without a matching trashcan or user
+};
+
+class PgWriter {
+ public:
+  explicit PgWriter(std::string conninfo) : conninfo_(std::move(conninfo)) {}
+  ~PgWriter();
+
+  PgWriter(const PgWriter&) = delete;
+  PgWriter& operator=(const PgWriter&) = delete;
+
+  bool connect();
+  bool connected() const { return conn_ != nullptr; }
+
+  // Write the batch in one transaction; false on error (nothing written, the
+  // connection is dropped and reopened by the next call)
+  bool write(const StatusBatch& batch, PgWriteResult& result);
+
+  // One report the way the backend writes it today: look up the trashcan,
+  // then upsert the row, each statement its own transaction (benchmark baseline)
+  bool write_row(const StatusRecord& record, PgWriteResult& result);
+
+  // Run a statement without results (benchmark setup and cleanup)
+  bool exec(const char* sql);
+
+  const std::string& last_error() const { return last_error_; }
+
+ private:
+  bool copy(const char* sql, const std::string& data);
+  bool fail(const char* what, PGresult* result = nullptr);
+
+  std::string conninfo_;
+  PGconn* conn_ = nullptr;
+  std::string last_error_;
+};
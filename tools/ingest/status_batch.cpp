@@ -0,0 +1,40 @@
+#include "status_batch.h"
+
+static StatusRowKey row_key(const StatusRecord& record) {
+  StatusRowKey key;
+  memcpy(key.name, record.name, sizeof(key.name));
+  key.channel = record.channel;
+  key.hour_ms = StatusBatch::hour_of(record.received_ms);
+  return key;
+}
+
+void StatusBatch::add(const StatusRecord& record) {
+  StatusRow row = {record, record.use_count, 1};
+  add_row(row);
+  if (record.bin_count > 0) histograms_.push_back(record);
+}
+
+void StatusBatch::add_row(const StatusRow& row) {
+  reports_ += row.reports;
+  auto inserted = rows_.emplace(row_key(row.latest), row);
+  if (inserted.second) return;
+
+  StatusRow& merged = inserted.first->second;
+  merged.use_count += row.use_count;
+  merged.reports += row.reports;
+  if (row.latest.received_ms >= merged.latest.received_ms) merged.latest = row.latest;
+}
+
+void StatusBatch::merge(StatusBatch& other) {
+  for (const auto& entry : other.rows_) add_row(entry.second);
+  cleanups_.insert(cleanups_.end(), other.cleanups_.begin(), other.cleanups_.end());
+  histograms_.insert(histograms_.end(), other.histograms_.begin(), other.histograms_.end());
+  other.clear();
+}
+
+void StatusBatch::clear() {
+  rows_.clear();
+  cleanups_.clear();
+  histograms_.clear();
+  reports_ = 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "uplink_decoder.h"
+
+// ============================================
+// Status Batch
+// ============================================
+//
+// Rows waiting for the next database flush. Reports of the same compartment
+// in the same hour are merged here, because Status is unique on
+// (trashcanId, hour) and one upsert statement cannot touch a row twice:
+// usage adds up, the fill level and forecast are those of the latest report.
+// Usage histograms (one UsageHistogram row per report) and cleanups are kept
+// as they come.
+
+#define INGEST_HOUR_MS  3600000LL
+
+struct StatusRowKey {
+  char    name[INGEST_NAME_SIZE];
+  uint8_t channel;
+  int64_t hour_ms;
+
+  bool operator==(const StatusRowKey& other) const {
+    return hour_ms == other.hour_ms && channel == other.channel && strcmp(name, other.name) == 0;
+  }
+};
+
+struct StatusRowKeyHash {
+  size_t operator()(const StatusRowKey& key) const {
+    uint64_t hash = 1469598103934665603ULL;  // FNV-1a
+    for (const char* p = key.name; *p; p++) hash = (hash ^ (uint8_t)*p) * 1099511628211ULL;
+    hash = (hash ^ key.channel) * 1099511628211ULL;
+    return (size_t)(hash ^ (uint64_t)key.hour_ms * 0x9E3779B97F4A7C15ULL);
+  }
+};
+
+struct StatusRow {
+  StatusRecord latest;    // use_count of the latest report is replaced by the sum below
+  uint32_t     use_count;
+  uint32_t     reports;   // Reports merged into this row
+};
+
+class StatusBatch {
+ public:
+  void add(const StatusRecord& record);
+  void add(const CleanupRecord& record) { cleanups_.push_back(record); }
+
+  // Merge another batch into this one (a failed flush going back in front)
+  void merge(StatusBatch& other);
+  void clear();
+
+  size_t status_rows() const { return rows_.size(); }
+  size_t cleanup_rows() const { return cleanups_.size(); }
+  size_t histogram_rows() const { return histograms_.size(); }
+  size_t rows() const { return rows_.size() + cleanups_.size() + histograms_.size(); }
+  uint64_t reports() const { return reports_; }
+  bool empty() const { return rows_.empty() && cleanups_.empty(); }
+
+  const std::unordered_map<StatusRowKey, StatusRow, StatusRowKeyHash>& status() const { return rows_; }
+  const std::vector<CleanupRecord>& cleanups() const { return cleanups_; }
+  const std::vector<StatusRecord>& histograms() const { return histograms_; }  // Reports with bin_count > 0
+
+  static int64_t hour_of(int64_t unix_ms) { return unix_ms - unix_ms % INGEST_HOUR_MS; }
+
+ private:
+  void add_row(const StatusRow& row);
+
+  std::unordered_map<StatusRowKey, StatusRow, StatusRowKeyHash> rows_;
+  std::vector<CleanupRecord> cleanups_;
+  std::vector<StatusRecord> histograms_;
+  uint64_t reports_ = 0;
+};
@@ -0,0 +1,209 @@
+#include "uplink_decoder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+// Value of "key": in json, as a view: a string's contents, or a bare token
+// (number) up to the next delimiter. Empty when the key is missing.
+static std::string_view find_value(std::string_view json, std::string_view key) {
+  size_t at = 0;
+  for (;;) {
+    at = json.find(key, at);
+    if (at == std::string_view::npos) return {};
+    // The key must be quoted: "key"
+    if (at == 0 || json[at - 1] != '"' || at + key.size() >= json.size() || json[at + key.size()] != '"') {
+      at += key.size();
+      continue;
+    }
+    size_t p = at + key.size() + 1;
+    while (p < json.size() && (json[p] == ' ' || json[p] == ':')) p++;
+    if (p >= json.size()) return {};
+    if (json[p] == '"') {
+      size_t end = json.find('"', p + 1);
+      if (end == std::string_view::npos) return {};
+      return json.substr(p + 1, end - p - 1);
+    }
+    size_t end = json.find_first_of(",}] \r\n", p);
+    return json.substr(p, end == std::string_view::npos ? json.size() - p : end - p);
+  }
+}
+
+bool uplink_scan(std::string_view json, UplinkView& view) {
+  view.device_id = find_value(json, "device_id");
+  view.received_at = find_value(json, "received_at");
+  view.frm_payload = find_value(json, "frm_payload");
+
+  std::string_view port = find_value(json, "f_port");
+  view.f_port = -1;
+  if (!port.empty() && port.size() <= 3) {
+    view.f_port = 0;
+    for (char c : port) {
+      if (c < '0' || c > '9') {
+        view.f_port = -1;
+        break;
+      }
+      view.f_port = view.f_port * 10 + (c - '0');
+    }
+  }
+  return view.f_port >= 0 && !view.frm_payload.empty();
+}
+
+static int parse_digits(std::string_view text, size_t at, size_t count) {
+  if (at + count > text.size()) return -1;
+  int value = 0;
+  for (size_t i = at; i < at + count; i++) {
+    if (text[i] < '0' || text[i] > '9') return -1;
+    value = value * 10 + (text[i] - '0');
+  }
+  return value;
+}
+
+int64_t uplink_parse_time_ms(std::string_view text) {
+  // YYYY-MM-DDTHH:MM:SS[.fraction]Z
+  if (text.size() < 20 || text[4] != '-' || text[7] != '-' || text[10] != 'T' || text[13] != ':' ||
+      text[16] != ':') {
+    return -1;
+  }
+  struct tm utc = {};
+  utc.tm_year = parse_digits(text, 0, 4) - 1900;
+  utc.tm_mon = parse_digits(text, 5, 2) - 1;
+  utc.tm_mday = parse_digits(text, 8, 2);
+  utc.tm_hour = parse_digits(text, 11, 2);
+  utc.tm_min = parse_digits(text, 14, 2);
+  utc.tm_sec = parse_digits(text, 17, 2);
+  if (utc.tm_year < 70 || utc.tm_mon < 0 || utc.tm_mday < 1 || utc.tm_hour < 0 || utc.tm_min < 0 ||
+      utc.tm_sec < 0) {
+    return -1;
+  }
+
+  int millis = 0;
+  size_t p = 19;
+  if (p < text.size() && text[p] == '.') {
+    int digits = 0;
+    for (p++; p < text.size() && text[p] >= '0' && text[p] <= '9'; p++, digits++) {
+      if (digits < 3) millis = millis * 10 + (text[p] - '0');
+    }
+    for (; digits < 3; digits++) millis *= 10;
+  }
+  if (p >= text.size() || text[p] != 'Z') return -1;
+  return (int64_t)timegm(&utc) * 1000 + millis;
+}
+
+int base64_decode(std::string_view text, uint8_t* out, size_t out_size) {
+  struct Table {
+    int8_t value[256];
+    Table() {
+      memset(value, -1, sizeof(value));
+      const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+      for (int i = 0; i < 64; i++) value[(uint8_t)alphabet[i]] = (int8_t)i;
+    }
+  };
+  static const Table table;
+
+  size_t length = 0;
+  uint32_t chunk = 0;
+  int bits = 0;
+  for (char c : text) {
+    if (c == '=') break;
+    int8_t value = table.value[(uint8_t)c];
+    if (value < 0) return -1;
+    chunk = (chunk << 6) | (uint32_t)value;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      if (length >= out_size) return -1;
+      out[length++] = (uint8_t)(chunk >> bits);
+    }
+  }
+  return (int)length;
+}
+
+static void copy_name(const uint8_t* frame, char* name) {
+  memcpy(name, frame + 1, DEVICE_NAME_LENGTH);
+  name[DEVICE_NAME_LENGTH] = '\0';
+  for (int i = DEVICE_NAME_LENGTH - 1; i >= 0 && (name[i] == ' ' || name[i] == '\0'); i--) name[i] = '\0';
+}
+
+// Histogram after the fixed fields; returns the total count, sets bin_count 0 if absent
+static uint32_t decode_bins(const uint8_t* data, size_t length, StatusRecord& record) {
+  uint32_t bin_minutes = 0;
+  int bins = length > 0 ? usage_histogram_decode(data, length, record.bins, &bin_minutes) : -1;
+  record.bin_count = bins > 0 ? (uint8_t)bins : 0;
+  record.bin_minutes = (uint16_t)bin_minutes;
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < record.bin_count; i++) total += record.bins[i];
+  return total;
+}
+
+static int32_t minutes_to_full(const uint8_t* p) {
+  uint16_t value = (uint16_t)((p[0] << 8) | p[1]);
+  return value == 0xFFFF ? -1 : value;
+}
+
+UplinkKind uplink_decode(std::string_view json, int64_t now_ms, DecodedUplink& out) {
+  out.kind = UPLINK_MALFORMED;
+  out.status_count = 0;
+
+  UplinkView view;
+  if (!uplink_scan(json, view)) return out.kind;
+  if (view.f_port != INGEST_UPLINK_PORT) return out.kind = UPLINK_IGNORED;
+
+  uint8_t frame[INGEST_FRAME_MAX];
+  int length = base64_decode(view.frm_payload, frame, sizeof(frame));
+  if (length < 1) return out.kind;
+  int64_t received_ms = view.received_at.empty() ? now_ms : uplink_parse_time_ms(view.received_at);
+  if (received_ms < 0) received_ms = now_ms;
+
+  if (frame[0] == OP_HOURLY_REPORT) {
+    // [OP] [NAME (6)] [FILL] [USAGE] [MINUTES_TO_FULL (2)] [HISTOGRAM]
+    if (length < UPLINK_FRAME_LENGTH) return out.kind;
+    StatusRecord& record = out.status[0];
+    copy_name(frame, record.name);
+    record.channel = 0;
+    record.fill_pct = frame[7];
+    record.minutes_to_full = minutes_to_full(frame + 9);
+    record.received_ms = received_ms;
+    uint32_t total = decode_bins(frame + UPLINK_FRAME_LENGTH, length - UPLINK_FRAME_LENGTH, record);
+    record.use_count = (uint16_t)(total > frame[8] ? total : frame[8]);
+    out.status_count = 1;
+    return out.kind = UPLINK_STATUS;
+  }
+
+  if (frame[0] == OP_MULTI_REPORT) {
+    // [OP] [NAME (6)] [USAGE] [COUNT] { [FILL] [MINUTES_TO_FULL (2)] } [HISTOGRAM]
+    if (length < 9) return out.kind;
+    uint8_t count = frame[8];
+    size_t histogram = 9 + 3 * (size_t)count;
+    if (count == 0 || count > SENSOR_CHANNELS_MAX || (size_t)length < histogram) return out.kind;
+
+    // Usage belongs to the station: recorded on channel 0 only, as the backend does
+    for (uint8_t ch = 0; ch < count; ch++) {
+      StatusRecord& record = out.status[ch];
+      copy_name(frame, record.name);
+      record.channel = ch;
+      record.fill_pct = frame[9 + 3 * ch];
+      record.minutes_to_full = minutes_to_full(frame + 10 + 3 * ch);
+      record.received_ms = received_ms;
+      record.bin_count = 0;
+      record.bin_minutes = 0;
+      record.use_count = 0;
+    }
+    uint32_t total = decode_bins(frame + histogram, length - histogram, out.status[0]);
+    out.status[0].use_count = (uint16_t)(total > frame[7] ? total : frame[7]);
+    out.status_count = count;
+    return out.kind = UPLINK_STATUS;
+  }
+
+  if (frame[0] == OP_WORKER_CLEANUP) {
+    // [OP] [NAME (6)] [RFID_UID (4)]
+    if (length != UPLINK_FRAME_LENGTH) return out.kind;
+    copy_name(frame, out.cleanup.name);
+    snprintf(out.cleanup.rfid, sizeof(out.cleanup.rfid), "%02X %02X %02X %02X", frame[7], frame[8], frame[9],
+             frame[10]);
+    out.cleanup.received_ms = received_ms;
+    return out.kind = UPLINK_CLEANUP;
+  }
+
+  return out.kind = UPLINK_IGNORED;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "usage_histogram.h"
+#include "wake_cycle.h"
+
+// ============================================
+// Uplink Decoder
+// ============================================
+//
+// Turns the TTN uplink JSON the backend's listener receives into the rows it
+// writes, straight from frm_payload with the firmware's frame layouts
+// (ESP32/wake_cycle.h), so the ingest does not depend on the payload
+// formatter. Fields are located in place and returned as views into the
+// message; the frame is base64-decoded into a fixed buffer. Nothing is
+// allocated per message.
+//
+// Only the top-level keys needed are looked up, by name and first
+// occurrence: end_device_ids.device_id, received_at, uplink_message.f_port
+// and uplink_message.frm_payload. TTN writes them before any nested copy
+// (rx_metadata), and their values never contain escapes.
+
+#define INGEST_UPLINK_PORT     1
+#define INGEST_NAME_SIZE       (DEVICE_NAME_LENGTH + 1)
+#define INGEST_RFID_TEXT_SIZE  12    // "AA BB CC DD" + NUL
+#define INGEST_FRAME_MAX       64
+
+struct UplinkView {
+  std::string_view device_id;
+  std::string_view received_at;
+  std::string_view frm_payload;
+  int f_port = -1;
+};
+
+// One fill report of one compartment (STATUS / MULTI_STATUS)
+struct StatusRecord {
+  char     name[INGEST_NAME_SIZE];
+  uint8_t  channel;
+  uint8_t  fill_pct;
+  uint16_t use_count;               // max(usage byte, histogram total), as handleStatusOperation()
+  int32_t  minutes_to_full;         // -1 = not filling (0xFFFF on air)
+  int64_t  received_ms;             // Unix ms
+  uint8_t  bin_count;               // 0 = no histogram (also on channels other than 0)
+  uint16_t bin_minutes;
+  uint8_t  bins[USAGE_HISTOGRAM_BINS];
+};
+
+// One RFID cleanup (CLEANUP)
+struct CleanupRecord {
+  char    name[INGEST_NAME_SIZE];
+  char    rfid[INGEST_RFID_TEXT_SIZE];
+  int64_t received_ms;
+};
+
+enum UplinkKind {
+  UPLINK_IGNORED,     // Valid, but not a report or cleanup (left to the backend)
+  UPLINK_STATUS,      // status[0 .. status_count)
+  UPLINK_CLEANUP,
+  UPLINK_MALFORMED,
+};
+
+struct DecodedUplink {
+  UplinkKind    kind = UPLINK_IGNORED;
+  uint8_t       status_count = 0;
+  StatusRecord  status[SENSOR_CHANNELS_MAX];
+  CleanupRecord cleanup;
+};
+
+// Locate the fields of a TTN uplink; false when a required one is missing
+bool uplink_scan(std::string_view json, UplinkView& view);
+
+// RFC 3339 UTC timestamp (fraction optional, any precision) to Unix ms; -1 if invalid
+int64_t uplink_parse_time_ms(std::string_view text);
+
+// Decode base64 into out; returns the length, or -1 if invalid or longer than out_size
+int base64_decode(std::string_view text, uint8_t* out, size_t out_size);
+
+// Scan and decode one message; now_ms stands in for a missing received_at
+UplinkKind uplink_decode(std::string_view json, int64_t now_ms, DecodedUplink& out);
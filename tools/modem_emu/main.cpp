@@ -0,0 +1,672 @@
+// Radioenge modem emulator: measures how long the firmware's modem code
+// (ESP32/at_modem.h) keeps a bin awake, on a virtual clock, under
+// configurable module latency, join failures, packet loss and downlinks.
+//
+//   modem_emu --trials 500 --join-fail 0.2 --uplink-loss 0.1
+//   modem_emu --pty --queue 5:0312345678   (real time, attach a terminal)
+//   modem_emu --multicast 50 --batch-entries 40   (fleet whitelist batch,
+//                                                  multicast vs unicast)
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "at_modem.h"
+#include "multicast_session.h"
+#include "radioenge_emulator.h"
+#include "wake_cycle.h"
+
+// Firmware factory default (DeviceConfig.downlink_wait_ms, caps the listen window)
+#define DEFAULT_DOWNLINK_WAIT_MS  15000
+
+// Virtual time for the Clock interface of at_modem.h
+// idle() stands for one pass of a polling loop
+struct VirtualClock {
+  uint64_t now_us = 0;
+
+  unsigned long millis() { return (unsigned long)(now_us / 1000); }
+  void delay(unsigned long ms) { now_us += (uint64_t)ms * 1000; }
+  void idle() { now_us += 100; }
+};
+
+struct HarnessOptions {
+  EmulatorConfig modem;
+  uint32_t trials = 200;
+  uint32_t downlink_every = 4;   // Queue a downlink before every n-th wake (0 = never)
+  uint32_t downlink_wait_ms = DEFAULT_DOWNLINK_WAIT_MS;
+  bool pty = false;
+  uint32_t multicast_bins = 0;   // Fleet mode: bins sharing the multicast group (0 = off)
+  uint32_t batch_entries = 40;   // Whitelist entries in the fleet mode batch
+  std::vector<std::pair<int, std::vector<uint8_t>>> queued;  // --queue PORT:HEX
+};
+
+struct WakeResult {
+  uint64_t modem_ms = 0;
+  bool joined = false;
+  bool sent = false;
+  uint32_t join_attempts = 0;
+  uint32_t downlinks = 0;
+};
+
+static uint32_t join_attempts_seen = 0;
+
+static void count_join_attempt(int attempt, int max_retries, AtJoinResult result) {
+  (void)max_retries;
+  (void)result;
+  join_attempts_seen = (uint32_t)attempt;
+}
+
+// RX1 delay the module reports, as query_lorawan_rx1_delay() reads it
+static uint32_t query_rx1_delay(RadioengeEmulator& modem, VirtualClock& clock, AtResponse& response) {
+  if (!at_command(modem, clock, LORA_RX1_DELAY_QUERY_CMD, AT_COMMAND_TIMEOUT_MS, 0, response)) {
+    return LORAWAN_RX1_DELAY_DEFAULT_MS;
+  }
+  long value = at_parse_rx1_delay(response.text);
+  return value > 0 && value <= LORAWAN_RX1_DELAY_MAX_MS ? (uint32_t)value : LORAWAN_RX1_DELAY_DEFAULT_MS;
+}
+
+// One timer wake as setup() runs it: boot, AT test, join, data rate and RX1
+// delay, report and its receive windows
+static WakeResult timer_wake(RadioengeEmulator& modem, VirtualClock& clock, const HarnessOptions& options) {
+  static AtResponse response;
+  WakeResult result;
+  uint64_t start_us = clock.now_us;
+
+  modem.power_cycle();
+  clock.delay(AT_MODULE_BOOT_MS);
+  at_command(modem, clock, "AT", AT_COMMAND_TIMEOUT_MS, 0, response);
+
+  join_attempts_seen = 0;
+  result.joined = at_join_network(modem, clock, AT_JOIN_MAX_RETRIES, AT_JOIN_TIMEOUT_MS, response,
+                                  count_join_attempt);
+  result.join_attempts = join_attempts_seen;
+
+  if (result.joined) {
+    at_command(modem, clock, LORA_DR_QUERY_CMD, AT_COMMAND_TIMEOUT_MS, 0, response);
+    uint32_t rx1_delay_ms = query_rx1_delay(modem, clock, response);
+
+    uint8_t frame[UPLINK_FRAME_LENGTH] = {OP_HOURLY_REPORT, 'L', 'X', '-', '0', '0', '1', 42, 3, 0x01, 0x2C};
+    char command[AT_SENDB_MAX_LENGTH];
+    at_format_sendb(command, sizeof(command), 1, frame, sizeof(frame));
+    // send_lorawan_data(): listen until both receive windows have closed
+    DeviceConfig config = {};
+    config.downlink_wait_ms = options.downlink_wait_ms;
+    uint32_t listen_ms = wake_cycle_listen_ms(config, lora_airtime_ms_for_data_rate(sizeof(frame), options.modem.data_rate),
+                                              rx1_delay_ms);
+    result.sent = at_command(modem, clock, command, AT_SENDB_TIMEOUT_MS, listen_ms, response);
+
+    // RX lines captured while listening
+    for (const char* rx = at_find_rx(response.text); rx != NULL; rx = at_find_rx(rx + 3)) {
+      AtDownlink downlink;
+      if (at_parse_rx_line(rx, downlink)) result.downlinks++;
+    }
+  }
+
+  result.modem_ms = (clock.now_us - start_us) / 1000;
+  return result;
+}
+
+// Report followed by a cleanup, as handle_rfid_tap() schedules it: the
+// report listens listen_ms after its OK (send_lorawan_data()), and the
+// cleanup goes gap_ms after that
+static bool back_to_back(RadioengeEmulator& modem, VirtualClock& clock, uint32_t listen_ms, uint32_t gap_ms) {
+  static AtResponse response;
+  modem.power_cycle();
+  at_join_network(modem, clock, AT_JOIN_MAX_RETRIES, AT_JOIN_TIMEOUT_MS, response);
+
+  uint8_t frame[UPLINK_FRAME_LENGTH] = {OP_HOURLY_REPORT, 'L', 'X', '-', '0', '0', '1', 42, 3, 0x01, 0x2C};
+  char command[AT_SENDB_MAX_LENGTH];
+  at_format_sendb(command, sizeof(command), 1, frame, sizeof(frame));
+  if (!at_command(modem, clock, command, AT_SENDB_TIMEOUT_MS, listen_ms, response)) return false;
+
+  clock.delay(gap_ms);
+
+  uint8_t uid[RFID_UID_LENGTH] = {0x21, 0x47, 0xC2, 0x4C};
+  DeviceConfig config = {};
+  memcpy(config.name, "LX-001", DEVICE_NAME_LENGTH);
+  wake_cycle_build_cleanup(config, uid, RFID_UID_LENGTH, frame);
+  at_format_sendb(command, sizeof(command), 1, frame, sizeof(frame));
+  return at_command(modem, clock, command, AT_SENDB_TIMEOUT_MS, 0, response);
+}
+
+static uint64_t percentile(std::vector<uint64_t> values, double p) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[index];
+}
+
+static int run_harness(const HarnessOptions& options) {
+  VirtualClock clock;
+  RadioengeEmulator modem(options.modem, [&clock] { return clock.now_us; });
+
+  std::vector<uint64_t> modem_ms;
+  uint32_t joined = 0, sent = 0, queued = 0, received = 0, retried_joins = 0;
+
+  for (uint32_t trial = 0; trial < options.trials; trial++) {
+    if (options.downlink_every > 0 && trial % options.downlink_every == 0) {
+      modem.queue_downlink(5, {0x01, 0x21, 0x47, 0xC2, 0x4C, 0x01});  // INSERT_USER
+      queued++;
+    }
+
+    WakeResult result = timer_wake(modem, clock, options);
+    modem_ms.push_back(result.modem_ms);
+    if (result.joined) joined++;
+    if (result.sent) sent++;
+    if (result.join_attempts > 1) retried_joins++;
+    received += result.downlinks;
+
+    clock.delay(180000);  // Deep sleep between wakes
+  }
+
+  const EmulatorStats& stats = modem.stats();
+  printf("Timer wake (%u trials, seed %llu)\n", options.trials, (unsigned long long)options.modem.seed);
+  printf("  Modem time per wake: min %llu ms, median %llu ms, p95 %llu ms, max %llu ms\n",
+         (unsigned long long)percentile(modem_ms, 0.0), (unsigned long long)percentile(modem_ms, 0.5),
+         (unsigned long long)percentile(modem_ms, 0.95), (unsigned long long)percentile(modem_ms, 1.0));
+  printf("  Joined: %u, needed a retry: %u, report sent: %u\n", joined, retried_joins, sent);
+  printf("  Downlinks: queued %u, captured %u, still queued %zu, lost on air %u\n", queued, received,
+         modem.queued_downlinks(), stats.downlinks_lost);
+  printf("  Module: %u commands, %u uplinks (%u lost), %u busy rejects\n", stats.commands,
+         stats.uplinks, stats.uplinks_lost, stats.busy_rejects);
+
+  // The report listens as send_lorawan_data() does, with the RX1 delay the
+  // module reports
+  DeviceConfig listen_config = {};
+  listen_config.downlink_wait_ms = options.downlink_wait_ms;
+  uint32_t listen_ms = wake_cycle_listen_ms(listen_config, lora_airtime_ms_for_data_rate(UPLINK_FRAME_LENGTH, options.modem.data_rate),
+                                            options.modem.rx1_delay_ms);
+  printf("\nBack-to-back uplinks (report, %u ms listen after OK, then cleanup)\n", listen_ms);
+  const uint32_t gaps[] = {0, 500, 1000, AT_UPLINK_GAP_MS, 3000};
+  for (uint32_t gap : gaps) {
+    VirtualClock gap_clock;
+    EmulatorConfig config = options.modem;
+    config.join_fail = 0;
+    config.join_silent = 0;
+    RadioengeEmulator gap_modem(config, [&gap_clock] { return gap_clock.now_us; });
+
+    uint32_t ok = 0;
+    uint32_t runs = std::min<uint32_t>(options.trials, 100);
+    for (uint32_t i = 0; i < runs; i++) {
+      if (back_to_back(gap_modem, gap_clock, listen_ms, gap)) ok++;
+      gap_clock.delay(60000);
+    }
+    printf("  Gap %4u ms: cleanup accepted %3u/%u%s\n", gap, ok, runs,
+           gap == AT_UPLINK_GAP_MS ? "  (AT_UPLINK_GAP_MS)" : "");
+  }
+  return 0;
+}
+
+// ============================================
+// Multicast fleet mode (network server stand-in)
+// ============================================
+//
+// One whitelist batch for the whole fleet, sent once in a multicast window
+// (ESP32/multicast_session.h) and repaired by unicast, against the same
+// entries sent to every bin by unicast. The stand-in plays the backend: it
+// transmits the batch frames to every module, reads the acks the modules
+// passed to the network, queues the entries of missing frames for the bins
+// that acked and the whole batch for the bins that did not (after one
+// report round). Bins wake hourly for reports; a report wake follows the
+// firmware: report, multicast ack if one is pending, then polls while
+// downlinks are queued.
+
+#define FLEET_GROUP_ADDR        0x01F2A3B4UL
+#define FLEET_REPORT_GAP_MS     3600000UL
+#define FLEET_MAX_FOLLOWUPS     3      // DOWNLINK_MAX_FOLLOWUPS in main.cpp
+#define FLEET_MAX_ROUNDS        100
+#define FLEET_UNICAST_PORT      5
+
+struct FleetBin {
+  explicit FleetBin(const EmulatorConfig& config, VirtualClock& clock)
+      : modem(config, [&clock] { return clock.now_us; }) {}
+
+  RadioengeEmulator modem;
+  DeviceConfig config = {};
+  uint32_t rx1_delay_ms = LORAWAN_RX1_DELAY_DEFAULT_MS;
+  MulticastBatchState batch = {};
+  std::set<uint32_t> whitelist;
+  bool acked = false;
+  bool sent_whole_batch = false;
+};
+
+struct FleetResult {
+  uint32_t multicast_frames = 0;
+  uint64_t multicast_airtime_ms = 0;
+  uint32_t downlinks = 0;           // Class A downlinks on air
+  uint64_t downlink_airtime_ms = 0;
+  uint32_t uplinks = 0;
+  uint32_t complete_after_window = 0;
+  uint32_t rounds = 0;              // Report rounds until nothing was left to send
+  uint32_t complete = 0;            // Bins with the whole batch at the end
+  uint32_t missing = 0;             // Entries lost on the way (unicast downlinks are not confirmed)
+};
+
+static uint32_t fleet_uid(uint32_t entry) {
+  return 0xA0000000UL + entry;
+}
+
+static std::vector<uint8_t> fleet_unicast_insert(uint32_t uid) {
+  return {0x01, (uint8_t)(uid >> 24), (uint8_t)(uid >> 16), (uint8_t)(uid >> 8), (uint8_t)uid, 0x01};
+}
+
+// Batch frames as the backend packs them; frame_entries[i] lists the UIDs of frame i
+static std::vector<std::vector<uint8_t>> fleet_batch_frames(uint16_t batch_id, uint32_t entries,
+                                                            std::vector<std::vector<uint32_t>>& frame_entries) {
+  const uint32_t per_frame = (MC_FRAME_MAX_LENGTH - MC_BATCH_HEADER_LENGTH) / MC_INSERT_LENGTH;
+  uint32_t count = (entries + per_frame - 1) / per_frame;
+  std::vector<std::vector<uint8_t>> frames;
+  for (uint32_t f = 0; f < count; f++) {
+    std::vector<uint8_t> frame = {(uint8_t)(batch_id >> 8), (uint8_t)batch_id, (uint8_t)f, (uint8_t)count};
+    frame_entries.emplace_back();
+    for (uint32_t e = f * per_frame; e < entries && e < (f + 1) * per_frame; e++) {
+      std::vector<uint8_t> entry = fleet_unicast_insert(fleet_uid(e));
+      frame.insert(frame.end(), entry.begin(), entry.end());
+      frame_entries.back().push_back(fleet_uid(e));
+    }
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+// Apply the RX lines in text as process_downlink_message() would
+static void fleet_apply_rx(FleetBin& bin, const char* text) {
+  for (const char* rx = at_find_rx(text); rx != NULL; rx = at_find_rx(rx + 3)) {
+    AtDownlink downlink;
+    if (!at_parse_rx_line(rx, downlink)) continue;
+    if (downlink.port == MC_WHITELIST_PORT) {
+      multicast_batch_receive(bin.batch, downlink.data, downlink.length,
+                              [&bin](uint8_t operation, const uint8_t* uid, uint8_t) {
+                                if (operation == MC_ENTRY_INSERT) bin.whitelist.insert(multicast_read_u32(uid));
+                              });
+    } else if (downlink.port == FLEET_UNICAST_PORT && downlink.length == 6 && downlink.data[0] == 0x01) {
+      bin.whitelist.insert(multicast_read_u32(downlink.data + 1));
+    }
+  }
+}
+
+static bool fleet_join(FleetBin& bin, VirtualClock& clock, AtResponse& response) {
+  bin.modem.power_cycle();
+  clock.delay(AT_MODULE_BOOT_MS);
+  at_command(bin.modem, clock, "AT", AT_COMMAND_TIMEOUT_MS, 0, response);
+  if (!at_join_network(bin.modem, clock, AT_JOIN_MAX_RETRIES, AT_JOIN_TIMEOUT_MS, response)) return false;
+  bin.rx1_delay_ms = query_rx1_delay(bin.modem, clock, response);
+  return true;
+}
+
+static bool fleet_send(FleetBin& bin, VirtualClock& clock, const HarnessOptions& options, const uint8_t* frame,
+                       size_t length, AtResponse& response) {
+  char command[AT_SENDB_MAX_LENGTH];
+  at_format_sendb(command, sizeof(command), 1, frame, length);
+  DeviceConfig config = {};
+  config.downlink_wait_ms = options.downlink_wait_ms;
+  uint32_t listen_ms = wake_cycle_listen_ms(config, lora_airtime_ms_for_data_rate(length, options.modem.data_rate),
+                                            bin.rx1_delay_ms);
+  bool sent = at_command(bin.modem, clock, command, AT_SENDB_TIMEOUT_MS, listen_ms, response);
+  fleet_apply_rx(bin, response.text);
+  return sent;
+}
+
+// Report wake: report, pending multicast ack, polls while downlinks are queued
+static void fleet_report_wake(FleetBin& bin, VirtualClock& clock, const HarnessOptions& options) {
+  static AtResponse response;
+  if (!fleet_join(bin, clock, response)) return;
+
+  uint8_t report[UPLINK_FRAME_LENGTH] = {OP_HOURLY_REPORT, 'L', 'X', '-', '0', '0', '1', 42, 3, 0x01, 0x2C};
+  fleet_send(bin, clock, options, report, sizeof(report), response);
+  if (bin.batch.ack_pending) {
+    uint8_t ack[MULTICAST_ACK_MAX_LENGTH];
+    size_t length = wake_cycle_build_multicast_ack(bin.batch, bin.config, ack);
+    if (fleet_send(bin, clock, options, ack, length, response)) bin.batch.ack_pending = 0;
+  }
+  for (int followups = 0; followups < FLEET_MAX_FOLLOWUPS && bin.modem.queued_downlinks() > 0; followups++) {
+    uint8_t poll[POLL_FRAME_LENGTH];
+    wake_cycle_build_poll(bin.config, poll);
+    fleet_send(bin, clock, options, poll, sizeof(poll), response);
+  }
+}
+
+// Backend side of the acks that reached the network: queue the missing entries
+static void fleet_handle_acks(FleetBin& bin, const std::vector<std::vector<uint32_t>>& frame_entries) {
+  for (const EmulatorUplink& uplink : bin.modem.take_uplinks()) {
+    const std::vector<uint8_t>& p = uplink.payload;
+    if (p.size() < 10 || p[0] != OP_MULTICAST_ACK || p[9] != frame_entries.size()) continue;
+    if (p.size() < 10 + (frame_entries.size() + 7) / 8) continue;
+    bin.acked = true;
+    for (size_t f = 0; f < frame_entries.size(); f++) {
+      if ((p[10 + f / 8] >> (f % 8)) & 1) continue;
+      for (uint32_t uid : frame_entries[f]) bin.modem.queue_downlink(FLEET_UNICAST_PORT, fleet_unicast_insert(uid));
+    }
+  }
+}
+
+static uint32_t fleet_complete(const std::vector<FleetBin*>& bins, uint32_t entries) {
+  uint32_t complete = 0;
+  for (const FleetBin* bin : bins) {
+    if (bin->whitelist.size() == entries) complete++;
+  }
+  return complete;
+}
+
+// True while a bin still has downlinks queued or an ack to send
+static bool fleet_pending(const std::vector<FleetBin*>& bins) {
+  for (const FleetBin* bin : bins) {
+    if (bin->modem.queued_downlinks() > 0 || bin->batch.ack_pending) return true;
+  }
+  return false;
+}
+
+static FleetResult run_fleet(const HarnessOptions& options, bool multicast) {
+  VirtualClock clock;
+  std::vector<FleetBin*> bins;
+  for (uint32_t i = 0; i < options.multicast_bins; i++) {
+    EmulatorConfig config = options.modem;
+    config.seed = options.modem.seed * 1000003ULL + i;
+    bins.push_back(new FleetBin(config, clock));
+    snprintf(bins.back()->config.name, sizeof(bins.back()->config.name), "LX%04u", i % 10000);
+  }
+
+  FleetResult result;
+  std::vector<std::vector<uint32_t>> frame_entries;
+  std::vector<std::vector<uint8_t>> frames = fleet_batch_frames(1, options.batch_entries, frame_entries);
+
+  if (multicast) {
+    // Setup as the MULTICAST_SETUP downlink carries it: 923.3 MHz, DR8, window every hour
+    uint8_t setup[MC_SETUP_LENGTH] = {0x05, (uint8_t)(FLEET_GROUP_ADDR >> 24), (uint8_t)(FLEET_GROUP_ADDR >> 16),
+                                      (uint8_t)(FLEET_GROUP_ADDR >> 8), (uint8_t)FLEET_GROUP_ADDR};
+    const uint32_t frequency = 923300000UL / 100;
+    setup[37] = (uint8_t)(frequency >> 16);
+    setup[38] = (uint8_t)(frequency >> 8);
+    setup[39] = (uint8_t)frequency;
+    setup[40] = 8;   // DATA_RATE
+    setup[42] = 60;  // PERIOD_MIN
+    setup[45] = 30;  // WINDOW_S
+    MulticastGroup group;
+    if (!multicast_group_parse_setup(setup, sizeof(setup), group)) return result;
+
+    char command[AT_MCAST_MAX_LENGTH];
+    at_format_mcast(command, sizeof(command), group.group_addr, group.nwk_skey, group.app_skey,
+                    group.frequency_hz, group.data_rate);
+
+    static AtResponse response;
+    for (FleetBin* bin : bins) {
+      if (!fleet_join(*bin, clock, response)) continue;
+      if (!at_command(bin->modem, clock, command, AT_COMMAND_TIMEOUT_MS, 0, response)) continue;
+      at_command(bin->modem, clock, LORA_CLASS_C_CMD, AT_COMMAND_TIMEOUT_MS, 0, response);
+    }
+    uint8_t sf;
+    uint16_t bw_khz;
+    if (!lora_downlink_data_rate_params(group.data_rate, sf, bw_khz)) return result;
+    for (const std::vector<uint8_t>& frame : frames) {
+      for (FleetBin* bin : bins) bin->modem.transmit_multicast(group.group_addr, MC_WHITELIST_PORT, frame);
+      uint32_t airtime_ms = (lora_airtime_us(frame.size(), sf, bw_khz) + 999) / 1000;
+      clock.delay(airtime_ms);
+      result.multicast_frames++;
+      result.multicast_airtime_ms += airtime_ms;
+    }
+    clock.delay((unsigned long)group.window_s * 1000);
+    for (FleetBin* bin : bins) {
+      std::string text;
+      while (bin->modem.available()) text += (char)bin->modem.read();
+      fleet_apply_rx(*bin, text.c_str());
+      if (bin->modem.class_c()) at_command(bin->modem, clock, LORA_CLASS_A_CMD, AT_COMMAND_TIMEOUT_MS, 0, response);
+      if (bin->batch.frame_count > 0) bin->batch.ack_pending = 1;
+    }
+    result.complete_after_window = fleet_complete(bins, options.batch_entries);
+  } else {
+    for (FleetBin* bin : bins) {
+      for (uint32_t e = 0; e < options.batch_entries; e++) {
+        bin->modem.queue_downlink(FLEET_UNICAST_PORT, fleet_unicast_insert(fleet_uid(e)));
+      }
+    }
+  }
+
+  while (result.rounds < FLEET_MAX_ROUNDS && fleet_complete(bins, options.batch_entries) < bins.size() &&
+         (fleet_pending(bins) || (multicast && result.rounds == 0))) {
+    clock.delay(FLEET_REPORT_GAP_MS);
+    result.rounds++;
+    for (FleetBin* bin : bins) {
+      fleet_report_wake(*bin, clock, options);
+      if (!multicast) continue;
+      fleet_handle_acks(*bin, frame_entries);
+      // No ack after a report round: the bin gets the whole batch by unicast
+      if (!bin->acked && !bin->sent_whole_batch && bin->batch.ack_pending == 0) {
+        for (uint32_t e = 0; e < options.batch_entries; e++) {
+          bin->modem.queue_downlink(FLEET_UNICAST_PORT, fleet_unicast_insert(fleet_uid(e)));
+        }
+        bin->sent_whole_batch = true;
+      }
+    }
+  }
+  result.complete = fleet_complete(bins, options.batch_entries);
+
+  for (FleetBin* bin : bins) {
+    result.missing += options.batch_entries - (uint32_t)bin->whitelist.size();
+    const EmulatorStats& stats = bin->modem.stats();
+    result.downlinks += stats.downlinks_delivered + stats.downlinks_lost;
+    result.downlink_airtime_ms += stats.downlink_airtime_ms;
+    result.uplinks += stats.uplinks;
+    delete bin;
+  }
+  return result;
+}
+
+static void print_fleet_result(const char* name, const FleetResult& result, uint32_t bins) {
+  printf("  %-10s", name);
+  if (result.multicast_frames > 0) {
+    printf("%u multicast frame(s) (%llu ms), %u/%u bins complete after the window\n%12s",
+           result.multicast_frames, (unsigned long long)result.multicast_airtime_ms,
+           result.complete_after_window, bins, "");
+  }
+  printf("%u unicast downlink(s) (%llu ms), %u uplinks, ", result.downlinks,
+         (unsigned long long)result.downlink_airtime_ms, result.uplinks);
+  printf("%u report round(s)\n%12s%u/%u bins complete, %u entries lost\n", result.rounds, "", result.complete, bins,
+         result.missing);
+}
+
+static int run_multicast_fleet(const HarnessOptions& options) {
+  std::vector<std::vector<uint32_t>> frame_entries;
+  size_t frames = fleet_batch_frames(1, options.batch_entries, frame_entries).size();
+  if (options.batch_entries == 0 || frames > MC_BATCH_MAX_FRAMES) {
+    fprintf(stderr, "Batch must have 1-%u entries\n",
+            MC_BATCH_MAX_FRAMES * ((MC_FRAME_MAX_LENGTH - MC_BATCH_HEADER_LENGTH) / MC_INSERT_LENGTH));
+    return 1;
+  }
+
+  printf("Whitelist batch to %u bins (%u entries in %zu frames, seed %llu)\n", options.multicast_bins,
+         options.batch_entries, frames, (unsigned long long)options.modem.seed);
+  print_fleet_result("Multicast", run_fleet(options, true), options.multicast_bins);
+  print_fleet_result("Unicast", run_fleet(options, false), options.multicast_bins);
+  return 0;
+}
+
+// ============================================
+// Pseudo-terminal mode (real time)
+// ============================================
+
+static volatile sig_atomic_t pty_running = 1;
+
+static void stop_pty(int) {
+  pty_running = 0;
+}
+
+static int run_pty(const HarnessOptions& options) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+
+  // Raw mode on the device side, like a UART
+  const char* slave_name = ptsname(master);
+  int slave = open(slave_name, O_RDWR | O_NOCTTY);
+  if (slave >= 0) {
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto now_us = [start] {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+  };
+  RadioengeEmulator modem(options.modem, now_us);
+  for (const auto& downlink : options.queued) {
+    modem.queue_downlink(downlink.first, downlink.second);
+  }
+
+  printf("Emulated module on %s (%u baud, DR%u) - Ctrl+C to stop\n", slave_name,
+         options.modem.uart_baud, options.modem.data_rate);
+  fflush(stdout);
+
+  signal(SIGINT, stop_pty);
+  signal(SIGTERM, stop_pty);
+
+  while (pty_running) {
+    struct pollfd pfd = {master, POLLIN, 0};
+    if (poll(&pfd, 1, 1) > 0 && (pfd.revents & POLLIN)) {
+      char buffer[256];
+      ssize_t n = ::read(master, buffer, sizeof(buffer));
+      for (ssize_t i = 0; i < n; i++) {
+        modem.write(buffer[i]);
+      }
+    }
+    while (modem.available()) {
+      char c = (char)modem.read();
+      if (::write(master, &c, 1) < 0) break;
+    }
+  }
+
+  const EmulatorStats& stats = modem.stats();
+  printf("\n%u commands, %u uplinks, %u downlinks delivered\n", stats.commands, stats.uplinks,
+         stats.downlinks_delivered);
+  if (slave >= 0) close(slave);
+  close(master);
+  return 0;
+}
+
+// ============================================
+// Options
+// ============================================
+
+static void print_usage(const char* program) {
+  printf("Usage: %s [options]\n", program);
+  printf("  --trials N           timer wakes to simulate (default 200)\n");
+  printf("  --seed N             random seed (default 1)\n");
+  printf("  --at-latency A:B     AT answer latency range, ms (default 5:30)\n");
+  printf("  --join-latency A:B   AT+JOIN answer latency range, ms (default 4000:12000)\n");
+  printf("  --join-fail P        probability AT+JOIN answers ERROR (default 0.1)\n");
+  printf("  --join-silent P      probability AT+JOIN is never answered (default 0)\n");
+  printf("  --sendb-latency A:B  AT+SENDB answer latency range, ms (default 20:80)\n");
+  printf("  --uplink-loss P      probability an uplink reaches no gateway (default 0.05)\n");
+  printf("  --downlink-loss P    probability a downlink is lost (default 0.02)\n");
+  printf("  --multicast-loss P   probability a bin misses a multicast frame (default 0.05)\n");
+  printf("  --rx1-delay MS       RX1 delay the join accept gives the module, 1000-15000 (default 5000)\n");
+  printf("  --rx2-share P        share of downlinks delivered in RX2 (default 0.3)\n");
+  printf("  --data-rate DR       uplink data rate 0-6 (default 5)\n");
+  printf("  --downlink-every N   queue a downlink before every N-th wake, 0 = never (default 4)\n");
+  printf("  --downlink-wait MS   cap on the listen window after each uplink (default %d)\n", DEFAULT_DOWNLINK_WAIT_MS);
+  printf("  --multicast N        send one whitelist batch to N bins, multicast vs unicast\n");
+  printf("  --batch-entries N    whitelist entries in the --multicast batch (default 40)\n");
+  printf("  --pty                serve the emulator on a pseudo-terminal in real time\n");
+  printf("  --queue PORT:HEX     downlink to deliver in pty mode (repeatable)\n");
+}
+
+static bool parse_range(const char* value, LatencyRange& range) {
+  unsigned a, b;
+  if (sscanf(value, "%u:%u", &a, &b) != 2 || a > b) return false;
+  range.min_ms = a;
+  range.max_ms = b;
+  return true;
+}
+
+static bool parse_downlink(const char* value, std::pair<int, std::vector<uint8_t>>& downlink) {
+  const char* colon = strchr(value, ':');
+  if (!colon) return false;
+  downlink.first = atoi(value);
+  downlink.second.clear();
+  for (const char* p = colon + 1; *p; p += 2) {
+    int high = hex_value(p[0]);
+    int low = high >= 0 ? hex_value(p[1]) : -1;
+    if (low < 0) return false;
+    downlink.second.push_back((uint8_t)((high << 4) | low));
+  }
+  return !downlink.second.empty();
+}
+
+static bool parse_options(int argc, char** argv, HarnessOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      exit(0);
+    }
+    if (arg == "--pty") {
+      options.pty = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg.c_str());
+      return false;
+    }
+    const char* value = argv[++i];
+    bool ok = true;
+
+    if (arg == "--trials") options.trials = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--seed") options.modem.seed = strtoull(value, nullptr, 10);
+    else if (arg == "--at-latency") ok = parse_range(value, options.modem.at_ok);
+    else if (arg == "--join-latency") ok = parse_range(value, options.modem.join);
+    else if (arg == "--join-fail") options.modem.join_fail = atof(value);
+    else if (arg == "--join-silent") options.modem.join_silent = atof(value);
+    else if (arg == "--sendb-latency") ok = parse_range(value, options.modem.sendb_ok);
+    else if (arg == "--uplink-loss") options.modem.uplink_loss = atof(value);
+    else if (arg == "--downlink-loss") options.modem.downlink_loss = atof(value);
+    else if (arg == "--multicast-loss") options.modem.multicast_loss = atof(value);
+    else if (arg == "--multicast") options.multicast_bins = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--batch-entries") options.batch_entries = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--rx1-delay") {
+      options.modem.rx1_delay_ms = (uint32_t)strtoul(value, nullptr, 10);
+      ok = options.modem.rx1_delay_ms >= 1000 && options.modem.rx1_delay_ms <= LORAWAN_RX1_DELAY_MAX_MS;
+    } else if (arg == "--rx2-share") options.modem.rx2_share = atof(value);
+    else if (arg == "--data-rate") options.modem.data_rate = (uint8_t)atoi(value);
+    else if (arg == "--downlink-every") options.downlink_every = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--downlink-wait") options.downlink_wait_ms = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--queue") {
+      std::pair<int, std::vector<uint8_t>> downlink;
+      ok = parse_downlink(value, downlink);
+      if (ok) options.queued.push_back(downlink);
+    } else {
+      fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+
+    if (!ok) {
+      fprintf(stderr, "Invalid value for %s: %s\n", arg.c_str(), value);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  HarnessOptions options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (options.pty) return run_pty(options);
+  return options.multicast_bins > 0 ? run_multicast_fleet(options) : run_harness(options);
+}
@@ -0,0 +1,225 @@
+#include "radioenge_emulator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "airtime.h"
+
+RadioengeEmulator::RadioengeEmulator(const EmulatorConfig& config, std::function<uint64_t()> now_us)
+    : config_(config),
+      now_us_(std::move(now_us)),
+      rng_(config.seed),
+      byte_time_us_(10ULL * 1000000ULL / std::max<uint32_t>(config.uart_baud, 1)) {}
+
+int RadioengeEmulator::available() {
+  uint64_t now = now_us_();
+  int count = 0;
+  for (const auto& entry : output_) {
+    if (entry.first > now) break;
+    count++;
+  }
+  return count;
+}
+
+int RadioengeEmulator::read() {
+  if (output_.empty() || output_.front().first > now_us_()) return -1;
+  char c = output_.front().second;
+  output_.pop_front();
+  return (uint8_t)c;
+}
+
+size_t RadioengeEmulator::println(const char* line) {
+  size_t length = 0;
+  for (const char* p = line; *p; p++, length++) {
+    write(*p);
+  }
+  write('\r');
+  write('\n');
+  return length + 2;
+}
+
+void RadioengeEmulator::write(char c) {
+  if (c == '\r' || c == '\n') {
+    if (!input_.empty()) {
+      std::string command;
+      command.swap(input_);
+      handle_command(command);
+    }
+    return;
+  }
+  input_ += c;
+}
+
+void RadioengeEmulator::queue_downlink(int port, const std::vector<uint8_t>& payload) {
+  downlinks_.push_back({port, payload});
+}
+
+bool RadioengeEmulator::transmit_multicast(uint32_t group_addr, int port, const std::vector<uint8_t>& payload) {
+  uint64_t now = now_us_();
+  if (!joined_ || !class_c_ || !mcast_set_ || group_addr != mcast_addr_ || now < busy_until_us_) return false;
+  if (chance(config_.multicast_loss)) {
+    stats_.multicast_lost++;
+    return false;
+  }
+  emit(now, rx_line(port, payload));
+  stats_.multicast_delivered++;
+  return true;
+}
+
+std::vector<EmulatorUplink> RadioengeEmulator::take_uplinks() {
+  std::vector<EmulatorUplink> uplinks;
+  uplinks.swap(uplinks_);
+  return uplinks;
+}
+
+void RadioengeEmulator::power_cycle() {
+  output_.clear();
+  input_.clear();
+  joined_ = false;
+  class_c_ = false;
+  mcast_set_ = false;
+  busy_until_us_ = 0;
+}
+
+uint64_t RadioengeEmulator::draw_ms(const LatencyRange& range) {
+  if (range.max_ms <= range.min_ms) return range.min_ms;
+  std::uniform_int_distribution<uint32_t> dist(range.min_ms, range.max_ms);
+  return dist(rng_);
+}
+
+bool RadioengeEmulator::chance(double probability) {
+  if (probability <= 0) return false;
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  return dist(rng_) < probability;
+}
+
+// Queue text on the UART; bytes follow each other at the UART rate
+void RadioengeEmulator::emit(uint64_t at_us, const std::string& text) {
+  uint64_t t = at_us;
+  if (!output_.empty()) {
+    t = std::max(t, output_.back().first + byte_time_us_);
+  }
+  for (char c : text) {
+    output_.emplace_back(t, c);
+    t += byte_time_us_;
+  }
+}
+
+void RadioengeEmulator::handle_command(const std::string& command) {
+  uint64_t now = now_us_();
+  stats_.commands++;
+
+  // While the radio is busy with an uplink the module refuses everything
+  if (now < busy_until_us_) {
+    stats_.busy_rejects++;
+    emit(now + draw_ms(config_.at_ok) * 1000, "ERROR\r\n");
+    return;
+  }
+
+  if (command == "AT") {
+    emit(now + draw_ms(config_.at_ok) * 1000, "OK\r\n");
+  } else if (command == "AT+JOIN") {
+    stats_.joins++;
+    if (chance(config_.join_silent)) return;
+    if (chance(config_.join_fail)) {
+      emit(now + draw_ms(config_.join) * 1000, "ERROR\r\n");
+      return;
+    }
+    joined_ = true;
+    emit(now + draw_ms(config_.join) * 1000, "JOINED\r\n");
+  } else if (command == "AT+DR=?") {
+    char answer[32];
+    snprintf(answer, sizeof(answer), "%u\r\nOK\r\n", config_.data_rate);
+    emit(now + draw_ms(config_.at_ok) * 1000, answer);
+  } else if (command == "AT+RX1DL=?") {
+    char answer[32];
+    snprintf(answer, sizeof(answer), "%u\r\nOK\r\n", config_.rx1_delay_ms);
+    emit(now + draw_ms(config_.at_ok) * 1000, answer);
+  } else if (command.rfind("AT+SENDB=", 0) == 0) {
+    handle_sendb(command.substr(9), now);
+  } else if (command == "AT+CLASS=A" || command == "AT+CLASS=C") {
+    // Class C needs a session to listen on
+    bool ok = command.back() == 'A' || (joined_ && mcast_set_);
+    if (ok) class_c_ = command.back() == 'C';
+    emit(now + draw_ms(config_.at_ok) * 1000, ok ? "OK\r\n" : "ERROR\r\n");
+  } else if (command.rfind("AT+MCAST=", 0) == 0) {
+    bool ok = joined_ && handle_mcast(command.substr(9));
+    emit(now + draw_ms(config_.at_ok) * 1000, ok ? "OK\r\n" : "ERROR\r\n");
+  } else {
+    emit(now + draw_ms(config_.at_ok) * 1000, "ERROR\r\n");
+  }
+}
+
+// AT+MCAST=<ADDR>:<NWKSKEY>:<APPSKEY>:<FREQ_HZ>:<DR>; only the address is
+// kept (the emulator does not encrypt)
+bool RadioengeEmulator::handle_mcast(const std::string& argument) {
+  unsigned long addr, frequency;
+  unsigned data_rate;
+  char nwk_skey[33], app_skey[33];
+  int end = 0;
+  if (sscanf(argument.c_str(), "%8lx:%32[0-9A-Fa-f]:%32[0-9A-Fa-f]:%lu:%u%n", &addr, nwk_skey, app_skey,
+             &frequency, &data_rate, &end) != 5 ||
+      (size_t)end != argument.size() || strlen(nwk_skey) != 32 || strlen(app_skey) != 32 || frequency == 0) {
+    return false;
+  }
+  mcast_addr_ = (uint32_t)addr;
+  mcast_set_ = true;
+  return true;
+}
+
+std::string RadioengeEmulator::rx_line(int port, const std::vector<uint8_t>& payload) const {
+  std::string line = "RX:";
+  char hex[3];
+  for (uint8_t b : payload) {
+    snprintf(hex, sizeof(hex), "%02X", b);
+    line += hex;
+  }
+  char meta[48];
+  snprintf(meta, sizeof(meta), ":%d:%d:%.1f\r\n", port, config_.rssi, config_.snr);
+  return line + meta;
+}
+
+// AT+SENDB=<port>:<hex>
+void RadioengeEmulator::handle_sendb(const std::string& argument, uint64_t now) {
+  size_t colon = argument.find(':');
+  size_t hex_length = colon == std::string::npos ? 0 : argument.size() - colon - 1;
+  if (!joined_ || colon == std::string::npos || hex_length == 0 || hex_length % 2 != 0) {
+    emit(now + draw_ms(config_.at_ok) * 1000, "ERROR\r\n");
+    return;
+  }
+
+  stats_.uplinks++;
+  uint64_t ok_us = now + draw_ms(config_.sendb_ok) * 1000;
+  emit(ok_us, "OK\r\n");
+
+  // TX starts after the OK; the module is busy until the RX windows have closed
+  uint64_t tx_end_us = ok_us + (uint64_t)lora_airtime_ms_for_data_rate(hex_length / 2, config_.data_rate) * 1000;
+  uint32_t rx2_delay_ms = config_.rx1_delay_ms + LORAWAN_RX2_AFTER_RX1_MS;
+  busy_until_us_ = tx_end_us + ((uint64_t)rx2_delay_ms + config_.rx_window_ms) * 1000;
+
+  if (chance(config_.uplink_loss)) {
+    stats_.uplinks_lost++;
+    return;
+  }
+  EmulatorUplink uplink;
+  uplink.port = atoi(argument.c_str());
+  for (size_t i = colon + 1; i + 1 < argument.size(); i += 2) {
+    uplink.payload.push_back((uint8_t)strtoul(argument.substr(i, 2).c_str(), nullptr, 16));
+  }
+  uplinks_.push_back(uplink);
+  if (downlinks_.empty()) return;
+
+  Downlink downlink = downlinks_.front();
+  downlinks_.pop_front();
+  stats_.downlink_airtime_ms += lora_airtime_ms_for_data_rate(downlink.payload.size(), config_.data_rate);
+  if (chance(config_.downlink_loss)) {
+    stats_.downlinks_lost++;
+    return;
+  }
+
+  uint32_t window_ms = chance(config_.rx2_share) ? rx2_delay_ms : config_.rx1_delay_ms;
+  emit(tx_end_us + (uint64_t)window_ms * 1000, rx_line(downlink.port, downlink.payload));
+  stats_.downlinks_delivered++;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+// ============================================
+// Radioenge LoRaWAN Module Emulator
+// ============================================
+//
+// Emulates the module's AT interface as seen from the ESP32 UART: AT,
+// AT+JOIN, AT+SENDB, AT+DR=?, AT+RX1DL=?, AT+CLASS, AT+MCAST and RX: lines for
+// downlinks (class A after an uplink, multicast while in class C). Answers are
+// delivered byte by byte at the UART rate after a configurable latency, and
+// the module is busy (answers ERROR) from an uplink's OK until its receive
+// windows close. Randomness comes from a seeded generator, so a run is
+// reproducible for a given seed.
+//
+// The emulator exposes the Port interface of ESP32/at_modem.h (available,
+// read, println) and reads time from a callback, so it can run on a virtual
+// clock in-process or in real time behind a pseudo-terminal.
+
+struct LatencyRange {
+  uint32_t min_ms;
+  uint32_t max_ms;
+};
+
+struct EmulatorConfig {
+  LatencyRange at_ok = {5, 30};          // AT / AT+DR=? / AT+RX1DL=? -> OK
+  LatencyRange join = {4000, 12000};     // AT+JOIN -> JOINED (OTAA round trip)
+  double join_fail = 0.10;               // AT+JOIN answered with ERROR
+  double join_silent = 0.0;              // AT+JOIN never answered
+  LatencyRange sendb_ok = {20, 80};      // AT+SENDB -> OK (queued for transmission)
+  double uplink_loss = 0.05;             // Uplink reaches no gateway (no downlink either)
+  double downlink_loss = 0.02;           // Downlink sent but not received
+  double multicast_loss = 0.05;          // Multicast frame sent but not received by this module
+  uint32_t rx1_delay_ms = 5000;          // RX1 opens this long after the end of TX (join accept; TTS default)
+  uint32_t rx_window_ms = 100;           // Module stays busy this long after RX2 opens
+  double rx2_share = 0.3;                // Share of downlinks delivered in RX2
+  uint8_t data_rate = 5;                 // Used for the uplink airtime
+  int rssi = -97;
+  float snr = 6.5f;
+  uint32_t uart_baud = 9600;             // Byte time on the UART (8N1)
+  uint64_t seed = 1;
+};
+
+struct EmulatorStats {
+  uint32_t commands = 0;
+  uint32_t joins = 0;
+  uint32_t uplinks = 0;
+  uint32_t uplinks_lost = 0;
+  uint32_t busy_rejects = 0;
+  uint32_t downlinks_delivered = 0;
+  uint32_t downlinks_lost = 0;
+  uint64_t downlink_airtime_ms = 0;     // Class A downlinks on air, delivered or lost
+  uint32_t multicast_delivered = 0;
+  uint32_t multicast_lost = 0;
+};
+
+// Uplink that reached the network (for a network server stand-in)
+struct EmulatorUplink {
+  int port;
+  std::vector<uint8_t> payload;
+};
+
+class RadioengeEmulator {
+ public:
+  RadioengeEmulator(const EmulatorConfig& config, std::function<uint64_t()> now_us);
+
+  // Port interface (ESP32/at_modem.h)
+  int available();
+  int read();
+  size_t println(const char* line);
+
+  // Raw UART input (pseudo-terminal mode): commands end with CR or LF
+  void write(char c);
+
+  // Queue a downlink for the next uplink that reaches the network (class A)
+  void queue_downlink(int port, const std::vector<uint8_t>& payload);
+  size_t queued_downlinks() const { return downlinks_.size(); }
+
+  // Transmit a multicast frame now; only a module in class C with a matching
+  // AT+MCAST session receives it. Returns true if an RX line was emitted
+  bool transmit_multicast(uint32_t group_addr, int port, const std::vector<uint8_t>& payload);
+
+  // Uplinks that reached the network since the last call
+  std::vector<EmulatorUplink> take_uplinks();
+
+  // Forget the session (module power cycle): pending output, busy state, join
+  void power_cycle();
+
+  const EmulatorStats& stats() const { return stats_; }
+  bool joined() const { return joined_; }
+  bool class_c() const { return class_c_; }
+
+ private:
+  struct Downlink {
+    int port;
+    std::vector<uint8_t> payload;
+  };
+
+  void handle_command(const std::string& command);
+  void handle_sendb(const std::string& argument, uint64_t now);
+  bool handle_mcast(const std::string& argument);
+  std::string rx_line(int port, const std::vector<uint8_t>& payload) const;
+  void emit(uint64_t at_us, const std::string& text);
+  uint64_t draw_ms(const LatencyRange& range);
+  bool chance(double probability);
+
+  EmulatorConfig config_;
+  std::function<uint64_t()> now_us_;
+  std::mt19937_64 rng_;
+  uint64_t byte_time_us_;
+
+  std::deque<std::pair<uint64_t, char>> output_;  // (due time, byte)
+  std::deque<Downlink> downlinks_;
+  std::vector<EmulatorUplink> uplinks_;
+  std::string input_;
+
+  bool joined_ = false;
+  bool class_c_ = false;
+  bool mcast_set_ = false;
+  uint32_t mcast_addr_ = 0;
+  uint64_t busy_until_us_ = 0;
+  EmulatorStats stats_;
+};
@@ -0,0 +1,159 @@
+#include "delta_encoder.h"
+
+#include <cstring>
+
+#include "crc32.h"
+#include "delta_patch.h"
+
+namespace {
+
+uint32_t hash_at(const uint8_t* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return (uint32_t)((value * 0x9E3779B97F4A7C15ULL) >> (64 - DELTA_HASH_BITS));
+}
+
+size_t varint_size(uint32_t value) {
+  size_t n = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    n++;
+  }
+  return n;
+}
+
+// Positions of one image by hash, newest first
+class MatchIndex {
+ public:
+  explicit MatchIndex(const std::vector<uint8_t>& data)
+      : data_(data), head_(1u << DELTA_HASH_BITS, -1), prev_(data.size(), -1) {}
+
+  void insert(uint32_t position) {
+    if (position + DELTA_MATCH_MIN > data_.size()) return;
+    uint32_t hash = hash_at(&data_[position]);
+    prev_[position] = head_[hash];
+    head_[hash] = (int32_t)position;
+  }
+
+  int32_t first(const uint8_t* key) const { return head_[hash_at(key)]; }
+  int32_t next(int32_t position) const { return prev_[position]; }
+
+ private:
+  const std::vector<uint8_t>& data_;
+  std::vector<int32_t> head_;
+  std::vector<int32_t> prev_;
+};
+
+size_t match_length(const std::vector<uint8_t>& source, size_t from,
+                    const std::vector<uint8_t>& target, size_t at) {
+  size_t n = 0;
+  while (from + n < source.size() && at + n < target.size() && source[from + n] == target[at + n]) n++;
+  return n;
+}
+
+struct Candidate {
+  uint8_t op = PATCH_OP_ADD;
+  uint32_t source = 0;
+  uint32_t length = 0;
+  long savings = 0;  // Bytes saved against sending the match as literals
+};
+
+void consider(Candidate& best, uint8_t op, uint32_t source, size_t length) {
+  if (length == 0) return;
+  size_t cost = 1 + varint_size((uint32_t)length);
+  if (op != PATCH_OP_COPY_NEXT) cost += varint_size(source);
+  long savings = (long)length - (long)cost;
+  if (savings > best.savings) {
+    best.op = op;
+    best.source = source;
+    best.length = (uint32_t)length;
+    best.savings = savings;
+  }
+}
+
+void put_op(std::vector<uint8_t>& patch, uint8_t op, uint32_t source, uint32_t length) {
+  uint8_t buffer[11];
+  size_t n = 0;
+  buffer[n++] = op;
+  if (op == PATCH_OP_COPY_OLD || op == PATCH_OP_COPY_NEW) n += patch_put_varint(buffer + n, source);
+  n += patch_put_varint(buffer + n, length);
+  patch.insert(patch.end(), buffer, buffer + n);
+}
+
+}  // namespace
+
+std::vector<uint8_t> delta_encode(const std::vector<uint8_t>& old_image,
+                                  const std::vector<uint8_t>& new_image,
+                                  DeltaStats* stats) {
+  DeltaStats local;
+  DeltaStats& s = stats ? *stats : local;
+
+  std::vector<uint8_t> patch(PATCH_HEADER_SIZE);
+  PatchHeader header;
+  header.magic = PATCH_MAGIC;
+  header.old_size = (uint32_t)old_image.size();
+  header.old_crc = crc32_buffer(old_image.data(), old_image.size());
+  header.new_size = (uint32_t)new_image.size();
+  header.new_crc = crc32_buffer(new_image.data(), new_image.size());
+  patch_header_encode(header, patch.data());
+
+  MatchIndex old_index(old_image);
+  MatchIndex new_index(new_image);
+  for (uint32_t i = 0; i < old_image.size(); i++) old_index.insert(i);
+
+  size_t i = 0;
+  size_t literal_start = 0;
+  uint32_t cursor = 0;  // Mirrors the decoder's COPY_NEXT cursor
+
+  auto flush_literals = [&]() {
+    if (i == literal_start) return;
+    uint32_t length = (uint32_t)(i - literal_start);
+    put_op(patch, PATCH_OP_ADD, 0, length);
+    patch.insert(patch.end(), new_image.begin() + literal_start, new_image.begin() + i);
+    s.adds++;
+    s.add_bytes += length;
+  };
+
+  while (i < new_image.size()) {
+    Candidate best;
+    if (cursor < old_image.size()) {
+      consider(best, PATCH_OP_COPY_NEXT, cursor, match_length(old_image, cursor, new_image, i));
+    }
+    if (i + DELTA_MATCH_MIN <= new_image.size()) {
+      const uint8_t* key = &new_image[i];
+      int chain = 0;
+      for (int32_t p = old_index.first(key); p >= 0 && chain < DELTA_CHAIN_LIMIT; p = old_index.next(p), chain++) {
+        consider(best, PATCH_OP_COPY_OLD, (uint32_t)p, match_length(old_image, p, new_image, i));
+      }
+      chain = 0;
+      for (int32_t p = new_index.first(key); p >= 0 && chain < DELTA_CHAIN_LIMIT; p = new_index.next(p), chain++) {
+        consider(best, PATCH_OP_COPY_NEW, (uint32_t)p, match_length(new_image, p, new_image, i));
+      }
+    }
+
+    // A copy that interrupts a literal run also costs the next ADD header
+    if (best.savings < 2) {
+      new_index.insert((uint32_t)i);
+      i++;
+      cursor++;
+      continue;
+    }
+
+    flush_literals();
+    put_op(patch, best.op, best.source, best.length);
+    if (best.op == PATCH_OP_COPY_NEW) {
+      s.copies_new++;
+      s.copy_new_bytes += best.length;
+    } else {
+      s.copies_old++;
+      s.copy_old_bytes += best.length;
+    }
+    cursor = (best.op == PATCH_OP_COPY_NEW ? cursor : best.source) + best.length;
+    for (uint32_t k = 0; k < best.length; k++) new_index.insert((uint32_t)(i + k));
+    i += best.length;
+    literal_start = i;
+  }
+  flush_literals();
+  patch.push_back(PATCH_OP_END);
+  return patch;
+}
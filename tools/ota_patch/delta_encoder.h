@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// ============================================
+// Delta Patch Encoder
+// ============================================
+//
+// Builds the patches applied by the firmware (ESP32/delta_patch.h). Every
+// position of the old image and of the new image written so far is indexed
+// by a hash of its next DELTA_MATCH_MIN bytes; at each position of the new
+// image the longest match among a bounded number of candidates becomes a
+// COPY_OLD or COPY_NEW when it is shorter to encode than the bytes it
+// replaces, and everything else goes out as ADD. The old image offset that
+// follows the previous copy is always tried first, which keeps the unchanged
+// code between two edits in one copy.
+
+#define DELTA_MATCH_MIN    8     // Shortest match looked up by hash
+#define DELTA_HASH_BITS    20
+#define DELTA_CHAIN_LIMIT  64    // Candidates tried per position and source
+
+struct DeltaStats {
+  uint32_t adds = 0;
+  uint32_t add_bytes = 0;
+  uint32_t copies_old = 0;
+  uint32_t copy_old_bytes = 0;
+  uint32_t copies_new = 0;
+  uint32_t copy_new_bytes = 0;
+};
+
+std::vector<uint8_t> delta_encode(const std::vector<uint8_t>& old_image,
+                                  const std::vector<uint8_t>& new_image,
+                                  DeltaStats* stats = nullptr);
@@ -0,0 +1,91 @@
+#include "fragmenter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "crc32.h"
+#include "frag_session.h"
+
+namespace {
+
+std::vector<uint8_t> data_fragment(uint16_t n, const uint8_t* payload, uint8_t frag_size) {
+  std::vector<uint8_t> fragment;
+  fragment.push_back(FRAG_DATA_FRAGMENT);
+  fragment.push_back((uint8_t)(n & 0xFF));
+  fragment.push_back((uint8_t)((n >> 8) & 0x3F));  // FragIndex 0
+  fragment.insert(fragment.end(), payload, payload + frag_size);
+  return fragment;
+}
+
+}  // namespace
+
+// Binomial tail: P(fewer than needed of sent fragments arrive), summed in
+// log space so large sessions do not underflow
+static double session_failure(size_t sent, size_t needed, double loss) {
+  if (needed > sent) return 1.0;
+  if (loss <= 0) return 0.0;
+  if (loss >= 1) return 1.0;
+  double failure = 0;
+  for (size_t k = 0; k < needed; k++) {
+    double log_p = std::lgamma((double)sent + 1) - std::lgamma((double)k + 1) - std::lgamma((double)(sent - k) + 1) +
+                   k * std::log(1 - loss) + (sent - k) * std::log(loss);
+    failure += std::exp(log_p);
+  }
+  return failure;
+}
+
+size_t frag_coded_for_loss(size_t nb_frag, double loss) {
+  size_t needed = nb_frag + FRAG_DECODE_MARGIN;
+  size_t coded = FRAG_DECODE_MARGIN;
+  while (coded < FRAG_MAX_CODED && session_failure(nb_frag + coded, needed, loss) > FRAG_SESSION_FAILURE) coded++;
+  return coded;
+}
+
+bool frag_plan(const std::vector<uint8_t>& block, uint8_t frag_size, uint32_t redundancy, double loss,
+               FragPlan& plan) {
+  if (frag_size == 0 || frag_size > FRAG_MAX_SIZE || block.empty()) return false;
+  size_t nb_frag = (block.size() + frag_size - 1) / frag_size;
+  if (nb_frag > FRAG_MAX_FRAGMENTS) return false;
+
+  plan = FragPlan();
+  plan.nb_frag = (uint16_t)nb_frag;
+  plan.frag_size = frag_size;
+  plan.padding = (uint8_t)(nb_frag * frag_size - block.size());
+  plan.descriptor = crc32_buffer(block.data(), block.size());
+
+  std::vector<uint8_t> padded(block);
+  padded.resize(nb_frag * frag_size, 0);
+
+  plan.setup = {
+    FRAG_SESSION_SETUP_REQ,
+    0x00,  // FragIndex 0, no multicast group
+    (uint8_t)(nb_frag & 0xFF), (uint8_t)(nb_frag >> 8),
+    frag_size,
+    0x00,  // Fragmentation matrix 0, BlockAckDelay 0
+    plan.padding,
+    (uint8_t)plan.descriptor, (uint8_t)(plan.descriptor >> 8),
+    (uint8_t)(plan.descriptor >> 16), (uint8_t)(plan.descriptor >> 24),
+  };
+
+  for (size_t n = 1; n <= nb_frag; n++) {
+    plan.fragments.push_back(data_fragment((uint16_t)n, &padded[(n - 1) * frag_size], frag_size));
+  }
+
+  // Small blocks get a few coded fragments more than the percentage
+  size_t coded = (nb_frag * redundancy + 99) / 100;
+  if (redundancy > 0 && coded < FRAG_MIN_CODED) coded = FRAG_MIN_CODED;
+  if (loss > 0) coded = std::max(coded, frag_coded_for_loss(nb_frag, loss));
+  if (coded > FRAG_MAX_CODED) coded = FRAG_MAX_CODED;
+  std::vector<uint8_t> row((nb_frag + 7) / 8);
+  std::vector<uint8_t> payload(frag_size);
+  for (size_t n = 1; n <= coded; n++) {
+    frag_parity_row((uint32_t)n, (uint32_t)nb_frag, row.data());
+    std::fill(payload.begin(), payload.end(), 0);
+    for (size_t j = 0; j < nb_frag; j++) {
+      if (!frag_bit(row.data(), (uint32_t)j)) continue;
+      for (size_t b = 0; b < frag_size; b++) payload[b] ^= padded[j * frag_size + b];
+    }
+    plan.fragments.push_back(data_fragment((uint16_t)(nb_frag + n), payload.data(), frag_size));
+  }
+  return true;
+}
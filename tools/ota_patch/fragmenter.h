@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ============================================
+// Fragmentation Sender
+// ============================================
+//
+// Server side of the LoRaWAN fragmented data block transport received by
+// ESP32/frag_session.h: the FragSessionSetupReq for a block and its
+// DataFragment downlinks, the uncoded fragments followed by coded ones built
+// with the same parity matrix. Payloads are for FRAG_PORT.
+
+#define FRAG_MIN_CODED        4      // Coded fragments of any block sent with redundancy
+#define FRAG_DECODE_MARGIN    12     // Fragments beyond nb_frag for the parity rows to decode
+#define FRAG_SESSION_FAILURE  1e-4   // Accepted chance a session runs out of fragments
+
+struct FragPlan {
+  std::vector<uint8_t> setup;                   // FragSessionSetupReq
+  std::vector<std::vector<uint8_t>> fragments;  // DataFragment, uncoded first
+  uint16_t nb_frag = 0;
+  uint8_t frag_size = 0;
+  uint8_t padding = 0;
+  uint32_t descriptor = 0;                      // CRC-32 of the block
+};
+
+// Coded fragments needed so that, with each downlink lost with probability
+// loss, a session of nb_frag fragments gets nb_frag + FRAG_DECODE_MARGIN of
+// them through with probability 1 - FRAG_SESSION_FAILURE. The parity rows
+// behave like random ones over GF(2): with d equations more than missing
+// fragments, elimination still comes up short about 2^-d of the time
+size_t frag_coded_for_loss(size_t nb_frag, double loss);
+
+// redundancy: coded fragments as a percentage of nb_frag, raised to what
+// frag_coded_for_loss() asks for at loss (at least FRAG_MIN_CODED, at most
+// FRAG_MAX_CODED)
+// Returns false if the block does not fit in one session
+bool frag_plan(const std::vector<uint8_t>& block, uint8_t frag_size, uint32_t redundancy, double loss,
+               FragPlan& plan);
@@ -0,0 +1,374 @@
+// OTA patch tool: builds delta patches between two firmware images, splits
+// them into LoRaWAN fragmentation downlinks and replays those downlinks with
+// loss through the firmware's receiver (ESP32/frag_session.h) and patch
+// applier (ESP32/delta_patch.h).
+//
+//   ota_patch diff old.bin new.bin update.patch
+//   ota_patch apply old.bin update.patch out.bin
+//   ota_patch fragment update.patch --redundancy 50 --loss 0.1
+//   ota_patch replay old.bin new.bin --loss 0.1 --runs 200
+//
+// Firmware images are the .bin files PlatformIO writes to .pio/build/<env>/.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "airtime.h"
+#include "delta_encoder.h"
+#include "delta_patch.h"
+#include "frag_session.h"
+#include "fragmenter.h"
+#include "wake_cycle.h"
+
+struct ToolOptions {
+  uint8_t frag_size = FRAG_MAX_SIZE;
+  uint32_t redundancy = 50;      // Coded fragments, % of the uncoded ones
+  double loss = 0.1;             // Downlink loss: sizes the coded fragments, and replay's loss
+  uint32_t runs = 100;
+  uint64_t seed = 1;
+  uint8_t data_rate = 2;         // Uplink data rate of the polls that fetch fragments
+  uint32_t synthetic = 0;        // Replay on a generated image pair of this size
+  std::vector<std::string> files;
+};
+
+// ============================================
+// Streams
+// ============================================
+
+// Fragment storage and patch source (frag_session.h, delta_patch.h)
+struct MemoryStorage {
+  std::vector<uint8_t> data;
+
+  bool reset() {
+    data.clear();
+    return true;
+  }
+
+  bool read(uint32_t offset, void* out, size_t length) {
+    if (offset + length > data.size()) return false;
+    memcpy(out, data.data() + offset, length);
+    return true;
+  }
+
+  bool write(uint32_t offset, const void* in, size_t length) {
+    if (offset + length > data.size()) data.resize(offset + length);
+    memcpy(data.data() + offset, in, length);
+    return true;
+  }
+};
+
+// Old image
+struct ImageReader {
+  const std::vector<uint8_t>& image;
+
+  bool read(uint32_t offset, void* out, size_t length) {
+    if (offset + length > image.size()) return false;
+    memcpy(out, image.data() + offset, length);
+    return true;
+  }
+};
+
+// New image
+struct ImageWriter {
+  std::vector<uint8_t> image;
+
+  bool write(const uint8_t* in, size_t length) {
+    image.insert(image.end(), in, in + length);
+    return true;
+  }
+
+  bool read(uint32_t offset, uint8_t* out, size_t length) {
+    if (offset + length > image.size()) return false;
+    memcpy(out, image.data() + offset, length);
+    return true;
+  }
+};
+
+static bool load_file(const std::string& path, std::vector<uint8_t>& data) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path.c_str());
+    return false;
+  }
+  data.clear();
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + n);
+  fclose(file);
+  return true;
+}
+
+static bool save_file(const std::string& path, const std::vector<uint8_t>& data) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    fprintf(stderr, "Cannot create %s\n", path.c_str());
+    return false;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok) fprintf(stderr, "Cannot write %s\n", path.c_str());
+  return ok;
+}
+
+static std::string hex(const std::vector<uint8_t>& data) {
+  static const char digits[] = "0123456789ABCDEF";
+  std::string out;
+  for (uint8_t b : data) {
+    out += digits[b >> 4];
+    out += digits[b & 0x0F];
+  }
+  return out;
+}
+
+// ============================================
+// Commands
+// ============================================
+
+static uint8_t apply_patch(const std::vector<uint8_t>& old_image, const std::vector<uint8_t>& patch,
+                           std::vector<uint8_t>& new_image) {
+  MemoryStorage in;
+  in.data = patch;
+  ImageReader old{old_image};
+  ImageWriter out;
+  uint8_t status = delta_patch_apply(in, (uint32_t)patch.size(), old, out);
+  new_image.swap(out.image);
+  return status;
+}
+
+static void print_patch_summary(const std::vector<uint8_t>& old_image, const std::vector<uint8_t>& new_image,
+                                const std::vector<uint8_t>& patch, const DeltaStats& stats) {
+  printf("old %zu bytes, new %zu bytes, patch %zu bytes (%.2f%% of new)\n", old_image.size(), new_image.size(),
+         patch.size(), new_image.empty() ? 0.0 : 100.0 * patch.size() / new_image.size());
+  printf("  %u copies from old (%u bytes), %u from new (%u bytes), %u literal runs (%u bytes)\n",
+         stats.copies_old, stats.copy_old_bytes, stats.copies_new, stats.copy_new_bytes, stats.adds,
+         stats.add_bytes);
+}
+
+static int command_diff(const ToolOptions& options) {
+  if (options.files.size() != 3) return 2;
+  std::vector<uint8_t> old_image, new_image;
+  if (!load_file(options.files[0], old_image) || !load_file(options.files[1], new_image)) return 1;
+
+  DeltaStats stats;
+  std::vector<uint8_t> patch = delta_encode(old_image, new_image, &stats);
+  print_patch_summary(old_image, new_image, patch, stats);
+
+  // Never write a patch the firmware would not rebuild the image from
+  std::vector<uint8_t> check;
+  uint8_t status = apply_patch(old_image, patch, check);
+  if (status != PATCH_OK || check != new_image) {
+    fprintf(stderr, "Patch check failed: %s\n", patch_status_name(status));
+    return 1;
+  }
+  return save_file(options.files[2], patch) ? 0 : 1;
+}
+
+static int command_apply(const ToolOptions& options) {
+  if (options.files.size() != 3) return 2;
+  std::vector<uint8_t> old_image, patch, new_image;
+  if (!load_file(options.files[0], old_image) || !load_file(options.files[1], patch)) return 1;
+
+  uint8_t status = apply_patch(old_image, patch, new_image);
+  if (status != PATCH_OK) {
+    fprintf(stderr, "Patch failed: %s\n", patch_status_name(status));
+    return 1;
+  }
+  return save_file(options.files[2], new_image) ? 0 : 1;
+}
+
+// Downlinks for the backend to queue, one "port hex" line each
+static int command_fragment(const ToolOptions& options) {
+  if (options.files.size() != 1) return 2;
+  std::vector<uint8_t> patch;
+  if (!load_file(options.files[0], patch)) return 1;
+
+  FragPlan plan;
+  if (!frag_plan(patch, options.frag_size, options.redundancy, options.loss, plan)) {
+    fprintf(stderr, "Patch of %zu bytes does not fit one session (%u fragments of %u bytes at most)\n",
+            patch.size(), FRAG_MAX_FRAGMENTS, options.frag_size);
+    return 1;
+  }
+  fprintf(stderr, "%u fragments of %u bytes + %zu coded, descriptor %08X\n", plan.nb_frag, plan.frag_size,
+          plan.fragments.size() - plan.nb_frag, (unsigned)plan.descriptor);
+  printf("%d %s\n", FRAG_PORT, hex(plan.setup).c_str());
+  for (const auto& fragment : plan.fragments) printf("%d %s\n", FRAG_PORT, hex(fragment).c_str());
+  return 0;
+}
+
+// Old image of random bytes; the new one changes a 4-byte word every ~2 KB
+// (moved addresses) and inserts a few short blocks (changed functions)
+static void synthetic_images(uint32_t size, uint64_t seed, std::vector<uint8_t>& old_image,
+                             std::vector<uint8_t>& new_image) {
+  std::mt19937_64 rng(seed);
+  old_image.resize(size);
+  for (auto& b : old_image) b = (uint8_t)rng();
+
+  new_image = old_image;
+  for (uint32_t i = 0; i + 4 <= new_image.size(); i += 1024 + rng() % 2048) {
+    for (int k = 0; k < 4; k++) new_image[i + k] = (uint8_t)rng();
+  }
+  for (int insert = 0; insert < 4 && !new_image.empty(); insert++) {
+    std::vector<uint8_t> block(64 + rng() % 256);
+    for (auto& b : block) b = (uint8_t)rng();
+    new_image.insert(new_image.begin() + rng() % new_image.size(), block.begin(), block.end());
+  }
+}
+
+static int command_replay(const ToolOptions& options) {
+  std::vector<uint8_t> old_image, new_image;
+  if (options.synthetic > 0) {
+    synthetic_images(options.synthetic, options.seed, old_image, new_image);
+  } else {
+    if (options.files.size() != 2) return 2;
+    if (!load_file(options.files[0], old_image) || !load_file(options.files[1], new_image)) return 1;
+  }
+
+  DeltaStats stats;
+  std::vector<uint8_t> patch = delta_encode(old_image, new_image, &stats);
+  print_patch_summary(old_image, new_image, patch, stats);
+
+  FragPlan plan;
+  if (!frag_plan(patch, options.frag_size, options.redundancy, options.loss, plan)) {
+    fprintf(stderr, "Patch of %zu bytes does not fit one session (%u fragments of %u bytes at most)\n",
+            patch.size(), FRAG_MAX_FRAGMENTS, options.frag_size);
+    return 1;
+  }
+  printf("%u fragments of %u bytes + %zu coded, %.0f%% downlink loss, %u runs\n", plan.nb_frag,
+         plan.frag_size, plan.fragments.size() - plan.nb_frag, options.loss * 100, options.runs);
+
+  std::mt19937_64 rng(options.seed);
+  std::bernoulli_distribution lost(options.loss);
+  std::vector<uint8_t> scratch(FRAG_SCRATCH_SIZE);
+  uint32_t complete = 0, verified = 0;
+  uint64_t total_sent = 0;
+  uint32_t max_sent = 0;
+
+  for (uint32_t run = 0; run < options.runs; run++) {
+    FragSessionState state;
+    frag_session_reset(state);
+    MemoryStorage storage;
+    frag_session_handle(state, storage, plan.setup.data(), plan.setup.size());
+
+    uint32_t sent = 0;
+    for (const auto& fragment : plan.fragments) {
+      sent++;
+      if (lost(rng)) continue;
+      FragResult result = frag_session_handle(state, storage, fragment.data(), fragment.size());
+      if (result.decode_due && frag_session_decode(state, storage, scratch.data())) break;
+    }
+    total_sent += sent;
+    if (sent > max_sent) max_sent = sent;
+    if (state.status != FRAG_STATUS_COMPLETE) continue;
+    complete++;
+
+    // Apply the block the receiver rebuilt, as the firmware does
+    uint32_t block_size = frag_block_size(state);
+    if (storage.data.size() < block_size) continue;
+    std::vector<uint8_t> block(storage.data.begin(), storage.data.begin() + block_size);
+    std::vector<uint8_t> rebuilt;
+    if (apply_patch(old_image, block, rebuilt) == PATCH_OK && rebuilt == new_image) verified++;
+  }
+
+  // Class A: every fragment is fetched by a poll uplink and arrives in RX2 (DR8)
+  uint8_t poll[POLL_FRAME_LENGTH] = {0};
+  DeviceConfig config = {};
+  wake_cycle_build_poll(config, poll);
+  uint32_t uplink_ms = lora_airtime_ms_for_data_rate(sizeof(poll), options.data_rate);
+  uint32_t downlink_ms = (lora_airtime_us(plan.fragments[0].size(), LORAWAN_RX2_SF, LORAWAN_RX2_BW_KHZ) + 999) / 1000;
+  double mean_sent = options.runs ? (double)total_sent / options.runs : 0;
+
+  printf("\n%u/%u sessions complete, %u images verified\n", complete, options.runs, verified);
+  printf("fragments sent per session: mean %.1f, max %u (%.2fx the uncoded count)\n", mean_sent, max_sent,
+         plan.nb_frag ? mean_sent / plan.nb_frag : 0);
+  printf("airtime per session: %.1f s of poll uplinks at DR%u, %.1f s of downlinks\n",
+         mean_sent * uplink_ms / 1000.0, options.data_rate, mean_sent * downlink_ms / 1000.0);
+  printf("  %.1f days at the device budget of %lu s/day\n", mean_sent * uplink_ms / AIRTIME_BUDGET_MS,
+         AIRTIME_BUDGET_MS / 1000);
+  return verified == options.runs ? 0 : 1;
+}
+
+// ============================================
+// Options
+// ============================================
+
+static void print_usage(const char* program) {
+  printf("Usage: %s <command> [options] files...\n", program);
+  printf("  diff OLD NEW PATCH     build a patch (checked by applying it)\n");
+  printf("  apply OLD PATCH OUT    rebuild the new image as the firmware does\n");
+  printf("  fragment PATCH         print the session setup and fragment downlinks (port hex)\n");
+  printf("  replay OLD NEW         deliver the patch over lossy downlinks and verify the image\n");
+  printf("Options:\n");
+  printf("  --frag-size N          fragment payload bytes, at most %d (default %d)\n", FRAG_MAX_SIZE, FRAG_MAX_SIZE);
+  printf("  --redundancy P         coded fragments, %% of the uncoded count (default 50)\n");
+  printf("  --loss P               downlink loss to size the coded fragments for, and replay's loss (default 0.1)\n");
+  printf("  --runs N               replay: sessions to simulate (default 100)\n");
+  printf("  --seed N               replay: random seed (default 1)\n");
+  printf("  --data-rate DR         replay: uplink data rate of the polls (default 2)\n");
+  printf("  --synthetic SIZE       replay: generated image pair instead of OLD NEW\n");
+}
+
+static bool parse_options(int argc, char** argv, ToolOptions& options) {
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      exit(0);
+    }
+    if (arg.compare(0, 2, "--") != 0) {
+      options.files.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg.c_str());
+      return false;
+    }
+    const char* value = argv[++i];
+
+    if (arg == "--frag-size") options.frag_size = (uint8_t)atoi(value);
+    else if (arg == "--redundancy") options.redundancy = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--loss") options.loss = atof(value);
+    else if (arg == "--runs") options.runs = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--seed") options.seed = strtoull(value, nullptr, 10);
+    else if (arg == "--data-rate") options.data_rate = (uint8_t)atoi(value);
+    else if (arg == "--synthetic") options.synthetic = (uint32_t)strtoul(value, nullptr, 10);
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+  if (options.frag_size == 0 || options.frag_size > FRAG_MAX_SIZE) {
+    fprintf(stderr, "--frag-size must be 1-%d\n", FRAG_MAX_SIZE);
+    return false;
+  }
+  if (!(options.loss >= 0 && options.loss < 1)) {
+    fprintf(stderr, "--loss must be at least 0 and below 1\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  ToolOptions options;
+  if (argc >= 2 && (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0)) {
+    print_usage(argv[0]);
+    return 0;
+  }
+  if (argc < 2 || !parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  std::string command = argv[1];
+  int result = 2;
+  if (command == "diff") result = command_diff(options);
+  else if (command == "apply") result = command_apply(options);
+  else if (command == "fragment") result = command_fragment(options);
+  else if (command == "replay") result = command_replay(options);
+
+  if (result == 2) print_usage(argv[0]);
+  return result;
+}
@@ -0,0 +1,383 @@
+// Energy model and battery-life predictor: runs the firmware's wake cycle in
+// the fleet simulator's virtual bins under a fixed traffic profile, prices
+// every wake with per-part currents (power_model.h) and predicts how long a
+// battery lasts.
+//
+//   power_model --motion 80 --taps 0.5 --interval 900
+//
+// Wake timings come from the simulation by default. Serial logs of real
+// bins carry one POWER line per wake (ESP32/power_profile.h); with
+//
+//   power_model --log bin-07.log --log bin-12.log
+//
+// the measured timings replace the simulated ones for every kind of wake
+// the logs contain, and the simulation only supplies how often each happens.
+//
+//   power_model --csv before.csv          save the prediction
+//   power_model --compare before.csv      show the change against it
+//
+// Run it before and after a firmware change to see what the change does to
+// battery life.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "at_modem.h"
+#include "power_model.h"
+#include "power_profile.h"
+#include "virtual_bin.h"
+
+// setup() besides its fixed delays and the join: AT test, database open,
+// sensor init and the serial log at 115200 baud
+#define POWER_SETUP_OVERHEAD_MS  1000
+// Network time of a Monday morning (the traffic model's day 0)
+#define POWER_EPOCH_UNIX_MS      1704067200000LL
+
+struct ModelOptions {
+  double motion_per_day = 60;    // Uses (PIR triggers) per bin per day
+  double taps_per_day = 0.5;     // Authorized cleanups per bin per day
+  double worker_delay_h = 2;     // Dispatch to cleanup
+  uint32_t join_ms = 6000;       // AT+JOIN until the join accept (RX2 opens 6 s after the request)
+  uint32_t bins = 8;
+  double days = 28;
+  uint64_t seed = 1;
+  BinParams bin = {180, 30000, 15000, 5, 1.0, 20.0};  // Firmware factory defaults, close to a gateway
+  PowerCurrents currents;
+  Battery battery;
+  std::string currents_path;
+  std::vector<std::string> log_paths;
+  std::string csv_path;
+  std::string compare_path;
+};
+
+struct Metric {
+  std::string name;
+  double value;
+};
+
+static void print_usage(const char* program) {
+  printf("Usage: %s [options]\n", program);
+  printf("Traffic\n");
+  printf("  --motion N        uses (PIR wakes) per bin per day (default 60)\n");
+  printf("  --taps N          authorized cleanups per bin per day (default 0.5)\n");
+  printf("  --worker-delay H  mean hours from dispatch to cleanup (default 2)\n");
+  printf("  --interval S      report interval in seconds (default 180)\n");
+  printf("  --window MS       active window after a PIR wake (default 30000)\n");
+  printf("  --data-rate DR    data rate 0-6 (default 5)\n");
+  printf("Timings\n");
+  printf("  --join-ms MS      AT+JOIN until the join accept (default 6000, 0 = no join per wake)\n");
+  printf("  --log FILE        serial log with POWER lines; measured timings replace simulated ones\n");
+  printf("  --bins N          virtual bins averaged (default 8)\n");
+  printf("  --days D          simulated days (default 28)\n");
+  printf("  --seed N          random seed (default 1)\n");
+  printf("Power\n");
+  printf("  --currents FILE   \"name = value\" overrides of the part currents\n");
+  printf("  --battery MAH     battery capacity (default 5200)\n");
+  printf("  --usable X        usable share of the capacity (default 0.85)\n");
+  printf("  --self-discharge P  percent lost per year (default 3)\n");
+  printf("Output\n");
+  printf("  --csv FILE        write the prediction as CSV\n");
+  printf("  --compare FILE    show the change against a CSV from an earlier run\n");
+}
+
+static bool parse_options(int argc, char** argv, ModelOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      exit(0);
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg.c_str());
+      return false;
+    }
+    const char* value = argv[++i];
+
+    if (arg == "--motion") options.motion_per_day = atof(value);
+    else if (arg == "--taps") options.taps_per_day = atof(value);
+    else if (arg == "--worker-delay") options.worker_delay_h = atof(value);
+    else if (arg == "--interval") options.bin.report_interval_s = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--window") options.bin.active_window_ms = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--data-rate") options.bin.data_rate = atoi(value);
+    else if (arg == "--join-ms") options.join_ms = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--log") options.log_paths.push_back(value);
+    else if (arg == "--bins") options.bins = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--days") options.days = atof(value);
+    else if (arg == "--seed") options.seed = strtoull(value, nullptr, 10);
+    else if (arg == "--currents") options.currents_path = value;
+    else if (arg == "--battery") options.battery.capacity_mah = atof(value);
+    else if (arg == "--usable") options.battery.usable = atof(value);
+    else if (arg == "--self-discharge") options.battery.self_discharge_pct = atof(value);
+    else if (arg == "--csv") options.csv_path = value;
+    else if (arg == "--compare") options.compare_path = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  if (options.motion_per_day < 0 || options.taps_per_day < 0 || options.worker_delay_h <= 0) {
+    fprintf(stderr, "--motion and --taps must not be negative, --worker-delay must be positive\n");
+    return false;
+  }
+  if (options.taps_per_day > 0 && options.motion_per_day <= 0) {
+    fprintf(stderr, "--taps needs --motion: workers are dispatched when uses fill the bin\n");
+    return false;
+  }
+  if (options.bin.report_interval_s < CFG_SLEEP_INTERVAL_MIN_S ||
+      options.bin.report_interval_s > CFG_SLEEP_INTERVAL_MAX_S) {
+    fprintf(stderr, "--interval must be between %d and %d seconds\n",
+            CFG_SLEEP_INTERVAL_MIN_S, CFG_SLEEP_INTERVAL_MAX_S);
+    return false;
+  }
+  if (options.bin.active_window_ms < CFG_ACTIVE_WINDOW_MIN_MS ||
+      options.bin.active_window_ms > CFG_ACTIVE_WINDOW_MAX_MS) {
+    fprintf(stderr, "--window must be between %d and %d ms\n", CFG_ACTIVE_WINDOW_MIN_MS, CFG_ACTIVE_WINDOW_MAX_MS);
+    return false;
+  }
+  uint8_t sf;
+  uint16_t bw_khz;
+  if (options.bin.data_rate < 0 || options.bin.data_rate > 255 ||
+      !lora_data_rate_params((uint8_t)options.bin.data_rate, sf, bw_khz)) {
+    fprintf(stderr, "--data-rate must be a valid data rate (0-6)\n");
+    return false;
+  }
+  if (options.bins == 0 || options.bins > 99999 || options.days < 1) {
+    fprintf(stderr, "--bins must be between 1 and 99999, --days at least 1\n");
+    return false;
+  }
+  if (options.battery.capacity_mah <= 0 || options.battery.usable <= 0 || options.battery.usable > 1 ||
+      options.battery.self_discharge_pct < 0) {
+    fprintf(stderr, "--battery must be positive, --usable in (0, 1], --self-discharge not negative\n");
+    return false;
+  }
+  return true;
+}
+
+// ============================================
+// Traffic
+// ============================================
+
+// Peak-hour rate and fill per use that give the requested daily uses and
+// cleanups under the campus profile (traffic_model.h)
+static TrafficProfile traffic_for(const ModelOptions& options) {
+  double weight_per_day = 0;
+  for (int hour = 0; hour < 24; hour++) weight_per_day += traffic_hour_weight(hour);
+  weight_per_day *= (5.0 + 2.0 * 0.25) / 7.0;  // Quieter weekends
+
+  TrafficProfile traffic;
+  traffic.peak_uses_per_hour = options.motion_per_day / weight_per_day;
+  traffic.worker_delay_h = options.worker_delay_h;
+  // A worker comes once the uses of a cycle fill the bin to the dispatch threshold
+  traffic.fill_per_use_pct = options.motion_per_day > 0 && options.taps_per_day > 0
+    ? options.taps_per_day * FORECAST_THRESHOLD_PCT / options.motion_per_day
+    : 1e-6;
+  return traffic;
+}
+
+// ============================================
+// Wake Timings
+// ============================================
+
+struct SimResult {
+  WakeTotals classes[WAKE_CLASSES];
+  uint64_t uses = 0;
+  double bin_days = 0;
+};
+
+static SimResult simulate(const ModelOptions& options) {
+  SimResult result;
+  TrafficProfile traffic = traffic_for(options);
+  uint32_t boot_ms = SETUP_SERIAL_SETTLE_MS + AT_MODULE_BOOT_MS + options.join_ms +
+                     POWER_SETUP_OVERHEAD_MS + SETUP_PIR_SETTLE_MS;
+  int64_t until_ms = (int64_t)(options.days * SIM_MS_PER_DAY);
+
+  std::vector<WakeProfile> wakes;
+  std::vector<SimUplink> uplinks;
+  for (uint32_t i = 0; i < options.bins; i++) {
+    VirtualBin bin(i, options.bin, POWER_EPOCH_UNIX_MS, options.seed);
+    bin.set_traffic(traffic);
+    bin.set_setup_ms(boot_ms, options.join_ms);
+    bin.set_wake_log(&wakes);
+
+    // Uplinks only matter for their airtime, already in the wake profiles
+    for (int64_t t = SIM_MS_PER_DAY; t < until_ms + SIM_MS_PER_DAY; t += SIM_MS_PER_DAY) {
+      bin.advance(std::min(t, until_ms), uplinks);
+      uplinks.clear();
+    }
+    result.uses += bin.stats().uses;
+  }
+
+  for (const WakeProfile& wake : wakes) result.classes[power_wake_class(wake)].add(wake);
+  result.bin_days = options.bins * options.days;
+  return result;
+}
+
+// Measured wakes from serial logs, grouped like the simulated ones
+static bool read_logs(const std::vector<std::string>& paths, WakeTotals classes[WAKE_CLASSES]) {
+  for (const std::string& path : paths) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+      fprintf(stderr, "Cannot read %s\n", path.c_str());
+      return false;
+    }
+    char line[1024];
+    uint32_t found = 0;
+    while (fgets(line, sizeof(line), file)) {
+      WakeProfile profile;
+      if (wake_profile_parse(line, profile)) {
+        classes[power_wake_class(profile)].add(profile);
+        found++;
+      }
+    }
+    fclose(file);
+    if (found == 0) fprintf(stderr, "No POWER lines in %s\n", path.c_str());
+  }
+  return true;
+}
+
+// ============================================
+// Comparison
+// ============================================
+
+static std::map<std::string, double> load_csv(const std::string& path) {
+  std::map<std::string, double> metrics;
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    fprintf(stderr, "Cannot read %s\n", path.c_str());
+    return metrics;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char name[128];
+    double value;
+    if (sscanf(line, "%127[^,],%lf", name, &value) == 2) metrics[name] = value;
+  }
+  fclose(file);
+  return metrics;
+}
+
+static void write_csv(const std::string& path, const std::vector<Metric>& metrics) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "Cannot write %s\n", path.c_str());
+    return;
+  }
+  fprintf(file, "metric,value\n");
+  for (const Metric& metric : metrics) fprintf(file, "%s,%.4f\n", metric.name.c_str(), metric.value);
+  fclose(file);
+}
+
+// ============================================
+// Main
+// ============================================
+
+int main(int argc, char** argv) {
+  ModelOptions options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (!options.currents_path.empty()) {
+    std::string error;
+    if (!power_load_currents(options.currents_path, options.currents, error)) {
+      fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+  }
+
+  SimResult sim = simulate(options);
+  WakeTotals measured[WAKE_CLASSES];
+  if (!read_logs(options.log_paths, measured)) return 1;
+
+  printf("Traffic: %.1f uses/day (%.1f simulated), %.2f cleanups/day, report every %u s, DR%d\n",
+         options.motion_per_day, sim.uses / sim.bin_days, sim.classes[WAKE_CLASS_CLEANUP].wakes / sim.bin_days,
+         options.bin.report_interval_s, options.bin.data_rate);
+  printf("Simulated: %u bins x %.0f days; timings from %s\n\n", options.bins, options.days,
+         options.log_paths.empty() ? "the simulation" : "the logs where they have the wake");
+
+  // Per-wake charge by class, rated by how often the simulation saw each
+  std::vector<Metric> metrics;
+  WakeCharge day;              // Per-part charge per day
+  double awake_ms_per_day = 0;
+  printf("%-8s %8s %9s %8s %8s %8s %6s %10s %10s  %s\n", "wake", "per day", "awake s", "tx ms", "rx ms",
+         "rfid s", "sonar", "µAh/wake", "µAh/day", "timings");
+  for (int c = 0; c < WAKE_CLASSES; c++) {
+    bool from_log = measured[c].wakes > 0;
+    const WakeTotals& totals = from_log ? measured[c] : sim.classes[c];
+    if (totals.wakes == 0) continue;
+
+    // The power-on boot happens once, not every day
+    double per_day = c == WAKE_CLASS_BOOT ? 0 : sim.classes[c].wakes / sim.bin_days;
+    WakeCharge charge = power_wake_charge(totals, options.currents);
+    double n = (double)totals.wakes;
+
+    char source[32];
+    if (from_log) snprintf(source, sizeof(source), "log (%llu)", (unsigned long long)totals.wakes);
+    else snprintf(source, sizeof(source), "sim");
+    printf("%-8s %8.2f %9.1f %8.0f %8.0f %8.1f %6.1f %10.1f %10.1f  %s\n", power_wake_class_name(c), per_day,
+           totals.awake_ms / n / 1000.0, totals.tx_ms / n, totals.rx_ms / n, totals.rfid_ms / n / 1000.0,
+           totals.ultrasound_readings / n, charge.total(), charge.total() * per_day, source);
+
+    day.cpu_uah += charge.cpu_uah * per_day;
+    day.modem_tx_uah += charge.modem_tx_uah * per_day;
+    day.modem_rx_uah += charge.modem_rx_uah * per_day;
+    day.ultrasound_uah += charge.ultrasound_uah * per_day;
+    day.rfid_uah += charge.rfid_uah * per_day;
+    awake_ms_per_day += totals.awake_ms / n * per_day;
+
+    std::string name = power_wake_class_name(c);
+    if (c != WAKE_CLASS_BOOT) metrics.push_back({name + ".per_day", per_day});
+    metrics.push_back({name + ".awake_ms", totals.awake_ms / n});
+    metrics.push_back({name + ".uah_per_wake", charge.total()});
+  }
+
+  double sleep_h = std::max(0.0, 24.0 - awake_ms_per_day / SIM_MS_PER_HOUR);
+  double sleep_uah = power_sleep_ua(options.currents) * sleep_h;
+  double total_uah = day.total() + sleep_uah;
+  double average_ua = total_uah / 24.0;
+  double days = power_battery_days(options.battery, average_ua);
+
+  printf("\nPer day %31s %10s\n", "µAh", "share");
+  const Metric parts[] = {
+    {"cpu", day.cpu_uah},
+    {"modem_tx", day.modem_tx_uah},
+    {"modem_rx", day.modem_rx_uah},
+    {"ultrasound", day.ultrasound_uah},
+    {"rfid", day.rfid_uah},
+    {"sleep", sleep_uah},
+  };
+  for (const Metric& part : parts) {
+    printf("  %-28s %10.1f %9.1f%%\n", part.name.c_str(), part.value, total_uah > 0 ? 100.0 * part.value / total_uah : 0);
+    metrics.push_back({"uah_per_day." + part.name, part.value});
+  }
+  printf("  %-28s %10.1f\n", "total", total_uah);
+  printf("  (asleep %.2f h/day at %.1f µA)\n", sleep_h, power_sleep_ua(options.currents));
+
+  printf("\nAverage current: %.1f µA\n", average_ua);
+  printf("Battery: %.0f mAh, %.0f%% usable, %.1f%%/year self-discharge -> %.0f days (%.1f years)\n",
+         options.battery.capacity_mah, options.battery.usable * 100.0, options.battery.self_discharge_pct,
+         days, days * 24.0 / POWER_HOURS_PER_YEAR);
+  metrics.push_back({"average_ua", average_ua});
+  metrics.push_back({"battery_days", days});
+
+  if (!options.compare_path.empty()) {
+    std::map<std::string, double> baseline = load_csv(options.compare_path);
+    printf("\nAgainst %s\n", options.compare_path.c_str());
+    printf("%-28s %12s %12s %9s\n", "metric", "before", "after", "change");
+    for (const Metric& metric : metrics) {
+      auto before = baseline.find(metric.name);
+      if (before == baseline.end()) continue;
+      printf("%-28s %12.2f %12.2f", metric.name.c_str(), before->second, metric.value);
+      if (before->second != 0) printf(" %+8.1f%%", 100.0 * (metric.value - before->second) / before->second);
+      printf("\n");
+    }
+  }
+
+  if (!options.csv_path.empty()) write_csv(options.csv_path, metrics);
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include "power_model.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void WakeTotals::add(const WakeProfile& profile) {
+  wakes++;
+  awake_ms += profile.awake_ms;
+  tx_ms += profile.tx_ms;
+  rx_ms += profile.rx_ms;
+  rfid_ms += profile.rfid_ms;
+  ultrasound_readings += profile.ultrasound_readings;
+  uplinks += profile.uplinks;
+}
+
+const char* power_wake_class_name(int wake_class) {
+  switch (wake_class) {
+    case WAKE_CLASS_BOOT:    return "boot";
+    case WAKE_CLASS_TIMER:   return "timer";
+    case WAKE_CLASS_MOTION:  return "motion";
+    case WAKE_CLASS_CLEANUP: return "cleanup";
+  }
+  return "?";
+}
+
+int power_wake_class(const WakeProfile& profile) {
+  if (profile.wake == POWER_WAKE_BOOT) return WAKE_CLASS_BOOT;
+  if (profile.taps > 0) return WAKE_CLASS_CLEANUP;
+  return profile.wake == POWER_WAKE_TIMER ? WAKE_CLASS_TIMER : WAKE_CLASS_MOTION;
+}
+
+WakeCharge power_wake_charge(const WakeTotals& totals, const PowerCurrents& currents) {
+  WakeCharge charge;
+  if (totals.wakes == 0) return charge;
+
+  double n = (double)totals.wakes;
+  double awake_ms = totals.awake_ms / n;
+  double tx_ms = totals.tx_ms / n;
+  double rx_ms = totals.rx_ms / n;
+  double idle_ms = awake_ms > tx_ms + rx_ms ? awake_ms - tx_ms - rx_ms : 0;
+
+  charge.cpu_uah = currents.cpu_ma * awake_ms / 3600.0;
+  charge.modem_tx_uah = currents.modem_tx_ma * tx_ms / 3600.0;
+  charge.modem_rx_uah = (currents.modem_rx_ma * rx_ms + currents.modem_idle_ma * idle_ms) / 3600.0;
+  charge.ultrasound_uah = currents.ultrasound_ma * currents.ultrasound_reading_ms *
+                          (totals.ultrasound_readings / n) / 3600.0;
+  charge.rfid_uah = currents.rfid_ma * (totals.rfid_ms / n) / 3600.0;
+  return charge;
+}
+
+double power_sleep_ua(const PowerCurrents& currents) {
+  return currents.deep_sleep_ua + currents.modem_sleep_ua + currents.pir_ua;
+}
+
+// Self-discharge takes a share of the full capacity every year, on top of
+// what the bin draws
+double power_battery_days(const Battery& battery, double average_ua) {
+  double drain_mah_per_day = average_ua / 1000.0 * 24.0 +
+                             battery.capacity_mah * battery.self_discharge_pct / 100.0 /
+                             (POWER_HOURS_PER_YEAR / 24.0);
+  if (drain_mah_per_day <= 0) return 0;
+  return battery.capacity_mah * battery.usable / drain_mah_per_day;
+}
+
+bool power_load_currents(const std::string& path, PowerCurrents& currents, std::string& error) {
+  struct Field {
+    const char* name;
+    double* value;
+  };
+  const Field fields[] = {
+    {"deep_sleep_ua", &currents.deep_sleep_ua},
+    {"pir_ua", &currents.pir_ua},
+    {"modem_sleep_ua", &currents.modem_sleep_ua},
+    {"cpu_ma", &currents.cpu_ma},
+    {"modem_idle_ma", &currents.modem_idle_ma},
+    {"modem_tx_ma", &currents.modem_tx_ma},
+    {"modem_rx_ma", &currents.modem_rx_ma},
+    {"ultrasound_ma", &currents.ultrasound_ma},
+    {"ultrasound_reading_ms", &currents.ultrasound_reading_ms},
+    {"rfid_ma", &currents.rfid_ma},
+  };
+
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    error = "cannot read " + path;
+    return false;
+  }
+
+  char line[256];
+  int number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    number++;
+    char* comment = strchr(line, '#');
+    if (comment != nullptr) *comment = '\0';
+
+    char name[64];
+    double value;
+    char rest;
+    if (sscanf(line, " %63[a-z_] = %lf %c", name, &value, &rest) != 2) {
+      if (sscanf(line, " %c", &rest) == 1) {
+        error = path + ":" + std::to_string(number) + ": expected \"name = value\"";
+        ok = false;
+      }
+      continue;
+    }
+
+    bool known = false;
+    for (const Field& field : fields) {
+      if (strcmp(name, field.name) == 0) {
+        *field.value = value;
+        known = true;
+      }
+    }
+    if (!known || value < 0) {
+      error = path + ":" + std::to_string(number) + ": " + (known ? "negative value for " : "unknown current ") + name;
+      ok = false;
+    }
+  }
+  fclose(file);
+  return ok;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "power_profile.h"
+
+// ============================================
+// Power Model
+// ============================================
+//
+// Prices wake cycles in charge. A wake's power profile (power_profile.h)
+// says how long each part was on; the currents below say what it draws
+// while it is. Between wakes only the sleep floor is drawn: the ESP32 in
+// deep sleep, the LoRaWAN module asleep and the PIR, which never sleeps.
+//
+// Charges are in µAh (mA × ms / 3600).
+
+// Wakes are grouped by what they cost: a tap turns a motion wake into a
+// cleanup with a second uplink and an early sleep
+#define WAKE_CLASS_BOOT     0
+#define WAKE_CLASS_TIMER    1
+#define WAKE_CLASS_MOTION   2
+#define WAKE_CLASS_CLEANUP  3
+#define WAKE_CLASSES        4
+
+#define POWER_HOURS_PER_YEAR  8766.0
+
+// Datasheet figures for the campus hardware; --currents FILE overrides any
+// of them with "name = value" lines
+struct PowerCurrents {
+  double deep_sleep_ua = 10.0;        // ESP32-S3 deep sleep, RTC memory kept
+  double pir_ua = 65.0;               // HC-SR501, always powered
+  double modem_sleep_ua = 2.0;        // LoRaWAN module between wakes
+  double cpu_ma = 40.0;               // ESP32-S3 awake, radios off
+  double modem_idle_ma = 1.5;         // Module awake, neither sending nor listening
+  double modem_tx_ma = 110.0;         // Module on air at 20 dBm
+  double modem_rx_ma = 6.0;           // Module listening (receive windows, join, class C)
+  double ultrasound_ma = 15.0;        // HC-SR04 during a reading
+  double ultrasound_reading_ms = 30;  // Trigger to echo timeout
+  double rfid_ma = 26.0;              // RC522 with its field on
+};
+
+struct Battery {
+  double capacity_mah = 5200.0;       // Two 18650 cells in parallel
+  double usable = 0.85;               // Share left above the brown-out voltage, cold days included
+  double self_discharge_pct = 3.0;    // Per year
+};
+
+// Phase timings summed over a group of wakes
+struct WakeTotals {
+  uint64_t wakes = 0;
+  double awake_ms = 0;
+  double tx_ms = 0;
+  double rx_ms = 0;
+  double rfid_ms = 0;
+  double ultrasound_readings = 0;
+  double uplinks = 0;
+
+  void add(const WakeProfile& profile);
+};
+
+// Mean charge of one wake, per part
+struct WakeCharge {
+  double cpu_uah = 0;
+  double modem_tx_uah = 0;
+  double modem_rx_uah = 0;            // Listening and idle
+  double ultrasound_uah = 0;
+  double rfid_uah = 0;
+
+  double total() const { return cpu_uah + modem_tx_uah + modem_rx_uah + ultrasound_uah + rfid_uah; }
+};
+
+const char* power_wake_class_name(int wake_class);
+int power_wake_class(const WakeProfile& profile);
+
+// Mean charge per wake of a group; zero for an empty group
+WakeCharge power_wake_charge(const WakeTotals& totals, const PowerCurrents& currents);
+
+// Current drawn while the bin sleeps
+double power_sleep_ua(const PowerCurrents& currents);
+
+// Days until the usable charge is gone at an average current
+double power_battery_days(const Battery& battery, double average_ua);
+
+// Read "name = value" overrides ('#' starts a comment); false with a message
+// on an unknown name or a bad value
+bool power_load_currents(const std::string& path, PowerCurrents& currents, std::string& error);
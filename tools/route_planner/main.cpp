@@ -0,0 +1,320 @@
+// Cleanup route planner: picks the bins a round has to empty from their
+// reported and forecast fill levels, splits them into cart-sized trips from
+// the depot with the least walking, and deals the trips to the crews.
+//
+//   route_planner --crews 3 --capacity 400 < bins.txt
+//
+// reads the depot and bins (route_problem.h) and prints the plan as JSON;
+// the backend runs it for GET /api/routes (src/server/route-planner.ts).
+//
+//   route_planner --bench 1000 --min-fill 0
+//
+// plans a synthetic campus and compares the solver's stages with the
+// nearest-bin walk a crew follows by eye.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "route_problem.h"
+#include "route_solver.h"
+
+struct PlannerOptions {
+  std::string input;           // Empty = stdin
+  std::string matrix;          // Walking distances, empty = great-circle estimate
+  uint32_t crews = 2;
+  float capacity_l = 400.0f;   // One cart
+  float min_fill_pct = 60.0f;  // Bins below this (now and forecast) wait for the next round
+  RouteTiming timing;
+  SolverOptions solver;
+  bool text = false;
+  uint32_t bench_bins = 0;     // 0 = plan the input
+};
+
+static void json_string(std::string& out, const std::string& value) {
+  out += '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') out += '\\';
+    if ((unsigned char)c < 0x20) continue;
+    out += c;
+  }
+  out += '"';
+}
+
+static void appendf(std::string& out, const char* format, double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), format, value);
+  out += buffer;
+}
+
+// ============================================
+// Output
+// ============================================
+
+static std::string plan_json(const RouteProblem& problem, const std::vector<RouteTrip>& trips,
+                             const std::vector<CrewPlan>& crews, const PlannerOptions& options,
+                             const SolverStats& stats) {
+  double makespan = 0;
+  for (const CrewPlan& crew : crews) makespan = std::max(makespan, crew.minutes);
+
+  std::string out = "{\"bins\":" + std::to_string(problem.bins.size()) +
+                    ",\"selected\":" + std::to_string(problem.selected.size());
+  appendf(out, ",\"meters\":%.0f", route_plan_meters(trips));
+  appendf(out, ",\"minutes\":%.1f", makespan);
+  out += ",\"crews\":[";
+  for (size_t c = 0; c < crews.size(); c++) {
+    const CrewPlan& crew = crews[c];
+    if (c > 0) out += ',';
+    out += "{\"crew\":" + std::to_string(c + 1);
+    appendf(out, ",\"meters\":%.0f", crew.meters);
+    appendf(out, ",\"minutes\":%.1f", crew.minutes);
+    out += ",\"trips\":[";
+    for (size_t t = 0; t < crew.trips.size(); t++) {
+      const RouteTrip& trip = trips[crew.trips[t]];
+      if (t > 0) out += ',';
+      appendf(out, "{\"meters\":%.0f", trip.meters);
+      appendf(out, ",\"minutes\":%.1f", route_trip_minutes(trip, options.timing));
+      appendf(out, ",\"load\":%.0f", trip.load_l);
+      out += ",\"bins\":[";
+      for (size_t i = 0; i < trip.nodes.size(); i++) {
+        if (i > 0) out += ',';
+        json_string(out, problem.bins[problem.selected[trip.nodes[i] - 1]].id);
+      }
+      out += "]}";
+    }
+    out += "]}";
+  }
+  out += "]";
+  appendf(out, ",\"solver\":{\"initialMeters\":%.0f", stats.initial_m);
+  out += ",\"threads\":" + std::to_string(stats.threads) + ",\"iterations\":" + std::to_string(stats.iterations);
+  appendf(out, ",\"ms\":%.0f}}", stats.seconds * 1000);
+  return out;
+}
+
+static void print_plan_text(const RouteProblem& problem, const std::vector<RouteTrip>& trips,
+                            const std::vector<CrewPlan>& crews, const PlannerOptions& options) {
+  printf("%zu of %zu bins, %zu trips, %.0f m\n", problem.selected.size(), problem.bins.size(), trips.size(),
+         route_plan_meters(trips));
+  for (size_t c = 0; c < crews.size(); c++) {
+    printf("Crew %zu: %zu trips, %.0f m, %.0f min\n", c + 1, crews[c].trips.size(), crews[c].meters,
+           crews[c].minutes);
+    for (uint32_t t : crews[c].trips) {
+      const RouteTrip& trip = trips[t];
+      printf("  %5.0f m %4.0f min %4.0f L:", trip.meters, route_trip_minutes(trip, options.timing), trip.load_l);
+      for (int node : trip.nodes) printf(" %s", problem.bins[problem.selected[node - 1]].id.c_str());
+      printf("\n");
+    }
+  }
+}
+
+static int run_plan(const PlannerOptions& options) {
+  RouteProblem problem;
+  problem.capacity_l = options.capacity_l;
+  std::string error;
+
+  FILE* in = options.input.empty() ? stdin : fopen(options.input.c_str(), "r");
+  if (!in) {
+    fprintf(stderr, "Cannot open %s\n", options.input.c_str());
+    return 1;
+  }
+  bool read = route_read_input(in, problem, error);
+  if (in != stdin) fclose(in);
+  if (!read) {
+    fprintf(stderr, "Input: %s\n", error.c_str());
+    return 1;
+  }
+
+  std::vector<float> matrix;
+  if (!options.matrix.empty() && !route_read_matrix(options.matrix.c_str(), problem.bins.size(), matrix, error)) {
+    fprintf(stderr, "Matrix: %s\n", error.c_str());
+    return 1;
+  }
+  route_select(problem, options.min_fill_pct, matrix);
+
+  SolverStats stats;
+  std::vector<RouteTrip> trips = route_solve(problem, options.solver, stats);
+  std::vector<CrewPlan> crews = route_assign_crews(trips, options.crews, options.timing);
+
+  if (options.text) {
+    print_plan_text(problem, trips, crews, options);
+  } else {
+    printf("%s\n", plan_json(problem, trips, crews, options, stats).c_str());
+  }
+  return 0;
+}
+
+// ============================================
+// Benchmark
+// ============================================
+
+// Bins in clusters around buildings on a 900 x 700 m campus, depot at a corner
+static void generate_campus(RouteProblem& problem, uint32_t bins, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::normal_distribution<double> spread(0.0, 15.0);
+  const double origin_lat = -22.9790, origin_lon = -43.2330;
+  const double m_per_deg_lat = 111320.0;
+  const double m_per_deg_lon = 111320.0 * cos(origin_lat * M_PI / 180.0);
+
+  uint32_t buildings = std::max(1u, bins / 8);
+  std::vector<std::pair<double, double>> centers;
+  for (uint32_t b = 0; b < buildings; b++) centers.push_back(std::make_pair(uniform(rng) * 900, uniform(rng) * 700));
+
+  problem.depot_lat = origin_lat;
+  problem.depot_lon = origin_lon;
+  problem.has_depot = true;
+  for (uint32_t i = 0; i < bins; i++) {
+    const std::pair<double, double>& center = centers[rng() % buildings];
+    RouteBin bin;
+    char id[16];
+    snprintf(id, sizeof(id), "B%05u", i);
+    bin.id = id;
+    bin.lat = origin_lat + (center.second + spread(rng)) / m_per_deg_lat;
+    bin.lon = origin_lon + (center.first + spread(rng)) / m_per_deg_lon;
+    bin.fill_pct = (float)(uniform(rng) * 100);
+    bin.forecast_pct = std::min(100.0f, bin.fill_pct + (float)(uniform(rng) * 30));
+    bin.volume_l = uniform(rng) < 0.3 ? 240.0f : ROUTE_DEFAULT_VOLUME_L;
+    problem.bins.push_back(bin);
+  }
+}
+
+static void print_stage(const char* name, double meters, double reference_m, double ms) {
+  printf("  %-28s %9.0f m  %+6.1f %%  %8.1f ms\n", name, meters, (meters / reference_m - 1) * 100, ms);
+}
+
+static int run_bench(const PlannerOptions& options) {
+  RouteProblem problem;
+  problem.capacity_l = options.capacity_l;
+  generate_campus(problem, options.bench_bins, options.solver.seed);
+  route_select(problem, options.min_fill_pct, std::vector<float>());
+  printf("Campus: %zu bins, %zu to empty, cart %.0f L, %u crews\n", problem.bins.size(), problem.selected.size(),
+         problem.capacity_l, options.crews);
+  if (problem.selected.empty()) return 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<RouteTrip> walk = route_nearest_neighbor(problem);
+  double walk_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  double walk_m = route_plan_meters(walk);
+
+  SolverOptions single = options.solver;
+  single.threads = 1;
+  SolverStats single_stats;
+  std::vector<RouteTrip> single_trips = route_solve(problem, single, single_stats);
+
+  SolverStats stats;
+  std::vector<RouteTrip> trips = route_solve(problem, options.solver, stats);
+
+  printf("Walking distance (vs nearest bin walk):\n");
+  print_stage("Nearest bin walk", walk_m, walk_m, walk_ms);
+  printf("  %-28s %9.0f m  %+6.1f %%\n", "Savings", stats.initial_m, (stats.initial_m / walk_m - 1) * 100);
+  print_stage("Savings + local search", stats.descent_m, walk_m, stats.start_seconds * 1000);
+  print_stage("Search, 1 thread", single_stats.best_m, walk_m, single_stats.seconds * 1000);
+  if (stats.threads > 1) {
+    char name[64];
+    snprintf(name, sizeof(name), "Search, %u threads", stats.threads);
+    print_stage(name, stats.best_m, walk_m, stats.seconds * 1000);
+    printf("  Search iterations: %llu with 1 thread, %llu with %u threads\n",
+           (unsigned long long)single_stats.iterations, (unsigned long long)stats.iterations, stats.threads);
+  } else {
+    printf("  Search iterations: %llu (one search thread, no scaling to compare)\n",
+           (unsigned long long)stats.iterations);
+  }
+
+  std::vector<CrewPlan> walk_crews = route_assign_crews(walk, options.crews, options.timing);
+  std::vector<CrewPlan> crews = route_assign_crews(trips, options.crews, options.timing);
+  double walk_makespan = 0, makespan = 0;
+  for (const CrewPlan& crew : walk_crews) walk_makespan = std::max(walk_makespan, crew.minutes);
+  for (const CrewPlan& crew : crews) makespan = std::max(makespan, crew.minutes);
+  printf("Trips: %zu (walk %zu), round done in %.0f min (walk %.0f min)\n", trips.size(), walk.size(), makespan,
+         walk_makespan);
+
+  bool valid = route_plan_valid(problem, walk) && route_plan_valid(problem, single_trips) &&
+               route_plan_valid(problem, trips);
+  printf("Plans: %s\n", valid ? "OK" : "INVALID");
+  return valid ? 0 : 2;
+}
+
+// ============================================
+// Options
+// ============================================
+
+static void print_usage(const char* program) {
+  printf("Usage: %s [options] < bins.txt\n", program);
+  printf("  --input FILE      depot and bin lines (default stdin)\n");
+  printf("  --matrix FILE     walking distances in meters, depot then bins (default great-circle x %.1f)\n",
+         ROUTE_DETOUR_FACTOR);
+  printf("  --crews N         crews sharing the round (default 2)\n");
+  printf("  --capacity L      cart capacity in liters (default 400)\n");
+  printf("  --min-fill PCT    empty bins at or above this, now or forecast (default 60)\n");
+  printf("  --speed M         walking speed with a cart, m/min (default 70)\n");
+  printf("  --service MIN     minutes to empty a bin (default 1.5)\n");
+  printf("  --unload MIN      minutes to unload the cart at the depot (default 3)\n");
+  printf("  --time-ms N       search time (default 800)\n");
+  printf("  --threads N       search threads, 0 = one per core (default 0)\n");
+  printf("  --iterations N    search iterations per thread instead of --time-ms, for repeatable plans\n");
+  printf("  --seed N          search seed (default 1)\n");
+  printf("  --text            print the plan as text instead of JSON\n");
+  printf("  --bench N         plan a synthetic campus of N bins instead of the input\n");
+}
+
+static bool parse_options(int argc, char** argv, PlannerOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      exit(0);
+    }
+    if (arg == "--text") {
+      options.text = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Missing value for %s\n", arg.c_str());
+      return false;
+    }
+    const char* value = argv[++i];
+
+    if (arg == "--input") options.input = value;
+    else if (arg == "--matrix") options.matrix = value;
+    else if (arg == "--crews") options.crews = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--capacity") options.capacity_l = (float)atof(value);
+    else if (arg == "--min-fill") options.min_fill_pct = (float)atof(value);
+    else if (arg == "--speed") options.timing.speed_m_min = (float)atof(value);
+    else if (arg == "--service") options.timing.service_min = (float)atof(value);
+    else if (arg == "--unload") options.timing.unload_min = (float)atof(value);
+    else if (arg == "--time-ms") options.solver.time_ms = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--threads") options.solver.threads = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--iterations") options.solver.iterations = strtoull(value, nullptr, 10);
+    else if (arg == "--seed") options.solver.seed = (uint32_t)strtoul(value, nullptr, 10);
+    else if (arg == "--bench") options.bench_bins = (uint32_t)strtoul(value, nullptr, 10);
+    else {
+      fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+
+  if (options.crews == 0 || options.capacity_l <= 0 || options.timing.speed_m_min <= 0) {
+    fprintf(stderr, "--crews, --capacity and --speed must be positive\n");
+    return false;
+  }
+  if (options.solver.time_ms == 0 && options.solver.iterations == 0) {
+    fprintf(stderr, "--time-ms or --iterations must be positive\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  PlannerOptions options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  return options.bench_bins > 0 ? run_bench(options) : run_plan(options);
+}
@@ -0,0 +1,139 @@
+#include "route_problem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+double route_haversine_m(double lat1, double lon1, double lat2, double lon2) {
+  const double earth_radius_m = 6371000.0;
+  const double rad = M_PI / 180.0;
+  double dlat = (lat2 - lat1) * rad;
+  double dlon = (lon2 - lon1) * rad;
+  double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * rad) * cos(lat2 * rad) * sin(dlon / 2) * sin(dlon / 2);
+  return 2 * earth_radius_m * asin(std::min(1.0, sqrt(a)));
+}
+
+static bool valid_position(double lat, double lon) {
+  return lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180;
+}
+
+bool route_read_input(FILE* in, RouteProblem& problem, std::string& error) {
+  char line[512];
+  unsigned line_number = 0;
+  while (fgets(line, sizeof(line), in)) {
+    line_number++;
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    char kind[16];
+    int consumed = 0;
+    if (sscanf(line, "%15s%n", kind, &consumed) != 1) continue;
+    const char* rest = line + consumed;
+
+    if (strcmp(kind, "depot") == 0) {
+      if (sscanf(rest, "%lf %lf", &problem.depot_lat, &problem.depot_lon) != 2 ||
+          !valid_position(problem.depot_lat, problem.depot_lon)) {
+        error = "line " + std::to_string(line_number) + ": expected depot LAT LON";
+        return false;
+      }
+      problem.has_depot = true;
+    } else if (strcmp(kind, "bin") == 0) {
+      RouteBin bin;
+      char id[128];
+      float volume_l = ROUTE_DEFAULT_VOLUME_L;
+      int fields = sscanf(rest, "%127s %lf %lf %f %f %f", id, &bin.lat, &bin.lon, &bin.fill_pct, &bin.forecast_pct,
+                          &volume_l);
+      if (fields < 5 || !valid_position(bin.lat, bin.lon) || volume_l <= 0) {
+        error = "line " + std::to_string(line_number) + ": expected bin ID LAT LON FILL_PCT FORECAST_PCT [VOLUME_L]";
+        return false;
+      }
+      bin.id = id;
+      bin.volume_l = volume_l;
+      problem.bins.push_back(bin);
+    } else {
+      error = "line " + std::to_string(line_number) + ": unknown item " + kind;
+      return false;
+    }
+  }
+  if (!problem.has_depot) {
+    error = "no depot line";
+    return false;
+  }
+  return true;
+}
+
+bool route_read_matrix(const char* path, size_t bins, std::vector<float>& matrix, std::string& error) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    error = std::string("cannot open ") + path;
+    return false;
+  }
+  size_t size = bins + 1;
+  matrix.assign(size * size, 0.0f);
+  for (size_t i = 0; i < size * size; i++) {
+    if (fscanf(file, "%f", &matrix[i]) != 1 || matrix[i] < 0) {
+      fclose(file);
+      error = "matrix needs " + std::to_string(size) + " x " + std::to_string(size) +
+              " non-negative distances (depot first, then the bins in input order)";
+      return false;
+    }
+  }
+  fclose(file);
+
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = i + 1; j < size; j++) {
+      float mean = (matrix[i * size + j] + matrix[j * size + i]) / 2;
+      matrix[i * size + j] = mean;
+      matrix[j * size + i] = mean;
+    }
+  }
+  return true;
+}
+
+void route_select(RouteProblem& problem, float min_fill_pct, const std::vector<float>& matrix) {
+  problem.selected.clear();
+  for (uint32_t i = 0; i < problem.bins.size(); i++) {
+    const RouteBin& bin = problem.bins[i];
+    if (std::max(bin.fill_pct, bin.forecast_pct) >= min_fill_pct) problem.selected.push_back(i);
+  }
+
+  size_t nodes = problem.nodes();
+  problem.load.assign(nodes, 0.0f);
+  for (size_t node = 1; node < nodes; node++) {
+    const RouteBin& bin = problem.bins[problem.selected[node - 1]];
+    float fill = std::min(100.0f, std::max(0.0f, bin.forecast_pct));
+    problem.load[node] = std::min(problem.capacity_l, fill / 100.0f * bin.volume_l);
+  }
+
+  // Input index of a node: 0 for the depot, 1 + bin index otherwise
+  auto input_index = [&](size_t node) { return node == 0 ? 0 : (size_t)problem.selected[node - 1] + 1; };
+  auto position = [&](size_t node, double& lat, double& lon) {
+    if (node == 0) {
+      lat = problem.depot_lat;
+      lon = problem.depot_lon;
+    } else {
+      lat = problem.bins[problem.selected[node - 1]].lat;
+      lon = problem.bins[problem.selected[node - 1]].lon;
+    }
+  };
+
+  size_t matrix_size = problem.bins.size() + 1;
+  problem.dist.assign(nodes * nodes, 0.0f);
+  for (size_t a = 0; a < nodes; a++) {
+    double lat_a, lon_a;
+    position(a, lat_a, lon_a);
+    for (size_t b = a + 1; b < nodes; b++) {
+      float meters;
+      if (!matrix.empty()) {
+        meters = matrix[input_index(a) * matrix_size + input_index(b)];
+      } else {
+        double lat_b, lon_b;
+        position(b, lat_b, lon_b);
+        meters = (float)(route_haversine_m(lat_a, lon_a, lat_b, lon_b) * ROUTE_DETOUR_FACTOR);
+      }
+      problem.dist[a * nodes + b] = meters;
+      problem.dist[b * nodes + a] = meters;
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// ============================================
+// Cleanup Routing Problem
+// ============================================
+//
+// The bins a round has to empty and the walking distances between them.
+// Node 0 is the depot, where carts are unloaded; nodes 1..n are the bins
+// selected for the round. A bin is selected when its last reported or its
+// forecast fill reaches the round's threshold, and it loads the cart with its
+// forecast fill times its volume: what the crew finds when it gets there.
+//
+// Input, one item per line ('#' starts a comment):
+//   depot LAT LON
+//   bin ID LAT LON FILL_PCT FORECAST_PCT [VOLUME_L]
+//
+// Distances come from a measured walking matrix when one is given (meters,
+// depot first, then the bins in input order, one row per line), otherwise
+// from the great-circle distance times ROUTE_DETOUR_FACTOR for the paths
+// around buildings. A matrix is made symmetric (mean of both directions).
+
+#define ROUTE_DETOUR_FACTOR      1.3
+#define ROUTE_DEFAULT_VOLUME_L   100.0f
+
+struct RouteBin {
+  std::string id;
+  double lat = 0;
+  double lon = 0;
+  float fill_pct = 0;       // Last reported
+  float forecast_pct = 0;   // Expected when the round reaches it
+  float volume_l = ROUTE_DEFAULT_VOLUME_L;
+};
+
+// Walking times (minutes) of a trip
+struct RouteTiming {
+  float speed_m_min = 70.0f;   // Walking with a cart
+  float service_min = 1.5f;    // Emptying one bin
+  float unload_min = 3.0f;     // Unloading the cart at the depot, once per trip
+};
+
+struct RouteProblem {
+  double depot_lat = 0;
+  double depot_lon = 0;
+  bool has_depot = false;
+  std::vector<RouteBin> bins;        // Every bin read
+  std::vector<uint32_t> selected;    // Node i (1..n) is bins[selected[i - 1]]
+  std::vector<float> load;           // Liters per node (0 for the depot)
+  std::vector<float> dist;           // nodes() x nodes() meters, row-major
+  float capacity_l = 400.0f;
+
+  size_t nodes() const { return selected.size() + 1; }
+  float d(int a, int b) const { return dist[(size_t)a * nodes() + b]; }
+};
+
+double route_haversine_m(double lat1, double lon1, double lat2, double lon2);
+
+// Read depot and bin lines; false with error set on a malformed line
+bool route_read_input(FILE* in, RouteProblem& problem, std::string& error);
+
+// Read a (bins + 1) x (bins + 1) walking matrix for the bins read
+bool route_read_matrix(const char* path, size_t bins, std::vector<float>& matrix, std::string& error);
+
+// Select the bins of the round and fill in loads and distances. matrix is
+// the full walking matrix or empty. A bin that alone exceeds the cart is
+// loaded as a full cart (one trip by itself).
+void route_select(RouteProblem& problem, float min_fill_pct, const std::vector<float>& matrix);
@@ -0,0 +1,616 @@
+#include "route_solver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <utility>
+
+#define SOLVER_EPSILON_M     1e-3
+#define SOLVER_LOAD_SLACK_L  1e-3f
+
+typedef std::vector<std::vector<int>> NeighborLists;
+
+// Nearest SOLVER_NEIGHBORS bins of every bin, closest first
+static NeighborLists build_neighbors(const RouteProblem& problem) {
+  size_t nodes = problem.nodes();
+  NeighborLists lists(nodes);
+  std::vector<std::pair<float, int>> row;
+  for (size_t a = 1; a < nodes; a++) {
+    row.clear();
+    for (size_t b = 1; b < nodes; b++) {
+      if (b != a) row.push_back(std::make_pair(problem.d((int)a, (int)b), (int)b));
+    }
+    size_t k = std::min((size_t)SOLVER_NEIGHBORS, row.size());
+    std::partial_sort(row.begin(), row.begin() + k, row.end());
+    for (size_t i = 0; i < k; i++) lists[a].push_back(row[i].second);
+  }
+  return lists;
+}
+
+double route_trip_meters(const RouteProblem& problem, const std::vector<int>& nodes) {
+  double meters = 0;
+  int previous = 0;
+  for (int node : nodes) {
+    meters += problem.d(previous, node);
+    previous = node;
+  }
+  return meters + problem.d(previous, 0);
+}
+
+double route_trip_minutes(const RouteTrip& trip, const RouteTiming& timing) {
+  return trip.meters / timing.speed_m_min + trip.nodes.size() * timing.service_min + timing.unload_min;
+}
+
+double route_plan_meters(const std::vector<RouteTrip>& trips) {
+  double meters = 0;
+  for (const RouteTrip& trip : trips) meters += trip.meters;
+  return meters;
+}
+
+static RouteTrip make_trip(const RouteProblem& problem, const std::vector<int>& nodes) {
+  RouteTrip trip;
+  trip.nodes = nodes;
+  for (int node : nodes) trip.load_l += problem.load[node];
+  trip.meters = route_trip_meters(problem, nodes);
+  return trip;
+}
+
+// ============================================
+// Plan (routes with node positions)
+// ============================================
+
+struct Plan {
+  const RouteProblem* problem = nullptr;
+  std::vector<std::vector<int>> routes;   // Empty routes are kept until trips()
+  std::vector<float> load;
+  std::vector<int> route_of;              // Per node, -1 while unrouted
+  std::vector<int> pos_of;
+  double cost = 0;
+
+  explicit Plan(const RouteProblem& p) : problem(&p), route_of(p.nodes(), -1), pos_of(p.nodes(), 0) {}
+
+  void assign(const std::vector<RouteTrip>& trips) {
+    routes.clear();
+    load.clear();
+    cost = 0;
+    for (const RouteTrip& trip : trips) {
+      routes.push_back(trip.nodes);
+      load.push_back(trip.load_l);
+      cost += trip.meters;
+      reindex((int)routes.size() - 1);
+    }
+  }
+
+  std::vector<RouteTrip> trips() const {
+    std::vector<RouteTrip> result;
+    for (const std::vector<int>& route : routes) {
+      if (!route.empty()) result.push_back(make_trip(*problem, route));
+    }
+    return result;
+  }
+
+  void reindex(int r) {
+    const std::vector<int>& route = routes[r];
+    for (size_t i = 0; i < route.size(); i++) {
+      route_of[route[i]] = r;
+      pos_of[route[i]] = (int)i;
+    }
+  }
+
+  int prev(int u) const {
+    int p = pos_of[u];
+    return p == 0 ? 0 : routes[route_of[u]][p - 1];
+  }
+
+  int next(int u) const {
+    const std::vector<int>& route = routes[route_of[u]];
+    size_t p = (size_t)pos_of[u] + 1;
+    return p == route.size() ? 0 : route[p];
+  }
+
+  double d(int a, int b) const { return problem->d(a, b); }
+
+  bool fits(int r, float extra) const { return load[r] + extra <= problem->capacity_l + SOLVER_LOAD_SLACK_L; }
+
+  void remove(int u) {
+    int r = route_of[u];
+    routes[r].erase(routes[r].begin() + pos_of[u]);
+    load[r] -= problem->load[u];
+    route_of[u] = -1;
+    reindex(r);
+  }
+
+  void insert(int u, int r, int pos) {
+    routes[r].insert(routes[r].begin() + pos, u);
+    load[r] += problem->load[u];
+    reindex(r);
+  }
+
+  int new_route() {
+    for (size_t r = 0; r < routes.size(); r++) {
+      if (routes[r].empty()) return (int)r;
+    }
+    routes.push_back(std::vector<int>());
+    load.push_back(0.0f);
+    return (int)routes.size() - 1;
+  }
+
+  float prefix_load(int r, int last_pos) const {
+    float sum = 0;
+    for (int i = 0; i <= last_pos; i++) sum += problem->load[routes[r][i]];
+    return sum;
+  }
+};
+
+// ============================================
+// Local Search
+// ============================================
+
+class Descent {
+ public:
+  Descent(const RouteProblem& problem, const NeighborLists& neighbors)
+      : problem_(problem), neighbors_(neighbors), queued_(problem.nodes(), 0) {}
+
+  void activate(int u) {
+    if (u != 0 && !queued_[u]) {
+      queued_[u] = 1;
+      queue_.push_back(u);
+    }
+  }
+
+  void activate_route(const Plan& plan, int r) {
+    for (int u : plan.routes[r]) activate(u);
+  }
+
+  void activate_all() {
+    for (size_t u = 1; u < problem_.nodes(); u++) activate((int)u);
+  }
+
+  void run(Plan& plan) {
+    while (!queue_.empty()) {
+      int u = queue_.back();
+      queue_.pop_back();
+      queued_[u] = 0;
+      if (improve(plan, u)) activate(u);
+    }
+  }
+
+ private:
+  bool improve(Plan& plan, int u) {
+    const std::vector<int>& near = neighbors_[u];
+    size_t count = std::min(near.size(), (size_t)SOLVER_MOVE_NEIGHBORS);
+    for (size_t i = 0; i < count; i++) {
+      int v = near[i];
+      if (plan.route_of[u] == plan.route_of[v]) {
+        if (relocate(plan, u, v) || swap(plan, u, v) || two_opt(plan, u, v)) return true;
+      } else {
+        if (relocate(plan, u, v) || swap(plan, u, v) || two_opt_star(plan, u, v)) return true;
+      }
+    }
+    return false;
+  }
+
+  void touched(const Plan& plan, int r1, int r2) {
+    activate_route(plan, r1);
+    if (r2 != r1) activate_route(plan, r2);
+  }
+
+  // Move u next to v (after it, or before it)
+  bool relocate(Plan& plan, int u, int v) {
+    int ru = plan.route_of[u], rv = plan.route_of[v];
+    float lu = problem_.load[u];
+    if (ru != rv && !plan.fits(rv, lu)) return false;
+
+    int pu = plan.prev(u), nu = plan.next(u);
+    int pv = plan.prev(v), nv = plan.next(v);
+    double removal = plan.d(pu, nu) - plan.d(pu, u) - plan.d(u, nu);
+
+    if (v != pu) {
+      double delta = removal + plan.d(v, u) + plan.d(u, nv) - plan.d(v, nv);
+      if (delta < -SOLVER_EPSILON_M) {
+        plan.remove(u);
+        plan.insert(u, rv, plan.pos_of[v] + 1);
+        plan.cost += delta;
+        touched(plan, ru, rv);
+        return true;
+      }
+    }
+    if (v != nu) {
+      double delta = removal + plan.d(pv, u) + plan.d(u, v) - plan.d(pv, v);
+      if (delta < -SOLVER_EPSILON_M) {
+        plan.remove(u);
+        plan.insert(u, rv, plan.pos_of[v]);
+        plan.cost += delta;
+        touched(plan, ru, rv);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool swap(Plan& plan, int u, int v) {
+    int ru = plan.route_of[u], rv = plan.route_of[v];
+    float lu = problem_.load[u], lv = problem_.load[v];
+    if (ru != rv && (!plan.fits(ru, lv - lu) || !plan.fits(rv, lu - lv))) return false;
+
+    int pu = plan.prev(u), nu = plan.next(u);
+    int pv = plan.prev(v), nv = plan.next(v);
+    if (v == nu || v == pu) return false;
+    double delta = plan.d(pu, v) + plan.d(v, nu) + plan.d(pv, u) + plan.d(u, nv) -
+                   plan.d(pu, u) - plan.d(u, nu) - plan.d(pv, v) - plan.d(v, nv);
+    if (delta >= -SOLVER_EPSILON_M) return false;
+
+    int pos_u = plan.pos_of[u], pos_v = plan.pos_of[v];
+    plan.routes[ru][pos_u] = v;
+    plan.routes[rv][pos_v] = u;
+    plan.load[ru] += lv - lu;
+    plan.load[rv] += lu - lv;
+    plan.reindex(ru);
+    if (rv != ru) plan.reindex(rv);
+    plan.cost += delta;
+    touched(plan, ru, rv);
+    return true;
+  }
+
+  // Reverse part of u's route so that u and v become adjacent
+  bool two_opt(Plan& plan, int u, int v) {
+    int r = plan.route_of[u];
+    if (plan.pos_of[u] > plan.pos_of[v]) std::swap(u, v);
+    int pu = plan.prev(u), nu = plan.next(u);
+    int pv = plan.prev(v), nv = plan.next(v);
+    if (v == nu) return false;
+
+    std::vector<int>& route = plan.routes[r];
+    // (u, nu) (v, nv) -> (u, v) (nu, nv): reverse nu..v
+    double delta = plan.d(u, v) + plan.d(nu, nv) - plan.d(u, nu) - plan.d(v, nv);
+    if (delta < -SOLVER_EPSILON_M) {
+      std::reverse(route.begin() + plan.pos_of[u] + 1, route.begin() + plan.pos_of[v] + 1);
+    } else {
+      // (pu, u) (pv, v) -> (pu, pv) (u, v): reverse u..pv
+      delta = plan.d(pu, pv) + plan.d(u, v) - plan.d(pu, u) - plan.d(pv, v);
+      if (delta >= -SOLVER_EPSILON_M) return false;
+      std::reverse(route.begin() + plan.pos_of[u], route.begin() + plan.pos_of[v]);
+    }
+    plan.reindex(r);
+    plan.cost += delta;
+    activate_route(plan, r);
+    return true;
+  }
+
+  // Exchange route ends between u's and v's routes so that u and v, or
+  // their successors, become adjacent
+  bool two_opt_star(Plan& plan, int u, int v) {
+    int ru = plan.route_of[u], rv = plan.route_of[v];
+    int nu = plan.next(u), nv = plan.next(v);
+    std::vector<int>& a = plan.routes[ru];
+    std::vector<int>& b = plan.routes[rv];
+    int pos_u = plan.pos_of[u], pos_v = plan.pos_of[v];
+    float head_a = plan.prefix_load(ru, pos_u), tail_a = plan.load[ru] - head_a;
+    float head_b = plan.prefix_load(rv, pos_v), tail_b = plan.load[rv] - head_b;
+    float capacity = problem_.capacity_l + SOLVER_LOAD_SLACK_L;
+    std::vector<int> new_a, new_b;
+
+    // a = A u | nu ..., b = B v | nv ... -> A u nv ..., B v nu ...
+    double delta = plan.d(u, nv) + plan.d(v, nu) - plan.d(u, nu) - plan.d(v, nv);
+    if (delta < -SOLVER_EPSILON_M && head_a + tail_b <= capacity && head_b + tail_a <= capacity) {
+      new_a.assign(a.begin(), a.begin() + pos_u + 1);
+      new_a.insert(new_a.end(), b.begin() + pos_v + 1, b.end());
+      new_b.assign(b.begin(), b.begin() + pos_v + 1);
+      new_b.insert(new_b.end(), a.begin() + pos_u + 1, a.end());
+      plan.load[ru] = head_a + tail_b;
+      plan.load[rv] = head_b + tail_a;
+    } else {
+      // -> A u v reversed(B), reversed(nu ...) nv ...
+      delta = plan.d(u, v) + plan.d(nu, nv) - plan.d(u, nu) - plan.d(v, nv);
+      if (delta >= -SOLVER_EPSILON_M || head_a + head_b > capacity || tail_a + tail_b > capacity) return false;
+      new_a.assign(a.begin(), a.begin() + pos_u + 1);
+      new_a.insert(new_a.end(), b.rend() - pos_v - 1, b.rend());
+      new_b.assign(a.rbegin(), a.rend() - pos_u - 1);
+      new_b.insert(new_b.end(), b.begin() + pos_v + 1, b.end());
+      plan.load[ru] = head_a + head_b;
+      plan.load[rv] = tail_a + tail_b;
+    }
+    a.swap(new_a);
+    b.swap(new_b);
+    plan.reindex(ru);
+    plan.reindex(rv);
+    plan.cost += delta;
+    touched(plan, ru, rv);
+    return true;
+  }
+
+  const RouteProblem& problem_;
+  const NeighborLists& neighbors_;
+  std::vector<char> queued_;
+  std::vector<int> queue_;
+};
+
+// ============================================
+// Ruin and Recreate
+// ============================================
+
+// Remove a bin and some of its nearest neighbors, then put each back where
+// it adds the least distance, in a route that holds one of its neighbors or
+// in a trip of its own
+static void ruin_recreate(Plan& plan, const NeighborLists& neighbors, Descent& descent, std::mt19937& rng) {
+  const RouteProblem& problem = *plan.problem;
+  int n = (int)problem.nodes() - 1;
+  int seed = 1 + (int)(rng() % (uint32_t)n);
+  const std::vector<int>& near = neighbors[seed];
+  int max_count = std::min(SOLVER_RUIN_MAX, (int)near.size() + 1);
+  int min_count = std::min(SOLVER_RUIN_MIN, max_count);
+  int count = min_count + (int)(rng() % (uint32_t)(max_count - min_count + 1));
+
+  std::vector<int> removed;
+  removed.push_back(seed);
+  for (int i = 0; i + 1 < count; i++) removed.push_back(near[i]);
+  for (int u : removed) {
+    int r = plan.route_of[u];
+    plan.cost += plan.d(plan.prev(u), plan.next(u)) - plan.d(plan.prev(u), u) - plan.d(u, plan.next(u));
+    plan.remove(u);
+    descent.activate_route(plan, r);
+  }
+  std::shuffle(removed.begin(), removed.end(), rng);
+
+  std::vector<int> candidates;
+  for (int u : removed) {
+    float lu = problem.load[u];
+    double best_delta = 2.0 * plan.d(0, u);
+    int best_route = -1, best_pos = 0;
+
+    candidates.clear();
+    for (int v : neighbors[u]) {
+      int r = plan.route_of[v];
+      if (r >= 0 && std::find(candidates.begin(), candidates.end(), r) == candidates.end()) candidates.push_back(r);
+    }
+    for (int r : candidates) {
+      if (!plan.fits(r, lu)) continue;
+      const std::vector<int>& route = plan.routes[r];
+      int previous = 0;
+      for (size_t pos = 0; pos <= route.size(); pos++) {
+        int following = pos < route.size() ? route[pos] : 0;
+        double delta = plan.d(previous, u) + plan.d(u, following) - plan.d(previous, following);
+        if (delta < best_delta) {
+          best_delta = delta;
+          best_route = r;
+          best_pos = (int)pos;
+        }
+        previous = following;
+      }
+    }
+
+    if (best_route < 0) {
+      best_route = plan.new_route();
+      best_pos = 0;
+    }
+    plan.insert(u, best_route, best_pos);
+    plan.cost += best_delta;
+    descent.activate_route(plan, best_route);
+  }
+  descent.run(plan);
+}
+
+// ============================================
+// Construction
+// ============================================
+
+std::vector<RouteTrip> route_nearest_neighbor(const RouteProblem& problem) {
+  std::vector<RouteTrip> trips;
+  size_t nodes = problem.nodes();
+  std::vector<char> visited(nodes, 0);
+  size_t remaining = nodes - 1;
+  std::vector<int> current;
+  float load = 0;
+  int at = 0;
+
+  while (remaining > 0) {
+    int best = -1;
+    for (size_t v = 1; v < nodes; v++) {
+      if (visited[v] || load + problem.load[v] > problem.capacity_l + SOLVER_LOAD_SLACK_L) continue;
+      if (best < 0 || problem.d(at, (int)v) < problem.d(at, best)) best = (int)v;
+    }
+    if (best < 0) {
+      // Cart full: back to the depot
+      trips.push_back(make_trip(problem, current));
+      current.clear();
+      load = 0;
+      at = 0;
+      continue;
+    }
+    visited[best] = 1;
+    remaining--;
+    current.push_back(best);
+    load += problem.load[best];
+    at = best;
+  }
+  if (!current.empty()) trips.push_back(make_trip(problem, current));
+  return trips;
+}
+
+static std::vector<RouteTrip> savings_plan(const RouteProblem& problem, const NeighborLists& neighbors) {
+  size_t nodes = problem.nodes();
+  struct Saving {
+    float meters;
+    int i, j;
+  };
+  std::vector<Saving> savings;
+  for (size_t i = 1; i < nodes; i++) {
+    for (int j : neighbors[i]) {
+      if ((int)i > j && std::find(neighbors[j].begin(), neighbors[j].end(), (int)i) != neighbors[j].end()) continue;
+      float meters = problem.d(0, (int)i) + problem.d(0, j) - problem.d((int)i, j);
+      if (meters > 0) savings.push_back(Saving{meters, (int)i, j});
+    }
+  }
+  std::sort(savings.begin(), savings.end(), [](const Saving& a, const Saving& b) {
+    return a.meters != b.meters ? a.meters > b.meters : (a.i != b.i ? a.i < b.i : a.j < b.j);
+  });
+
+  std::vector<std::vector<int>> routes(nodes);
+  std::vector<float> load(nodes, 0.0f);
+  std::vector<int> route_of(nodes, 0);
+  for (size_t u = 1; u < nodes; u++) {
+    routes[u].push_back((int)u);
+    load[u] = problem.load[u];
+    route_of[u] = (int)u;
+  }
+
+  for (const Saving& saving : savings) {
+    int ri = route_of[saving.i], rj = route_of[saving.j];
+    if (ri == rj || load[ri] + load[rj] > problem.capacity_l + SOLVER_LOAD_SLACK_L) continue;
+    std::vector<int>& a = routes[ri];
+    std::vector<int>& b = routes[rj];
+    // Join ... i | j ...: i must end its route and j start its own
+    if (a.back() != saving.i) {
+      if (a.front() != saving.i) continue;
+      if (b.front() != saving.j && b.back() != saving.j) continue;
+      std::reverse(a.begin(), a.end());
+    }
+    if (b.front() != saving.j) {
+      if (b.back() != saving.j) continue;
+      std::reverse(b.begin(), b.end());
+    }
+    for (int u : b) route_of[u] = ri;
+    a.insert(a.end(), b.begin(), b.end());
+    load[ri] += load[rj];
+    b.clear();
+  }
+
+  std::vector<RouteTrip> trips;
+  for (const std::vector<int>& route : routes) {
+    if (!route.empty()) trips.push_back(make_trip(problem, route));
+  }
+  return trips;
+}
+
+std::vector<RouteTrip> route_savings(const RouteProblem& problem) {
+  if (problem.nodes() <= 1) return std::vector<RouteTrip>();
+  NeighborLists neighbors = build_neighbors(problem);
+  return savings_plan(problem, neighbors);
+}
+
+// ============================================
+// Solver
+// ============================================
+
+struct WorkerResult {
+  std::vector<RouteTrip> trips;
+  double meters = 0;
+  uint64_t iterations = 0;
+};
+
+static void search_worker(const RouteProblem& problem, const NeighborLists& neighbors,
+                          const std::vector<RouteTrip>& start, const SolverOptions& options, uint32_t seed,
+                          std::chrono::steady_clock::time_point deadline, WorkerResult& result) {
+  std::mt19937 rng(seed);
+  Descent descent(problem, neighbors);
+  Plan current(problem);
+  current.assign(start);
+  Plan best = current;
+  auto begin = std::chrono::steady_clock::now();
+  double budget_s = std::chrono::duration<double>(deadline - begin).count();
+  uint64_t iteration = 0;
+
+  while (true) {
+    auto now = std::chrono::steady_clock::now();
+    if (now >= deadline || (options.iterations > 0 && iteration >= options.iterations)) break;
+    double progress = options.iterations > 0 ? (double)iteration / options.iterations
+                                             : std::chrono::duration<double>(now - begin).count() / budget_s;
+    double threshold = SOLVER_ACCEPT_START * best.cost * std::max(0.0, 1.0 - progress);
+
+    Plan candidate = current;
+    ruin_recreate(candidate, neighbors, descent, rng);
+    iteration++;
+
+    if (candidate.cost < best.cost - SOLVER_EPSILON_M) best = candidate;
+    if (candidate.cost < current.cost + threshold) current = std::move(candidate);
+  }
+
+  result.trips = best.trips();
+  result.meters = route_plan_meters(result.trips);
+  result.iterations = iteration;
+}
+
+std::vector<RouteTrip> route_solve(const RouteProblem& problem, const SolverOptions& options, SolverStats& stats) {
+  auto begin = std::chrono::steady_clock::now();
+  stats = SolverStats();
+  if (problem.nodes() <= 1) return std::vector<RouteTrip>();
+
+  NeighborLists neighbors = build_neighbors(problem);
+  std::vector<RouteTrip> start = savings_plan(problem, neighbors);
+  stats.initial_m = route_plan_meters(start);
+
+  Plan descended(problem);
+  descended.assign(start);
+  Descent descent(problem, neighbors);
+  descent.activate_all();
+  descent.run(descended);
+  start = descended.trips();
+  stats.descent_m = route_plan_meters(start);
+  stats.start_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  uint32_t threads = options.threads;
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  stats.threads = threads;
+
+  // A number of iterations replaces the time budget
+  auto deadline = options.iterations == 0 ? begin + std::chrono::milliseconds(options.time_ms)
+                                          : std::chrono::steady_clock::time_point::max();
+  std::vector<WorkerResult> results(threads);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++) {
+    workers.emplace_back(search_worker, std::cref(problem), std::cref(neighbors), std::cref(start),
+                         std::cref(options), options.seed * 7919u + t, deadline, std::ref(results[t]));
+  }
+  for (std::thread& worker : workers) worker.join();
+
+  std::vector<RouteTrip> best = start;
+  stats.best_m = stats.descent_m;
+  for (const WorkerResult& result : results) {
+    stats.iterations += result.iterations;
+    if (!result.trips.empty() && result.meters < stats.best_m - SOLVER_EPSILON_M) {
+      best = result.trips;
+      stats.best_m = result.meters;
+    }
+  }
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  return best;
+}
+
+std::vector<CrewPlan> route_assign_crews(const std::vector<RouteTrip>& trips, uint32_t crews,
+                                         const RouteTiming& timing) {
+  std::vector<CrewPlan> plans(std::max(1u, crews));
+  std::vector<uint32_t> order(trips.size());
+  for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return route_trip_minutes(trips[a], timing) > route_trip_minutes(trips[b], timing);
+  });
+
+  for (uint32_t trip : order) {
+    CrewPlan* least = &plans[0];
+    for (CrewPlan& plan : plans) {
+      if (plan.minutes < least->minutes) least = &plan;
+    }
+    least->trips.push_back(trip);
+    least->minutes += route_trip_minutes(trips[trip], timing);
+    least->meters += trips[trip].meters;
+  }
+  return plans;
+}
+
+bool route_plan_valid(const RouteProblem& problem, const std::vector<RouteTrip>& trips) {
+  std::vector<int> seen(problem.nodes(), 0);
+  for (const RouteTrip& trip : trips) {
+    float load = 0;
+    for (int node : trip.nodes) {
+      if (node <= 0 || (size_t)node >= problem.nodes()) return false;
+      seen[node]++;
+      load += problem.load[node];
+    }
+    if (load > problem.capacity_l + 0.01f) return false;
+  }
+  for (size_t node = 1; node < problem.nodes(); node++) {
+    if (seen[node] != 1) return false;
+  }
+  return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "route_problem.h"
+
+// ============================================
+// Route Solver
+// ============================================
+//
+// Capacitated routing: the selected bins are split into trips that start and
+// end at the depot and never carry more than one cart, for the least total
+// walking distance; the trips are then dealt to the crews.
+//
+// The first plan comes from Clarke-Wright savings over each bin's nearest
+// neighbors. Every worker thread then runs its own iterated local search
+// from it, with a different seed: ruin a neighborhood of bins, reinsert them
+// where they cost least, and descend with relocate, swap, 2-opt and
+// 2-opt* moves between neighbors (don't-look bits keep a descent local to
+// what changed). A worse plan is accepted while it stays within a threshold
+// that shrinks to zero by the end of the time budget. The best plan of all
+// threads wins.
+
+#define SOLVER_NEIGHBORS       30   // Nearest bins kept per bin (moves and savings)
+#define SOLVER_MOVE_NEIGHBORS  20   // Of those, the ones the local search tries
+#define SOLVER_RUIN_MIN        4
+#define SOLVER_RUIN_MAX        24
+#define SOLVER_ACCEPT_START    0.01 // Worse plans accepted within 1 % at the start
+
+struct RouteTrip {
+  std::vector<int> nodes;   // Bins in visiting order, without the depot
+  float load_l = 0;
+  double meters = 0;
+};
+
+struct SolverOptions {
+  uint32_t threads = 0;      // 0 = one per core
+  uint32_t time_ms = 800;
+  uint64_t iterations = 0;   // Per thread instead of time_ms, for repeatable plans
+  uint32_t seed = 1;
+};
+
+struct SolverStats {
+  double initial_m = 0;      // Savings plan
+  double descent_m = 0;      // Savings plan after one local search descent
+  double best_m = 0;
+  double start_seconds = 0;  // Neighbor lists, savings and the first descent
+  uint64_t iterations = 0;   // All threads
+  uint32_t threads = 0;
+  double seconds = 0;
+};
+
+struct CrewPlan {
+  std::vector<uint32_t> trips;   // Indices into the trip list, in walking order
+  double minutes = 0;
+  double meters = 0;
+};
+
+double route_trip_meters(const RouteProblem& problem, const std::vector<int>& nodes);
+double route_trip_minutes(const RouteTrip& trip, const RouteTiming& timing);
+double route_plan_meters(const std::vector<RouteTrip>& trips);
+
+// Nearest-neighbor walk that heads back to the depot when the cart is full
+// (the plan a crew follows by eye)
+std::vector<RouteTrip> route_nearest_neighbor(const RouteProblem& problem);
+
+// Clarke-Wright savings plan
+std::vector<RouteTrip> route_savings(const RouteProblem& problem);
+
+// Best plan found within the options' budget
+std::vector<RouteTrip> route_solve(const RouteProblem& problem, const SolverOptions& options, SolverStats& stats);
+
+// Deal trips to crews, longest first, each to the crew with the least work
+std::vector<CrewPlan> route_assign_crews(const std::vector<RouteTrip>& trips, uint32_t crews,
+                                         const RouteTiming& timing);
+
+// True when every selected bin is in exactly one trip and no trip is over capacity
+bool route_plan_valid(const RouteProblem& problem, const std::vector<RouteTrip>& trips);